@@ -5,10 +5,13 @@
 #include "port.h"
 
 #include "core/viconfig.h"
+#include "core/vigc.h"
+#include "core/vitracemalloc.h"
 #include "core/viperrun.h"
 
 #include "objects/bytesarrayobject.h"
 #include "objects/codeobject.h"
+#include "objects/dictobject.h"
 #include "objects/floatobject.h"
 #include "objects/intobject.h"
 #include "objects/listobject.h"
@@ -38,26 +38,24 @@ static void error_clear(ViThreadState *tstate)
 
 static ViObject *error_format_string(ViThreadState *tstate, ViObject *exception, const char *string)
 {
-	if (ViException_Check(exception))
+	if (!ViException_Check(exception))
 		return NULL;
 
-	ViObject *result = NULL;
-	ViObject *str1;
-	ViObject *str2;
-
-	str1 = ((ViExceptionObject *)exception)->type;
-	if (str1 == NULL)
-		return NULL;
-	str2 = ViStringObject_FromString(string);
-	if (str2 == NULL)
+	ViObject *type = ((ViExceptionObject *)exception)->type;
+	if (type == NULL)
 		return NULL;
 
-	ViObject *sep_str = ViStringObject_FromString(": ");
-
-	result = (ViObject *)ViString_Concat(ViString_Concat(str1, sep_str), str2);
-	ViObject_XDECREF(str1);
-	ViObject_XDECREF(str2);
-	return result;
+	/* "<type>: <string>" */
+	ViStringWriter writer;
+	ViStringWriter_Init(&writer);
+	if (ViStringWriter_WriteObject(&writer, type) < 0 ||
+		ViStringWriter_WriteBytes(&writer, ": ", 2) < 0 ||
+		ViStringWriter_WriteString(&writer, string) < 0)
+	{
+		ViStringWriter_Dealloc(&writer);
+		return NULL;
+	}
+	return ViStringWriter_Finish(&writer);
 }
 
 static ViObject *error_format(ViThreadState *tstate, ViObject *exception, const char *string)
@@ -71,12 +69,13 @@ static ViObject *error_format(ViThreadState *tstate, ViObject *exception, const
 
 static void error_set_object(ViThreadState *tstate, ViObject *exception, ViObject *value)
 {
-	if (exception == NULL || ViException_Check(exception))
+	if (exception == NULL || !ViException_Check(exception))
 	{
 		error_format(tstate, ViExc_SystemError, "exception is not an Exception object");
 		return;
 	}
 
+	ViObject_XINCREF(exception);
 	ViObject_XINCREF(value);
 	error_restore(tstate, exception, value);
 }
@@ -85,13 +84,30 @@ static void error_print_exception(ViThreadState *tstate)
 {
 	if (error_occured(tstate))
 	{
-		ViStringObject *msg = (ViStringObject *)tstate->curr_exc_value;
-		printf(msg->ob_svar);
+		ViExceptionObject *exc = (ViExceptionObject *)tstate->curr_exc_type;
+		ViObject *value = tstate->curr_exc_value;
 
-		Vi_Exit(((ViExceptionObject *)tstate->curr_exc_type)->exitcode);
+		/* A rope message is flattened first, which fails without memory */
+		const char *msg = value != NULL && ViString_Check(value) ? ViString_AS_STRING(value) : NULL;
+		fputs(msg != NULL ? msg : "error: no message available", stdout);
+
+		Vi_Exit(exc->exitcode);
 	}
 }
 
+/* Messages of ViError_NoMemory(), allocated up front since there may be no
+   memory left when they are needed */
+static ViObject *message_new_static(const char *message)
+{
+	ViObject *msg = ViStringObject_FromString(message);
+	if (msg != NULL)
+		ViObject_SET_IMMORTAL(msg);
+	return msg;
+}
+
+static ViObject *nomemory_message = message_new_static("MemoryError: out of memory");
+static ViObject *memory_limit_message = message_new_static("MemoryError: memory limit exceeded");
+
 /* API Function definitions */
 
 void ViError_SetNone(ViObject *exception)
@@ -145,12 +161,20 @@ void ViError_Print()
 void ViError_NoMemory()
 {
 	ViThreadState *tstate = ViThreadState_GET();
-	if (ViExc_MemoryError == NULL)
+	ViMemAccount *account = ViMem_GetAccount();
+	ViObject *msg = nomemory_message;
+
+	if (account != NULL && account->exceeded)
+	{
+		account->exceeded = 0;
+		msg = memory_limit_message;
+	}
+	if (ViExc_MemoryError == NULL || msg == NULL)
 	{
 		std::cout << "out of memory" << std::endl;
 		return;
 	}
-	ViObject *msg = ViStringObject_FromString("out of memory");
+	/* The message is preallocated, raising needs no memory */
 	error_set_object(tstate, ViExc_MemoryError, msg);
 }
 
@@ -161,6 +185,13 @@ void ViError_BadInternalCall()
 	error_set_object(tstate, ViExc_SystemError, msg);
 }
 
+static void exception_dealloc(ViExceptionObject *self)
+{
+	ViObject_XDECREF(self->type);
+	ViObject_XDECREF(self->context);
+	Vi_TYPE(self)->tp_free((ViObject *)self);
+}
+
 ViObject *ViExceptionObject_New(const char *type, int exitcode)
 {
 	ViExceptionObject *exc = ViObject_NEW(ViExceptionObject, &ViExceptionType);
@@ -182,26 +213,47 @@ ViTypeObject ViExceptionType = {
 	0,										    // tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	    // tp_flags
 		TPFLAGS_BASE_EXC_SUBCLASS,
-	0,										    // tp_dealloc
+	(destructor)exception_dealloc,			    // tp_dealloc
 	0,										    // tp_number_methods
 	0,                  					    // tp_sequence_methods
+	0,										    // tp_hash
+	0,										    // tp_traverse
 	0,										    // tp_clear
+	0,										    // tp_richcompare
 	0,										    // tp_base
 	0,										    // tp_dict
 	0,										    // tp_new
-	Mem_Free								    // tp_free
+	ViObject_Free,								// tp_free
+	0,										    // tp_cached_keys
 };
 
-ViObject *ViExc_Exception = ViExceptionObject_New("Exception", 1);
-ViObject *ViExc_TypeError = ViExceptionObject_New("TypeError", 2);
-ViObject *ViExc_IndexError = ViExceptionObject_New("IndexError", 3);
-ViObject *ViExc_ValueError = ViExceptionObject_New("ValueError", 4);
-
-ViObject *ViExc_SyntaxError = ViExceptionObject_New("SyntaxError", 5);
-ViObject *ViExc_IndentationError = ViExceptionObject_New("IndentationError", 6);
-ViObject *ViExc_TabError = ViExceptionObject_New("TabError", 7);
+/* The predefined exceptions live for the whole process */
+static ViObject *exception_new_static(const char *type, int exitcode)
+{
+	ViObject *exc = ViExceptionObject_New(type, exitcode);
+	if (exc != NULL)
+	{
+		if (((ViExceptionObject *)exc)->type != NULL)
+			ViObject_SET_IMMORTAL(((ViExceptionObject *)exc)->type);
+		ViObject_SET_IMMORTAL(exc);
+	}
+	return exc;
+}
 
-ViObject *ViExc_KeyboardInterrupt = ViExceptionObject_New("KeyboardInterrupt", 8);
-ViObject *ViExc_MemoryError = ViExceptionObject_New("MemoryError", 9);
-ViObject *ViExc_SystemError = ViExceptionObject_New("SystemError", 10);
-ViObject *ViExc_RuntimeError = ViExceptionObject_New("RuntimeError", 11);
\ No newline at end of file
+ViObject *ViExc_Exception = exception_new_static("Exception", 1);
+ViObject *ViExc_TypeError = exception_new_static("TypeError", 2);
+ViObject *ViExc_IndexError = exception_new_static("IndexError", 3);
+ViObject *ViExc_ValueError = exception_new_static("ValueError", 4);
+
+ViObject *ViExc_SyntaxError = exception_new_static("SyntaxError", 5);
+ViObject *ViExc_IndentationError = exception_new_static("IndentationError", 6);
+ViObject *ViExc_TabError = exception_new_static("TabError", 7);
+
+ViObject *ViExc_KeyboardInterrupt = exception_new_static("KeyboardInterrupt", 8);
+ViObject *ViExc_MemoryError = exception_new_static("MemoryError", 9);
+ViObject *ViExc_SystemError = exception_new_static("SystemError", 10);
+ViObject *ViExc_RuntimeError = exception_new_static("RuntimeError", 11);
+ViObject *ViExc_OverflowError = exception_new_static("OverflowError", 12);
+ViObject *ViExc_ZeroDivisionError = exception_new_static("ZeroDivisionError", 13);
+ViObject *ViExc_KeyError = exception_new_static("KeyError", 14);
+ViObject *ViExc_UnicodeError = exception_new_static("UnicodeError", 15);
\ No newline at end of file
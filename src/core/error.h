@@ -36,13 +36,15 @@ typedef struct _viexceptionobject
 
 ViObject *ViExceptionObject_New(const char *type, int exitcode);
 
-#define ViException_Check(self) ViType_HasFeature((ViTypeObject*)self, TPFLAGS_BASE_EXC_SUBCLASS)
+#define ViException_Check(self) ViType_HasFeature(Vi_TYPE(self), TPFLAGS_BASE_EXC_SUBCLASS)
 
 /* Predefined exceptions */
 extern ViObject *ViExc_Exception;
 extern ViObject *ViExc_TypeError;
 extern ViObject *ViExc_IndexError;
 extern ViObject *ViExc_ValueError;
+extern ViObject *ViExc_KeyError;
+extern ViObject *ViExc_UnicodeError;
 
 extern ViObject *ViExc_SyntaxError;
 extern ViObject *ViExc_IndentationError;
@@ -52,5 +54,7 @@ extern ViObject *ViExc_KeyboardInterrupt;
 extern ViObject *ViExc_MemoryError;
 extern ViObject *ViExc_SystemError;
 extern ViObject *ViExc_RuntimeError;
+extern ViObject *ViExc_OverflowError;
+extern ViObject *ViExc_ZeroDivisionError;
 
 #endif // __ERROR_H__
\ No newline at end of file
@@ -17,12 +17,20 @@ ViInterpreterState* ViInterpreter_New()
 
     ViConfig_InitViperConfig(&interp->config);
 
+    memset(&interp->arena_usage, 0, sizeof(interp->arena_usage));
+    if (ViMem_InitAccount(&interp->mem_account) < 0)
+    {
+        Mem_Free(interp);
+        return NULL;
+    }
+
 	struct _runtimestate::_interpreters *interpreters = &runtime->interpreters;
 
     if (interpreters->next_id < 0)
     {
         /* overflow or Py_Initialize() not called! */
         ViError_SetString(ViExc_RuntimeError, "failed to get an interpreter ID");
+        ViMem_ReleaseAccount(&interp->mem_account);
         Mem_Free(interp);
         interp = NULL;
     }
@@ -32,7 +40,10 @@ ViInterpreterState* ViInterpreter_New()
         interpreters->next_id += 1;
         interp->next = interpreters->head;
         if (interpreters->main == NULL)
+        {
             interpreters->main = interp;
+            ViMem_SetAccount(&interp->mem_account);
+        }
         interpreters->head = interp;
     }
 
@@ -46,3 +57,13 @@ const ViConfig *ViInterpreterState_GetConfig(ViInterpreterState *interp)
 {
     return &interp->config;
 }
+
+void ViInterpreterState_SetMemoryLimit(ViInterpreterState *interp, size_t limit)
+{
+    ViMem_SetAccountLimit(&interp->mem_account, limit);
+}
+
+size_t ViInterpreterState_GetMemoryUsage(ViInterpreterState *interp)
+{
+    return interp->mem_account.used;
+}
\ No newline at end of file
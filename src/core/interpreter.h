@@ -3,7 +3,9 @@
 
 #include "../port.h"
 #include "thread.h"
+#include "viarena.h"
 #include "viconfig.h"
+#include "vimem.h"
 #include "../objects/object.h"
 
 struct _runtimestate; // Defined in "runtime.h"
@@ -20,10 +22,20 @@ typedef struct _interpreterstate
 	ViThreadState* thread;
 
 	ViConfig config;
+
+	ViArenaUsage arena_usage; // Usage of the arenas created by the interpreter
+	ViMemAccount mem_account; // Memory charged to the interpreter, see vimem.h
 } ViInterpreterState;
 
 ViInterpreterState* ViInterpreter_New();
 
 const ViConfig *ViInterpreterState_GetConfig(ViInterpreterState *interp);
 
+/* Hard limit on the memory charged to the interpreter, 0 for no limit.
+   Allocations over the limit fail with a MemoryError. */
+void ViInterpreterState_SetMemoryLimit(ViInterpreterState *interp, size_t limit);
+
+/* Bytes currently charged to the interpreter */
+size_t ViInterpreterState_GetMemoryUsage(ViInterpreterState *interp);
+
 #endif // __INTERPRETER_H__
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "runtime.h"
 
+#include "viarena.h"
+
 ViStatus ViRuntimeState_Init(ViRuntimeState& runtime)
 {
 	runtime.interpreters.next_id = 0;
@@ -14,6 +16,9 @@ void ViRuntimeState_Finalize(ViRuntimeState& runtime)
 	if (!runtime.initialized)
 		return;
 
+	ViArena_ClearCache(runtime.interpreters.main->thread);
+	ViThreadState_Swap(NULL);
+	ViMem_ReleaseAccount(&runtime.interpreters.main->mem_account);
 	Mem_Free(runtime.interpreters.main->thread);
 	Mem_Free(runtime.interpreters.main);
 
@@ -22,10 +27,14 @@ void ViRuntimeState_Finalize(ViRuntimeState& runtime)
 
 ViThreadState* ViRuntimeState_GetThreadState(ViRuntimeState* runtime)
 {
+	if (runtime->tstate_current != NULL)
+		return runtime->tstate_current;
 	return runtime->interpreters.main->thread;
 }
 
 ViInterpreterState *ViRuntimeState_GetInterpreterState(ViRuntimeState *runtime)
 {
+	if (runtime->tstate_current != NULL)
+		return runtime->tstate_current->interp;
 	return runtime->interpreters.main;
 }
@@ -22,6 +22,8 @@ typedef struct _runtimestate
 		int64_t next_id;
 	} interpreters;
 
+	ViThreadState *tstate_current; // The running thread, see ViThreadState_Swap()
+
 	ViPreConfig preconfig;
 } ViRuntimeState;
 
@@ -2,6 +2,7 @@
 
 #include "vimem.h"
 #include "interpreter.h"
+#include "runtime.h"
 
 ViThreadState* ViThreadState_New(_interpreterstate* interp)
 {
@@ -14,7 +15,23 @@ ViThreadState* ViThreadState_New(_interpreterstate* interp)
 	tstate->curr_exc_type = NULL;
 	tstate->curr_exc_value = NULL;
 
+	tstate->arena_cache = NULL;
+	tstate->arena_cache_size = 0;
+
 	interp->thread = tstate;
 
+	if (ViRuntime.tstate_current == NULL)
+		ViThreadState_Swap(tstate);
+
 	return tstate;
 }
+
+ViThreadState* ViThreadState_Swap(ViThreadState* tstate)
+{
+	ViThreadState* old = ViRuntime.tstate_current;
+
+	ViRuntime.tstate_current = tstate;
+	ViMem_SetAccount(tstate != NULL ? &tstate->interp->mem_account : NULL);
+
+	return old;
+}
@@ -5,6 +5,7 @@
 #include "../objects/object.h"
 
 struct _interpreterstate; // Defined in "interpreter.h"
+struct _arena; // Defined in "viarena.cpp"
 
 typedef struct _vithreadstate
 {
@@ -13,8 +14,17 @@ typedef struct _vithreadstate
     /* The exception currently being raised */
     ViObject* curr_exc_type;
     ViObject* curr_exc_value;
+
+    /* Reset arenas kept for reuse, see ViArena_Acquire() */
+    struct _arena* arena_cache;
+    int arena_cache_size;
 } ViThreadState;
 
 ViThreadState* ViThreadState_New(_interpreterstate* interp);
 
+/* Make tstate the running thread state and the account of its
+   interpreter the current memory account.  Returns the previous one,
+   tstate may be NULL. */
+ViThreadState* ViThreadState_Swap(ViThreadState* tstate);
+
 #endif // __THREAD_H__
\ No newline at end of file
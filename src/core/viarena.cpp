@@ -2,6 +2,7 @@
 
 #include "vimem.h"
 #include "error.h"
+#include "runtime.h"
 #include "../objects/listobject.h"
 
 /* A simple arena block structure.
@@ -10,13 +11,22 @@
    allocation is about 20 bytes and that most compiles use a single
    block.
 
-   TODO: Think about a realloc API, maybe just for the last
-   allocation?
+   ViArena_Realloc() resizes the last allocation in place, which lets
+   growable buffers live in the arena as long as they are the most
+   recent thing allocated.
+
+   Blocks come from the block provider (ViMem_BlockAlloc()), the size
+   of the default blocks is its arena_block_size setting.  Big modules
+   compile with fewer blocks and less TLB pressure if it is raised.
 */
 
-#define DEFAULT_BLOCK_SIZE	8192
 #define ALIGNMENT			8
 
+/* Blocks kept by an arena released to the thread cache */
+#define CACHE_KEEP_BLOCKS	1
+/* Arenas kept by each thread cache */
+#define MAX_CACHED_ARENAS	4
+
 typedef struct _block
 {
     /* Total number of bytes owned by this block available to pass out.
@@ -40,6 +50,9 @@ typedef struct _block
      * only after initialization.
      */
     void *ab_mem;
+
+    /* The account charged for the block, see vimem.h */
+    unsigned int ab_owner;
 } block;
 
 /* The arena manages two kinds of memory, blocks of raw memory
@@ -55,10 +68,8 @@ typedef struct _arena
      */
     block *a_head;
 
-    /* Pointer to the block currently used for allocation.  Its
-       ab_next field should be NULL.  If it is not-null after a
-       call to block_alloc(), it means a new block has been allocated
-       and a_cur should be reset to point it.
+    /* Pointer to the block currently used for allocation.  The blocks
+       after it, if any, are empty blocks kept by ViArena_Reset().
      */
     block *a_cur;
 
@@ -68,27 +79,116 @@ typedef struct _arena
     */
     ViObject *a_objects;
 
-#ifdef Vi_DEBUG
-    /* Debug output */
-    size_t total_allocs;
-    size_t total_size;
-    size_t total_blocks;
-    size_t total_block_size;
-    size_t total_big_blocks;
-#endif
+    /* Next arena in the thread's arena cache */
+    struct _arena *a_cache_next;
+
+    /* Interpreter the arena is accounted to, may be NULL */
+    ViInterpreterState *a_interp;
+
+    /* Statistics since the arena was created or last reset */
+    ViArenaStats a_stats;
 };
 
+/* Usage of all arenas in the process */
+static ViArenaUsage global_usage;
+
+//
+//
+//		Statistics
+//
+//
+
+static inline void stats_init(ViArenaStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+static void stats_merge(ViArenaStats *to, const ViArenaStats *from)
+{
+    to->allocs += from->allocs;
+    to->alloc_bytes += from->alloc_bytes;
+    to->blocks += from->blocks;
+    to->block_bytes += from->block_bytes;
+    to->big_blocks += from->big_blocks;
+    to->wasted_bytes += from->wasted_bytes;
+    to->objects += from->objects;
+}
+
+/* Account for a change of the number of live arenas and of the block
+   bytes they hold */
+static void usage_update(ViArenaUsage *usage, Vi_size_t arenas, Vi_size_t block_bytes)
+{
+    usage->live_arenas += arenas;
+    usage->live_block_bytes += block_bytes;
+    if (usage->live_block_bytes > usage->peak_live_block_bytes)
+        usage->peak_live_block_bytes = usage->live_block_bytes;
+}
+
+/* Fold the statistics of an arena into the totals, done when it is
+   freed or reset */
+static void usage_retire(ViArenaUsage *usage, const ViArenaStats *stats)
+{
+    usage->arenas++;
+    stats_merge(&usage->totals, stats);
+    if (stats->block_bytes > usage->peak_arena_block_bytes)
+        usage->peak_arena_block_bytes = stats->block_bytes;
+}
+
+static void arena_usage_update(ViArena *arena, Vi_size_t arenas, Vi_size_t block_bytes)
+{
+    usage_update(&global_usage, arenas, block_bytes);
+    if (arena->a_interp != NULL)
+        usage_update(&arena->a_interp->arena_usage, arenas, block_bytes);
+}
+
+static void arena_usage_retire(ViArena *arena)
+{
+    usage_retire(&global_usage, &arena->a_stats);
+    if (arena->a_interp != NULL)
+        usage_retire(&arena->a_interp->arena_usage, &arena->a_stats);
+}
+
+//
+//
+//		Blocks
+//
+//
+
+/* Offset of the first aligned byte of a block */
+static inline size_t block_start(block *b)
+{
+    return (char *)Vi_ALIGN_UP(b->ab_mem, ALIGNMENT) - (char *)(b->ab_mem);
+}
+
+/* Usable bytes of a default block, the configured block size includes
+   the header */
+static size_t default_block_size()
+{
+    ViMemBlockConfig config;
+    ViMem_GetBlockConfig(&config);
+    return config.arena_block_size - sizeof(block);
+}
+
 static block *block_new(size_t size)
 {
-    /* Allocate header and block as one unit.
+    /* Allocate header and block as one unit from the block provider,
+       it rounds up to whole pages and the rest is usable too.
        ab_mem points just past header. */
-    block *b = (block *)Mem_Alloc(sizeof(block) + size);
+    size_t total = ViMem_BlockSize(sizeof(block) + size);
+    unsigned int owner = ViMem_CurrentOwner();
+    if (ViMem_Charge(owner, total) < 0)
+        return NULL;
+    block *b = (block *)ViMem_BlockAlloc(total);
     if (!b)
+    {
+        ViMem_Credit(owner, total);
         return NULL;
-    b->ab_size = size;
+    }
+    b->ab_owner = owner;
+    b->ab_size = total - sizeof(block);
     b->ab_mem = (void *)(b + 1);
     b->ab_next = NULL;
-    b->ab_offset = (char *)Vi_ALIGN_UP(b->ab_mem, ALIGNMENT) - (char *)(b->ab_mem);
+    b->ab_offset = block_start(b);
     return b;
 }
 
@@ -97,30 +197,50 @@ static void block_free(block *b)
     while (b)
     {
         block *next = b->ab_next;
-        Mem_Free(b);
+        ViMem_Credit(b->ab_owner, sizeof(block) + b->ab_size);
+        ViMem_BlockFree(b, sizeof(block) + b->ab_size);
         b = next;
     }
 }
 
-static void *block_alloc(block *b, size_t size)
+/* Allocate from the arena's current block, moving on to the next block
+   when it is full */
+static void *block_alloc(ViArena *arena, size_t size)
 {
     void *p;
+    block *b = arena->a_cur;
     assert(b);
     size = Vi_SIZE_ROUND_UP(size, ALIGNMENT);
     if (b->ab_offset + size > b->ab_size)
     {
-        /* If we need to allocate more memory than will fit in
-           the default block, allocate a one-off block that is
-           exactly the right size. */
-        /* TODO:Think about space waste at end of block */
-        block *newbl = block_new(
-            size < DEFAULT_BLOCK_SIZE ?
-            DEFAULT_BLOCK_SIZE : size);
-        if (!newbl)
-            return NULL;
-        assert(!b->ab_next);
-        b->ab_next = newbl;
-        b = newbl;
+        block *next = b->ab_next;
+        /* Blocks after the current one are empty blocks kept by
+           ViArena_Reset(), use the next one if it is big enough */
+        if (next == NULL || next->ab_offset + size > next->ab_size)
+        {
+            /* If we need to allocate more memory than will fit in
+               the default block, allocate a one-off block that is
+               exactly the right size. */
+            size_t default_size = default_block_size();
+            block *newbl = block_new(
+                size < default_size ?
+                default_size : size);
+            if (!newbl)
+                return NULL;
+            newbl->ab_next = next;
+            b->ab_next = newbl;
+            next = newbl;
+
+            arena->a_stats.blocks++;
+            arena->a_stats.block_bytes += newbl->ab_size;
+            if (size > default_size)
+                arena->a_stats.big_blocks++;
+            arena_usage_update(arena, 0, newbl->ab_size);
+        }
+        /* The tail of the block we leave is never used */
+        arena->a_stats.wasted_bytes += b->ab_size - b->ab_offset;
+        b = next;
+        arena->a_cur = b;
     }
 
     assert(b->ab_offset + size <= b->ab_size);
@@ -129,6 +249,12 @@ static void *block_alloc(block *b, size_t size)
     return p;
 }
 
+//
+//
+//		Arenas
+//
+//
+
 ViArena *ViArena_New()
 {
     ViArena *arena = (ViArena *)Mem_Alloc(sizeof(ViArena));
@@ -138,7 +264,7 @@ ViArena *ViArena_New()
         return NULL;
     }
 
-    arena->a_head = block_new(DEFAULT_BLOCK_SIZE);
+    arena->a_head = block_new(default_block_size());
     arena->a_cur = arena->a_head;
     if (!arena->a_head)
     {
@@ -154,13 +280,13 @@ ViArena *ViArena_New()
         ViError_NoMemory();
         return NULL;
     }
-#ifdef Vi_DEBUG
-    arena->total_allocs = 0;
-    arena->total_size = 0;
-    arena->total_blocks = 1;
-    arena->total_block_size = DEFAULT_BLOCK_SIZE;
-    arena->total_big_blocks = 0;
-#endif
+    arena->a_cache_next = NULL;
+    arena->a_interp = ViInterpreterState_GET();
+
+    stats_init(&arena->a_stats);
+    arena->a_stats.blocks = 1;
+    arena->a_stats.block_bytes = arena->a_head->ab_size;
+    arena_usage_update(arena, 1, arena->a_head->ab_size);
     return arena;
 }
 
@@ -169,11 +295,14 @@ void ViArena_Free(ViArena *arena)
     assert(arena);
 #ifdef Vi_DEBUG
     fprintf(stderr,
-            "alloc=%zu size=%zu blocks=%zu block_size=%zu big=%zu objects=%zu\n",
-            arena->total_allocs, arena->total_size, arena->total_blocks,
-            arena->total_block_size, arena->total_big_blocks,
-            ViList_GET_SIZE(arena->a_objects));
+            "alloc=%zu size=%zu blocks=%zu block_size=%zu big=%zu wasted=%zu objects=%zu\n",
+            arena->a_stats.allocs, arena->a_stats.alloc_bytes, arena->a_stats.blocks,
+            arena->a_stats.block_bytes, arena->a_stats.big_blocks,
+            arena->a_stats.wasted_bytes, arena->a_stats.objects);
 #endif
+    arena_usage_retire(arena);
+    arena_usage_update(arena, -1, -(Vi_size_t)arena->a_stats.block_bytes);
+
     block_free(arena->a_head);
     /* This property normally holds, except when the code being compiled
        is sys.getobjects(0), in which case there will be two references.
@@ -186,27 +315,51 @@ void ViArena_Free(ViArena *arena)
 
 void *ViArena_Alloc(ViArena *arena, size_t size)
 {
-    void *p = block_alloc(arena->a_cur, size);
+    void *p = block_alloc(arena, size);
     if (!p)
     {
         ViError_NoMemory();
         return NULL;
     }
-#ifdef Vi_DEBUG
-    arena->total_allocs++;
-    arena->total_size += size;
-#endif
-    /* Reset cur if we allocated a new block. */
-    if (arena->a_cur->ab_next)
+    arena->a_stats.allocs++;
+    arena->a_stats.alloc_bytes += size;
+    return p;
+}
+
+/* Is ptr, a block of size bytes, the last allocation passed out of b? */
+static int block_is_last(block *b, void *ptr, size_t size)
+{
+    size = Vi_SIZE_ROUND_UP(size, ALIGNMENT);
+    return (char *)ptr + size == (char *)b->ab_mem + b->ab_offset;
+}
+
+void *ViArena_Realloc(ViArena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    void *p;
+    block *b = arena->a_cur;
+
+    if (ptr == NULL)
+        return ViArena_Alloc(arena, new_size);
+
+    if (block_is_last(b, ptr, old_size))
     {
-        arena->a_cur = arena->a_cur->ab_next;
-#ifdef Vi_DEBUG
-        arena->total_blocks++;
-        arena->total_block_size += arena->a_cur->ab_size;
-        if (arena->a_cur->ab_size > DEFAULT_BLOCK_SIZE)
-            ++arena->total_big_blocks;
-#endif
+        /* Offset of ptr inside the block, new_size bytes have to fit
+           between there and the end of the block */
+        size_t start = (char *)ptr - (char *)b->ab_mem;
+        if (new_size <= b->ab_size - start)
+        {
+            b->ab_offset = start + Vi_SIZE_ROUND_UP(new_size, ALIGNMENT);
+            arena->a_stats.alloc_bytes += new_size - old_size;
+            return ptr;
+        }
     }
+    else if (new_size <= old_size)
+        return ptr;
+
+    p = ViArena_Alloc(arena, new_size);
+    if (p == NULL)
+        return NULL;
+    memcpy(p, ptr, old_size < new_size ? old_size : new_size);
     return p;
 }
 
@@ -214,6 +367,108 @@ int ViArena_AddViObject(ViArena *arena, ViObject *obj)
 {
     int result = ViList_Append(arena->a_objects, obj);
     if (result >= 0)
+    {
         ViObject_DECREF(obj);
+        arena->a_stats.objects++;
+    }
     return result;
 }
+
+void ViArena_Reset(ViArena *arena, size_t keep_blocks)
+{
+    block *b = arena->a_head;
+    Vi_size_t i, n;
+    ViObject **items;
+    size_t blocks = 0, block_bytes = 0;
+
+    assert(arena);
+    if (keep_blocks < 1)
+        keep_blocks = 1;
+
+    arena_usage_retire(arena);
+
+    /* Empty the kept blocks and free the others */
+    for (;;)
+    {
+        b->ab_offset = block_start(b);
+        blocks++;
+        block_bytes += b->ab_size;
+        if (b->ab_next == NULL)
+            break;
+        if (blocks == keep_blocks)
+        {
+            block_free(b->ab_next);
+            b->ab_next = NULL;
+            break;
+        }
+        b = b->ab_next;
+    }
+    arena->a_cur = arena->a_head;
+
+    /* Drop the objects but keep the list and its item vector.  The size
+       is cleared first so the list is consistent while DECREFing. */
+    n = ViList_GET_SIZE(arena->a_objects);
+    items = ((ViListObject *)arena->a_objects)->ob_items;
+    VAROBJECT_SET_SIZE(arena->a_objects, 0);
+    for (i = 0; i < n; i++)
+        ViObject_DECREF(items[i]);
+
+    arena_usage_update(arena, 0, (Vi_size_t)block_bytes - (Vi_size_t)arena->a_stats.block_bytes);
+    stats_init(&arena->a_stats);
+    arena->a_stats.blocks = blocks;
+    arena->a_stats.block_bytes = block_bytes;
+}
+
+ViArena *ViArena_Acquire()
+{
+    ViThreadState *tstate = ViThreadState_GET();
+    ViArena *arena = tstate->arena_cache;
+
+    if (arena == NULL)
+        return ViArena_New();
+    tstate->arena_cache = arena->a_cache_next;
+    tstate->arena_cache_size--;
+    arena->a_cache_next = NULL;
+    return arena;
+}
+
+void ViArena_Release(ViArena *arena)
+{
+    ViThreadState *tstate = ViThreadState_GET();
+
+    if (tstate->arena_cache_size >= MAX_CACHED_ARENAS)
+    {
+        ViArena_Free(arena);
+        return;
+    }
+    ViArena_Reset(arena, CACHE_KEEP_BLOCKS);
+    arena->a_cache_next = tstate->arena_cache;
+    tstate->arena_cache = arena;
+    tstate->arena_cache_size++;
+}
+
+void ViArena_ClearCache(ViThreadState *tstate)
+{
+    while (tstate->arena_cache != NULL)
+    {
+        ViArena *arena = tstate->arena_cache;
+        tstate->arena_cache = arena->a_cache_next;
+        ViArena_Free(arena);
+    }
+    tstate->arena_cache_size = 0;
+}
+
+void ViArena_GetStats(ViArena *arena, ViArenaStats *stats)
+{
+    *stats = arena->a_stats;
+}
+
+void ViArena_GetInterpreterUsage(ViInterpreterState *interp, ViArenaUsage *usage)
+{
+    *usage = interp->arena_usage;
+}
+
+void ViArena_GetGlobalUsage(ViArenaUsage *usage)
+{
+    *usage = global_usage;
+}
\ No newline at end of file
@@ -3,14 +3,66 @@
 
 #include "../port.h"
 #include "../objects/object.h"
+#include "thread.h"
+
+struct _interpreterstate; // Defined in "interpreter.h"
 
 typedef struct _arena ViArena;
 
+/* Statistics of one arena, since it was created or last reset */
+typedef struct _arenastats
+{
+	size_t allocs;			// Allocations passed out
+	size_t alloc_bytes;		// Bytes requested
+	size_t blocks;			// Blocks owned
+	size_t block_bytes;		// Bytes owned by the blocks
+	size_t big_blocks;		// One-off blocks larger than the default block size
+	size_t wasted_bytes;	// Bytes left unused at the tail of full blocks
+	size_t objects;			// ViObjects added with ViArena_AddViObject()
+} ViArenaStats;
+
+/* Arena usage of an interpreter or of the whole process */
+typedef struct _arenausage
+{
+	ViArenaStats totals;			// Sum of the statistics of retired arenas
+	size_t arenas;					// Arenas retired (freed or reset)
+	size_t live_arenas;				// Arenas currently alive
+	size_t live_block_bytes;		// Bytes owned by the blocks of live arenas
+	size_t peak_live_block_bytes;	// High-water mark of live_block_bytes
+	size_t peak_arena_block_bytes;	// Most bytes owned by a single arena
+} ViArenaUsage;
+
 ViArena *ViArena_New();
 void ViArena_Free(ViArena *arena);
 
 void *ViArena_Alloc(ViArena *arena, size_t size);
 
+/* Resize an allocation of old_size bytes.  The most recent allocation is
+   grown or shrunk in place when it fits its block, anything else is
+   copied to a new allocation and the old bytes stay unused until the
+   arena is freed.  A NULL ptr behaves like ViArena_Alloc(). */
+void *ViArena_Realloc(ViArena *arena, void *ptr, size_t old_size, size_t new_size);
+
 int ViArena_AddViObject(ViArena *arena, ViObject *obj);
 
+/* Rewind the arena so it can be used again as if it was new.  The
+   objects are DECREFed, the first keep_blocks blocks (at least one) are
+   kept and emptied, the rest is freed. */
+void ViArena_Reset(ViArena *arena, size_t keep_blocks);
+
+/* Get an empty arena from the current thread's cache, or a new one */
+ViArena *ViArena_Acquire();
+
+/* Reset the arena and put it in the current thread's cache for the next
+   ViArena_Acquire(), it is freed if the cache is full */
+void ViArena_Release(ViArena *arena);
+
+/* Free all arenas cached by the thread */
+void ViArena_ClearCache(ViThreadState *tstate);
+
+/* Statistics */
+void ViArena_GetStats(ViArena *arena, ViArenaStats *stats);
+void ViArena_GetInterpreterUsage(struct _interpreterstate *interp, ViArenaUsage *usage);
+void ViArena_GetGlobalUsage(ViArenaUsage *usage);
+
 #endif // __VIARENA_H__
\ No newline at end of file
@@ -0,0 +1,275 @@
+#define Vi_MEM_NO_SITES
+#include "vimem.h"
+
+#ifdef MS_WINDOWS
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <unistd.h>
+#	if defined(MAP_ANONYMOUS) || defined(MAP_ANON)
+#		define Vi_HAVE_MMAP
+#		ifndef MAP_ANONYMOUS
+#			define MAP_ANONYMOUS MAP_ANON
+#		endif
+#	endif
+#endif
+
+/* The block provider hands out big blocks of memory for the ViArena
+   blocks and the object allocator's arenas.
+
+   Blocks of at least MMAP_THRESHOLD bytes are mapped directly from the
+   OS where possible, so they are page aligned and do not fragment the
+   malloc heap.  Smaller blocks come from the raw allocator, a mapping
+   each would cost a system call on every allocation and free.  With
+   huge_pages set, mapped blocks of at least HUGE_PAGE_SIZE are aligned
+   to a huge page and advised for transparent huge pages.  Freed mapped
+   blocks are kept in a small cache for reuse with their pages given back
+   to the OS (MADV_DONTNEED / MEM_DECOMMIT), the address range stays
+   reserved but costs no memory.  Without mmap all blocks come from the
+   raw allocator.
+
+   The provider is not thread safe, callers must serialize access.
+*/
+
+#define DEFAULT_ARENA_BLOCK_SIZE	8192
+#define MIN_ARENA_BLOCK_SIZE		1024
+#define DEFAULT_CACHE_BLOCKS		8
+#define MAX_CACHE_BLOCKS			64
+
+/* Blocks below this size come from the raw allocator */
+#define MMAP_THRESHOLD				(64 * 1024)
+
+/* Transparent huge pages are only used for ranges of at least this size */
+#define HUGE_PAGE_SIZE				(2 * 1024 * 1024)
+
+typedef struct _cachedblock
+{
+	void *address;
+	size_t size;
+} cached_block;
+
+static ViMemBlockConfig block_config = {
+	DEFAULT_ARENA_BLOCK_SIZE,	// arena_block_size
+	0,							// huge_pages
+	DEFAULT_CACHE_BLOCKS		// cache_blocks
+};
+
+static ViMemBlockStats block_stats;
+
+static cached_block block_cache[MAX_CACHE_BLOCKS];
+static int nblock_cache = 0;
+
+static size_t page_size()
+{
+	static size_t size = 0;
+	if (size == 0)
+	{
+#ifdef MS_WINDOWS
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		size = info.dwPageSize;
+#elif defined(Vi_HAVE_MMAP)
+		long ps = sysconf(_SC_PAGESIZE);
+		size = ps > 0 ? (size_t)ps : 4096;
+#else
+		size = 4096;
+#endif
+	}
+	return size;
+}
+
+//
+//
+//		OS memory
+//
+//
+
+/* Whether blocks of this size are mapped from the OS.  The block size
+   alone decides it, so os_free() needs no record of how a block was
+   obtained. */
+static inline int block_is_mapped(size_t size)
+{
+#if defined(MS_WINDOWS) || defined(Vi_HAVE_MMAP)
+	return size >= MMAP_THRESHOLD;
+#else
+	return 0;
+#endif
+}
+
+#ifdef Vi_HAVE_MMAP
+/* Map a block aligned to a huge page, so all of it can be backed by huge
+   pages.  Maps enough to find an aligned range in and unmaps the rest. */
+static void *os_alloc_huge(size_t size)
+{
+	size_t span = size + HUGE_PAGE_SIZE - page_size();
+	char *base = (char *)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	char *ptr = (char *)Vi_SIZE_ROUND_UP((uintptr_t)base, HUGE_PAGE_SIZE);
+	size_t head = ptr - base;
+	size_t tail = span - head - size;
+	if (head != 0)
+		munmap(base, head);
+	if (tail != 0)
+		munmap(ptr + size, tail);
+#	ifdef MADV_HUGEPAGE
+	(void)madvise(ptr, size, MADV_HUGEPAGE);
+#	endif
+	return ptr;
+}
+#endif
+
+static void *os_alloc(size_t size)
+{
+	if (!block_is_mapped(size))
+		return ViMem_RawMalloc(size);
+#ifdef MS_WINDOWS
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#elif defined(Vi_HAVE_MMAP)
+	if (block_config.huge_pages && size >= HUGE_PAGE_SIZE)
+		return os_alloc_huge(size);
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+#else
+	return NULL;
+#endif
+}
+
+static void os_free(void *ptr, size_t size)
+{
+	if (!block_is_mapped(size))
+	{
+		ViMem_RawFree(ptr);
+		return;
+	}
+#ifdef MS_WINDOWS
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(Vi_HAVE_MMAP)
+	munmap(ptr, size);
+#endif
+}
+
+/* Give the pages of a block back to the OS but keep the address range */
+static void os_release_pages(void *ptr, size_t size)
+{
+#ifdef MS_WINDOWS
+	VirtualFree(ptr, size, MEM_DECOMMIT);
+#elif defined(Vi_HAVE_MMAP) && defined(MADV_DONTNEED)
+	(void)madvise(ptr, size, MADV_DONTNEED);
+#endif
+}
+
+/* Make the pages of a cached block usable again, returns 0 on failure */
+static int os_reuse_pages(void *ptr, size_t size)
+{
+#ifdef MS_WINDOWS
+	return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+	(void)ptr;
+	(void)size;
+	return 1; // Pages are faulted in again on first touch
+#endif
+}
+
+//
+//
+//		API Functions
+//
+//
+
+size_t ViMem_BlockSize(size_t size)
+{
+	size_t ps = page_size();
+	return Vi_SIZE_ROUND_UP(size, ps);
+}
+
+void *ViMem_BlockAlloc(size_t size)
+{
+	void *ptr = NULL;
+
+	if (size == 0 || size > (size_t)VI_SIZE_T_MAX - page_size())
+		return NULL;
+	size = ViMem_BlockSize(size);
+
+	/* Look for a cached block of the same size, most recent first */
+	for (int i = nblock_cache - 1; i >= 0; i--)
+	{
+		if (block_cache[i].size == size)
+		{
+			ptr = block_cache[i].address;
+			block_cache[i] = block_cache[--nblock_cache];
+			if (!os_reuse_pages(ptr, size))
+			{
+				os_free(ptr, size);
+				ptr = NULL;
+				break;
+			}
+			block_stats.cache_hits++;
+			break;
+		}
+	}
+
+	if (ptr == NULL)
+	{
+		ptr = os_alloc(size);
+		if (ptr == NULL)
+			return NULL;
+	}
+
+	block_stats.blocks++;
+	block_stats.bytes += size;
+	if (block_stats.bytes > block_stats.peak_bytes)
+		block_stats.peak_bytes = block_stats.bytes;
+	return ptr;
+}
+
+void ViMem_BlockFree(void *ptr, size_t size)
+{
+	if (ptr == NULL)
+		return;
+	size = ViMem_BlockSize(size);
+
+	block_stats.blocks--;
+	block_stats.bytes -= size;
+
+	if (block_is_mapped(size) && nblock_cache < block_config.cache_blocks)
+	{
+		os_release_pages(ptr, size);
+		block_cache[nblock_cache].address = ptr;
+		block_cache[nblock_cache].size = size;
+		nblock_cache++;
+		return;
+	}
+	os_free(ptr, size);
+}
+
+void ViMem_GetBlockConfig(ViMemBlockConfig *config)
+{
+	*config = block_config;
+}
+
+int ViMem_SetBlockConfig(const ViMemBlockConfig *config)
+{
+	if (config->arena_block_size < MIN_ARENA_BLOCK_SIZE ||
+		config->cache_blocks < 0 || config->cache_blocks > MAX_CACHE_BLOCKS)
+		return -1;
+
+	/* Cached blocks were mapped for the old huge page setting */
+	int flush = config->huge_pages != block_config.huge_pages;
+	block_config = *config;
+
+	/* Unmap what no longer fits in the cache */
+	while (nblock_cache > (flush ? 0 : block_config.cache_blocks))
+	{
+		cached_block *cb = &block_cache[--nblock_cache];
+		os_free(cb->address, cb->size);
+	}
+	return 0;
+}
+
+void ViMem_GetBlockStats(ViMemBlockStats *stats)
+{
+	*stats = block_stats;
+	stats->cached_blocks = nblock_cache;
+}
\ No newline at end of file
@@ -167,9 +167,15 @@ ViStatus ViArgv_AsWstrList(const ViArgv *args, ViWideStringList *list)
 
 		for (Vi_size_t i = 0; i < args->argc; i++)
 		{
-			size_t len;
-			wchar_t *arg = (wchar_t *)malloc(sizeof(wchar_t));
-			len = mbstowcs(arg, args->bytes_argv[i], mbstowcs(NULL, args->bytes_argv[i], 0));
+			size_t len = mbstowcs(NULL, args->bytes_argv[i], 0);
+			wchar_t *arg = NULL;
+			/* Must come from Mem_Alloc(), the list is freed with Mem_Free() */
+			if (len != (size_t)-1)
+			{
+				arg = (wchar_t *)Mem_Alloc((len + 1) * sizeof(wchar_t));
+				if (arg != NULL)
+					mbstowcs(arg, args->bytes_argv[i], len + 1);
+			}
 			if (arg == NULL)
 			{
 				ViWideStringList_Clear(&wargv);
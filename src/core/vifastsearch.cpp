@@ -0,0 +1,816 @@
+#include "vifastsearch.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define FASTSEARCH_HAVE_SSE2
+#	include <immintrin.h>
+#	if defined(_MSC_VER) && !defined(__clang__)
+#		include <intrin.h>
+		/* MSVC compiles AVX2 intrinsics without /arch:AVX2 */
+#		define TARGET_AVX2
+#	else
+#		define TARGET_AVX2 __attribute__((target("avx2")))
+#	endif
+#endif
+
+/* Returned by a short needle kernel that found too many false candidates,
+   the search goes on with the two-way algorithm */
+#define GAVE_UP ((Vi_size_t)-2)
+
+/* False candidates a short needle kernel accepts after scanning i bytes */
+#define MISS_LIMIT(i) (64 + (i) / 8)
+
+static inline int lowest_bit(Vi_uint32_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline int count_bits(Vi_uint32_t mask)
+{
+	int n = 0;
+	for (; mask != 0; mask &= mask - 1)
+		n++;
+	return n;
+}
+
+/* Compare a candidate whose first and last bytes are known to match */
+static inline Vi_size_t find_short_tail(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t i)
+{
+	for (; i + m <= n; i++)
+	{
+		if (s[i] == p[0] && s[i + m - 1] == p[m - 1] && memcmp(s + i + 1, p + 1, m - 2) == 0)
+			return i;
+	}
+	return -1;
+}
+
+//
+//
+//		Scalar kernels
+//
+//
+
+static Vi_size_t find_char_scalar(const char *s, Vi_size_t n, char c)
+{
+	const char *hit = (const char *)memchr(s, c, n);
+	return hit == NULL ? -1 : hit - s;
+}
+
+static Vi_size_t count_char_scalar(const char *s, Vi_size_t n, char c)
+{
+	Vi_size_t count = 0;
+	for (Vi_size_t i = 0; i < n; i++)
+		count += s[i] == c;
+	return count;
+}
+
+static Vi_size_t find_non_ascii_scalar(const char *s, Vi_size_t n)
+{
+	for (Vi_size_t i = 0; i < n; i++)
+	{
+		if ((unsigned char)s[i] >= 0x80)
+			return i;
+	}
+	return -1;
+}
+
+/* Back i up to the lead byte of a sequence that i cuts, the sequences
+   before i must be valid */
+static inline Vi_size_t utf8_boundary(const char *str, Vi_size_t i)
+{
+	const unsigned char *s = (const unsigned char *)str;
+
+	for (Vi_size_t j = i - 1; j >= 0 && j >= i - 3; j--)
+	{
+		if ((s[j] & 0xC0) == 0x80)
+			continue;
+		int len = s[j] < 0x80 ? 1 : s[j] < 0xE0 ? 2 : s[j] < 0xF0 ? 3 : 4;
+		return j + len > i ? j : i;
+	}
+	return i;
+}
+
+/* Validation is left to the caller below AVX2 */
+static Vi_size_t utf8_prefix_scalar(const char *, Vi_size_t, Vi_size_t *count)
+{
+	*count = 0;
+	return 0;
+}
+
+static Vi_size_t find_short_scalar(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t *resume)
+{
+	Vi_size_t i = 0, misses = 0;
+
+	while (i + m <= n)
+	{
+		const char *hit = (const char *)memchr(s + i, p[0], n - m + 1 - i);
+		if (hit == NULL)
+			return -1;
+		i = hit - s;
+		if (s[i + m - 1] == p[m - 1] && memcmp(s + i + 1, p + 1, m - 2) == 0)
+			return i;
+		i++;
+		if (++misses > MISS_LIMIT(i))
+		{
+			*resume = i;
+			return GAVE_UP;
+		}
+	}
+	return -1;
+}
+
+#ifdef FASTSEARCH_HAVE_SSE2
+
+//
+//
+//		SSE2 kernels
+//
+//
+
+static Vi_size_t find_char_sse2(const char *s, Vi_size_t n, char c)
+{
+	const __m128i needle = _mm_set1_epi8(c);
+	Vi_size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+		Vi_uint32_t mask = (Vi_uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+		if (mask != 0)
+			return i + lowest_bit(mask);
+	}
+	for (; i < n; i++)
+	{
+		if (s[i] == c)
+			return i;
+	}
+	return -1;
+}
+
+static Vi_size_t count_char_sse2(const char *s, Vi_size_t n, char c)
+{
+	const __m128i needle = _mm_set1_epi8(c);
+	Vi_size_t i = 0, count = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)(s + i));
+		count += count_bits((Vi_uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+	}
+	return count + count_char_scalar(s + i, n - i, c);
+}
+
+/* The high bit of each byte is what movemask collects */
+static Vi_size_t find_non_ascii_sse2(const char *s, Vi_size_t n)
+{
+	Vi_size_t i = 0, found;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		Vi_uint32_t mask = (Vi_uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+		if (mask != 0)
+			return i + lowest_bit(mask);
+	}
+	found = find_non_ascii_scalar(s + i, n - i);
+	return found < 0 ? -1 : found + i;
+}
+
+/* Compare 16 positions at once against the first and the last byte of
+   the needle, only positions matching both are compared in full */
+static Vi_size_t find_short_sse2(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t *resume)
+{
+	const __m128i first = _mm_set1_epi8(p[0]);
+	const __m128i last = _mm_set1_epi8(p[m - 1]);
+	Vi_size_t i = 0, misses = 0;
+
+	for (; i + m - 1 + 16 <= n; i += 16)
+	{
+		__m128i block_first = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i block_last = _mm_loadu_si128((const __m128i *)(s + i + m - 1));
+		__m128i eq = _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last));
+		Vi_uint32_t mask = (Vi_uint32_t)_mm_movemask_epi8(eq);
+		for (; mask != 0; mask &= mask - 1)
+		{
+			int bit = lowest_bit(mask);
+			if (memcmp(s + i + bit + 1, p + 1, m - 2) == 0)
+				return i + bit;
+			misses++;
+		}
+		if (misses > MISS_LIMIT(i))
+		{
+			*resume = i + 16;
+			return GAVE_UP;
+		}
+	}
+	return find_short_tail(s, n, p, m, i);
+}
+
+//
+//
+//		AVX2 kernels
+//
+//
+
+TARGET_AVX2 static Vi_size_t find_char_avx2(const char *s, Vi_size_t n, char c)
+{
+	const __m256i needle = _mm256_set1_epi8(c);
+	Vi_size_t i = 0, found;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *)(s + i));
+		Vi_uint32_t mask = (Vi_uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+		if (mask != 0)
+			return i + lowest_bit(mask);
+	}
+	found = find_char_sse2(s + i, n - i, c);
+	return found < 0 ? -1 : found + i;
+}
+
+TARGET_AVX2 static Vi_size_t count_char_avx2(const char *s, Vi_size_t n, char c)
+{
+	const __m256i needle = _mm256_set1_epi8(c);
+	Vi_size_t i = 0, count = 0;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *)(s + i));
+		count += count_bits((Vi_uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+	}
+	return count + count_char_sse2(s + i, n - i, c);
+}
+
+TARGET_AVX2 static Vi_size_t find_non_ascii_avx2(const char *s, Vi_size_t n)
+{
+	Vi_size_t i = 0, found;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		Vi_uint32_t mask = (Vi_uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+		if (mask != 0)
+			return i + lowest_bit(mask);
+	}
+	found = find_non_ascii_sse2(s + i, n - i);
+	return found < 0 ? -1 : found + i;
+}
+
+/* UTF-8 validation by nibble lookup (Keiser and Lemire, "Validating
+   UTF-8 In Less Than One Instruction Per Byte").  Every byte is looked up
+   by the high and the low nibble of the byte before it and by its own
+   high nibble, each table giving the errors that nibble can be part of.
+   A byte pair is invalid where the three results share a bit. */
+#define UTF8_TOO_SHORT		(1 << 0)	// Lead byte not followed by a continuation
+#define UTF8_TOO_LONG		(1 << 1)	// Continuation after an ASCII byte
+#define UTF8_OVERLONG_3		(1 << 2)	// E0 80..9F
+#define UTF8_TOO_LARGE		(1 << 3)	// F4 90..BF and above
+#define UTF8_SURROGATE		(1 << 4)	// ED A0..BF
+#define UTF8_OVERLONG_2		(1 << 5)	// C0 or C1 lead
+#define UTF8_TOO_LARGE_1000	(1 << 6)	// F5 80..8F and above
+#define UTF8_OVERLONG_4		(1 << 6)	// F0 80..8F
+#define UTF8_TWO_CONTS		(1 << 7)	// Continuation after a continuation
+#define UTF8_CARRY			(UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+/* The tables are repeated for both 128-bit lanes */
+#define REPEAT_LANES(...) __VA_ARGS__, __VA_ARGS__
+
+static const Vi_uint8_t utf8_byte_1_high[32] = { REPEAT_LANES(
+	/* 0___ ASCII */
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	/* 10__ continuation */
+	UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+	/* 1100, 1101 two byte lead */
+	UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+	UTF8_TOO_SHORT,
+	/* 1110 three byte lead */
+	UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+	/* 1111 four byte lead */
+	UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+) };
+
+static const Vi_uint8_t utf8_byte_1_low[32] = { REPEAT_LANES(
+	/* ____0000, ____0001 */
+	UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+	UTF8_CARRY | UTF8_OVERLONG_2,
+	/* ____001_ */
+	UTF8_CARRY,
+	UTF8_CARRY,
+	/* ____0100 */
+	UTF8_CARRY | UTF8_TOO_LARGE,
+	/* ____0101 to ____1100 */
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	/* ____1101 */
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+	/* ____111_ */
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+) };
+
+static const Vi_uint8_t utf8_byte_2_high[32] = { REPEAT_LANES(
+	/* 0___ ASCII */
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	/* 1000 */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+	/* 1001 */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+	/* 101_ */
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+	/* 11__ lead */
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+) };
+
+/* Bytes above these at the end of a block start a sequence the block does
+   not finish */
+static const Vi_uint8_t utf8_incomplete_max[32] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+
+/* The block shifted by n bytes with the end of the previous block in
+   front, across the two 128-bit lanes */
+#define PREV_BYTES(input, prev, n) \
+	_mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev), (input), 0x21), 16 - (n))
+
+TARGET_AVX2 static inline __m256i high_nibbles(__m256i v)
+{
+	return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+/* Non-zero where the block, following prev_input, is not valid UTF-8 */
+TARGET_AVX2 static inline __m256i utf8_block_errors(__m256i input, __m256i prev_input, const __m256i *tables)
+{
+	__m256i prev1 = PREV_BYTES(input, prev_input, 1);
+	__m256i byte_1_high = _mm256_shuffle_epi8(tables[0], high_nibbles(prev1));
+	__m256i byte_1_low = _mm256_shuffle_epi8(tables[1], _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+	__m256i byte_2_high = _mm256_shuffle_epi8(tables[2], high_nibbles(input));
+	__m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+	/* Two bytes after a three or four byte lead and three after a four
+	   byte lead must be continuations, which is where TWO_CONTS is set */
+	__m256i prev2 = PREV_BYTES(input, prev_input, 2);
+	__m256i prev3 = PREV_BYTES(input, prev_input, 3);
+	__m256i is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+	__m256i is_fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+	__m256i must_continue = _mm256_and_si256(_mm256_or_si256(is_third, is_fourth), _mm256_set1_epi8((char)0x80));
+	return _mm256_xor_si256(must_continue, special);
+}
+
+/* Validate whole blocks until one has an error, the prefix returned ends
+   before the sequence the error may be in */
+TARGET_AVX2 static Vi_size_t utf8_prefix_avx2(const char *s, Vi_size_t n, Vi_size_t *count)
+{
+	const __m256i tables[3] = {
+		_mm256_loadu_si256((const __m256i *)utf8_byte_1_high),
+		_mm256_loadu_si256((const __m256i *)utf8_byte_1_low),
+		_mm256_loadu_si256((const __m256i *)utf8_byte_2_high)
+	};
+	const __m256i incomplete_max = _mm256_loadu_si256((const __m256i *)utf8_incomplete_max);
+	__m256i prev_input = _mm256_setzero_si256();
+	__m256i prev_incomplete = _mm256_setzero_si256();
+	Vi_size_t i = 0, continuations = 0, end;
+
+	for (; i + 32 <= n; i += 32)
+	{
+		__m256i input = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i error;
+		if (_mm256_movemask_epi8(input) == 0)
+		{
+			/* An ASCII block only has to finish the previous one */
+			error = prev_incomplete;
+			prev_incomplete = _mm256_setzero_si256();
+		}
+		else
+		{
+			error = utf8_block_errors(input, prev_input, tables);
+			prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+		}
+		if (!_mm256_testz_si256(error, error))
+			break;
+		/* Continuation bytes are -128 to -65 as signed chars */
+		continuations += count_bits((Vi_uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-64), input)));
+		prev_input = input;
+	}
+
+	end = utf8_boundary(s, i);
+	for (Vi_size_t j = end; j < i; j++)
+		continuations -= ((unsigned char)s[j] & 0xC0) == 0x80;
+	*count = end - continuations;
+	return end;
+}
+
+TARGET_AVX2 static Vi_size_t find_short_avx2(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t *resume)
+{
+	const __m256i first = _mm256_set1_epi8(p[0]);
+	const __m256i last = _mm256_set1_epi8(p[m - 1]);
+	Vi_size_t i = 0, misses = 0;
+
+	for (; i + m - 1 + 32 <= n; i += 32)
+	{
+		__m256i block_first = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i block_last = _mm256_loadu_si256((const __m256i *)(s + i + m - 1));
+		__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last));
+		Vi_uint32_t mask = (Vi_uint32_t)_mm256_movemask_epi8(eq);
+		for (; mask != 0; mask &= mask - 1)
+		{
+			int bit = lowest_bit(mask);
+			if (memcmp(s + i + bit + 1, p + 1, m - 2) == 0)
+				return i + bit;
+			misses++;
+		}
+		if (misses > MISS_LIMIT(i))
+		{
+			*resume = i + 32;
+			return GAVE_UP;
+		}
+	}
+	return find_short_tail(s, n, p, m, i);
+}
+
+#endif // FASTSEARCH_HAVE_SSE2
+
+//
+//
+//		Two-way search
+//
+//
+
+/* A needle prepared for the two-way algorithm.  The needle is split at a
+   critical factorization into a left and a right half, the right half is
+   compared left to right and the left half right to left, which never
+   moves back in the haystack.  A bad character table on the last byte
+   skips most positions before any comparison. */
+typedef struct _twoway
+{
+	const unsigned char *needle;
+	size_t m;
+	size_t suffix; // Start of the right half
+	size_t period; // Period of the needle, only exact if periodic
+	int periodic; // The left half occurs again a period further
+	size_t shift[256]; // Distance from the last occurrence of a byte to the end
+} twoway_t;
+
+/* Split the needle at the later of its maximal suffixes for the two
+   orderings of the bytes, also returns the period of that suffix */
+static size_t critical_factorization(const unsigned char *needle, size_t m, size_t *period)
+{
+	size_t max_suffix, max_suffix_rev, j, k, p;
+	unsigned char a, b;
+
+	if (m < 3)
+	{
+		*period = 1;
+		return m - 1;
+	}
+
+	/* max_suffix starts at -1, max_suffix + k wraps around to k - 1 */
+	max_suffix = (size_t)-1;
+	j = 0;
+	k = p = 1;
+	while (j + k < m)
+	{
+		a = needle[j + k];
+		b = needle[max_suffix + k];
+		if (a < b)
+		{
+			j += k;
+			k = 1;
+			p = j - max_suffix;
+		}
+		else if (a == b)
+		{
+			if (k != p)
+				k++;
+			else
+			{
+				j += p;
+				k = 1;
+			}
+		}
+		else
+		{
+			max_suffix = j++;
+			k = p = 1;
+		}
+	}
+	*period = p;
+
+	max_suffix_rev = (size_t)-1;
+	j = 0;
+	k = p = 1;
+	while (j + k < m)
+	{
+		a = needle[j + k];
+		b = needle[max_suffix_rev + k];
+		if (b < a)
+		{
+			j += k;
+			k = 1;
+			p = j - max_suffix_rev;
+		}
+		else if (a == b)
+		{
+			if (k != p)
+				k++;
+			else
+			{
+				j += p;
+				k = 1;
+			}
+		}
+		else
+		{
+			max_suffix_rev = j++;
+			k = p = 1;
+		}
+	}
+
+	if (max_suffix_rev + 1 < max_suffix + 1)
+		return max_suffix + 1;
+	*period = p;
+	return max_suffix_rev + 1;
+}
+
+static void twoway_prepare(twoway_t *tw, const char *p, Vi_size_t m)
+{
+	tw->needle = (const unsigned char *)p;
+	tw->m = (size_t)m;
+	tw->suffix = critical_factorization(tw->needle, tw->m, &tw->period);
+	tw->periodic = memcmp(tw->needle, tw->needle + tw->period, tw->suffix) == 0;
+	if (!tw->periodic)
+		tw->period = (tw->suffix > tw->m - tw->suffix ? tw->suffix : tw->m - tw->suffix) + 1;
+
+	for (int c = 0; c < 256; c++)
+		tw->shift[c] = tw->m;
+	for (size_t i = 0; i < tw->m; i++)
+		tw->shift[tw->needle[i]] = tw->m - i - 1;
+}
+
+static Vi_size_t twoway_find(const twoway_t *tw, const char *haystack, Vi_size_t n)
+{
+	const unsigned char *s = (const unsigned char *)haystack;
+	const unsigned char *needle = tw->needle;
+	size_t m = tw->m, suffix = tw->suffix, period = tw->period;
+	size_t i, j = 0, shift, memory = 0;
+
+	if ((size_t)n < m)
+		return -1;
+
+	if (tw->periodic)
+	{
+		/* memory is the length of the prefix known to match after a shift
+		   by the period, it is not compared again */
+		while (j <= (size_t)n - m)
+		{
+			shift = tw->shift[s[j + m - 1]];
+			if (shift > 0)
+			{
+				/* A shift shorter than the period can not line up with
+				   what memory remembers */
+				if (memory && shift < period)
+					shift = m - period;
+				memory = 0;
+				j += shift;
+				continue;
+			}
+
+			i = suffix > memory ? suffix : memory;
+			while (i < m - 1 && needle[i] == s[i + j])
+				i++;
+			if (m - 1 <= i)
+			{
+				i = suffix - 1;
+				while (memory < i + 1 && needle[i] == s[i + j])
+					i--;
+				if (i + 1 < memory + 1)
+					return (Vi_size_t)j;
+				j += period;
+				memory = m - period;
+			}
+			else
+			{
+				j += i - suffix + 1;
+				memory = 0;
+			}
+		}
+	}
+	else
+	{
+		while (j <= (size_t)n - m)
+		{
+			shift = tw->shift[s[j + m - 1]];
+			if (shift > 0)
+			{
+				j += shift;
+				continue;
+			}
+
+			i = suffix;
+			while (i < m - 1 && needle[i] == s[i + j])
+				i++;
+			if (m - 1 <= i)
+			{
+				i = suffix - 1;
+				while (i != (size_t)-1 && needle[i] == s[i + j])
+					i--;
+				if (i == (size_t)-1)
+					return (Vi_size_t)j;
+				j += period;
+			}
+			else
+				j += i - suffix + 1;
+		}
+	}
+	return -1;
+}
+
+//
+//
+//		Dispatch
+//
+//
+
+typedef Vi_size_t (*find_char_func)(const char *s, Vi_size_t n, char c);
+typedef Vi_size_t (*count_char_func)(const char *s, Vi_size_t n, char c);
+typedef Vi_size_t (*find_non_ascii_func)(const char *s, Vi_size_t n);
+typedef Vi_size_t (*find_short_func)(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t *resume);
+typedef Vi_size_t (*utf8_prefix_func)(const char *s, Vi_size_t n, Vi_size_t *count);
+
+typedef struct _kernels
+{
+	find_char_func find_char;
+	count_char_func count_char;
+	find_non_ascii_func find_non_ascii;
+	find_short_func find_short;
+	utf8_prefix_func utf8_prefix;
+} kernels_t;
+
+/* Indexed by level */
+static const kernels_t kernel_table[] = {
+	{ find_char_scalar, count_char_scalar, find_non_ascii_scalar, find_short_scalar, utf8_prefix_scalar },
+#ifdef FASTSEARCH_HAVE_SSE2
+	{ find_char_sse2, count_char_sse2, find_non_ascii_sse2, find_short_sse2, utf8_prefix_scalar },
+	{ find_char_avx2, count_char_avx2, find_non_ascii_avx2, find_short_avx2, utf8_prefix_avx2 },
+#endif
+};
+
+static int cpu_level = -1; // Best level the CPU supports, -1 until detected
+static const kernels_t *kernels = NULL; // Kernels in use, NULL until first search
+
+static int detect_level()
+{
+#ifdef FASTSEARCH_HAVE_SSE2
+#	if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		/* The OS must save the YMM registers, see XGETBV */
+		int osxsave = (info[2] & (1 << 27)) != 0;
+		int avx = (info[2] & (1 << 28)) != 0;
+		if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+		{
+			__cpuidex(info, 7, 0);
+			if (info[1] & (1 << 5))
+				return ViFastSearch_AVX2;
+		}
+	}
+	return ViFastSearch_SSE2;
+#	else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return ViFastSearch_AVX2;
+	return ViFastSearch_SSE2;
+#	endif
+#else
+	return ViFastSearch_SCALAR;
+#endif
+}
+
+static inline const kernels_t *get_kernels()
+{
+	if (kernels == NULL)
+	{
+		cpu_level = detect_level();
+		kernels = &kernel_table[cpu_level];
+	}
+	return kernels;
+}
+
+//
+//
+//		API Functions
+//
+//
+
+Vi_size_t ViFastSearch_Find(const char *s, Vi_size_t n, const char *p, Vi_size_t m)
+{
+	const kernels_t *k = get_kernels();
+	Vi_size_t start = 0, found;
+	twoway_t tw;
+
+	if (m == 0)
+		return 0;
+	if (m > n)
+		return -1;
+	if (m == 1)
+		return k->find_char(s, n, p[0]);
+
+	if (m <= ViFastSearch_SHORT_NEEDLE)
+	{
+		found = k->find_short(s, n, p, m, &start);
+		if (found != GAVE_UP)
+			return found;
+	}
+
+	twoway_prepare(&tw, p, m);
+	found = twoway_find(&tw, s + start, n - start);
+	return found < 0 ? -1 : found + start;
+}
+
+Vi_size_t ViFastSearch_Count(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t maxcount)
+{
+	const kernels_t *k = get_kernels();
+	Vi_size_t count = 0, i = 0, found, resume;
+	int use_twoway = m > ViFastSearch_SHORT_NEEDLE;
+	twoway_t tw;
+
+	if (maxcount <= 0)
+		return 0;
+	if (m == 0)
+		return n < maxcount ? n + 1 : maxcount;
+	if (m > n)
+		return 0;
+	if (m == 1)
+	{
+		count = k->count_char(s, n, p[0]);
+		return count < maxcount ? count : maxcount;
+	}
+
+	if (use_twoway)
+		twoway_prepare(&tw, p, m);
+	while (count < maxcount && i <= n - m)
+	{
+		if (use_twoway)
+			found = twoway_find(&tw, s + i, n - i);
+		else
+		{
+			found = k->find_short(s + i, n - i, p, m, &resume);
+			if (found == GAVE_UP)
+			{
+				i += resume;
+				use_twoway = 1;
+				twoway_prepare(&tw, p, m);
+				continue;
+			}
+		}
+		if (found < 0)
+			break;
+		count++;
+		i += found + m;
+	}
+	return count;
+}
+
+Vi_size_t ViFastSearch_FindChar(const char *s, Vi_size_t n, char c)
+{
+	return get_kernels()->find_char(s, n, c);
+}
+
+Vi_size_t ViFastSearch_FindNonAscii(const char *s, Vi_size_t n)
+{
+	return get_kernels()->find_non_ascii(s, n);
+}
+
+Vi_size_t ViFastSearch_ValidUtf8Prefix(const char *s, Vi_size_t n, Vi_size_t *count)
+{
+	return get_kernels()->utf8_prefix(s, n, count);
+}
+
+int ViFastSearch_SetLevel(int level)
+{
+	get_kernels();
+	if (level > cpu_level)
+		level = cpu_level;
+	if (level < ViFastSearch_SCALAR)
+		level = ViFastSearch_SCALAR;
+	kernels = &kernel_table[level];
+	return level;
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef __VIFASTSEARCH_H__
+#define __VIFASTSEARCH_H__
+
+#include "../port.h"
+
+/*
+ * Substring search
+ *
+ * Single bytes and short needles are searched with SSE2 or AVX2, picked
+ * at run time from what the CPU supports.  The short needle kernel looks
+ * for blocks where both the first and the last byte of the needle match
+ * and only compares the candidates it finds.  Needles longer than
+ * ViFastSearch_SHORT_NEEDLE bytes, and short needles that keep producing
+ * false candidates, use the Crochemore-Perrin two-way algorithm, which is
+ * linear in the haystack whatever the input.
+ *
+ * The AVX2 kernels also validate UTF-8 by nibble table lookups, see
+ * core/viutf8.h.
+*/
+
+#define ViFastSearch_SHORT_NEEDLE 32
+
+/* Instruction sets, in the order they are preferred */
+#define ViFastSearch_SCALAR 0
+#define ViFastSearch_SSE2 1
+#define ViFastSearch_AVX2 2
+
+/* Index of the first occurrence of the needle p of length m in s, -1 if
+   there is none.  An empty needle is found at 0. */
+Vi_size_t ViFastSearch_Find(const char *s, Vi_size_t n, const char *p, Vi_size_t m);
+
+/* Number of non-overlapping occurrences, counting stops at maxcount.  An
+   empty needle occurs n + 1 times. */
+Vi_size_t ViFastSearch_Count(const char *s, Vi_size_t n, const char *p, Vi_size_t m, Vi_size_t maxcount);
+
+/* Index of the first byte c in s, -1 if there is none */
+Vi_size_t ViFastSearch_FindChar(const char *s, Vi_size_t n, char c);
+
+/* Index of the first byte of s that is not ASCII, -1 if there is none */
+Vi_size_t ViFastSearch_FindNonAscii(const char *s, Vi_size_t n);
+
+/* Length of a prefix of s that is valid UTF-8 and ends on a character
+   boundary, with its number of code points in *count.  The prefix stops
+   before an error and may leave up to a block at the end unchecked.
+   Only the AVX2 kernel validates, the others return 0. */
+Vi_size_t ViFastSearch_ValidUtf8Prefix(const char *s, Vi_size_t n, Vi_size_t *count);
+
+/* Limit the kernels to the given instruction set, for tests and
+   benchmarks.  Returns the level in use, which is lower if the CPU does
+   not support the one asked for. */
+int ViFastSearch_SetLevel(int level);
+
+#endif // __VIFASTSEARCH_H__
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include "vigc.h"
+
+#include <chrono>
+
+#include "vimem.h"
+#include "error.h"
+
+/* A generational cycle collector.
+
+   Tracked objects live in one of ViGC_NUM_GENERATIONS lists.  New
+   objects start in generation 0, objects that survive a collection are
+   moved to the next older generation.  A collection of a generation
+   also collects all younger generations.
+
+   Finding the garbage works like this:
+
+   1. For every object being collected, copy its reference count into
+      gc_refs (update_refs).
+   2. Traverse every object and decrement gc_refs of each object it
+      refers to that is also being collected (subtract_refs).  What is
+      left in gc_refs is the number of references from outside the
+      collected set.
+   3. Objects with gc_refs > 0 are directly reachable from outside, so
+      is everything they refer to.  Whatever is not reached this way is
+      part of unreachable cycles (move_unreachable).
+   4. Unreachable objects have their references cleared with tp_clear,
+      which breaks the cycles and lets reference counting free them.
+
+   The collector is not thread safe, callers must serialize access.
+*/
+
+typedef struct _gcgeneration
+{
+	ViGC_Head head;
+	int threshold;	// Collection threshold
+	int count;		// Allocations or collections of younger generations
+} gc_generation;
+
+#define GEN_HEAD(n) (&generations[n].head)
+
+static gc_generation generations[ViGC_NUM_GENERATIONS] = {
+	{{{GEN_HEAD(0), GEN_HEAD(0), 0}},		700,		0},
+	{{{GEN_HEAD(1), GEN_HEAD(1), 0}},		10,			0},
+	{{{GEN_HEAD(2), GEN_HEAD(2), 0}},		10,			0},
+};
+
+static ViGCStats gc_stats[ViGC_NUM_GENERATIONS];
+
+static int enabled = 1;		// Automatic collection enabled?
+static int collecting = 0;	// Collection in progress?
+
+//
+//
+//		GC lists
+//
+//
+
+static inline void gc_list_init(ViGC_Head *list)
+{
+	list->gc.gc_prev = list;
+	list->gc.gc_next = list;
+}
+
+static inline int gc_list_is_empty(ViGC_Head *list)
+{
+	return list->gc.gc_next == list;
+}
+
+/* Append node to the end of list */
+static inline void gc_list_append(ViGC_Head *node, ViGC_Head *list)
+{
+	node->gc.gc_next = list;
+	node->gc.gc_prev = list->gc.gc_prev;
+	node->gc.gc_prev->gc.gc_next = node;
+	list->gc.gc_prev = node;
+}
+
+/* Remove node from the list it is in */
+static inline void gc_list_remove(ViGC_Head *node)
+{
+	node->gc.gc_prev->gc.gc_next = node->gc.gc_next;
+	node->gc.gc_next->gc.gc_prev = node->gc.gc_prev;
+	node->gc.gc_next = NULL;
+}
+
+/* Move node from the list it is in to the end of list */
+static inline void gc_list_move(ViGC_Head *node, ViGC_Head *list)
+{
+	node->gc.gc_prev->gc.gc_next = node->gc.gc_next;
+	node->gc.gc_next->gc.gc_prev = node->gc.gc_prev;
+	gc_list_append(node, list);
+}
+
+/* Append all nodes of from to the end of to, from is left empty */
+static void gc_list_merge(ViGC_Head *from, ViGC_Head *to)
+{
+	if (!gc_list_is_empty(from))
+	{
+		ViGC_Head *tail = to->gc.gc_prev;
+		tail->gc.gc_next = from->gc.gc_next;
+		tail->gc.gc_next->gc.gc_prev = tail;
+		to->gc.gc_prev = from->gc.gc_prev;
+		to->gc.gc_prev->gc.gc_next = to;
+	}
+	gc_list_init(from);
+}
+
+//
+//
+//		Collection
+//
+//
+
+/* Set gc_refs to the reference count of every object in containers,
+   returns the number of objects */
+static Vi_size_t update_refs(ViGC_Head *containers)
+{
+	Vi_size_t n = 0;
+	for (ViGC_Head *gc = containers->gc.gc_next; gc != containers; gc = gc->gc.gc_next)
+	{
+		assert(gc->gc.gc_refs == ViGC_REFS_REACHABLE);
+		gc->gc.gc_refs = ViGC_AS_OBJECT(gc)->ob_refcount;
+		assert(gc->gc.gc_refs != 0);
+		n++;
+	}
+	return n;
+}
+
+/* A traversal callback for subtract_refs */
+static int visit_decref(ViObject *obj, void *)
+{
+	if (ViObject_IS_GC(obj))
+	{
+		ViGC_Head *gc = ViGC_AS_GC(obj);
+		/* Only objects in the collected set have gc_refs > 0 */
+		if (gc->gc.gc_refs > 0)
+			gc->gc.gc_refs--;
+	}
+	return 0;
+}
+
+/* Subtract internal references from gc_refs */
+static void subtract_refs(ViGC_Head *containers)
+{
+	for (ViGC_Head *gc = containers->gc.gc_next; gc != containers; gc = gc->gc.gc_next)
+	{
+		ViObject *obj = ViGC_AS_OBJECT(gc);
+		traverseproc traverse = Vi_TYPE(obj)->tp_traverse;
+		(void)traverse(obj, visit_decref, NULL);
+	}
+}
+
+/* A traversal callback for move_unreachable */
+static int visit_reachable(ViObject *obj, ViGC_Head *reachable)
+{
+	if (ViObject_IS_GC(obj))
+	{
+		ViGC_Head *gc = ViGC_AS_GC(obj);
+		const Vi_size_t gc_refs = gc->gc.gc_refs;
+
+		if (gc_refs == 0)
+		{
+			/* Not visited yet, move_unreachable() will get to it */
+			gc->gc.gc_refs = 1;
+		}
+		else if (gc_refs == ViGC_REFS_TENTATIVELY_UNREACHABLE)
+		{
+			/* Already moved to unreachable, but it is reachable after
+			   all.  Move it back so it gets traversed again. */
+			gc_list_move(gc, reachable);
+			gc->gc.gc_refs = 1;
+		}
+		else
+		{
+			assert(gc_refs > 0 ||
+				gc_refs == ViGC_REFS_REACHABLE ||
+				gc_refs == ViGC_REFS_UNTRACKED);
+		}
+	}
+	return 0;
+}
+
+/* Move the objects in young that can not be reached from outside of it
+   into unreachable.  All objects left in young are marked reachable. */
+static void move_unreachable(ViGC_Head *young, ViGC_Head *unreachable)
+{
+	ViGC_Head *gc = young->gc.gc_next;
+
+	while (gc != young)
+	{
+		ViGC_Head *next;
+
+		if (gc->gc.gc_refs)
+		{
+			ViObject *obj = ViGC_AS_OBJECT(gc);
+			traverseproc traverse = Vi_TYPE(obj)->tp_traverse;
+			assert(gc->gc.gc_refs > 0);
+			gc->gc.gc_refs = ViGC_REFS_REACHABLE;
+			(void)traverse(obj, (visitproc)visit_reachable, (void *)young);
+			next = gc->gc.gc_next;
+		}
+		else
+		{
+			/* Might still be reached from an object later in young */
+			next = gc->gc.gc_next;
+			gc_list_move(gc, unreachable);
+			gc->gc.gc_refs = ViGC_REFS_TENTATIVELY_UNREACHABLE;
+		}
+		gc = next;
+	}
+}
+
+/* Break the reference cycles in collectable, objects that survive
+   are moved to old.  Returns the number of survivors. */
+static Vi_size_t delete_garbage(ViGC_Head *collectable, ViGC_Head *old)
+{
+	Vi_size_t survivors = 0;
+
+	while (!gc_list_is_empty(collectable))
+	{
+		ViGC_Head *gc = collectable->gc.gc_next;
+		ViObject *obj = ViGC_AS_OBJECT(gc);
+		inquiry clear = Vi_TYPE(obj)->tp_clear;
+
+		if (clear != NULL)
+		{
+			ViObject_INCREF(obj);
+			(void)clear(obj);
+			ViObject_DECREF(obj);
+		}
+		if (collectable->gc.gc_next == gc)
+		{
+			/* Object is still alive, move it, it may die later */
+			gc_list_move(gc, old);
+			gc->gc.gc_refs = ViGC_REFS_REACHABLE;
+			survivors++;
+		}
+	}
+	return survivors;
+}
+
+/* The main collection routine */
+static Vi_size_t collect(int generation)
+{
+	ViGC_Head *young, *old;
+	ViGC_Head unreachable;
+	ViGCStats *stats = &gc_stats[generation];
+	Vi_size_t visited, collected = 0, uncollectable;
+
+	auto start = std::chrono::steady_clock::now();
+
+	/* Update collection and allocation counters */
+	if (generation + 1 < ViGC_NUM_GENERATIONS)
+		generations[generation + 1].count += 1;
+	for (int i = 0; i <= generation; i++)
+		generations[i].count = 0;
+
+	/* Merge younger generations with the one we are collecting */
+	for (int i = 0; i < generation; i++)
+		gc_list_merge(GEN_HEAD(i), GEN_HEAD(generation));
+
+	young = GEN_HEAD(generation);
+	if (generation < ViGC_NUM_GENERATIONS - 1)
+		old = GEN_HEAD(generation + 1);
+	else
+		old = young;
+
+	/* Find the objects only referenced from within young */
+	visited = update_refs(young);
+	subtract_refs(young);
+
+	gc_list_init(&unreachable);
+	move_unreachable(young, &unreachable);
+
+	/* Survivors are promoted to the next generation */
+	if (young != old)
+		gc_list_merge(young, old);
+
+	for (ViGC_Head *gc = unreachable.gc.gc_next; gc != &unreachable; gc = gc->gc.gc_next)
+		collected++;
+
+	/* Break the cycles, the objects are freed by reference counting */
+	uncollectable = delete_garbage(&unreachable, old);
+
+	auto pause = (Vi_uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	stats->collections++;
+	stats->collected += collected;
+	stats->uncollectable += uncollectable;
+	stats->visited += visited;
+	stats->total_pause_ns += pause;
+	if (pause > stats->max_pause_ns)
+		stats->max_pause_ns = pause;
+
+	return collected;
+}
+
+/* Collect the oldest generation that went over its threshold */
+static Vi_size_t collect_generations()
+{
+	for (int i = ViGC_NUM_GENERATIONS - 1; i >= 0; i--)
+	{
+		if (generations[i].count > generations[i].threshold)
+			return collect(i);
+	}
+	return 0;
+}
+
+//
+//
+//		GC objects
+//
+//
+
+void *ViObject_GC_Malloc(size_t size)
+{
+	if (size > (size_t)VI_SIZE_T_MAX - sizeof(ViGC_Head))
+		return NULL;
+
+	ViGC_Head *g = (ViGC_Head *)ViObject_Malloc(sizeof(ViGC_Head) + size);
+	if (g == NULL)
+		return NULL;
+	g->gc.gc_next = NULL;
+	g->gc.gc_prev = NULL;
+	g->gc.gc_refs = ViGC_REFS_UNTRACKED;
+
+	generations[0].count++;
+	if (generations[0].count > generations[0].threshold &&
+		generations[0].threshold &&
+		enabled &&
+		!collecting)
+	{
+		collecting = 1;
+		collect_generations();
+		collecting = 0;
+	}
+	return ViGC_AS_OBJECT(g);
+}
+
+void ViObject_GC_Del(void *obj)
+{
+	ViGC_Head *g = ViGC_AS_GC(obj);
+	if (ViObject_GC_IS_TRACKED(obj))
+		gc_list_remove(g);
+	if (generations[0].count > 0)
+		generations[0].count--;
+	ViObject_Free(g);
+}
+
+void ViObject_GC_Track(void *obj)
+{
+	ViGC_Head *g = ViGC_AS_GC(obj);
+	assert(g->gc.gc_refs == ViGC_REFS_UNTRACKED);
+	g->gc.gc_refs = ViGC_REFS_REACHABLE;
+	gc_list_append(g, GEN_HEAD(0));
+}
+
+void ViObject_GC_UnTrack(void *obj)
+{
+	ViGC_Head *g = ViGC_AS_GC(obj);
+	if (g->gc.gc_refs != ViGC_REFS_UNTRACKED)
+	{
+		gc_list_remove(g);
+		g->gc.gc_refs = ViGC_REFS_UNTRACKED;
+	}
+}
+
+//
+//
+//		API Functions
+//
+//
+
+Vi_size_t ViGC_CollectGeneration(int generation)
+{
+	Vi_size_t n;
+
+	if (generation < 0 || generation >= ViGC_NUM_GENERATIONS)
+	{
+		ViError_SetString(ViExc_ValueError, "invalid generation");
+		return -1;
+	}
+	if (collecting)
+		return 0; // Already collecting, don't do anything
+
+	collecting = 1;
+	n = collect(generation);
+	collecting = 0;
+	return n;
+}
+
+Vi_size_t ViGC_Collect()
+{
+	return ViGC_CollectGeneration(ViGC_NUM_GENERATIONS - 1);
+}
+
+int ViGC_Enable()
+{
+	int old_state = enabled;
+	enabled = 1;
+	return old_state;
+}
+
+int ViGC_Disable()
+{
+	int old_state = enabled;
+	enabled = 0;
+	return old_state;
+}
+
+int ViGC_IsEnabled()
+{
+	return enabled;
+}
+
+void ViGC_SetThreshold(int threshold0, int threshold1, int threshold2)
+{
+	generations[0].threshold = threshold0;
+	generations[1].threshold = threshold1;
+	generations[2].threshold = threshold2;
+}
+
+void ViGC_GetThreshold(int *threshold0, int *threshold1, int *threshold2)
+{
+	*threshold0 = generations[0].threshold;
+	*threshold1 = generations[1].threshold;
+	*threshold2 = generations[2].threshold;
+}
+
+void ViGC_GetCount(int *count0, int *count1, int *count2)
+{
+	*count0 = generations[0].count;
+	*count1 = generations[1].count;
+	*count2 = generations[2].count;
+}
+
+int ViGC_GetStats(int generation, ViGCStats *stats)
+{
+	if (generation < 0 || generation >= ViGC_NUM_GENERATIONS)
+	{
+		ViError_SetString(ViExc_ValueError, "invalid generation");
+		return -1;
+	}
+	*stats = gc_stats[generation];
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef __VIGC_H__
+#define __VIGC_H__
+
+#include "../port.h"
+#include "../objects/object.h"
+
+/*
+ * Cyclic garbage collection
+ *
+ * Reference counting can not free objects that are part of a reference
+ * cycle, so container types (TPFLAGS_HAVE_GC) are additionally tracked
+ * by a generational cycle collector.  Every GC object is preceded in
+ * memory by a ViGC_Head which links it into the list of its generation.
+ *
+ * A GC type must:
+ *   - set TPFLAGS_HAVE_GC, its instances are then allocated with a
+ *     GC head by Object_New() / Object_NewVar()
+ *   - implement tp_traverse, calling visit on every object it refers to
+ *   - implement tp_clear if it can be part of a cycle by itself
+ *   - use ViObject_GC_Del as tp_free
+ *   - track new instances with ViObject_GC_Track() once they are fully
+ *     initialized and untrack them first thing in tp_dealloc
+*/
+
+#define ViGC_NUM_GENERATIONS 3
+
+/* GC information is stored BEFORE the object structure */
+typedef union _gc_head
+{
+	struct
+	{
+		union _gc_head *gc_next;
+		union _gc_head *gc_prev;
+		Vi_size_t gc_refs;
+	} gc;
+	double dummy; // Force at least 8 byte alignment
+} ViGC_Head;
+
+#define ViGC_AS_GC(obj) ((ViGC_Head *)(obj) - 1)
+#define ViGC_AS_OBJECT(g) ((ViObject *)((ViGC_Head *)(g) + 1))
+
+/* Special gc_refs values, objects being collected use gc_refs >= 0 */
+#define ViGC_REFS_UNTRACKED					(-2)
+#define ViGC_REFS_REACHABLE					(-3)
+#define ViGC_REFS_TENTATIVELY_UNREACHABLE	(-4)
+
+/* Test if a type has a GC head */
+#define ViType_IS_GC(type) ViType_HasFeature((type), TPFLAGS_HAVE_GC)
+
+/* Test if an object has a GC head */
+#define ViObject_IS_GC(obj) ViType_IS_GC(Vi_TYPE(obj))
+
+/* Test if a GC object is tracked by the collector */
+#define ViObject_GC_IS_TRACKED(obj) \
+	(ViGC_AS_GC(obj)->gc.gc_refs != ViGC_REFS_UNTRACKED)
+
+/* Utility macro to help write tp_traverse functions */
+#define Vi_VISIT(obj)									\
+	do {												\
+		if (obj) {										\
+			int vi_vret = visit(ViObject_CAST(obj), arg);	\
+			if (vi_vret)								\
+				return vi_vret;							\
+		}												\
+	} while (0)
+
+/* Allocate memory for a GC object of the given size, the GC head is
+   placed in front of it.  May run a collection. */
+void *ViObject_GC_Malloc(size_t size);
+
+/* Free a GC object, used as tp_free for GC types */
+void ViObject_GC_Del(void *obj);
+
+/* Start and stop tracking a GC object */
+void ViObject_GC_Track(void *obj);
+void ViObject_GC_UnTrack(void *obj);
+
+/* Collector statistics for one generation */
+typedef struct _gcstats
+{
+	size_t collections;		// Number of times this generation was collected
+	size_t collected;		// Unreachable objects found
+	size_t uncollectable;	// Unreachable objects that could not be freed
+	size_t visited;			// Objects examined
+	Vi_uint64_t total_pause_ns;	// Time spent collecting
+	Vi_uint64_t max_pause_ns;	// Longest single collection
+} ViGCStats;
+
+/* Run a collection of the given generation and all younger ones,
+   returns the number of unreachable objects found */
+Vi_size_t ViGC_CollectGeneration(int generation);
+
+/* Run a full collection */
+Vi_size_t ViGC_Collect();
+
+/* Enable or disable automatic collection, return the previous state */
+int ViGC_Enable();
+int ViGC_Disable();
+int ViGC_IsEnabled();
+
+/* Allocation count thresholds that trigger a collection of each generation */
+void ViGC_SetThreshold(int threshold0, int threshold1, int threshold2);
+void ViGC_GetThreshold(int *threshold0, int *threshold1, int *threshold2);
+void ViGC_GetCount(int *count0, int *count1, int *count2);
+
+int ViGC_GetStats(int generation, ViGCStats *stats);
+
+#endif // __VIGC_H__
\ No newline at end of file
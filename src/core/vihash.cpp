@@ -0,0 +1,170 @@
+#include "vihash.h"
+
+#include <cmath>
+#include <random>
+
+/* SipHash key, drawn on first use unless a seed was set */
+static Vi_uint64_t hash_k0 = 0;
+static Vi_uint64_t hash_k1 = 0;
+static int hash_key_ready = 0;
+
+static Vi_uint64_t splitmix64(Vi_uint64_t *state)
+{
+	Vi_uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static void init_key()
+{
+	std::random_device rd;
+	hash_k0 = ((Vi_uint64_t)rd() << 32) | rd();
+	hash_k1 = ((Vi_uint64_t)rd() << 32) | rd();
+	hash_key_ready = 1;
+}
+
+//
+//
+//		SipHash-1-3
+//
+//
+
+#define ROTATE(x, b) (Vi_uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define HALF_ROUND(a, b, c, d, s, t)	\
+	a += b; c += d;						\
+	b = ROTATE(b, s) ^ a;				\
+	d = ROTATE(d, t) ^ c;				\
+	a = ROTATE(a, 32);
+
+#define SINGLE_ROUND(v0, v1, v2, v3)		\
+	HALF_ROUND(v0, v1, v2, v3, 13, 16);		\
+	HALF_ROUND(v2, v1, v0, v3, 17, 21);
+
+/* One compression round per 8 byte word and three finalization rounds,
+   words are read little endian */
+static Vi_uint64_t siphash13(Vi_uint64_t k0, Vi_uint64_t k1, const void *src, Vi_size_t src_sz)
+{
+	Vi_uint64_t b = (Vi_uint64_t)src_sz << 56;
+	const Vi_uint8_t *in = (const Vi_uint8_t *)src;
+	Vi_uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+	Vi_uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+	Vi_uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+	Vi_uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+	Vi_uint64_t t = 0;
+
+	while (src_sz >= 8)
+	{
+		Vi_uint64_t mi;
+		memcpy(&mi, in, sizeof(mi));
+		in += sizeof(mi);
+		src_sz -= sizeof(mi);
+		v3 ^= mi;
+		SINGLE_ROUND(v0, v1, v2, v3);
+		v0 ^= mi;
+	}
+
+	/* Up to 7 remaining bytes */
+	for (Vi_size_t i = 0; i < src_sz; i++)
+		t |= (Vi_uint64_t)in[i] << (8 * i);
+	b |= t;
+
+	v3 ^= b;
+	SINGLE_ROUND(v0, v1, v2, v3);
+	v0 ^= b;
+	v2 ^= 0xff;
+	SINGLE_ROUND(v0, v1, v2, v3);
+	SINGLE_ROUND(v0, v1, v2, v3);
+	SINGLE_ROUND(v0, v1, v2, v3);
+
+	return (v0 ^ v1) ^ (v2 ^ v3);
+}
+
+//
+//
+//		API Functions
+//
+//
+
+Vi_hash_t ViHash_Bytes(const void *src, Vi_size_t len)
+{
+	Vi_hash_t x;
+
+	if (len == 0)
+		return 0;
+	if (!hash_key_ready)
+		init_key();
+
+	x = (Vi_hash_t)siphash13(hash_k0, hash_k1, src, len);
+	return x == -1 ? -2 : x;
+}
+
+Vi_hash_t ViHash_Double(ViObject *inst, double v)
+{
+	int e, sign;
+	double m;
+	Vi_uint64_t x, y;
+
+	if (!std::isfinite(v))
+	{
+		if (std::isinf(v))
+			return v > 0 ? ViHASH_INF : -ViHASH_INF;
+		return ViHash_Pointer(inst);
+	}
+
+	m = frexp(v, &e);
+	sign = 1;
+	if (m < 0)
+	{
+		sign = -1;
+		m = -m;
+	}
+
+	/* Process 28 bits of the mantissa at a time, multiplying by 2^28 is a
+	   rotation modulo 2^61 - 1 */
+	x = 0;
+	while (m)
+	{
+		x = ((x << 28) & ViHASH_MODULUS) | x >> (ViHASH_BITS - 28);
+		m *= 268435456.0; // 2^28
+		e -= 28;
+		y = (Vi_uint64_t)m;
+		m -= y;
+		x += y;
+		if (x >= ViHASH_MODULUS)
+			x -= ViHASH_MODULUS;
+	}
+
+	/* Multiply by 2^e, reducing e modulo 61 first */
+	e = e >= 0 ? e % ViHASH_BITS : ViHASH_BITS - 1 - ((-1 - e) % ViHASH_BITS);
+	x = ((x << e) & ViHASH_MODULUS) | x >> (ViHASH_BITS - e);
+
+	x = x * sign;
+	if (x == (Vi_uint64_t)-1)
+		x = (Vi_uint64_t)-2;
+	return (Vi_hash_t)x;
+}
+
+Vi_hash_t ViHash_Pointer(const void *ptr)
+{
+	/* The low bits of an address are always zero */
+	uintptr_t y = (uintptr_t)ptr;
+	Vi_hash_t x = (Vi_hash_t)((y >> 4) | (y << (8 * sizeof(void *) - 4)));
+	return x == -1 ? -2 : x;
+}
+
+void ViHash_SetSeed(Vi_uint64_t seed)
+{
+	if (seed == 0)
+	{
+		hash_k0 = 0;
+		hash_k1 = 0;
+	}
+	else
+	{
+		hash_k0 = splitmix64(&seed);
+		hash_k1 = splitmix64(&seed);
+	}
+	hash_key_ready = 1;
+}
\ No newline at end of file
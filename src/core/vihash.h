@@ -0,0 +1,39 @@
+#ifndef __VIHASH_H__
+#define __VIHASH_H__
+
+#include "../port.h"
+#include "../objects/object.h"
+
+/*
+ * Hashing
+ *
+ * Strings and bytes are hashed with SipHash-1-3 under a secret 128 bit
+ * key, so an attacker can not craft keys that collide in a dict.  The key
+ * is drawn at random the first time something is hashed, ViHash_SetSeed()
+ * fixes it beforehand for reproducible hashes.
+ *
+ * Numbers hash to their value modulo the prime 2^61 - 1, so ints, bools
+ * and floats that compare equal hash equal as well.  -1 is never a valid
+ * hash, it is returned by hash functions on error.
+*/
+
+#define ViHASH_BITS 61
+#define ViHASH_MODULUS (((Vi_uint64_t)1 << ViHASH_BITS) - 1)
+#define ViHASH_INF 314159
+#define ViHASH_IMAG 1000003UL
+
+/* Hash of a buffer of bytes, 0 for an empty buffer */
+Vi_hash_t ViHash_Bytes(const void *src, Vi_size_t len);
+
+/* Hash of a double, equal to the hash of the int it is equal to.  NaN
+   hashes by the identity of the object holding it. */
+Vi_hash_t ViHash_Double(ViObject *inst, double v);
+
+/* Hash of an object identity */
+Vi_hash_t ViHash_Pointer(const void *ptr);
+
+/* Derive the key from seed instead of drawing a random one, must be
+   called before anything is hashed.  Seed 0 gives an all zero key. */
+void ViHash_SetSeed(Vi_uint64_t seed);
+
+#endif // __VIHASH_H__
\ No newline at end of file
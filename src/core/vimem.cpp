@@ -1,15 +1,51 @@
+#define Vi_MEM_NO_SITES
 #include "vimem.h"
 
-void* Mem_Alloc(size_t size)
+#include <climits>
+#include <cstddef>
+
+#include "viarena.h"
+#include "runtime.h"
+
+/* Every Mem_* block is preceded by its requested size and its owner so
+   that frees and reallocs can be accounted for.  The header keeps
+   malloc's alignment. */
+typedef struct alignas(std::max_align_t) _memheader
+{
+	size_t size;
+	unsigned int owner;	// Account charged for the block
+} mem_header;
+
+#define HEADER_SIZE sizeof(mem_header)
+
+#define MEM_TO_HEADER(p) ((mem_header *)(p) - 1)
+#define HEADER_TO_MEM(h) ((void *)((mem_header *)(h) + 1))
+
+static ViMemStats mem_stats;
+
+ViMemAccount *ViMem_CurrentAccount = NULL;
+
+static ViMemAccount *no_accounts[1] = { NULL };
+ViMemAccount **ViMem_Accounts = no_accounts;
+static unsigned int naccounts = 1;
+static unsigned int maxaccounts = 1;
+
+//
+//
+//		Allocator domains
+//
+//
+
+static void* raw_malloc(void *, size_t size)
 {
 	if (size == 0)
 		size = 1;
 	return malloc(size);
 }
 
-void* Mem_Calloc(size_t elemCount, size_t elemSize)
+static void* raw_calloc(void *, size_t elemCount, size_t elemSize)
 {
-	if (elemCount == 0 || elemCount == 0)
+	if (elemCount == 0 || elemSize == 0)
 	{
 		elemCount = 1;
 		elemSize = 1;
@@ -17,18 +53,348 @@ void* Mem_Calloc(size_t elemCount, size_t elemSize)
 	return calloc(elemCount, elemSize);
 }
 
-void* Mem_Realloc(void* ptr, size_t new_size)
+static void* raw_realloc(void *, void *ptr, size_t new_size)
 {
 	if (new_size == 0)
 		new_size = 1;
 	return realloc(ptr, new_size);
 }
 
-void Mem_Free(void* ptr)
+static void raw_free(void *, void *ptr)
 {
 	free(ptr);
 }
 
+#define RAW_ALLOC {NULL, raw_malloc, raw_calloc, raw_realloc, raw_free}
+#define OBJ_ALLOC {NULL, ViObmalloc_Malloc, ViObmalloc_Calloc, ViObmalloc_Realloc, ViObmalloc_Free}
+
+static ViMemAllocator raw_allocator = RAW_ALLOC;
+static ViMemAllocator mem_allocator = RAW_ALLOC;
+static ViMemAllocator obj_allocator = OBJ_ALLOC;
+
+static ViMemAllocator *get_allocator(ViMemAllocatorDomain domain)
+{
+	switch (domain)
+	{
+	case ViMem_DOMAIN_RAW: return &raw_allocator;
+	case ViMem_DOMAIN_MEM: return &mem_allocator;
+	case ViMem_DOMAIN_OBJ: return &obj_allocator;
+	default: return NULL;
+	}
+}
+
+void ViMem_GetAllocator(ViMemAllocatorDomain domain, ViMemAllocator *allocator)
+{
+	ViMemAllocator *current = get_allocator(domain);
+	if (current == NULL)
+	{
+		/* Unknown domain, leave the allocator empty */
+		memset(allocator, 0, sizeof(*allocator));
+		return;
+	}
+	*allocator = *current;
+}
+
+void ViMem_SetAllocator(ViMemAllocatorDomain domain, ViMemAllocator *allocator)
+{
+	ViMemAllocator *current = get_allocator(domain);
+	if (current == NULL)
+		return; // Unknown domain, ignore
+	*current = *allocator;
+}
+
+void* ViMem_RawMalloc(size_t size)
+{
+	return raw_allocator.malloc(raw_allocator.ctx, size);
+}
+
+void* ViMem_RawCalloc(size_t elemCount, size_t elemSize)
+{
+	return raw_allocator.calloc(raw_allocator.ctx, elemCount, elemSize);
+}
+
+void* ViMem_RawRealloc(void* ptr, size_t new_size)
+{
+	return raw_allocator.realloc(raw_allocator.ctx, ptr, new_size);
+}
+
+void ViMem_RawFree(void* ptr)
+{
+	raw_allocator.free(raw_allocator.ctx, ptr);
+}
+
+void* ViObject_Malloc(size_t size)
+{
+	return obj_allocator.malloc(obj_allocator.ctx, size);
+}
+
+void* ViObject_Calloc(size_t elemCount, size_t elemSize)
+{
+	return obj_allocator.calloc(obj_allocator.ctx, elemCount, elemSize);
+}
+
+void* ViObject_Realloc(void* ptr, size_t new_size)
+{
+	return obj_allocator.realloc(obj_allocator.ctx, ptr, new_size);
+}
+
+void ViObject_Free(void* ptr)
+{
+	obj_allocator.free(obj_allocator.ctx, ptr);
+}
+
+//
+//
+//		Mem_* with statistics
+//
+//
+
+static inline void stats_add(size_t size)
+{
+	mem_stats.current_bytes += size;
+	mem_stats.total_bytes += size;
+	if (mem_stats.current_bytes > mem_stats.peak_bytes)
+		mem_stats.peak_bytes = mem_stats.current_bytes;
+}
+
+/* Fail a call before it reaches the allocator, which would have taken
+   its site */
+static inline void *refuse_alloc()
+{
+	ViTraceMalloc_CLEAR_SITE();
+	return NULL;
+}
+
+void* Mem_Alloc(size_t size)
+{
+	mem_header *h;
+	unsigned int owner = ViMem_CurrentOwner();
+
+	if (size == 0)
+		size = 1;
+	if (size > (size_t)VI_SIZE_T_MAX - HEADER_SIZE || ViMem_Charge(owner, size) < 0)
+		return refuse_alloc();
+	h = (mem_header *)mem_allocator.malloc(mem_allocator.ctx, HEADER_SIZE + size);
+	if (h == NULL)
+	{
+		ViMem_Credit(owner, size);
+		return NULL;
+	}
+	h->size = size;
+	h->owner = owner;
+	mem_stats.allocs++;
+	stats_add(size);
+	return HEADER_TO_MEM(h);
+}
+
+void* Mem_Calloc(size_t elemCount, size_t elemSize)
+{
+	mem_header *h;
+	size_t size;
+	unsigned int owner = ViMem_CurrentOwner();
+
+	if (elemCount == 0 || elemSize == 0)
+	{
+		elemCount = 1;
+		elemSize = 1;
+	}
+	if (elemCount > ((size_t)VI_SIZE_T_MAX - HEADER_SIZE) / elemSize)
+		return refuse_alloc();
+	size = elemCount * elemSize;
+	if (ViMem_Charge(owner, size) < 0)
+		return refuse_alloc();
+	h = (mem_header *)mem_allocator.calloc(mem_allocator.ctx, 1, HEADER_SIZE + size);
+	if (h == NULL)
+	{
+		ViMem_Credit(owner, size);
+		return NULL;
+	}
+	h->size = size;
+	h->owner = owner;
+	mem_stats.allocs++;
+	stats_add(size);
+	return HEADER_TO_MEM(h);
+}
+
+void* Mem_Realloc(void* ptr, size_t new_size)
+{
+	mem_header *h;
+	size_t old_size;
+	unsigned int owner;
+
+	if (ptr == NULL)
+		return Mem_Alloc(new_size);
+	if (new_size == 0)
+		new_size = 1;
+	if (new_size > (size_t)VI_SIZE_T_MAX - HEADER_SIZE)
+		return refuse_alloc();
+
+	old_size = MEM_TO_HEADER(ptr)->size;
+	owner = MEM_TO_HEADER(ptr)->owner;
+	/* The block stays with its owner.  Only growth is charged up front,
+	   a shrink is credited once done. */
+	if (new_size > old_size && ViMem_Charge(owner, new_size - old_size) < 0)
+		return refuse_alloc();
+	h = (mem_header *)mem_allocator.realloc(mem_allocator.ctx, MEM_TO_HEADER(ptr), HEADER_SIZE + new_size);
+	if (h == NULL)
+	{
+		if (new_size > old_size)
+			ViMem_Credit(owner, new_size - old_size);
+		return NULL;
+	}
+	if (new_size < old_size)
+		ViMem_Credit(owner, old_size - new_size);
+	h->size = new_size;
+	mem_stats.reallocs++;
+	mem_stats.current_bytes -= old_size;
+	stats_add(new_size);
+	return HEADER_TO_MEM(h);
+}
+
+void Mem_Free(void* ptr)
+{
+	if (ptr == NULL)
+		return;
+	mem_header *h = MEM_TO_HEADER(ptr);
+	mem_stats.frees++;
+	mem_stats.current_bytes -= h->size;
+	ViMem_Credit(h->owner, h->size);
+	mem_allocator.free(mem_allocator.ctx, h);
+}
+
+//
+//
+//		Memory accounting
+//
+//
+
+int ViMem_InitAccount(ViMemAccount *account)
+{
+	account->used = 0;
+	account->limit = (size_t)VI_SIZE_T_MAX;
+	account->refused = 0;
+	account->exceeded = 0;
+	account->id = 0;
+
+	if (naccounts == maxaccounts)
+	{
+		if (maxaccounts > UINT_MAX / 2)
+			return -1;
+		unsigned int n = maxaccounts < 16 ? 16 : maxaccounts * 2;
+		ViMemAccount **table = (ViMemAccount **)ViMem_RawMalloc(n * sizeof(*table));
+		if (table == NULL)
+			return -1;
+		memcpy(table, ViMem_Accounts, naccounts * sizeof(*table));
+		if (ViMem_Accounts != no_accounts)
+			ViMem_RawFree(ViMem_Accounts);
+		ViMem_Accounts = table;
+		maxaccounts = n;
+	}
+
+	/* A new id every time, blocks of a released account must never be
+	   credited to another one */
+	account->id = naccounts;
+	ViMem_Accounts[naccounts++] = account;
+	return 0;
+}
+
+void ViMem_ReleaseAccount(ViMemAccount *account)
+{
+	if (account->id != 0)
+		ViMem_Accounts[account->id] = NULL;
+	account->id = 0;
+	if (ViMem_CurrentAccount == account)
+		ViMem_CurrentAccount = NULL;
+}
+
+void ViMem_SetAccount(ViMemAccount *account)
+{
+	ViMem_CurrentAccount = account;
+}
+
+ViMemAccount *ViMem_GetAccount()
+{
+	return ViMem_CurrentAccount;
+}
+
+void ViMem_SetAccountLimit(ViMemAccount *account, size_t limit)
+{
+	account->limit = limit == 0 ? (size_t)VI_SIZE_T_MAX : limit;
+}
+
+int ViMem_RefuseCharge(ViMemAccount *account)
+{
+	account->refused++;
+	account->exceeded = 1;
+	return -1;
+}
+
+void ViMem_GetStats(ViMemStats *stats)
+{
+	*stats = mem_stats;
+}
+
+void ViMem_ResetPeak()
+{
+	mem_stats.peak_bytes = mem_stats.current_bytes;
+}
+
+static void json_arena_usage(Vi_string_t &out, const ViArenaUsage *usage)
+{
+	char buf[512];
+	snprintf(buf, sizeof(buf),
+		"{\"arenas\": %zu, \"live_arenas\": %zu, \"live_block_bytes\": %zu, "
+		"\"peak_live_block_bytes\": %zu, \"peak_arena_block_bytes\": %zu, "
+		"\"allocs\": %zu, \"alloc_bytes\": %zu, \"blocks\": %zu, "
+		"\"block_bytes\": %zu, \"big_blocks\": %zu, \"wasted_bytes\": %zu, "
+		"\"objects\": %zu}",
+		usage->arenas, usage->live_arenas, usage->live_block_bytes,
+		usage->peak_live_block_bytes, usage->peak_arena_block_bytes,
+		usage->totals.allocs, usage->totals.alloc_bytes, usage->totals.blocks,
+		usage->totals.block_bytes, usage->totals.big_blocks, usage->totals.wasted_bytes,
+		usage->totals.objects);
+	out += buf;
+}
+
+Vi_string_t ViMem_StatsAsJSON()
+{
+	char buf[256];
+	Vi_string_t out;
+	ViArenaUsage usage;
+	ViInterpreterState *interp = ViInterpreterState_GET();
+
+	snprintf(buf, sizeof(buf),
+		"{\"mem\": {\"allocs\": %zu, \"reallocs\": %zu, \"frees\": %zu, "
+		"\"current_bytes\": %zu, \"peak_bytes\": %zu, \"total_bytes\": %zu}, ",
+		mem_stats.allocs, mem_stats.reallocs, mem_stats.frees,
+		mem_stats.current_bytes, mem_stats.peak_bytes, mem_stats.total_bytes);
+	out += buf;
+
+	ViMemBlockStats block_stats;
+	ViMem_GetBlockStats(&block_stats);
+	snprintf(buf, sizeof(buf),
+		"\"blocks\": {\"blocks\": %zu, \"bytes\": %zu, \"peak_bytes\": %zu, "
+		"\"cache_hits\": %zu, \"cached_blocks\": %zu}, ",
+		block_stats.blocks, block_stats.bytes, block_stats.peak_bytes,
+		block_stats.cache_hits, block_stats.cached_blocks);
+	out += buf;
+
+	ViArena_GetGlobalUsage(&usage);
+	out += "\"arenas\": ";
+	json_arena_usage(out, &usage);
+
+	out += ", \"interpreter\": ";
+	if (interp != NULL)
+	{
+		ViArena_GetInterpreterUsage(interp, &usage);
+		json_arena_usage(out, &usage);
+	}
+	else
+		out += "null";
+	out += "}";
+	return out;
+}
+
 wchar_t *Mem_WcsDup(const wchar_t *str)
 {
 	assert(str != NULL);
@@ -3,6 +3,49 @@
 
 #include "../port.h"
 
+/*
+ * Allocator domains
+ *
+ * RAW:  ViMem_Raw*, plain system memory
+ * MEM:  Mem_*, general purpose memory
+ * OBJ:  ViObject_*, small and short lived object memory
+ *
+ * Each domain forwards to a replaceable allocator table.  A new
+ * allocator must be installed before the first allocation of its domain,
+ * or it must forward to the allocator it replaces (get it first with
+ * ViMem_GetAllocator()), since blocks allocated by one allocator must be
+ * released by the same one.  This is how hooks for debugging and tracing
+ * are layered on top of the defaults.
+ *
+ * Allocators must return a distinct non NULL pointer for a size of 0
+ * and must not set an error, the callers do.
+*/
+
+typedef enum
+{
+	ViMem_DOMAIN_RAW,
+	ViMem_DOMAIN_MEM,
+	ViMem_DOMAIN_OBJ
+} ViMemAllocatorDomain;
+
+typedef struct _memallocator
+{
+	void *ctx; // User context passed as first argument to the functions
+
+	void* (*malloc)(void *ctx, size_t size);
+	void* (*calloc)(void *ctx, size_t elemCount, size_t elemSize);
+	void* (*realloc)(void *ctx, void *ptr, size_t new_size);
+	void (*free)(void *ctx, void *ptr);
+} ViMemAllocator;
+
+void ViMem_GetAllocator(ViMemAllocatorDomain domain, ViMemAllocator *allocator);
+void ViMem_SetAllocator(ViMemAllocatorDomain domain, ViMemAllocator *allocator);
+
+void* ViMem_RawMalloc(size_t size);
+void* ViMem_RawCalloc(size_t elemCount, size_t elemSize);
+void* ViMem_RawRealloc(void* ptr, size_t new_size);
+void ViMem_RawFree(void* ptr);
+
 void* Mem_Alloc(size_t size);
 void* Mem_Calloc(size_t elemCount, size_t elemSize);
 void* Mem_Realloc(void* ptr, size_t new_size);
@@ -10,4 +53,180 @@ void Mem_Free(void* ptr);
 
 wchar_t *Mem_WcsDup(const wchar_t *str);
 
+/* Statistics of the Mem_* functions, always collected */
+typedef struct _memstats
+{
+	size_t allocs;			// Calls to Mem_Alloc() and Mem_Calloc()
+	size_t reallocs;		// Calls to Mem_Realloc() on an existing block
+	size_t frees;			// Calls to Mem_Free() on an existing block
+	size_t current_bytes;	// Bytes currently allocated
+	size_t peak_bytes;		// High-water mark of current_bytes
+	size_t total_bytes;		// Bytes allocated since startup
+} ViMemStats;
+
+void ViMem_GetStats(ViMemStats *stats);
+
+/* Start a new high-water mark from the current usage */
+void ViMem_ResetPeak();
+
+/* The Mem_* statistics, the global and the current interpreter's arena
+   statistics as a JSON object */
+Vi_string_t ViMem_StatsAsJSON();
+
+/* Object allocator, optimized for small and short lived blocks.
+   Memory must be released with the function of the same family. */
+void* ViObject_Malloc(size_t size);
+void* ViObject_Calloc(size_t elemCount, size_t elemSize);
+void* ViObject_Realloc(void* ptr, size_t new_size);
+void ViObject_Free(void* ptr);
+
+/* The default OBJ domain allocator, see viobmalloc.cpp */
+void* ViObmalloc_Malloc(void *ctx, size_t size);
+void* ViObmalloc_Calloc(void *ctx, size_t elemCount, size_t elemSize);
+void* ViObmalloc_Realloc(void *ctx, void* ptr, size_t new_size);
+void ViObmalloc_Free(void *ctx, void* ptr);
+
+/*
+ * Block provider
+ *
+ * Big blocks for the ViArena blocks and the object allocator's arenas.
+ * Blocks of 64 KiB and more are mapped directly from the OS where
+ * possible and are page aligned, smaller ones come from the raw
+ * allocator.  Sizes are rounded up to whole pages, ViMem_BlockSize()
+ * tells by how much.
+*/
+
+typedef struct _blockconfig
+{
+	size_t arena_block_size;	// Bytes per ViArena block, header included
+	int huge_pages;				// Huge pages for blocks of 2 MiB and up, 2 MiB object arenas
+	int cache_blocks;			// Freed blocks kept, without their pages, for reuse
+} ViMemBlockConfig;
+
+typedef struct _blockstats
+{
+	size_t blocks;			// Blocks in use
+	size_t bytes;			// Bytes in use
+	size_t peak_bytes;		// High-water mark of bytes
+	size_t cache_hits;		// Allocations served from the cache
+	size_t cached_blocks;	// Blocks currently in the cache
+} ViMemBlockStats;
+
+size_t ViMem_BlockSize(size_t size);
+void *ViMem_BlockAlloc(size_t size);
+void ViMem_BlockFree(void *ptr, size_t size);
+
+void ViMem_GetBlockConfig(ViMemBlockConfig *config);
+/* Returns -1 if the configuration is invalid */
+int ViMem_SetBlockConfig(const ViMemBlockConfig *config);
+void ViMem_GetBlockStats(ViMemBlockStats *stats);
+
+/*
+ * Memory accounting
+ *
+ * Memory of the Mem_* functions, the object allocator's pools and the
+ * ViArena blocks is charged to the current account, normally the one of
+ * the running interpreter.  An allocation that would take an account
+ * over its limit is refused, it fails like any other out of memory
+ * condition and ViError_NoMemory() reports that the limit was exceeded.
+ *
+ * Blocks record the account they were charged to, their owner, and are
+ * credited to it when freed whatever account is current then.
+ * ViThreadState_Swap() switches the current account with the thread
+ * state.  Accounts are registered by ViMem_InitAccount() and must be
+ * released before they go away, blocks that outlive their account are
+ * not credited to anything.
+*/
+
+typedef struct _memaccount
+{
+	size_t used;		// Bytes charged
+	size_t limit;		// Hard limit on used, VI_SIZE_T_MAX for no limit
+	size_t refused;		// Allocations refused because of the limit
+	int exceeded;		// Set when an allocation is refused, cleared by ViError_NoMemory()
+	unsigned int id;	// Owner recorded in the blocks charged to the account, 0 if not registered
+} ViMemAccount;
+
+/* The account charged for new memory, NULL to charge nothing */
+extern ViMemAccount *ViMem_CurrentAccount;
+
+/* Registered accounts by id.  ViMem_Accounts[0] is always NULL, it owns
+   the blocks charged to no account.  Ids are never reused. */
+extern ViMemAccount **ViMem_Accounts;
+
+/* Initialize and register the account, returns -1 if out of memory */
+int ViMem_InitAccount(ViMemAccount *account);
+/* Unregister the account, it is no longer current either */
+void ViMem_ReleaseAccount(ViMemAccount *account);
+void ViMem_SetAccount(ViMemAccount *account);
+ViMemAccount *ViMem_GetAccount();
+
+/* Set the hard limit in bytes, 0 for no limit */
+void ViMem_SetAccountLimit(ViMemAccount *account, size_t limit);
+
+/* Record a refused charge, returns -1 */
+int ViMem_RefuseCharge(ViMemAccount *account);
+
+/* The owner of new blocks, the id of the current account */
+static inline unsigned int ViMem_CurrentOwner()
+{
+	ViMemAccount *account = ViMem_CurrentAccount;
+	return account != NULL ? account->id : 0;
+}
+
+/* Charge size bytes to the account of owner, returns -1 if that would
+   exceed its limit.  The fast path is a comparison and a counter
+   update, size must not be above VI_SIZE_T_MAX. */
+static inline int ViMem_Charge(unsigned int owner, size_t size)
+{
+	ViMemAccount *account = ViMem_Accounts[owner];
+	if (account != NULL)
+	{
+		if (account->used + size > account->limit)
+			return ViMem_RefuseCharge(account);
+		account->used += size;
+	}
+	return 0;
+}
+
+/* Give size bytes back to the account of owner */
+static inline void ViMem_Credit(unsigned int owner, size_t size)
+{
+	ViMemAccount *account = ViMem_Accounts[owner];
+	if (account != NULL)
+		account->used -= size < account->used ? size : account->used;
+}
+
+/* Allocation sites for tracing, see vitracemalloc.h.  The site is only
+   recorded while tracing, the first site set before an allocation wins
+   so callers can attribute their allocations, e.g. to a type name. */
+extern int ViTraceMalloc_Tracing;
+void ViTraceMalloc_SetSite(const char *filename, int lineno);
+
+/* Forget the site of a call that fails before it reaches the allocator,
+   so it is not given to the next allocation */
+void ViTraceMalloc_ClearSite();
+
+#define ViTraceMalloc_SET_SITE(filename, lineno) \
+	(ViTraceMalloc_Tracing ? ViTraceMalloc_SetSite(filename, lineno) : (void)0)
+#define ViTraceMalloc_CLEAR_SITE() \
+	(ViTraceMalloc_Tracing ? ViTraceMalloc_ClearSite() : (void)0)
+
+/* The allocator implementations define Vi_MEM_NO_SITES to see the plain
+   functions */
+#ifndef Vi_MEM_NO_SITES
+#	define Mem_Alloc(size) \
+		(ViTraceMalloc_SET_SITE(__FILE__, __LINE__), Mem_Alloc(size))
+#	define Mem_Calloc(elemCount, elemSize) \
+		(ViTraceMalloc_SET_SITE(__FILE__, __LINE__), Mem_Calloc(elemCount, elemSize))
+#	define Mem_Realloc(ptr, new_size) \
+		(ViTraceMalloc_SET_SITE(__FILE__, __LINE__), Mem_Realloc(ptr, new_size))
+#	define ViObject_Malloc(size) \
+		(ViTraceMalloc_SET_SITE(__FILE__, __LINE__), ViObject_Malloc(size))
+#	define ViObject_Calloc(elemCount, elemSize) \
+		(ViTraceMalloc_SET_SITE(__FILE__, __LINE__), ViObject_Calloc(elemCount, elemSize))
+#	define ViObject_Realloc(ptr, new_size) \
+		(ViTraceMalloc_SET_SITE(__FILE__, __LINE__), ViObject_Realloc(ptr, new_size))
+#endif
+
 #endif // __MEMORY_H__
\ No newline at end of file
@@ -0,0 +1,486 @@
+#define Vi_MEM_NO_SITES
+#include "vimem.h"
+
+#include <climits>
+
+/* An object allocator for Viper.
+
+   Objects are small and short lived, and going to the system malloc()
+   for each of them costs both time and memory (per-chunk metadata and
+   fragmentation).  Requests of up to SMALL_REQUEST_THRESHOLD bytes are
+   therefore served from pools of equally sized blocks, anything bigger
+   is passed through to Mem_Alloc().
+
+   The memory layout follows the classic pymalloc design:
+
+   - An arena is ARENA_SIZE bytes of memory obtained from the system,
+     a whole huge page when the block provider uses huge pages.
+     It is carved into POOL_SIZE aligned pools.
+   - A pool holds blocks of a single size class, all charged to the same
+     memory account.  Free blocks of a pool are threaded into a
+     singly-linked list through their first word, untouched blocks at
+     the end of the pool are handed out lazily.
+   - Partially used pools of each account and size class are linked
+     into usedpools[][], so the common allocation and deallocation paths
+     only do a handful of pointer operations.
+   - Pools that become empty go back to their arena and arenas that
+     become empty are given back to the system.
+
+   The allocator is not thread safe, callers must serialize access.
+*/
+
+/* Blocks are aligned to (and sizes rounded up to) ALIGNMENT bytes. */
+#if SIZEOF_VOID_P > 4 || defined(__LP64__) || defined(_WIN64)
+#	define ALIGNMENT			16
+#	define ALIGNMENT_SHIFT		4
+#else
+#	define ALIGNMENT			8
+#	define ALIGNMENT_SHIFT		3
+#endif
+
+/* Requests larger than this are forwarded to Mem_Alloc() */
+#define SMALL_REQUEST_THRESHOLD	512
+#define NB_SMALL_SIZE_CLASSES	(SMALL_REQUEST_THRESHOLD / ALIGNMENT)
+#define IS_SMALL_REQUEST(S)		((S) != 0 && (S) <= SMALL_REQUEST_THRESHOLD)
+
+/* Size class index <-> block size */
+#define INDEX2SIZE(I) (((unsigned int)(I) + 1) << ALIGNMENT_SHIFT)
+#define SIZE2INDEX(S) (((unsigned int)(S) - 1) >> ALIGNMENT_SHIFT)
+
+/* A pool must never be larger than a system page, address_in_range()
+   relies on the pool header living in the same page as the address
+   being freed. */
+#define SYSTEM_PAGE_SIZE		(4 * 1024)
+#define POOL_SIZE				SYSTEM_PAGE_SIZE
+#define POOL_SIZE_MASK			(POOL_SIZE - 1)
+
+/* Arenas come from the block provider, ViMem_BlockAlloc() */
+#ifndef ViObmalloc_ARENA_SIZE
+#	define ViObmalloc_ARENA_SIZE	(256 * 1024)
+#endif
+#define HUGE_ARENA_SIZE			(2 * 1024 * 1024)
+#define ARENA_SIZE				arena_size
+
+#define INITIAL_ARENA_OBJECTS	16
+
+typedef Vi_uint8_t block;
+
+/* Pool header, lives at the start of each pool */
+typedef struct _poolheader
+{
+	unsigned int count;				// Number of allocated blocks
+	block *freeblock;				// Head of the pool's free list
+	struct _poolheader *nextpool;	// Next pool of this size class
+	struct _poolheader *prevpool;	// Previous pool of this size class
+	unsigned int arenaindex;		// Index into arenas of the owning arena
+	unsigned int szidx;				// Block size class index
+	unsigned int owner;				// Account charged for the blocks, see vimem.h
+	unsigned int nextoffset;		// Bytes to the next never used block
+	unsigned int maxnextoffset;		// Largest valid nextoffset
+} poolheader;
+
+typedef poolheader *poolp;
+
+#define POOL_OVERHEAD Vi_SIZE_ROUND_UP(sizeof(poolheader), ALIGNMENT)
+
+/* Round pointer "p" down to the start of its pool */
+#define POOL_ADDR(p) ((poolp)Vi_ALIGN_DOWN((p), POOL_SIZE))
+
+/* Record keeping for arenas */
+typedef struct _arenaobject
+{
+	/* The address of the arena as returned by the system, 0 if this
+	   object is not associated with an allocated arena. */
+	uintptr_t address;
+
+	/* Pool aligned pointer to the next pool to be carved off */
+	block *pool_address;
+
+	/* Number of available pools in the arena, either in freepools or
+	   still to be carved off at pool_address */
+	unsigned int nfreepools;
+
+	/* Total number of pools in the arena, whether or not available */
+	unsigned int ntotalpools;
+
+	/* Singly-linked list of pools that were used and became empty */
+	poolheader *freepools;
+
+	/* Whenever this object is not associated with an allocated arena,
+	   nextarena links it into unused_arena_objects.  Otherwise, if the
+	   arena has free pools, nextarena and prevarena link it into
+	   usable_arenas. */
+	struct _arenaobject *nextarena;
+	struct _arenaobject *prevarena;
+} arenaobject;
+
+/* Array of arena objects, grown on demand */
+static arenaobject *arenas = NULL;
+static unsigned int maxarenas = 0;
+
+/* Arena objects without an associated arena */
+static arenaobject *unused_arena_objects = NULL;
+
+/* Arenas with at least one available pool */
+static arenaobject *usable_arenas = NULL;
+
+/* Partially used pools for every size class, NULL if there are none */
+typedef poolp usedpool_lists[NB_SMALL_SIZE_CLASSES];
+
+/* The used pools of every owner, grown on demand */
+static usedpool_lists no_owner_pools[1];
+static usedpool_lists *usedpools = no_owner_pools;
+static unsigned int nowners = 1;
+
+/* Number of arenas currently allocated */
+static size_t narenas_currently_allocated = 0;
+
+/* Size of every allocated arena, only changes while there are none */
+static size_t arena_size = ViObmalloc_ARENA_SIZE;
+
+/* Allocate a new arena.  Returns NULL if out of memory.  Must only be
+   called when there are no usable arenas, so that growing the arenas
+   array cannot invalidate any pointer into it. */
+static arenaobject *new_arena()
+{
+	arenaobject *arenaobj;
+	uintptr_t excess;
+
+	assert(usable_arenas == NULL);
+
+	if (unused_arena_objects == NULL)
+	{
+		unsigned int numarenas = maxarenas ? maxarenas << 1 : INITIAL_ARENA_OBJECTS;
+		if (numarenas <= maxarenas)
+			return NULL; // Overflow
+		if ((size_t)numarenas > SIZE_MAX / sizeof(*arenas))
+			return NULL;
+
+		arenaobj = (arenaobject *)Mem_Realloc(arenas, numarenas * sizeof(*arenas));
+		if (arenaobj == NULL)
+			return NULL;
+		arenas = arenaobj;
+
+		/* Thread the new arena objects onto unused_arena_objects */
+		for (unsigned int i = maxarenas; i < numarenas; i++)
+		{
+			arenas[i].address = 0;
+			arenas[i].nextarena = i < numarenas - 1 ? &arenas[i + 1] : NULL;
+		}
+		unused_arena_objects = &arenas[maxarenas];
+		maxarenas = numarenas;
+	}
+
+	if (narenas_currently_allocated == 0)
+	{
+		ViMemBlockConfig config;
+		ViMem_GetBlockConfig(&config);
+		arena_size = config.huge_pages ? HUGE_ARENA_SIZE : ViObmalloc_ARENA_SIZE;
+	}
+
+	arenaobj = unused_arena_objects;
+	void *address = ViMem_BlockAlloc(ARENA_SIZE);
+	if (address == NULL)
+		return NULL;
+	unused_arena_objects = arenaobj->nextarena;
+	arenaobj->address = (uintptr_t)address;
+	narenas_currently_allocated++;
+
+	arenaobj->freepools = NULL;
+	arenaobj->pool_address = (block *)arenaobj->address;
+	arenaobj->nfreepools = ARENA_SIZE / POOL_SIZE;
+	excess = (uintptr_t)arenaobj->address & POOL_SIZE_MASK;
+	if (excess != 0)
+	{
+		/* Sacrifice a pool to get the rest aligned */
+		--arenaobj->nfreepools;
+		arenaobj->pool_address += POOL_SIZE - excess;
+	}
+	arenaobj->ntotalpools = arenaobj->nfreepools;
+	return arenaobj;
+}
+
+/* Return 1 if p was allocated by this allocator.  The pool header is
+   read even if p does not belong to us; this is safe since the header
+   lies in the same system page as p, but it is not memory we own, so
+   the function is hidden from the sanitizers. */
+static Vi_NO_SANITIZE int address_in_range(void *p, poolp pool)
+{
+	unsigned int arenaindex = *((volatile unsigned int *)&pool->arenaindex);
+	return arenaindex < maxarenas &&
+		(uintptr_t)p - arenas[arenaindex].address < ARENA_SIZE &&
+		arenas[arenaindex].address != 0;
+}
+
+/* Make room for the used pools of owner.  Returns -1 if out of memory. */
+static int usedpools_grow(unsigned int owner)
+{
+	unsigned int n = nowners;
+	while (n <= owner)
+		n = n > UINT_MAX / 2 ? owner + 1 : n * 2;
+
+	usedpool_lists *lists = (usedpool_lists *)ViMem_RawMalloc(n * sizeof(*lists));
+	if (lists == NULL)
+		return -1;
+	memcpy(lists, usedpools, nowners * sizeof(*lists));
+	memset(lists + nowners, 0, (n - nowners) * sizeof(*lists));
+	if (usedpools != no_owner_pools)
+		ViMem_RawFree(usedpools);
+	usedpools = lists;
+	nowners = n;
+	return 0;
+}
+
+static inline void usedpool_link(poolp pool, unsigned int size_idx)
+{
+	poolp next = usedpools[pool->owner][size_idx];
+	pool->nextpool = next;
+	pool->prevpool = NULL;
+	if (next != NULL)
+		next->prevpool = pool;
+	usedpools[pool->owner][size_idx] = pool;
+}
+
+static inline void usedpool_unlink(poolp pool)
+{
+	poolp next = pool->nextpool;
+	poolp prev = pool->prevpool;
+	if (prev != NULL)
+		prev->nextpool = next;
+	else
+		usedpools[pool->owner][pool->szidx] = next;
+	if (next != NULL)
+		next->prevpool = prev;
+}
+
+/* Take an empty pool from the usable arenas and set it up for the size
+   class and owner.  Returns the first block, or NULL if out of memory. */
+static void *allocate_from_new_pool(unsigned int size_idx, unsigned int owner)
+{
+	arenaobject *arena;
+	poolp pool;
+	block *bp;
+	unsigned int size;
+
+	if (usable_arenas == NULL)
+	{
+		usable_arenas = new_arena();
+		if (usable_arenas == NULL)
+			return NULL;
+		usable_arenas->nextarena = usable_arenas->prevarena = NULL;
+	}
+	arena = usable_arenas;
+	assert(arena->address != 0);
+	assert(arena->nfreepools > 0);
+
+	pool = arena->freepools;
+	if (pool != NULL)
+	{
+		arena->freepools = pool->nextpool;
+	}
+	else
+	{
+		assert((block *)arena->pool_address <= (block *)arena->address + ARENA_SIZE - POOL_SIZE);
+		pool = (poolp)arena->pool_address;
+		pool->arenaindex = (unsigned int)(arena - arenas);
+		arena->pool_address += POOL_SIZE;
+	}
+	--arena->nfreepools;
+
+	if (arena->nfreepools == 0)
+	{
+		/* Arena is exhausted, drop it from usable_arenas */
+		usable_arenas = arena->nextarena;
+		if (usable_arenas != NULL)
+			usable_arenas->prevarena = NULL;
+	}
+
+	size = INDEX2SIZE(size_idx);
+	pool->szidx = size_idx;
+	pool->owner = owner;
+	pool->count = 1;
+	bp = (block *)pool + POOL_OVERHEAD;
+	pool->nextoffset = POOL_OVERHEAD + (size << 1);
+	pool->maxnextoffset = POOL_SIZE - size;
+	pool->freeblock = bp + size;
+	*(block **)(pool->freeblock) = NULL;
+	usedpool_link(pool, size_idx);
+	return bp;
+}
+
+/* Allocate a block for a small request from the pools of owner, NULL if
+   there is no memory left for a new arena. */
+static inline void *pool_alloc(size_t size, unsigned int owner)
+{
+	assert(IS_SMALL_REQUEST(size));
+	assert(owner < nowners);
+
+	unsigned int size_idx = SIZE2INDEX(size);
+	poolp pool = usedpools[owner][size_idx];
+	block *bp;
+
+	if (pool == NULL)
+		return allocate_from_new_pool(size_idx, owner);
+
+	/* There is a used pool for this size class, pick its first
+	   free block. */
+	++pool->count;
+	bp = pool->freeblock;
+	assert(bp != NULL);
+	if ((pool->freeblock = *(block **)bp) != NULL)
+		return bp;
+
+	/* Reached the end of the free list, try to extend it */
+	if (pool->nextoffset <= pool->maxnextoffset)
+	{
+		pool->freeblock = (block *)pool + pool->nextoffset;
+		pool->nextoffset += INDEX2SIZE(size_idx);
+		*(block **)(pool->freeblock) = NULL;
+		return bp;
+	}
+
+	/* Pool is full, unlink it from the used pools */
+	usedpool_unlink(pool);
+	return bp;
+}
+
+/* Give an emptied pool back to its arena */
+static void insert_to_freepool(poolp pool)
+{
+	arenaobject *arena = &arenas[pool->arenaindex];
+	unsigned int nf;
+
+	usedpool_unlink(pool);
+	pool->nextpool = arena->freepools;
+	arena->freepools = pool;
+	nf = ++arena->nfreepools;
+
+	if (nf == arena->ntotalpools && (arena->prevarena != NULL || arena->nextarena != NULL))
+	{
+		/* Arena is completely free, give it back to the system.  The
+		   last usable arena is kept around so that a program hovering
+		   around an arena boundary does not thrash the system allocator. */
+		assert(nf > 1);
+		if (arena->prevarena == NULL)
+			usable_arenas = arena->nextarena;
+		else
+			arena->prevarena->nextarena = arena->nextarena;
+		if (arena->nextarena != NULL)
+			arena->nextarena->prevarena = arena->prevarena;
+
+		arena->nextarena = unused_arena_objects;
+		unused_arena_objects = arena;
+
+		ViMem_BlockFree((void *)arena->address, ARENA_SIZE);
+		arena->address = 0;
+		--narenas_currently_allocated;
+		return;
+	}
+
+	if (nf == 1)
+	{
+		/* Arena was full and is usable again, put it in front */
+		arena->nextarena = usable_arenas;
+		arena->prevarena = NULL;
+		if (usable_arenas != NULL)
+			usable_arenas->prevarena = arena;
+		usable_arenas = arena;
+	}
+}
+
+/* Free a block that is known to be owned by the pool allocator */
+static inline void pool_free(poolp pool, void *p)
+{
+	block *lastfree = pool->freeblock;
+
+	assert(pool->count > 0);
+	ViMem_Credit(pool->owner, INDEX2SIZE(pool->szidx));
+	*(block **)p = lastfree;
+	pool->freeblock = (block *)p;
+	pool->count--;
+
+	/* A pool without free blocks was full, it can serve allocations
+	   again. */
+	if (lastfree == NULL)
+		usedpool_link(pool, pool->szidx);
+
+	if (pool->count == 0)
+		insert_to_freepool(pool);
+}
+
+void* ViObmalloc_Malloc(void *, size_t size)
+{
+	if (!IS_SMALL_REQUEST(size))
+		return Mem_Alloc(size);
+
+	unsigned int owner = ViMem_CurrentOwner();
+	if (owner >= nowners && usedpools_grow(owner) < 0)
+		return Mem_Alloc(size);
+
+	/* The whole size class is charged.  A refused charge fails the
+	   allocation, Mem_Alloc() is only the fallback for running out of
+	   memory. */
+	size_t charge = INDEX2SIZE(SIZE2INDEX(size));
+	if (ViMem_Charge(owner, charge) < 0)
+		return NULL;
+	void *ptr = pool_alloc(size, owner);
+	if (ptr != NULL)
+		return ptr;
+	ViMem_Credit(owner, charge);
+	return Mem_Alloc(size);
+}
+
+void* ViObmalloc_Calloc(void *ctx, size_t elemCount, size_t elemSize)
+{
+	if (elemSize != 0 && elemCount > (size_t)VI_SIZE_T_MAX / elemSize)
+		return NULL;
+
+	size_t size = elemCount * elemSize;
+	if (!IS_SMALL_REQUEST(size))
+		return Mem_Calloc(elemCount, elemSize);
+
+	void *ptr = ViObmalloc_Malloc(ctx, size);
+	if (ptr != NULL)
+		memset(ptr, 0, size);
+	return ptr;
+}
+
+void* ViObmalloc_Realloc(void *ctx, void* ptr, size_t new_size)
+{
+	if (ptr == NULL)
+		return ViObmalloc_Malloc(ctx, new_size);
+
+	poolp pool = POOL_ADDR(ptr);
+	if (!address_in_range(ptr, pool))
+		return Mem_Realloc(ptr, new_size);
+
+	size_t size = INDEX2SIZE(pool->szidx);
+	if (new_size <= size)
+	{
+		/* Avoid moving the block unless it shrinks by more than a
+		   quarter */
+		if (new_size != 0 && 4 * new_size > 3 * size)
+			return ptr;
+		size = new_size;
+	}
+
+	void *bp = ViObmalloc_Malloc(ctx, new_size);
+	if (bp != NULL)
+	{
+		memcpy(bp, ptr, size);
+		pool_free(pool, ptr);
+	}
+	return bp;
+}
+
+void ViObmalloc_Free(void *, void* ptr)
+{
+	if (ptr == NULL)
+		return;
+
+	poolp pool = POOL_ADDR(ptr);
+	if (address_in_range(ptr, pool))
+		pool_free(pool, ptr);
+	else
+		Mem_Free(ptr);
+}
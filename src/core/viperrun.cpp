@@ -183,6 +183,7 @@ int ViRuntime_Finalize()
 	if (!ViRuntime.initialized)
 		return status;
 
+	ViTrash_Flush();
 	ViRuntimeState_Finalize(ViRuntime);
 	return status;
 }
@@ -192,8 +193,8 @@ int Vi_FileIsInteractive(std::ifstream* fp, ViObject* filename)
 	if (ViString_Check(filename))
 	{
 		return (filename == NULL) ||
-			(strcmp(((ViStringObject*)filename)->ob_svar, "<stdin>")) ||
-			(strcmp(((ViStringObject*)filename)->ob_svar, "???"));
+			(strcmp(ViString_AS_STRING(filename), "<stdin>")) ||
+			(strcmp(ViString_AS_STRING(filename), "???"));
 	}
 	ViError_SetString(ViExc_SystemError, "Bad internal call");
 	return -1;
@@ -264,14 +265,15 @@ int ViRun_InteractiveObject(std::ifstream* fp, ViObject* filename)
 		ps2 = "... ";
 	}
 
-	arena = ViArena_New();
+	/* One arena per statement, recycled through the thread's cache */
+	arena = ViArena_Acquire();
 	if (arena == NULL)
 		return -1;
 
 	mod = ViParser_ASTFromFileObject(fp, filename, PARSER_MODE_SINGLE_INPUT, ps1, ps2, &error_code, arena);
 	if (mod == NULL)
 	{
-		ViArena_Free(arena);
+		ViArena_Release(arena);
 		if (error_code == E_EOF)
 		{
 			ViError_Clear();
@@ -280,7 +282,7 @@ int ViRun_InteractiveObject(std::ifstream* fp, ViObject* filename)
 		return -1;
 	}
 
-	ViArena_Free(arena);
+	ViArena_Release(arena);
 	return 0;
 }
 
@@ -295,6 +297,8 @@ int ViRun_InteractiveLoop(std::ifstream* fp, ViObject* filename)
 		{
 			ViError_Print();
 		}
+		/* Statement boundary, free what the trashcan deferred */
+		ViTrash_Checkpoint();
 	} while (ret != E_EOF);
 	return error;
 }
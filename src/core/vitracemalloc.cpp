@@ -0,0 +1,406 @@
+#include "vitracemalloc.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+/* Tracing hooks are layered on top of the MEM and OBJ allocators.  The
+   bookkeeping lives in standard containers, they allocate with operator
+   new and never come back into the hooks.
+
+   The OBJ allocator falls back to Mem_Alloc() for big blocks and pool
+   arenas.  Those calls are made while the hook is "reentrant" and are
+   not traced, so every block is only counted once. */
+
+int ViTraceMalloc_Tracing = 0;
+
+typedef struct _tracesite
+{
+	const char *filename;
+	int lineno;
+
+	bool operator==(const _tracesite &other) const
+	{
+		return filename == other.filename && lineno == other.lineno;
+	}
+} trace_site;
+
+struct trace_site_hash
+{
+	size_t operator()(const trace_site &site) const
+	{
+		return std::hash<const void *>()(site.filename) ^ ((size_t)site.lineno * 31);
+	}
+};
+
+typedef struct _trace
+{
+	size_t size;
+	trace_site site;
+} trace_t;
+
+typedef struct _sitetotals
+{
+	size_t count;
+	size_t size;
+} site_totals;
+
+static std::unordered_map<void *, trace_t> *traces = NULL;
+static std::unordered_map<trace_site, site_totals, trace_site_hash> *sites = NULL;
+
+static size_t traced_memory = 0;
+static size_t peak_traced_memory = 0;
+
+/* Site of the next allocation, set by ViTraceMalloc_SET_SITE() */
+static trace_site next_site = { NULL, 0 };
+
+/* Set while a hook calls the allocator below it */
+static int reentrant = 0;
+
+static ViMemAllocator allocator_mem;
+static ViMemAllocator allocator_obj;
+
+#define UNKNOWN_SITE "<unknown>"
+
+void ViTraceMalloc_SetSite(const char *filename, int lineno)
+{
+	if (next_site.filename == NULL)
+	{
+		next_site.filename = filename;
+		next_site.lineno = lineno;
+	}
+}
+
+void ViTraceMalloc_ClearSite()
+{
+	next_site.filename = NULL;
+	next_site.lineno = 0;
+}
+
+/* Take the site of the current allocation and clear it */
+static trace_site take_site()
+{
+	trace_site site = next_site;
+	if (site.filename == NULL)
+		site.filename = UNKNOWN_SITE;
+	next_site.filename = NULL;
+	next_site.lineno = 0;
+	return site;
+}
+
+//
+//
+//		Traces
+//
+//
+
+static void trace_add(void *ptr, size_t size, trace_site site)
+{
+	try
+	{
+		site_totals &totals = (*sites)[site];
+		(*traces)[ptr] = { size, site };
+		totals.count++;
+		totals.size += size;
+	}
+	catch (const std::bad_alloc &)
+	{
+		return; // Out of memory, the block is not traced
+	}
+
+	traced_memory += size;
+	if (traced_memory > peak_traced_memory)
+		peak_traced_memory = traced_memory;
+}
+
+/* Forget the trace of ptr, returns its site or one with a NULL filename
+   if the block is not traced */
+static trace_site trace_remove(void *ptr)
+{
+	trace_site site = { NULL, 0 };
+	auto it = traces->find(ptr);
+	if (it == traces->end())
+		return site;
+
+	site = it->second.site;
+	site_totals &totals = (*sites)[site];
+	totals.count--;
+	totals.size -= it->second.size;
+	traced_memory -= it->second.size;
+	traces->erase(it);
+	return site;
+}
+
+//
+//
+//		Hooks
+//
+//
+
+static void *hook_malloc(void *ctx, size_t size)
+{
+	ViMemAllocator *alloc = (ViMemAllocator *)ctx;
+	void *ptr;
+
+	if (reentrant)
+		return alloc->malloc(alloc->ctx, size);
+
+	trace_site site = take_site();
+	reentrant = 1;
+	ptr = alloc->malloc(alloc->ctx, size);
+	reentrant = 0;
+	take_site(); // Drop sites set by the allocator itself
+
+	if (ptr != NULL)
+		trace_add(ptr, size, site);
+	return ptr;
+}
+
+static void *hook_calloc(void *ctx, size_t elemCount, size_t elemSize)
+{
+	ViMemAllocator *alloc = (ViMemAllocator *)ctx;
+	void *ptr;
+
+	if (reentrant)
+		return alloc->calloc(alloc->ctx, elemCount, elemSize);
+
+	trace_site site = take_site();
+	reentrant = 1;
+	ptr = alloc->calloc(alloc->ctx, elemCount, elemSize);
+	reentrant = 0;
+	take_site();
+
+	if (ptr != NULL)
+		trace_add(ptr, elemCount * elemSize, site);
+	return ptr;
+}
+
+static void *hook_realloc(void *ctx, void *ptr, size_t new_size)
+{
+	ViMemAllocator *alloc = (ViMemAllocator *)ctx;
+	void *ptr2;
+
+	if (reentrant)
+		return alloc->realloc(alloc->ctx, ptr, new_size);
+
+	trace_site site = take_site();
+	reentrant = 1;
+	ptr2 = alloc->realloc(alloc->ctx, ptr, new_size);
+	reentrant = 0;
+	take_site();
+
+	if (ptr2 != NULL)
+	{
+		/* A resized block keeps the site it was allocated at, unless it
+		   was not traced yet */
+		trace_site old_site = ptr != NULL ? trace_remove(ptr) : site;
+		trace_add(ptr2, new_size, old_site.filename != NULL ? old_site : site);
+	}
+	return ptr2;
+}
+
+static void hook_free(void *ctx, void *ptr)
+{
+	ViMemAllocator *alloc = (ViMemAllocator *)ctx;
+
+	if (!reentrant && ptr != NULL)
+		trace_remove(ptr);
+	alloc->free(alloc->ctx, ptr);
+}
+
+//
+//
+//		API Functions
+//
+//
+
+int ViTraceMalloc_Start()
+{
+	ViMemAllocator hooks;
+
+	if (ViTraceMalloc_Tracing)
+		return -1;
+
+	traces = new (std::nothrow) std::unordered_map<void *, trace_t>();
+	sites = new (std::nothrow) std::unordered_map<trace_site, site_totals, trace_site_hash>();
+	if (traces == NULL || sites == NULL)
+	{
+		delete traces;
+		delete sites;
+		traces = NULL;
+		sites = NULL;
+		return -1;
+	}
+	traced_memory = 0;
+	peak_traced_memory = 0;
+	next_site.filename = NULL;
+	next_site.lineno = 0;
+
+	hooks.malloc = hook_malloc;
+	hooks.calloc = hook_calloc;
+	hooks.realloc = hook_realloc;
+	hooks.free = hook_free;
+
+	ViMem_GetAllocator(ViMem_DOMAIN_MEM, &allocator_mem);
+	ViMem_GetAllocator(ViMem_DOMAIN_OBJ, &allocator_obj);
+
+	hooks.ctx = &allocator_mem;
+	ViMem_SetAllocator(ViMem_DOMAIN_MEM, &hooks);
+	hooks.ctx = &allocator_obj;
+	ViMem_SetAllocator(ViMem_DOMAIN_OBJ, &hooks);
+
+	ViTraceMalloc_Tracing = 1;
+	return 0;
+}
+
+void ViTraceMalloc_Stop()
+{
+	if (!ViTraceMalloc_Tracing)
+		return;
+
+	ViTraceMalloc_Tracing = 0;
+	ViMem_SetAllocator(ViMem_DOMAIN_MEM, &allocator_mem);
+	ViMem_SetAllocator(ViMem_DOMAIN_OBJ, &allocator_obj);
+
+	delete traces;
+	delete sites;
+	traces = NULL;
+	sites = NULL;
+	traced_memory = 0;
+	next_site.filename = NULL;
+	next_site.lineno = 0;
+}
+
+int ViTraceMalloc_IsTracing()
+{
+	return ViTraceMalloc_Tracing;
+}
+
+void ViTraceMalloc_GetTracedMemory(size_t *current, size_t *peak)
+{
+	*current = traced_memory;
+	*peak = peak_traced_memory;
+}
+
+ViTraceSnapshot *ViTraceMalloc_TakeSnapshot()
+{
+	ViTraceSnapshot *snapshot;
+	Vi_size_t length = 0;
+
+	if (!ViTraceMalloc_Tracing)
+		return NULL;
+
+	snapshot = (ViTraceSnapshot *)ViMem_RawMalloc(sizeof(ViTraceSnapshot));
+	if (snapshot == NULL)
+		return NULL;
+	snapshot->stats = (ViTraceStat *)ViMem_RawMalloc(sites->size() * sizeof(ViTraceStat));
+	if (snapshot->stats == NULL)
+	{
+		ViMem_RawFree(snapshot);
+		return NULL;
+	}
+
+	for (const auto &entry : *sites)
+	{
+		if (entry.second.count == 0)
+			continue;
+		ViTraceStat *stat = &snapshot->stats[length++];
+		stat->filename = entry.first.filename;
+		stat->lineno = entry.first.lineno;
+		stat->count = entry.second.count;
+		stat->size = entry.second.size;
+	}
+	snapshot->length = length;
+
+	std::sort(snapshot->stats, snapshot->stats + length,
+		[](const ViTraceStat &a, const ViTraceStat &b) { return a.size > b.size; });
+	return snapshot;
+}
+
+void ViTraceMalloc_FreeSnapshot(ViTraceSnapshot *snapshot)
+{
+	if (snapshot == NULL)
+		return;
+	ViMem_RawFree(snapshot->stats);
+	ViMem_RawFree(snapshot);
+}
+
+ViTraceDiff *ViTraceMalloc_CompareSnapshots(const ViTraceSnapshot *old_snapshot, const ViTraceSnapshot *new_snapshot)
+{
+	ViTraceDiff *diff;
+	std::unordered_map<trace_site, const ViTraceStat *, trace_site_hash> old_stats;
+	Vi_size_t length = 0;
+
+	diff = (ViTraceDiff *)ViMem_RawMalloc(sizeof(ViTraceDiff));
+	if (diff == NULL)
+		return NULL;
+	diff->diffs = (ViTraceStatDiff *)ViMem_RawMalloc(
+		(old_snapshot->length + new_snapshot->length) * sizeof(ViTraceStatDiff));
+	if (diff->diffs == NULL)
+	{
+		ViMem_RawFree(diff);
+		return NULL;
+	}
+
+	try
+	{
+		for (Vi_size_t i = 0; i < old_snapshot->length; i++)
+		{
+			const ViTraceStat *stat = &old_snapshot->stats[i];
+			old_stats[{ stat->filename, stat->lineno }] = stat;
+		}
+	}
+	catch (const std::bad_alloc &)
+	{
+		ViMem_RawFree(diff->diffs);
+		ViMem_RawFree(diff);
+		return NULL;
+	}
+
+	/* Sites in the new snapshot, matched with the old one */
+	for (Vi_size_t i = 0; i < new_snapshot->length; i++)
+	{
+		const ViTraceStat *stat = &new_snapshot->stats[i];
+		ViTraceStatDiff *d = &diff->diffs[length++];
+		d->filename = stat->filename;
+		d->lineno = stat->lineno;
+		d->count = stat->count;
+		d->size = stat->size;
+		d->count_diff = (Vi_size_t)stat->count;
+		d->size_diff = (Vi_size_t)stat->size;
+
+		auto it = old_stats.find({ stat->filename, stat->lineno });
+		if (it != old_stats.end())
+		{
+			d->count_diff -= (Vi_size_t)it->second->count;
+			d->size_diff -= (Vi_size_t)it->second->size;
+			old_stats.erase(it);
+		}
+	}
+
+	/* Sites that are gone */
+	for (const auto &entry : old_stats)
+	{
+		ViTraceStatDiff *d = &diff->diffs[length++];
+		d->filename = entry.second->filename;
+		d->lineno = entry.second->lineno;
+		d->count = 0;
+		d->size = 0;
+		d->count_diff = -(Vi_size_t)entry.second->count;
+		d->size_diff = -(Vi_size_t)entry.second->size;
+	}
+	diff->length = length;
+
+	std::sort(diff->diffs, diff->diffs + length,
+		[](const ViTraceStatDiff &a, const ViTraceStatDiff &b) {
+			return std::abs(a.size_diff) > std::abs(b.size_diff);
+		});
+	return diff;
+}
+
+void ViTraceMalloc_FreeDiff(ViTraceDiff *diff)
+{
+	if (diff == NULL)
+		return;
+	ViMem_RawFree(diff->diffs);
+	ViMem_RawFree(diff);
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef __VITRACEMALLOC_H__
+#define __VITRACEMALLOC_H__
+
+#include "../port.h"
+#include "vimem.h"
+
+/*
+ * Allocation tracing
+ *
+ * While tracing, every live block of the MEM and OBJ domains is recorded
+ * together with the site that allocated it: the source file and line of
+ * the Mem_* / ViObject_* call, or the type name for objects created with
+ * Object_New().  Snapshots group the live blocks by site and two
+ * snapshots can be compared to see where memory grew.
+ *
+ * Blocks allocated before tracing started are not recorded.  When not
+ * tracing the only cost is a test of ViTraceMalloc_Tracing at each call.
+*/
+
+/* Live memory of one allocation site */
+typedef struct _tracestat
+{
+	const char *filename;	// Source file, or type name if lineno is 0
+	int lineno;
+	size_t count;			// Live blocks
+	size_t size;			// Live bytes
+} ViTraceStat;
+
+/* Live memory grouped by site, sorted by size, largest first */
+typedef struct _tracesnapshot
+{
+	Vi_size_t length;
+	ViTraceStat *stats;
+} ViTraceSnapshot;
+
+/* Change of one allocation site between two snapshots */
+typedef struct _tracestatdiff
+{
+	const char *filename;
+	int lineno;
+	size_t count;			// Live blocks in the newer snapshot
+	size_t size;			// Live bytes in the newer snapshot
+	Vi_size_t count_diff;
+	Vi_size_t size_diff;
+} ViTraceStatDiff;
+
+/* Sorted by the absolute size difference, largest first */
+typedef struct _tracediff
+{
+	Vi_size_t length;
+	ViTraceStatDiff *diffs;
+} ViTraceDiff;
+
+/* Install the tracing hooks, returns -1 if they are already installed */
+int ViTraceMalloc_Start();
+
+/* Remove the tracing hooks and forget all traces */
+void ViTraceMalloc_Stop();
+
+int ViTraceMalloc_IsTracing();
+
+/* Bytes currently traced and their high-water mark */
+void ViTraceMalloc_GetTracedMemory(size_t *current, size_t *peak);
+
+/* Returns NULL without setting an error if not tracing or out of memory */
+ViTraceSnapshot *ViTraceMalloc_TakeSnapshot();
+void ViTraceMalloc_FreeSnapshot(ViTraceSnapshot *snapshot);
+
+/* What changed from old_snapshot to new_snapshot, NULL if out of memory */
+ViTraceDiff *ViTraceMalloc_CompareSnapshots(const ViTraceSnapshot *old_snapshot, const ViTraceSnapshot *new_snapshot);
+void ViTraceMalloc_FreeDiff(ViTraceDiff *diff);
+
+#endif // __VITRACEMALLOC_H__
\ No newline at end of file
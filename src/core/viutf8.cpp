@@ -0,0 +1,141 @@
+#include "viutf8.h"
+
+#include "vifastsearch.h"
+
+#define IS_CONTINUATION(c) (((c) & 0xC0) == 0x80)
+
+/* ASCII bytes in a row after which validation skips with the kernel */
+#define ASCII_RUN 16
+
+/* Length of the valid multibyte sequence at the start of s, 0 if it is
+   not valid.  The ranges of the second byte exclude the overlong forms,
+   the surrogates and the code points above U+10FFFF. */
+static inline int valid_sequence(const unsigned char *s, Vi_size_t n)
+{
+	unsigned char c = s[0];
+
+	if (c < 0xC2)
+		return 0; // A continuation byte or an overlong form of ASCII
+	if (c < 0xE0)
+		return n >= 2 && IS_CONTINUATION(s[1]) ? 2 : 0;
+	if (c < 0xF0)
+	{
+		if (n < 3 || !IS_CONTINUATION(s[1]) || !IS_CONTINUATION(s[2]))
+			return 0;
+		if ((c == 0xE0 && s[1] < 0xA0) || (c == 0xED && s[1] >= 0xA0))
+			return 0;
+		return 3;
+	}
+	if (c < 0xF5)
+	{
+		if (n < 4 || !IS_CONTINUATION(s[1]) || !IS_CONTINUATION(s[2]) || !IS_CONTINUATION(s[3]))
+			return 0;
+		if ((c == 0xF0 && s[1] < 0x90) || (c == 0xF4 && s[1] >= 0x90))
+			return 0;
+		return 4;
+	}
+	return 0;
+}
+
+Vi_size_t ViUtf8_Check(const char *str, Vi_size_t n, int *is_ascii)
+{
+	const unsigned char *s = (const unsigned char *)str;
+	Vi_size_t i, count, run;
+	int len, ascii;
+
+	/* The AVX2 kernel validates most of the string, the rest is checked
+	   here */
+	i = ViFastSearch_ValidUtf8Prefix(str, n, &count);
+	if (is_ascii != NULL)
+		*is_ascii = count == i;
+	while (i < n)
+	{
+		run = ViFastSearch_FindNonAscii(str + i, n - i);
+		if (run < 0)
+			return count + n - i;
+		count += run;
+		i += run;
+		if (is_ascii != NULL)
+			*is_ascii = 0;
+
+		/* Decode the multibyte sequences and step over short runs of
+		   ASCII between them, a long run goes back to the kernel */
+		for (ascii = 0; i < n && ascii < ASCII_RUN; count++)
+		{
+			if (s[i] < 0x80)
+			{
+				i++;
+				ascii++;
+				continue;
+			}
+			len = valid_sequence(s + i, n - i);
+			if (len == 0)
+				return -1;
+			i += len;
+			ascii = 0;
+		}
+	}
+	return count;
+}
+
+Vi_size_t ViUtf8_Count(const char *s, Vi_size_t n)
+{
+	Vi_size_t continuations = 0;
+
+	for (Vi_size_t i = 0; i < n; i++)
+		continuations += IS_CONTINUATION((unsigned char)s[i]);
+	return n - continuations;
+}
+
+int ViUtf8_Encode(Vi_uint32_t cp, char *out)
+{
+	unsigned char *o = (unsigned char *)out;
+
+	if (cp < 0x80)
+	{
+		o[0] = (unsigned char)cp;
+		return 1;
+	}
+	if (cp < 0x800)
+	{
+		o[0] = (unsigned char)(0xC0 | (cp >> 6));
+		o[1] = (unsigned char)(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000)
+	{
+		if (cp >= 0xD800 && cp <= 0xDFFF)
+			return 0;
+		o[0] = (unsigned char)(0xE0 | (cp >> 12));
+		o[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+		o[2] = (unsigned char)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	if (cp <= ViUtf8_MAX_CODE_POINT)
+	{
+		o[0] = (unsigned char)(0xF0 | (cp >> 18));
+		o[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+		o[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+		o[3] = (unsigned char)(0x80 | (cp & 0x3F));
+		return 4;
+	}
+	return 0;
+}
+
+Vi_uint32_t ViUtf8_Decode(const char *str)
+{
+	const unsigned char *s = (const unsigned char *)str;
+
+	switch (ViUtf8_SequenceLength(s[0]))
+	{
+	case 1:
+		return s[0];
+	case 2:
+		return ((Vi_uint32_t)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+	case 3:
+		return ((Vi_uint32_t)(s[0] & 0x0F) << 12) | ((Vi_uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+	default:
+		return ((Vi_uint32_t)(s[0] & 0x07) << 18) | ((Vi_uint32_t)(s[1] & 0x3F) << 12) |
+			((Vi_uint32_t)(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+	}
+}
\ No newline at end of file
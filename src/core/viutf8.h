@@ -0,0 +1,45 @@
+#ifndef __VIUTF8_H__
+#define __VIUTF8_H__
+
+#include "../port.h"
+
+/*
+ * UTF-8
+ *
+ * Strings hold their text as UTF-8.  With AVX2 validation runs 32 bytes
+ * at a time with the nibble lookup kernel of core/vifastsearch.h.
+ * Otherwise it skips runs of ASCII with the vectorised kernel and only
+ * decodes the multibyte sequences, so mostly ASCII text is checked at
+ * close to memory speed.  Overlong forms, surrogates and code points
+ * above ViUtf8_MAX_CODE_POINT are rejected.
+*/
+
+#define ViUtf8_MAX_CODE_POINT 0x10FFFF
+
+/* Number of code points in s, -1 if s is not valid UTF-8.  *is_ascii is
+   set to 1 if every byte is ASCII, it may be NULL. */
+Vi_size_t ViUtf8_Check(const char *s, Vi_size_t n, int *is_ascii);
+
+/* Number of code points in s, which must be valid UTF-8 */
+Vi_size_t ViUtf8_Count(const char *s, Vi_size_t n);
+
+/* Write the encoding of cp to out, which has room for 4 bytes.  Returns
+   the number of bytes written, 0 if cp is not a valid code point. */
+int ViUtf8_Encode(Vi_uint32_t cp, char *out);
+
+/* Decode the code point at the start of s, which must be valid UTF-8 */
+Vi_uint32_t ViUtf8_Decode(const char *s);
+
+/* Number of bytes of the sequence starting with lead */
+static inline int ViUtf8_SequenceLength(unsigned char lead)
+{
+	if (lead < 0xC0)
+		return 1;
+	if (lead < 0xE0)
+		return 2;
+	if (lead < 0xF0)
+		return 3;
+	return 4;
+}
+
+#endif // __VIUTF8_H__
\ No newline at end of file
@@ -55,6 +55,13 @@ static ViObject *bool_xor(ViObject *a, ViObject *b)
 	return ViBool_FromLong((a == Vi_True) ^ (b == Vi_True));
 }
 
+/* Bools compare and hash as the ints 0 and 1 */
+
+static ViObject *bool_richcompare(ViObject *a, ViObject *b, int op)
+{
+	return ViIntType.tp_richcompare(a, b, op);
+}
+
 static ViNumberMethods bool_as_number = {
     0,                          // nb_add
     0,                          // nb_subtract
@@ -102,13 +109,17 @@ ViTypeObject ViBoolType = {
 	0,										// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
 	(destructor)bool_dealloc,				// tp_dealloc
-	0,										// tp_number_methods
+	&bool_as_number,						// tp_number_methods
 	0,										// tp_sequence_methods
+	(hashfunc)ViInt_Hash,					// tp_hash
+	0,										// tp_traverse
 	0,										// tp_clear
+	bool_richcompare,						// tp_richcompare
 	0,										// tp_base
 	0,										// tp_dict
 	bool_new,								// tp_new
-	Mem_Free								// tp_free
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
 };
 
 /* The objects representing bool values False and True */
@@ -119,7 +130,7 @@ ViIntObject ViFalseStruct = {
 };
 
 ViIntObject ViTrueStruct = {
-	VAROBJECT_HEAD_INIT(&ViBoolType, 0)
+	VAROBJECT_HEAD_INIT(&ViBoolType, 1)
 	{ 1 }
 };
 
@@ -3,6 +3,9 @@
 #include "../core/error.h"
 #include "intobject.h"
 
+/* The empty byte array is a shared, immortal singleton */
+static ViByteArrayObject *empty_bytearray = NULL;
+
 static inline int valid_index(Vi_size_t i, Vi_size_t limit)
 {
 	return (size_t)i < (size_t)limit;
@@ -17,14 +20,19 @@ static int get_byte_value(ViObject* obj, int* value)
 		return 0;
 	}
 
-	int v = ((ViIntObject*)obj)->ob_ival;
+	Vi_int64_t v = ViInt_AsInt64(obj);
+	if (v == -1 && ViError_Occurred())
+	{
+		*value = -1;
+		return 0;
+	}
 	if (v < 0 || v >= 256)
 	{
 		ViError_SetString(ViExc_ValueError, "byte must be in range (0, 256)");
 		*value = -1;
 		return 0;
 	}
-	*value = v;
+	*value = (int)v;
 	return 1;
 }
 
@@ -37,7 +45,7 @@ static int get_byte_value(ViObject* obj, int* value)
 static void bytearray_dealloc(ViByteArrayObject *self)
 {
 	if (self->ob_bytes != 0)
-		Mem_Free(self->ob_bytes);
+		ViObject_Free(self->ob_bytes);
 	Vi_TYPE(self)->tp_free((ViObject *)self);
 }
 
@@ -101,11 +109,15 @@ ViTypeObject ViByteArrayType = {
 	(destructor)bytearray_dealloc,				// tp_dealloc
 	0,											// tp_number_methods
 	&bytearray_sequence_methods,				// tp_sequence_methods
+	ViObject_HashNotImplemented,				// tp_hash
+	0,											// tp_traverse
 	0,											// tp_clear
+	0,											// tp_richcompare
 	0,											// tp_base
 	0,											// tp_dict
 	0,											// tp_new
-	Mem_Free									// tp_free
+	ViObject_Free,								// tp_free
+	0,											// tp_cached_keys
 };
 
 ViObject* ViByteArrayObject_FromString(const char* bytes, size_t size)
@@ -113,18 +125,25 @@ ViObject* ViByteArrayObject_FromString(const char* bytes, size_t size)
 	ViByteArrayObject* obj;
 	size_t alloc;
 
+	if (size == 0 && empty_bytearray != NULL)
+		return (ViObject*)empty_bytearray;
+
 	obj = ViObject_NEW(ViByteArrayObject, &ViByteArrayType);
 	if (obj == NULL)
 		return NULL;
 	if (size == 0)
 	{
 		obj->ob_bytes = NULL;
-		alloc = 0;
+		obj->ob_alloc = 0;
+		VAROBJECT_SET_SIZE(obj, 0);
+		ViObject_SET_IMMORTAL(obj);
+		empty_bytearray = obj;
+		return (ViObject*)obj;
 	}
 	else
 	{
 		alloc = size + 1;
-		obj->ob_bytes = (Vi_int8_t*)Mem_Alloc(alloc);
+		obj->ob_bytes = (Vi_int8_t*)ViObject_Malloc(alloc);
 		if (bytes != NULL && size > 0)
 			memcpy(obj->ob_bytes, bytes, size);
 		obj->ob_bytes[size] = '\0'; // Trailing NULL byte (end of string)
@@ -32,38 +32,37 @@ ViTypeObject ViCodeType = {
 	(destructor)code_dealloc,			// tp_dealloc
 	0,									// tp_number_methods
 	0,									// tp_sequence_methods
+	0,									// tp_hash
+	0,									// tp_traverse
 	0,									// tp_clear
+	0,									// tp_richcompare
 	0,									// tp_base
 	0,									// tp_dict
 	0,									// tp_new
-	Mem_Free							// tp_free
+	ViObject_Free,						// tp_free
+	0,									// tp_cached_keys
 };
 
 ViCodeObject* ViCodeObject_NewEmpty(const char* filename, const char* func_name, Vi_int32_t lineno)
 {
-	static ViObject* empty_byte_array = NULL;
-	static ViObject* null_tuple = NULL;
 	ViCodeObject* co = NULL;
 	ViObject* filename_ob = NULL;
 	ViObject* funcname_ob = NULL;
+	ViObject* empty_byte_array = NULL;
+	ViObject* null_tuple = NULL;
 
+	// Both are shared immortal singletons
+	empty_byte_array = ViByteArrayObject_FromString("", 0);
 	if (empty_byte_array == NULL)
-	{
-		empty_byte_array = ViByteArrayObject_FromString("", 0);
-		if (empty_byte_array == NULL)
-			goto failed;
-	}
+		goto failed;
+	null_tuple = ViTupleObject_New(0);
 	if (null_tuple == NULL)
-	{
-		null_tuple = ViTupleObject_New(0);
-		if (null_tuple == NULL)
-			goto failed;
-	}
+		goto failed;
 
-	filename_ob = ViStringObject_FromStringAndSize(filename, sizeof(filename));
+	filename_ob = ViStringObject_FromString(filename);
 	if (filename_ob == NULL)
 		goto failed;
-	funcname_ob = ViStringObject_FromStringAndSize(func_name, sizeof(func_name));
+	funcname_ob = ViStringObject_FromString(func_name);
 	if (funcname_ob == NULL)
 		goto failed;
 
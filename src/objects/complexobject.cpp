@@ -1,5 +1,37 @@
 #include "complexobject.h"
 
+#include "../core/vihash.h"
+
+#include "boolobject.h"
+#include "floatobject.h"
+#include "intobject.h"
+
+/* Dead complex objects are kept on a free list, linked through ob_type,
+   so that temporaries do not churn the allocator. */
+#ifndef ViComplex_MAXFREELIST
+#	define ViComplex_MAXFREELIST 100
+#endif
+
+static ViComplexObject *free_list = NULL;
+static int numfree = 0;
+static size_t free_list_hits = 0;
+static size_t free_list_misses = 0;
+
+static ViComplexObject *complex_alloc()
+{
+	ViComplexObject *obj = free_list;
+	if (obj != NULL)
+	{
+		free_list = (ViComplexObject *)Vi_TYPE(obj);
+		numfree--;
+		free_list_hits++;
+		ObjectInit((ViObject *)obj, &ViComplexType);
+		return obj;
+	}
+	free_list_misses++;
+	return ViObject_NEW(ViComplexObject, &ViComplexType);
+}
+
 //
 //
 //		Methods
@@ -8,9 +40,60 @@
 
 static void complex_dealloc(ViComplexObject *self)
 {
+	if (ViComplex_CheckExact(self) && numfree < ViComplex_MAXFREELIST)
+	{
+		numfree++;
+		ViObject_SET_TYPE(self, (ViTypeObject *)free_list);
+		free_list = self;
+		return;
+	}
 	Vi_TYPE(self)->tp_free((ViObject *)self);
 }
 
+static Vi_hash_t complex_hash(ViComplexObject *self)
+{
+	Vi_uint64_t hashreal, hashimag, combined;
+
+	hashreal = (Vi_uint64_t)ViHash_Double((ViObject *)self, self->ob_cval.real);
+	hashimag = (Vi_uint64_t)ViHash_Double((ViObject *)self, self->ob_cval.imag);
+
+	/* A complex with a zero imaginary part hashes as its real part */
+	combined = hashreal + ViHASH_IMAG * hashimag;
+	if (combined == (Vi_uint64_t)-1)
+		combined = (Vi_uint64_t)-2;
+	return (Vi_hash_t)combined;
+}
+
+/* Complex numbers only support equality, a complex with a zero imaginary
+   part equals its real part */
+static ViObject *complex_richcompare(ViObject *a, ViObject *b, int op)
+{
+	ViComplex x;
+	ViObject *real, *res;
+
+	if (!ViComplex_Check(a) || (op != Vi_EQ && op != Vi_NE))
+		Vi_RETURN_NOTIMPLEMENTED;
+	x = ((ViComplexObject *)a)->ob_cval;
+
+	if (ViComplex_Check(b))
+	{
+		ViComplex y = ((ViComplexObject *)b)->ob_cval;
+		int equal = x.real == y.real && x.imag == y.imag;
+		return ViBool_FromLong(op == Vi_EQ ? equal : !equal);
+	}
+	if (!ViFloat_Check(b) && !ViInt_Check(b) && !ViBool_Check(b))
+		Vi_RETURN_NOTIMPLEMENTED;
+
+	if (x.imag != 0.0)
+		return ViBool_FromLong(op == Vi_NE);
+	real = ViFloatObject_FromDouble(x.real);
+	if (real == NULL)
+		return NULL;
+	res = ViObject_RichCompare(real, b, op);
+	ViObject_DECREF(real);
+	return res;
+}
+
 ViTypeObject ViComplexType = {
 	VAROBJECT_HEAD_INIT(&ViComplexType, 0)	// base
 	"float",								// tp_name
@@ -21,16 +104,22 @@ ViTypeObject ViComplexType = {
 	(destructor)complex_dealloc,			// tp_dealloc
 	0,										// tp_number_methods
 	0,										// tp_sequence_methods
+	(hashfunc)complex_hash,					// tp_hash
+	0,										// tp_traverse
 	0,										// tp_clear
+	complex_richcompare,					// tp_richcompare
 	0,										// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
 };
 
 ViObject *ViComplexObject_FromComplex(ViComplex cval)
 {
-	ViComplexObject *obj = ViObject_NEW(ViComplexObject, &ViComplexType);
+	ViComplexObject *obj = complex_alloc();
+	if (obj == NULL)
+		return NULL;
 	obj->ob_cval = cval;
 	return (ViObject *)obj;
 }
@@ -42,3 +131,23 @@ ViObject *ViComplexObject_FromDoubles(double real, double imag)
 	c.imag = imag;
 	return ViComplexObject_FromComplex(c);
 }
+
+int ViComplex_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		ViComplexObject *next = (ViComplexObject *)Vi_TYPE(free_list);
+		ViObject_Free(free_list);
+		free_list = next;
+	}
+	numfree = 0;
+	return freed;
+}
+
+void ViComplex_GetFreeListStats(ViFreeListStats *stats)
+{
+	stats->hits = free_list_hits;
+	stats->misses = free_list_misses;
+	stats->size = numfree;
+}
@@ -25,4 +25,8 @@ extern ViTypeObject ViComplexType;
 ViObject *ViComplexObject_FromComplex(ViComplex cval);
 ViObject *ViComplexObject_FromDoubles(double real, double imag);
 
+/* Free list functions */
+int ViComplex_ClearFreeList();
+void ViComplex_GetFreeListStats(ViFreeListStats *stats);
+
 #endif // __COMPLEXOBJECT_H__
\ No newline at end of file
@@ -0,0 +1,1006 @@
+#include "dictobject.h"
+
+#include "../core/error.h"
+#include "../core/vigc.h"
+#include "../core/vimem.h"
+
+#include "stringobject.h"
+
+/*
+ * A keys object is a header followed by the hash table of DK_SIZE
+ * indices and the array of entries:
+ *
+ *     +----------------+-------------------------+---------------------+
+ *     | header         | indices                 | entries             |
+ *     +----------------+-------------------------+---------------------+
+ *                        DK_SIZE * 1/2/4/8 bytes   USABLE_FRACTION(DK_SIZE)
+ *
+ * An index is DKIX_EMPTY for a slot never used, DKIX_DUMMY for a slot
+ * whose entry was deleted and the position of the entry otherwise.
+ * Entries are appended in insertion order, deleted ones keep their place
+ * with a NULL key and value until the next resize compacts the array.
+ *
+ * Collisions are resolved with the perturbed probe sequence of CPython,
+ * which eventually visits every slot and uses all bits of the hash.
+ * At most two thirds of the slots are used, a full table is resized to
+ * three times the number of items, rounded up to a power of two.
+*/
+
+typedef struct _dictentry
+{
+	Vi_hash_t me_hash;
+	ViObject *me_key;
+	ViObject *me_value; // Always NULL in the keys of a split table
+} dict_entry;
+
+/* Kinds of keys objects */
+#define DICT_KEYS_GENERAL	0	// Keys of any type
+#define DICT_KEYS_STRING	1	// Only exact strings, compared without dispatch
+#define DICT_KEYS_SPLIT		2	// Shared keys of split tables, only exact strings
+
+struct _dictkeysobject
+{
+	Vi_size_t dk_refcnt;		// Split tables share their keys
+	Vi_uint8_t dk_log2_size;	// Log2 of the number of slots
+	Vi_uint8_t dk_log2_index_bytes; // Log2 of the size of an index
+	Vi_uint8_t dk_kind;
+	Vi_size_t dk_usable;		// Entries that can still be appended
+	Vi_size_t dk_nentries;		// Entries used, deleted ones included
+	/* Followed by the indices and the entries */
+};
+
+#define DKIX_EMPTY (-1)
+#define DKIX_DUMMY (-2)
+#define DKIX_ERROR (-3)
+
+#define PERTURB_SHIFT 5
+
+#define DICT_LOG_MINSIZE 3
+#define DICT_MINSIZE (1 << DICT_LOG_MINSIZE)
+
+/* Shared keys have room for 21 attributes */
+#define SHARED_KEYS_LOG_SIZE 5
+
+#define DK_SIZE(dk) ((Vi_size_t)1 << (dk)->dk_log2_size)
+#define DK_MASK(dk) (DK_SIZE(dk) - 1)
+#define DK_INDICES(dk) ((char *)((dk) + 1))
+#define DK_ENTRIES(dk) \
+	((dict_entry *)(DK_INDICES(dk) + ((size_t)1 << ((dk)->dk_log2_size + (dk)->dk_log2_index_bytes))))
+
+/* At most two thirds of the slots are used */
+#define USABLE_FRACTION(n) (((n) << 1) / 3)
+
+/* Number of slots a full dict is resized to */
+#define GROWTH_RATE(d) ((d)->ma_used * 3)
+
+/* Empty dicts share an immortal keys object without entries, so
+   creating one does not allocate a table */
+static struct
+{
+	ViDictKeysObject keys;
+	Vi_int8_t indices[8];
+} empty_keys_struct = {
+	{
+		Vi_IMMORTAL_REFCNT,	// dk_refcnt
+		0,					// dk_log2_size
+		0,					// dk_log2_index_bytes
+		DICT_KEYS_STRING,	// dk_kind
+		0,					// dk_usable
+		0					// dk_nentries
+	},
+	{ DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY, DKIX_EMPTY }
+};
+
+#define Vi_EMPTY_KEYS (&empty_keys_struct.keys)
+
+/* Dead dicts and the keys objects of minimum size are kept for reuse */
+#ifndef ViDict_MAXFREELIST
+#	define ViDict_MAXFREELIST 80
+#endif
+
+static ViDictObject *free_list[ViDict_MAXFREELIST];
+static int numfree = 0;
+static ViDictKeysObject *keys_free_list[ViDict_MAXFREELIST];
+static int numfreekeys = 0;
+static size_t free_list_hits = 0;
+static size_t free_list_misses = 0;
+
+//
+//
+//		Keys
+//
+//
+
+/* The hash of a string is cached in it, take it without dispatching */
+static inline Vi_hash_t key_hash(ViObject *key)
+{
+	if (ViString_CheckExact(key))
+		return ViString_Hash(key);
+	return ViObject_Hash(key);
+}
+
+static inline Vi_size_t dictkeys_get_index(const ViDictKeysObject *keys, Vi_size_t i)
+{
+	switch (keys->dk_log2_index_bytes)
+	{
+	case 0:
+		return ((const Vi_int8_t *)DK_INDICES(keys))[i];
+	case 1:
+		return ((const Vi_int16_t *)DK_INDICES(keys))[i];
+	case 2:
+		return ((const Vi_int32_t *)DK_INDICES(keys))[i];
+	default:
+		return (Vi_size_t)((const Vi_int64_t *)DK_INDICES(keys))[i];
+	}
+}
+
+static inline void dictkeys_set_index(ViDictKeysObject *keys, Vi_size_t i, Vi_size_t ix)
+{
+	switch (keys->dk_log2_index_bytes)
+	{
+	case 0:
+		((Vi_int8_t *)DK_INDICES(keys))[i] = (Vi_int8_t)ix;
+		break;
+	case 1:
+		((Vi_int16_t *)DK_INDICES(keys))[i] = (Vi_int16_t)ix;
+		break;
+	case 2:
+		((Vi_int32_t *)DK_INDICES(keys))[i] = (Vi_int32_t)ix;
+		break;
+	default:
+		((Vi_int64_t *)DK_INDICES(keys))[i] = ix;
+		break;
+	}
+}
+
+/* Smallest table size with at least minsize slots */
+static Vi_uint8_t calculate_log2_keysize(Vi_size_t minsize)
+{
+	Vi_uint8_t log2_size = DICT_LOG_MINSIZE;
+	while (((Vi_size_t)1 << log2_size) < minsize)
+		log2_size++;
+	return log2_size;
+}
+
+/* Smallest table size with room for n entries */
+static Vi_uint8_t estimate_log2_keysize(Vi_size_t n)
+{
+	return calculate_log2_keysize((n * 3 + 1) / 2);
+}
+
+static size_t keys_object_size(Vi_uint8_t log2_size, Vi_uint8_t log2_index_bytes)
+{
+	Vi_size_t size = (Vi_size_t)1 << log2_size;
+	return sizeof(ViDictKeysObject) + ((size_t)1 << (log2_size + log2_index_bytes)) +
+		USABLE_FRACTION(size) * sizeof(dict_entry);
+}
+
+static ViDictKeysObject *new_keys_object(Vi_uint8_t log2_size, int kind)
+{
+	ViDictKeysObject *dk;
+	Vi_uint8_t log2_index_bytes;
+	Vi_size_t usable = USABLE_FRACTION((Vi_size_t)1 << log2_size);
+
+	/* Small tables get small indices */
+	if (log2_size < 8)
+		log2_index_bytes = 0;
+	else if (log2_size < 16)
+		log2_index_bytes = 1;
+	else if (log2_size < 32)
+		log2_index_bytes = 2;
+	else
+		log2_index_bytes = 3;
+
+	if (log2_size >= 8 * sizeof(Vi_size_t) - 4)
+	{
+		ViError_NoMemory();
+		return NULL;
+	}
+
+	if (log2_size == DICT_LOG_MINSIZE && numfreekeys > 0)
+		dk = keys_free_list[--numfreekeys];
+	else
+	{
+		dk = (ViDictKeysObject *)ViObject_Malloc(keys_object_size(log2_size, log2_index_bytes));
+		if (dk == NULL)
+		{
+			ViError_NoMemory();
+			return NULL;
+		}
+	}
+
+	dk->dk_refcnt = 1;
+	dk->dk_log2_size = log2_size;
+	dk->dk_log2_index_bytes = log2_index_bytes;
+	dk->dk_kind = (Vi_uint8_t)kind;
+	dk->dk_usable = usable;
+	dk->dk_nentries = 0;
+	memset(DK_INDICES(dk), 0xff, (size_t)1 << (log2_size + log2_index_bytes));
+	memset(DK_ENTRIES(dk), 0, usable * sizeof(dict_entry));
+	return dk;
+}
+
+/* Release the memory of a keys object, its entries are already gone */
+static void free_keys_memory(ViDictKeysObject *keys)
+{
+	if (keys == Vi_EMPTY_KEYS)
+		return;
+	if (keys->dk_log2_size == DICT_LOG_MINSIZE && numfreekeys < ViDict_MAXFREELIST)
+		keys_free_list[numfreekeys++] = keys;
+	else
+		ViObject_Free(keys);
+}
+
+static inline void dictkeys_incref(ViDictKeysObject *keys)
+{
+	if (keys != Vi_EMPTY_KEYS)
+		keys->dk_refcnt++;
+}
+
+static void dictkeys_decref(ViDictKeysObject *keys)
+{
+	dict_entry *entries;
+
+	if (keys == Vi_EMPTY_KEYS || --keys->dk_refcnt > 0)
+		return;
+
+	entries = DK_ENTRIES(keys);
+	for (Vi_size_t i = 0, n = keys->dk_nentries; i < n; i++)
+	{
+		ViObject_XDECREF(entries[i].me_key);
+		ViObject_XDECREF(entries[i].me_value);
+	}
+	free_keys_memory(keys);
+}
+
+/* Values array of a split table, one slot per entry the keys can hold */
+static ViObject **new_values(ViDictKeysObject *keys)
+{
+	Vi_size_t size = USABLE_FRACTION(DK_SIZE(keys));
+	ViObject **values = (ViObject **)ViObject_Calloc(size, sizeof(ViObject *));
+	if (values == NULL)
+		ViError_NoMemory();
+	return values;
+}
+
+//
+//
+//		Lookup
+//
+//
+
+/* Find the entry of key.  Returns its position with *value_addr set to
+   the value, DKIX_EMPTY if the key is missing or DKIX_ERROR with an error
+   set.  In a split table a key can have an entry but no value in this
+   dict, then *value_addr is NULL. */
+static Vi_size_t dict_lookup(ViDictObject *mp, ViObject *key, Vi_hash_t hash, ViObject **value_addr)
+{
+	ViDictKeysObject *dk;
+	dict_entry *ep0;
+	size_t mask, perturb, i;
+	Vi_size_t ix;
+	int string_key = ViString_CheckExact(key);
+
+restart:
+	dk = mp->ma_keys;
+	ep0 = DK_ENTRIES(dk);
+	mask = (size_t)DK_MASK(dk);
+	perturb = (size_t)hash;
+	i = (size_t)hash & mask;
+
+	for (;;)
+	{
+		ix = dictkeys_get_index(dk, i);
+		if (ix == DKIX_EMPTY)
+		{
+			*value_addr = NULL;
+			return DKIX_EMPTY;
+		}
+		if (ix >= 0)
+		{
+			dict_entry *ep = &ep0[ix];
+			if (ep->me_key == key)
+				break;
+			if (ep->me_hash == hash)
+			{
+				if (dk->dk_kind != DICT_KEYS_GENERAL && string_key)
+				{
+					/* Only strings, no code runs while comparing */
+					if (ViString_Equal(ep->me_key, key))
+						break;
+				}
+				else
+				{
+					ViObject *startkey = ep->me_key;
+					int cmp;
+
+					ViObject_INCREF(startkey);
+					cmp = ViObject_RichCompareBool(startkey, key, Vi_EQ);
+					ViObject_DECREF(startkey);
+					if (cmp < 0)
+					{
+						*value_addr = NULL;
+						return DKIX_ERROR;
+					}
+					/* The comparison changed the dict, start over */
+					if (dk != mp->ma_keys || ep->me_key != startkey)
+						goto restart;
+					if (cmp > 0)
+						break;
+				}
+			}
+		}
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+
+	*value_addr = mp->ma_values != NULL ? mp->ma_values[ix] : ep0[ix].me_value;
+	return ix;
+}
+
+/* Slot of the hash table that holds entry index */
+static Vi_size_t lookup_index(ViDictKeysObject *keys, Vi_hash_t hash, Vi_size_t index)
+{
+	size_t mask = (size_t)DK_MASK(keys);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	for (;;)
+	{
+		Vi_size_t ix = dictkeys_get_index(keys, i);
+		if (ix == index)
+			return i;
+		assert(ix != DKIX_EMPTY);
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* First free slot for hash, the key must not be in the table */
+static Vi_size_t find_empty_slot(ViDictKeysObject *keys, Vi_hash_t hash)
+{
+	size_t mask = (size_t)DK_MASK(keys);
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	while (dictkeys_get_index(keys, i) >= 0)
+	{
+		perturb >>= PERTURB_SHIFT;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+	return i;
+}
+
+static void build_indices(ViDictKeysObject *keys, dict_entry *ep, Vi_size_t n)
+{
+	for (Vi_size_t ix = 0; ix != n; ix++, ep++)
+		dictkeys_set_index(keys, find_empty_slot(keys, ep->me_hash), ix);
+}
+
+//
+//
+//		Insertion and deletion
+//
+//
+
+/* Move the items to a new table of 1 << log2_newsize slots, dropping
+   deleted entries.  A split table becomes a combined one. */
+static int dictresize(ViDictObject *mp, Vi_uint8_t log2_newsize, int string_keys)
+{
+	ViDictKeysObject *oldkeys = mp->ma_keys;
+	ViObject **oldvalues = mp->ma_values;
+	dict_entry *oldentries, *newentries;
+	Vi_size_t numentries = mp->ma_used;
+
+	mp->ma_keys = new_keys_object(log2_newsize, string_keys ? DICT_KEYS_STRING : DICT_KEYS_GENERAL);
+	if (mp->ma_keys == NULL)
+	{
+		mp->ma_keys = oldkeys;
+		return -1;
+	}
+	assert(mp->ma_keys->dk_usable >= numentries);
+
+	oldentries = DK_ENTRIES(oldkeys);
+	newentries = DK_ENTRIES(mp->ma_keys);
+	if (oldvalues != NULL)
+	{
+		/* The values of a split table are filled in key order without
+		   gaps, the keys stay owned by the shared keys object */
+		for (Vi_size_t i = 0; i < numentries; i++)
+		{
+			assert(oldvalues[i] != NULL);
+			ViObject_INCREF(oldentries[i].me_key);
+			newentries[i].me_key = oldentries[i].me_key;
+			newentries[i].me_hash = oldentries[i].me_hash;
+			newentries[i].me_value = oldvalues[i];
+		}
+		mp->ma_values = NULL;
+		ViObject_Free(oldvalues);
+		dictkeys_decref(oldkeys);
+	}
+	else
+	{
+		/* The entries move to the new table with their references */
+		assert(oldkeys == Vi_EMPTY_KEYS || oldkeys->dk_refcnt == 1);
+		if (oldkeys->dk_nentries == numentries)
+			memcpy(newentries, oldentries, numentries * sizeof(dict_entry));
+		else
+		{
+			dict_entry *ep = oldentries;
+			for (Vi_size_t i = 0; i < numentries; i++)
+			{
+				while (ep->me_value == NULL)
+					ep++;
+				newentries[i] = *ep++;
+			}
+		}
+		free_keys_memory(oldkeys);
+	}
+
+	build_indices(mp->ma_keys, newentries, numentries);
+	mp->ma_keys->dk_usable -= numentries;
+	mp->ma_keys->dk_nentries = numentries;
+	return 0;
+}
+
+static int insertion_resize(ViDictObject *mp, int string_keys)
+{
+	return dictresize(mp, calculate_log2_keysize(GROWTH_RATE(mp)), string_keys);
+}
+
+/* Insert or replace an item, steals the references to key and value */
+static int insertdict(ViDictObject *mp, ViObject *key, Vi_hash_t hash, ViObject *value)
+{
+	ViDictKeysObject *dk;
+	ViObject *old_value;
+	Vi_size_t ix;
+
+	/* A key that is not a string turns a string-only table general,
+	   keeping the size of a presized table */
+	if (mp->ma_keys->dk_kind != DICT_KEYS_GENERAL && !ViString_CheckExact(key))
+	{
+		Vi_uint8_t log2_size = mp->ma_keys->dk_log2_size;
+		if (dictresize(mp, log2_size < DICT_LOG_MINSIZE ? DICT_LOG_MINSIZE : log2_size, 0) < 0)
+			goto fail;
+	}
+
+	ix = dict_lookup(mp, key, hash, &old_value);
+	if (ix == DKIX_ERROR)
+		goto fail;
+
+	/* Split tables only take keys in the order of the shared keys */
+	if (mp->ma_values != NULL &&
+		((ix >= 0 && old_value == NULL && mp->ma_used != ix) ||
+		 (ix == DKIX_EMPTY && mp->ma_used != mp->ma_keys->dk_nentries)))
+	{
+		if (insertion_resize(mp, 1) < 0)
+			goto fail;
+		ix = DKIX_EMPTY;
+	}
+
+	if (ix == DKIX_EMPTY)
+	{
+		dict_entry *ep;
+		Vi_size_t hashpos;
+
+		/* A full split table is combined, its keys are shared */
+		if (mp->ma_keys->dk_usable <= 0)
+		{
+			if (insertion_resize(mp, mp->ma_keys->dk_kind != DICT_KEYS_GENERAL) < 0)
+				goto fail;
+		}
+		dk = mp->ma_keys;
+		hashpos = find_empty_slot(dk, hash);
+		ep = &DK_ENTRIES(dk)[dk->dk_nentries];
+		dictkeys_set_index(dk, hashpos, dk->dk_nentries);
+		ep->me_key = key;
+		ep->me_hash = hash;
+		if (mp->ma_values != NULL)
+		{
+			assert(mp->ma_values[dk->dk_nentries] == NULL);
+			mp->ma_values[dk->dk_nentries] = value;
+		}
+		else
+			ep->me_value = value;
+		mp->ma_used++;
+		dk->dk_usable--;
+		dk->dk_nentries++;
+		return 0;
+	}
+
+	/* The key is known, replace its value */
+	if (mp->ma_values != NULL)
+	{
+		mp->ma_values[ix] = value;
+		if (old_value == NULL)
+			mp->ma_used++; // Next key of the shared keys
+	}
+	else
+		DK_ENTRIES(mp->ma_keys)[ix].me_value = value;
+	ViObject_XDECREF(old_value);
+	ViObject_DECREF(key);
+	return 0;
+
+fail:
+	ViObject_DECREF(value);
+	ViObject_DECREF(key);
+	return -1;
+}
+
+static void delitem_common(ViDictObject *mp, Vi_hash_t hash, Vi_size_t ix, ViObject *old_value)
+{
+	ViDictKeysObject *dk = mp->ma_keys;
+	dict_entry *ep = &DK_ENTRIES(dk)[ix];
+	ViObject *old_key = ep->me_key;
+
+	assert(mp->ma_values == NULL);
+	dictkeys_set_index(dk, lookup_index(dk, hash, ix), DKIX_DUMMY);
+	ep->me_key = NULL;
+	ep->me_value = NULL;
+	mp->ma_used--;
+	ViObject_DECREF(old_value);
+	ViObject_DECREF(old_key);
+}
+
+//
+//
+//		Methods
+//
+//
+
+static ViObject *new_dict(ViDictKeysObject *keys, ViObject **values)
+{
+	ViDictObject *mp;
+
+	if (numfree)
+	{
+		mp = free_list[--numfree];
+		free_list_hits++;
+		ObjectInit((ViObject *)mp, &ViDictType);
+	}
+	else
+	{
+		free_list_misses++;
+		mp = ViObject_NEW(ViDictObject, &ViDictType);
+		if (mp == NULL)
+		{
+			dictkeys_decref(keys);
+			ViObject_Free(values);
+			return NULL;
+		}
+	}
+	mp->ma_keys = keys;
+	mp->ma_values = values;
+	mp->ma_used = 0;
+	ViObject_GC_Track(mp);
+	return (ViObject *)mp;
+}
+
+static void dict_dealloc(ViDictObject *self)
+{
+	ViObject **values = self->ma_values;
+	ViDictKeysObject *keys = self->ma_keys;
+
+	ViObject_GC_UnTrack(self);
+	ViTrash_BEGIN(self)
+	if (values != NULL)
+	{
+		for (Vi_size_t i = 0, n = keys->dk_nentries; i < n; i++)
+			ViObject_XDECREF(values[i]);
+		ViObject_Free(values);
+	}
+	if (keys != NULL)
+		dictkeys_decref(keys);
+	if (numfree < ViDict_MAXFREELIST && ViDict_CheckExact(self))
+		free_list[numfree++] = self;
+	else
+		Vi_TYPE(self)->tp_free((ViObject *)self);
+	ViTrash_END
+}
+
+static int dict_traverse(ViDictObject *self, visitproc visit, void *arg)
+{
+	ViDictKeysObject *keys = self->ma_keys;
+	dict_entry *entries = DK_ENTRIES(keys);
+	Vi_size_t n = keys->dk_nentries;
+
+	if (self->ma_values != NULL)
+	{
+		for (Vi_size_t i = 0; i < n; i++)
+			Vi_VISIT(self->ma_values[i]);
+		return 0;
+	}
+	for (Vi_size_t i = 0; i < n; i++)
+	{
+		/* Strings hold no references, only general keys can be in a cycle */
+		if (keys->dk_kind == DICT_KEYS_GENERAL)
+			Vi_VISIT(entries[i].me_key);
+		Vi_VISIT(entries[i].me_value);
+	}
+	return 0;
+}
+
+static int dict_clear(ViDictObject *self)
+{
+	ViDict_Clear((ViObject *)self);
+	return 0;
+}
+
+/* Sequence methods */
+
+static Vi_size_t dict_length(ViDictObject *self)
+{
+	return self->ma_used;
+}
+
+static int dict_contains(ViDictObject *self, ViObject *key)
+{
+	return ViDict_Contains((ViObject *)self, key);
+}
+
+static ViSequenceMethods dict_sequence_methods = {
+	(lenfunc)dict_length,		// sq_length
+	0,	// sq_concat
+	0,	// sq_repeat
+	0,	// sq_item
+	0,	// sq_slice
+	0,	// sq_assign_item
+	0,	// sq_assign_slice
+	(objobjproc)dict_contains,	// sq_contains
+	0,	// sq_inplace_concat
+	0,	// sq_inplace_repeat
+};
+
+ViTypeObject ViDictType = {
+	VAROBJECT_HEAD_INIT(&ViDictType, 0)		// base
+	"dict",									// tp_name
+	"Dict object type",						// tp_doc
+	sizeof(ViDictObject),					// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT | TPFLAGS_HAVE_GC |		// tp_flags
+		TPFLAGS_BASETYPE | TPFLAGS_DICT_SUBCLASS,
+	(destructor)dict_dealloc,				// tp_dealloc
+	0,										// tp_number_methods
+	&dict_sequence_methods,					// tp_sequence_methods
+	ViObject_HashNotImplemented,			// tp_hash
+	(traverseproc)dict_traverse,			// tp_traverse
+	(inquiry)dict_clear,					// tp_clear
+	0,										// tp_richcompare
+	&ViBaseObjectType,						// tp_base
+	0,										// tp_dict
+	0,										// tp_new
+	ViObject_GC_Del,							// tp_free
+	0,										// tp_cached_keys
+};
+
+//
+//
+//		API Functions
+//
+//
+
+ViObject *ViDictObject_New()
+{
+	return new_dict(Vi_EMPTY_KEYS, NULL);
+}
+
+ViObject *ViDictObject_NewPresized(Vi_size_t minused)
+{
+	ViDictKeysObject *keys;
+
+	if (minused <= USABLE_FRACTION(DICT_MINSIZE))
+		return ViDictObject_New();
+	if (minused > VI_SIZE_T_MAX / 3)
+	{
+		ViError_NoMemory();
+		return NULL;
+	}
+	keys = new_keys_object(estimate_log2_keysize(minused), DICT_KEYS_STRING);
+	if (keys == NULL)
+		return NULL;
+	return new_dict(keys, NULL);
+}
+
+ViObject *ViDictObject_NewForInstance(ViTypeObject *type)
+{
+	ViDictKeysObject *keys = type->tp_cached_keys;
+	ViObject **values;
+
+	if (keys == NULL)
+	{
+		keys = new_keys_object(SHARED_KEYS_LOG_SIZE, DICT_KEYS_SPLIT);
+		if (keys == NULL)
+			return NULL;
+		type->tp_cached_keys = keys;
+	}
+	values = new_values(keys);
+	if (values == NULL)
+		return NULL;
+	dictkeys_incref(keys);
+	return new_dict(keys, values);
+}
+
+ViObject *ViDict_GetItemWithError(ViObject *dict, ViObject *key)
+{
+	ViObject *value;
+	Vi_hash_t hash;
+
+	if (!ViDict_Check(dict))
+	{
+		ViError_BadInternalCall();
+		return NULL;
+	}
+	hash = key_hash(key);
+	if (hash == -1)
+		return NULL;
+	(void)dict_lookup((ViDictObject *)dict, key, hash, &value);
+	return value;
+}
+
+ViObject *ViDict_GetItemString(ViObject *dict, const char *key)
+{
+	ViObject *kv = ViString_InternFromString(key);
+	if (kv == NULL)
+		return NULL;
+	return ViDict_GetItemWithError(dict, kv);
+}
+
+ViObject *ViDict_GetItemId(ViObject *dict, ViIdentifier *key)
+{
+	ViObject *kv = ViString_FromId(key);
+	if (kv == NULL)
+		return NULL;
+	return ViDict_GetItemWithError(dict, kv);
+}
+
+int ViDict_SetItem(ViObject *dict, ViObject *key, ViObject *value)
+{
+	Vi_hash_t hash;
+
+	if (!ViDict_Check(dict) || key == NULL || value == NULL)
+	{
+		ViError_BadInternalCall();
+		return -1;
+	}
+	hash = key_hash(key);
+	if (hash == -1)
+		return -1;
+	ViObject_INCREF(key);
+	ViObject_INCREF(value);
+	/* Attribute names are interned, shared keys compare by pointer */
+	if (((ViDictObject *)dict)->ma_values != NULL && ViString_CheckExact(key))
+		ViString_InternInPlace(&key);
+	return insertdict((ViDictObject *)dict, key, hash, value);
+}
+
+int ViDict_SetItemString(ViObject *dict, const char *key, ViObject *value)
+{
+	ViObject *kv = ViString_InternFromString(key);
+	if (kv == NULL)
+		return -1;
+	return ViDict_SetItem(dict, kv, value);
+}
+
+int ViDict_SetItemId(ViObject *dict, ViIdentifier *key, ViObject *value)
+{
+	ViObject *kv = ViString_FromId(key);
+	if (kv == NULL)
+		return -1;
+	return ViDict_SetItem(dict, kv, value);
+}
+
+int ViDict_DelItem(ViObject *dict, ViObject *key)
+{
+	ViDictObject *mp;
+	ViObject *old_value;
+	Vi_hash_t hash;
+	Vi_size_t ix;
+
+	if (!ViDict_Check(dict))
+	{
+		ViError_BadInternalCall();
+		return -1;
+	}
+	mp = (ViDictObject *)dict;
+	hash = key_hash(key);
+	if (hash == -1)
+		return -1;
+
+	ix = dict_lookup(mp, key, hash, &old_value);
+	if (ix == DKIX_ERROR)
+		return -1;
+	if (ix == DKIX_EMPTY || old_value == NULL)
+	{
+		ViError_SetObject(ViExc_KeyError, key);
+		return -1;
+	}
+
+	/* Deleting would leave a gap in the values, combine the table */
+	if (mp->ma_values != NULL)
+	{
+		if (dictresize(mp, mp->ma_keys->dk_log2_size, 1) < 0)
+			return -1;
+		ix = dict_lookup(mp, key, hash, &old_value);
+		assert(ix >= 0);
+	}
+
+	delitem_common(mp, hash, ix, old_value);
+	return 0;
+}
+
+int ViDict_Contains(ViObject *dict, ViObject *key)
+{
+	ViObject *value;
+	Vi_hash_t hash;
+	Vi_size_t ix;
+
+	if (!ViDict_Check(dict))
+	{
+		ViError_BadInternalCall();
+		return -1;
+	}
+	hash = key_hash(key);
+	if (hash == -1)
+		return -1;
+	ix = dict_lookup((ViDictObject *)dict, key, hash, &value);
+	if (ix == DKIX_ERROR)
+		return -1;
+	return ix != DKIX_EMPTY && value != NULL;
+}
+
+void ViDict_Clear(ViObject *dict)
+{
+	ViDictObject *mp;
+	ViDictKeysObject *oldkeys;
+	ViObject **oldvalues;
+
+	if (!ViDict_Check(dict))
+		return;
+	mp = (ViDictObject *)dict;
+	oldkeys = mp->ma_keys;
+	oldvalues = mp->ma_values;
+	if (oldkeys == Vi_EMPTY_KEYS)
+		return;
+
+	/* Empty the dict first, DECREF may run code that looks at it */
+	mp->ma_keys = Vi_EMPTY_KEYS;
+	mp->ma_values = NULL;
+	mp->ma_used = 0;
+	if (oldvalues != NULL)
+	{
+		for (Vi_size_t i = 0, n = oldkeys->dk_nentries; i < n; i++)
+			ViObject_XDECREF(oldvalues[i]);
+		ViObject_Free(oldvalues);
+	}
+	dictkeys_decref(oldkeys);
+}
+
+ViObject *ViDict_Copy(ViObject *dict)
+{
+	ViDictObject *mp, *copy;
+	Vi_size_t pos = 0;
+	ViObject *key, *value;
+
+	if (!ViDict_Check(dict))
+	{
+		ViError_BadInternalCall();
+		return NULL;
+	}
+	mp = (ViDictObject *)dict;
+	if (mp->ma_used == 0)
+		return ViDictObject_New();
+
+	/* A compact combined table is copied as one block */
+	if (mp->ma_values == NULL && mp->ma_keys->dk_nentries == mp->ma_used)
+	{
+		ViDictKeysObject *keys = mp->ma_keys;
+		size_t size = keys_object_size(keys->dk_log2_size, keys->dk_log2_index_bytes);
+		ViDictKeysObject *newkeys = (ViDictKeysObject *)ViObject_Malloc(size);
+		dict_entry *ep;
+
+		if (newkeys == NULL)
+		{
+			ViError_NoMemory();
+			return NULL;
+		}
+		memcpy(newkeys, keys, size);
+		newkeys->dk_refcnt = 1;
+		ep = DK_ENTRIES(newkeys);
+		for (Vi_size_t i = 0; i < newkeys->dk_nentries; i++)
+		{
+			ViObject_INCREF(ep[i].me_key);
+			ViObject_INCREF(ep[i].me_value);
+		}
+		copy = (ViDictObject *)new_dict(newkeys, NULL);
+		if (copy != NULL)
+			copy->ma_used = mp->ma_used;
+		return (ViObject *)copy;
+	}
+
+	copy = (ViDictObject *)ViDictObject_NewPresized(mp->ma_used);
+	if (copy == NULL)
+		return NULL;
+	while (ViDict_Next(dict, &pos, &key, &value))
+	{
+		if (ViDict_SetItem((ViObject *)copy, key, value) < 0)
+		{
+			ViObject_DECREF(copy);
+			return NULL;
+		}
+	}
+	return (ViObject *)copy;
+}
+
+Vi_size_t ViDict_Size(ViObject *dict)
+{
+	if (!ViDict_Check(dict))
+	{
+		ViError_BadInternalCall();
+		return -1;
+	}
+	return ((ViDictObject *)dict)->ma_used;
+}
+
+int ViDict_Next(ViObject *dict, Vi_size_t *pos, ViObject **key, ViObject **value)
+{
+	ViDictObject *mp;
+	dict_entry *entries;
+	Vi_size_t i = *pos;
+
+	if (!ViDict_Check(dict) || i < 0)
+		return 0;
+	mp = (ViDictObject *)dict;
+	entries = DK_ENTRIES(mp->ma_keys);
+
+	if (mp->ma_values != NULL)
+	{
+		if (i >= mp->ma_used)
+			return 0;
+		if (value != NULL)
+			*value = mp->ma_values[i];
+	}
+	else
+	{
+		Vi_size_t n = mp->ma_keys->dk_nentries;
+		while (i < n && entries[i].me_value == NULL)
+			i++;
+		if (i >= n)
+			return 0;
+		if (value != NULL)
+			*value = entries[i].me_value;
+	}
+	if (key != NULL)
+		*key = entries[i].me_key;
+	*pos = i + 1;
+	return 1;
+}
+
+void ViDict_ClearCachedKeys(ViTypeObject *type)
+{
+	if (type->tp_cached_keys != NULL)
+	{
+		dictkeys_decref(type->tp_cached_keys);
+		type->tp_cached_keys = NULL;
+	}
+}
+
+int ViDict_ClearFreeList()
+{
+	int freed = numfree + numfreekeys;
+	while (numfree)
+	{
+		ViDictObject *mp = free_list[--numfree];
+		assert(ViDict_CheckExact(mp));
+		ViObject_GC_Del(mp);
+	}
+	while (numfreekeys)
+		ViObject_Free(keys_free_list[--numfreekeys]);
+	return freed;
+}
+
+void ViDict_GetFreeListStats(ViFreeListStats *stats)
+{
+	stats->hits = free_list_hits;
+	stats->misses = free_list_misses;
+	stats->size = numfree;
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef __DICTOBJECT_H__
+#define __DICTOBJECT_H__
+
+#include "object.h"
+
+/*
+ * Dict objects
+ *
+ * A dict keeps its entries in a dense array in insertion order, next to
+ * a small open addressing hash table of indices into that array.  The
+ * indices are 1, 2, 4 or 8 bytes wide depending on the table size, so a
+ * small dict costs little more than its entries.
+ *
+ * Combined tables hold keys and values in the entries.  Split tables
+ * share their keys with other dicts and only hold an array of values,
+ * they are used for the attribute dicts of instances of a type, which
+ * usually all have the same attributes added in the same order.  Adding
+ * keys in another order, deleting a key or adding a key that is not a
+ * string turns a split table into a combined one.
+*/
+
+typedef struct _dictkeysobject ViDictKeysObject;
+
+typedef struct _dictobject
+{
+	ViObject_HEAD
+	Vi_size_t ma_used; // Number of items in the dict
+	ViDictKeysObject *ma_keys;
+	/* NULL for a combined table, otherwise the values of a split table,
+	   ma_values[i] belongs to the key of entry i */
+	ViObject **ma_values;
+} ViDictObject;
+
+/* Type object */
+extern ViTypeObject ViDictType;
+
+/* Type check macros */
+#define ViDict_Check(self) ViObject_TypeCheck(self, &ViDictType)
+#define ViDict_CheckExact(self) Vi_IS_TYPE(self, &ViDictType)
+
+/* Cast argument to ViDictObject* type. */
+#define ViDict_CAST(obj) (assert(ViDict_Check(obj)), ((ViDictObject*)obj))
+
+#define ViDict_GET_SIZE(obj) (ViDict_CAST(obj)->ma_used)
+
+/* Create an empty dict */
+ViObject *ViDictObject_New();
+
+/* Create an empty dict with room for minused items without resizing */
+ViObject *ViDictObject_NewPresized(Vi_size_t minused);
+
+/* Create an empty attribute dict for an instance of type, a split table
+   sharing its keys with the other instances of the type */
+ViObject *ViDictObject_NewForInstance(ViTypeObject *type);
+
+/* API Functions */
+
+/* Borrowed reference to the value of key, NULL with an error set if the
+   key is not hashable.  NULL without an error if the key is missing. */
+ViObject *ViDict_GetItemWithError(ViObject *dict, ViObject *key);
+
+/* Same with a C string key, the key is interned so looking up a key
+   inserted by ViDict_SetItemString is a pointer compare */
+ViObject *ViDict_GetItemString(ViObject *dict, const char *key);
+
+/* Insert or replace an item, the dict takes new references to key and
+   value.  Returns 0 on success, -1 with an error set. */
+int ViDict_SetItem(ViObject *dict, ViObject *key, ViObject *value);
+int ViDict_SetItemString(ViObject *dict, const char *key, ViObject *value);
+
+/* Item access by a Vi_IDENTIFIER, the key is its interned string */
+ViObject *ViDict_GetItemId(ViObject *dict, ViIdentifier *key);
+int ViDict_SetItemId(ViObject *dict, ViIdentifier *key, ViObject *value);
+
+/* Remove an item, -1 with a KeyError set if the key is missing */
+int ViDict_DelItem(ViObject *dict, ViObject *key);
+
+/* 1 if key is in the dict, 0 if not, -1 on error */
+int ViDict_Contains(ViObject *dict, ViObject *key);
+
+/* Remove all items */
+void ViDict_Clear(ViObject *dict);
+
+/* Shallow copy of a dict, the copy is always a combined table */
+ViObject *ViDict_Copy(ViObject *dict);
+
+Vi_size_t ViDict_Size(ViObject *dict);
+
+/* Iterate over the items in insertion order, start with *pos = 0.
+   Returns 0 when done, key and value are borrowed references and may be
+   NULL if not needed.  The dict must not change while iterating. */
+int ViDict_Next(ViObject *dict, Vi_size_t *pos, ViObject **key, ViObject **value);
+
+/* Release the shared keys cached in a type */
+void ViDict_ClearCachedKeys(ViTypeObject *type);
+
+/* Free list functions */
+int ViDict_ClearFreeList();
+void ViDict_GetFreeListStats(ViFreeListStats *stats);
+
+#endif // __DICTOBJECT_H__
\ No newline at end of file
@@ -1,5 +1,39 @@
 #include "floatobject.h"
 
+#include <cmath>
+
+#include "../core/error.h"
+#include "../core/vihash.h"
+
+#include "boolobject.h"
+#include "intobject.h"
+
+/* Dead float objects are kept on a free list, linked through ob_type,
+   so that temporaries do not churn the allocator. */
+#ifndef ViFloat_MAXFREELIST
+#	define ViFloat_MAXFREELIST 100
+#endif
+
+static ViFloatObject *free_list = NULL;
+static int numfree = 0;
+static size_t free_list_hits = 0;
+static size_t free_list_misses = 0;
+
+static ViFloatObject *float_alloc()
+{
+	ViFloatObject *obj = free_list;
+	if (obj != NULL)
+	{
+		free_list = (ViFloatObject *)Vi_TYPE(obj);
+		numfree--;
+		free_list_hits++;
+		ObjectInit((ViObject *)obj, &ViFloatType);
+		return obj;
+	}
+	free_list_misses++;
+	return ViObject_NEW(ViFloatObject, &ViFloatType);
+}
+
 //
 //
 //		Methods
@@ -8,9 +42,94 @@
 
 static void float_dealloc(ViFloatObject *self)
 {
+	if (ViFloat_CheckExact(self) && numfree < ViFloat_MAXFREELIST)
+	{
+		numfree++;
+		ViObject_SET_TYPE(self, (ViTypeObject *)free_list);
+		free_list = self;
+		return;
+	}
 	Vi_TYPE(self)->tp_free((ViObject *)self);
 }
 
+static Vi_hash_t float_hash(ViFloatObject *self)
+{
+	return ViHash_Double((ViObject *)self, self->ob_fval);
+}
+
+/* Compare a finite double with an int without losing precision, returns
+   -1, 0 or 1 as x is less than, equal to or greater than w and -2 on
+   error */
+static int compare_with_int(double x, ViObject *w)
+{
+	Vi_int64_t v;
+	double d;
+	ViObject *zero, *m, *shift, *xi;
+	int e, c;
+
+	/* Ints of up to 53 bits convert to double exactly */
+	v = ViInt_AsInt64(w);
+	if (!(v == -1 && ViError_Occurred()) && v >= -(1LL << 53) && v <= (1LL << 53))
+		return (x > (double)v) - (x < (double)v);
+	ViError_Clear();
+
+	/* Rounding is monotonic, if the rounded int differs from x so does
+	   the int itself */
+	d = ViInt_AsDouble(w);
+	if (d == -1.0 && ViError_Occurred())
+	{
+		/* Too big for a double, bigger than any finite x */
+		ViError_Clear();
+		zero = ViIntObject_FromInt(0);
+		return ViInt_Compare(w, zero) < 0 ? 1 : -1;
+	}
+	if (d != x)
+		return x < d ? -1 : 1;
+
+	/* x is integral and at least 2^53, compare it as an int */
+	m = ViIntObject_FromInt64((Vi_int64_t)ldexp(frexp(x, &e), 53));
+	if (m == NULL)
+		return -2;
+	shift = ViIntObject_FromInt(e - 53);
+	xi = ViIntType.tp_number_methods->nb_lshift(m, shift);
+	ViObject_DECREF(m);
+	if (xi == NULL)
+		return -2;
+	c = -ViInt_Compare(w, xi);
+	ViObject_DECREF(xi);
+	return c;
+}
+
+static ViObject *float_richcompare(ViObject *a, ViObject *b, int op)
+{
+	double x, y;
+	int c;
+
+	if (!ViFloat_Check(a))
+		Vi_RETURN_NOTIMPLEMENTED;
+	x = ((ViFloatObject *)a)->ob_fval;
+
+	if (ViFloat_Check(b))
+	{
+		y = ((ViFloatObject *)b)->ob_fval;
+		Vi_RETURN_RICHCOMPARE(x, y, op);
+	}
+	if (!ViInt_Check(b) && !ViBool_Check(b))
+		Vi_RETURN_NOTIMPLEMENTED;
+
+	if (std::isnan(x))
+		return ViBool_FromLong(op == Vi_NE);
+	if (std::isinf(x))
+		c = x > 0 ? 1 : -1;
+	else
+	{
+		c = compare_with_int(x, b);
+		if (c == -2)
+			return NULL;
+	}
+	Vi_RETURN_RICHCOMPARE(c, 0, op);
+}
+
 ViTypeObject ViFloatType = {
 	VAROBJECT_HEAD_INIT(&ViFloatType, 0) // base
 	"float",							 // tp_name
@@ -21,16 +140,42 @@ ViTypeObject ViFloatType = {
 	(destructor)float_dealloc,			 // tp_dealloc
 	0,									 // tp_number_methods
 	0,									 // tp_sequence_methods
+	(hashfunc)float_hash,				 // tp_hash
+	0,									 // tp_traverse
 	0,									 // tp_clear
+	float_richcompare,					 // tp_richcompare
 	0,									 // tp_base
 	0,									 // tp_dict
 	0,									 // tp_new
-	Mem_Free							 // tp_free
+	ViObject_Free,							// tp_free
+	0,									 // tp_cached_keys
 };
 
 ViObject* ViFloatObject_FromDouble(double dval)
 {
-	ViFloatObject* obj = ViObject_NEW(ViFloatObject, &ViFloatType);
+	ViFloatObject* obj = float_alloc();
+	if (obj == NULL)
+		return NULL;
 	obj->ob_fval = dval;
 	return (ViObject*)obj;
 }
+
+int ViFloat_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		ViFloatObject *next = (ViFloatObject *)Vi_TYPE(free_list);
+		ViObject_Free(free_list);
+		free_list = next;
+	}
+	numfree = 0;
+	return freed;
+}
+
+void ViFloat_GetFreeListStats(ViFreeListStats *stats)
+{
+	stats->hits = free_list_hits;
+	stats->misses = free_list_misses;
+	stats->size = numfree;
+}
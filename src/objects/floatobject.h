@@ -11,7 +11,15 @@ typedef struct _floatobject
 
 extern ViTypeObject ViFloatType;
 
+/* Type check macros */
+#define ViFloat_Check(self) ViObject_TypeCheck(self, &ViFloatType)
+#define ViFloat_CheckExact(self) Vi_IS_TYPE(self, &ViFloatType)
+
 /* Convert a C++ double to a ViFloatObject */
 ViObject* ViFloatObject_FromDouble(double dval);
 
+/* Free list functions */
+int ViFloat_ClearFreeList();
+void ViFloat_GetFreeListStats(ViFreeListStats *stats);
+
 #endif // __FLOATOBJECT_H__
\ No newline at end of file
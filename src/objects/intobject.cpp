@@ -1,5 +1,1889 @@
 #include "intobject.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+#include "boolobject.h"
+#include "floatobject.h"
+#include "stringobject.h"
+#include "tupleobject.h"
+#include "../core/error.h"
+#include "../core/vihash.h"
+
+/*
+ * Ints are tagged pointers when their value fits (see object.h) and heap
+ * objects holding an array of 30 bit digits otherwise.
+ *
+ * The number slots first try a single word fast path: both operands fit
+ * in 64 bits and so does the result.  Only when that fails do they go to
+ * the digit algorithms, which get tagged operands unpacked into a
+ * wide_int on the stack.  Results are handed out through int_result() so
+ * values that fit always come back tagged.
+ *
+ * Big products use Karatsuba multiplication and big quotients the
+ * Burnikel-Ziegler recursive division.  Decimal conversion in both
+ * directions splits the number around powers of 10 built by squaring,
+ * which keeps it sub-quadratic.
+ *
+ * The digit algorithms take borrowed operands and always return a new
+ * heap int, never one of their operands.
+*/
+
+typedef ViInt_digit digit;
+typedef Vi_int32_t sdigit;
+typedef Vi_uint64_t twodigits;
+typedef Vi_int64_t stwodigits;
+
+#define SHIFT ViInt_SHIFT
+#define BASE ViInt_BASE
+#define MASK ViInt_MASK
+
+#define ABS_SIZE(v) (Vi_SIZE(v) < 0 ? -Vi_SIZE(v) : Vi_SIZE(v))
+#define NEGATE(v) VAROBJECT_SET_SIZE(v, -Vi_SIZE(v))
+
+/* Digits needed for any 64 bit value */
+#define WIDE_DIGITS 3
+
+/* Heap ints are limited so that their number of bits fits in a Vi_size_t */
+#define MAX_INT_DIGITS (VI_SIZE_T_MAX / SHIFT)
+
+/* Operands with fewer digits than these use the quadratic algorithms */
+#define KARATSUBA_CUTOFF 70
+#define BZ_CUTOFF 140
+
+/* Decimal conversion works in base 10^9 below DEC_CLASSIC_DIGITS digits
+   (about 900 decimal digits) and splits bigger numbers around
+   10^(DEC_CHUNK * 2^j) */
+#define DECIMAL_SHIFT 9
+#define DECIMAL_BASE ((digit)1000000000)
+#define DEC_CLASSIC_DIGITS 100
+#define DEC_CHUNK 500
+#define DEC_MAX_POWERS 48
+
+/* Dead int objects are kept on a free list, linked through ob_type,
+   so that temporaries do not churn the allocator.  Every int has room
+   for at least WIDE_DIGITS digits so any of them can be reused for a
+   value that fits in 64 bits. */
+#ifndef ViInt_MAXFREELIST
+#	define ViInt_MAXFREELIST 100
+#endif
+
+static ViIntObject *free_list = NULL;
+static int numfree = 0;
+static size_t free_list_hits = 0;
+static size_t free_list_misses = 0;
+
+/* A value that fits in 64 bits laid out as a heap int, used to hand
+   tagged operands to the digit algorithms without allocating */
+typedef struct _wideint
+{
+	ViObject_VAR_HEAD
+	digit ob_digit[WIDE_DIGITS];
+} wide_int;
+
+static ViIntObject *wide_int_init(wide_int *w, Vi_int64_t ival)
+{
+	Vi_uint64_t abs_ival = ival < 0 ? 0 - (Vi_uint64_t)ival : (Vi_uint64_t)ival;
+	Vi_size_t ndigits = 0;
+
+	ViObject_SET_TYPE(w, &ViIntType);
+	ViObject_SET_IMMORTAL(w);
+	while (abs_ival != 0)
+	{
+		w->ob_digit[ndigits++] = (digit)(abs_ival & MASK);
+		abs_ival >>= SHIFT;
+	}
+	VAROBJECT_SET_SIZE(w, ival < 0 ? -ndigits : ndigits);
+	return (ViIntObject *)w;
+}
+
+//
+//
+//		Heap ints
+//
+//
+
+/* Allocate a heap int of ndigits digits, ob_size is set to ndigits and
+   the digits are not initialized */
+static ViIntObject *int_new(Vi_size_t ndigits)
+{
+	ViIntObject *v;
+
+	if (ndigits > MAX_INT_DIGITS)
+	{
+		ViError_SetString(ViExc_OverflowError, "too many digits in integer");
+		return NULL;
+	}
+
+	if (ndigits <= WIDE_DIGITS && free_list != NULL)
+	{
+		v = free_list;
+		free_list = (ViIntObject *)Vi_TYPE(v);
+		numfree--;
+		free_list_hits++;
+		ObjectInit((ViObject *)v, &ViIntType);
+	}
+	else
+	{
+		if (ndigits <= WIDE_DIGITS)
+			free_list_misses++;
+		v = (ViIntObject *)Object_NewVar(&ViIntType, ndigits < WIDE_DIGITS ? WIDE_DIGITS : ndigits);
+		if (v == NULL)
+		{
+			ViError_NoMemory();
+			return NULL;
+		}
+	}
+	VAROBJECT_SET_SIZE(v, ndigits);
+	return v;
+}
+
+/* Strip leading zero digits */
+static ViIntObject *int_normalize(ViIntObject *v)
+{
+	Vi_size_t j = ABS_SIZE(v);
+	Vi_size_t i = j;
+
+	while (i > 0 && v->ob_digit[i - 1] == 0)
+		--i;
+	if (i != j)
+		VAROBJECT_SET_SIZE(v, Vi_SIZE(v) < 0 ? -i : i);
+	return v;
+}
+
+static ViIntObject *long_copy(const ViIntObject *a)
+{
+	Vi_size_t size = ABS_SIZE(a);
+	ViIntObject *z = int_new(size);
+	if (z == NULL)
+		return NULL;
+	memcpy(z->ob_digit, a->ob_digit, size * sizeof(digit));
+	VAROBJECT_SET_SIZE(z, Vi_SIZE(a));
+	return z;
+}
+
+static ViIntObject *long_from_wide(Vi_int64_t ival)
+{
+	wide_int tmp;
+	return long_copy(wide_int_init(&tmp, ival));
+}
+
+/* Value of a heap int if it fits in 64 bits */
+static int int_to_wide(const ViIntObject *v, Vi_int64_t *ival)
+{
+	Vi_size_t i = ABS_SIZE(v);
+	Vi_uint64_t x = 0;
+
+	if (i > WIDE_DIGITS)
+		return 0;
+	while (--i >= 0)
+	{
+		if (x > (UINT64_MAX >> SHIFT))
+			return 0;
+		x = (x << SHIFT) | v->ob_digit[i];
+	}
+
+	if (Vi_SIZE(v) < 0)
+	{
+		if (x > (Vi_uint64_t)INT64_MAX + 1)
+			return 0;
+		*ival = x == (Vi_uint64_t)INT64_MAX + 1 ? INT64_MIN : -(Vi_int64_t)x;
+	}
+	else
+	{
+		if (x > (Vi_uint64_t)INT64_MAX)
+			return 0;
+		*ival = (Vi_int64_t)x;
+	}
+	return 1;
+}
+
+/* Hand out the result of a digit algorithm, values that fit are
+   returned tagged and the heap int is released */
+static ViObject *int_result(ViIntObject *v)
+{
+	Vi_int64_t ival;
+
+	if (v == NULL)
+		return NULL;
+	if (int_to_wide(v, &ival) && ViTaggedInt_FITS(ival))
+	{
+		ViObject_DECREF(v);
+		return ViTaggedInt_FROM(ival);
+	}
+	return (ViObject *)v;
+}
+
+/* Get an int operand in digit form, tagged ints are unpacked into tmp.
+   Returns a borrowed reference, or NULL with a TypeError for non ints. */
+static ViIntObject *int_digits(ViObject *obj, wide_int *tmp)
+{
+	if (ViTaggedInt_Check(obj))
+		return wide_int_init(tmp, ViTaggedInt_VALUE(obj));
+	if (ViInt_Check(obj) || ViBool_Check(obj))
+		return (ViIntObject *)obj;
+	ViError_SetString(ViExc_TypeError, "unsupported operand type(s) for int operation");
+	return NULL;
+}
+
+//
+//
+//		Digit vectors
+//
+//
+
+/* x[0:m] += y[0:n], m >= n, returns the carry out of x */
+static digit v_iadd(digit *x, Vi_size_t m, const digit *y, Vi_size_t n)
+{
+	Vi_size_t i;
+	digit carry = 0;
+
+	for (i = 0; i < n; ++i)
+	{
+		carry += x[i] + y[i];
+		x[i] = carry & MASK;
+		carry >>= SHIFT;
+	}
+	for (; carry && i < m; ++i)
+	{
+		carry += x[i];
+		x[i] = carry & MASK;
+		carry >>= SHIFT;
+	}
+	return carry;
+}
+
+/* x[0:m] -= y[0:n], m >= n, returns the borrow out of x */
+static digit v_isub(digit *x, Vi_size_t m, const digit *y, Vi_size_t n)
+{
+	Vi_size_t i;
+	digit borrow = 0;
+
+	for (i = 0; i < n; ++i)
+	{
+		borrow = x[i] - y[i] - borrow;
+		x[i] = borrow & MASK;
+		borrow >>= SHIFT;
+		borrow &= 1;
+	}
+	for (; borrow && i < m; ++i)
+	{
+		borrow = x[i] - borrow;
+		x[i] = borrow & MASK;
+		borrow >>= SHIFT;
+		borrow &= 1;
+	}
+	return borrow;
+}
+
+/* z[0:m] = a[0:m] << d for 0 <= d < SHIFT, returns the bits shifted out */
+static digit v_lshift(digit *z, const digit *a, Vi_size_t m, int d)
+{
+	digit carry = 0;
+	for (Vi_size_t i = 0; i < m; i++)
+	{
+		twodigits acc = (twodigits)a[i] << d | carry;
+		z[i] = (digit)acc & MASK;
+		carry = (digit)(acc >> SHIFT);
+	}
+	return carry;
+}
+
+/* z[0:m] = a[0:m] >> d for 0 <= d < SHIFT, returns the bits shifted out */
+static digit v_rshift(digit *z, const digit *a, Vi_size_t m, int d)
+{
+	digit carry = 0;
+	digit mask = ((digit)1 << d) - 1;
+	for (Vi_size_t i = m; i-- > 0;)
+	{
+		twodigits acc = (twodigits)carry << SHIFT | a[i];
+		carry = (digit)acc & mask;
+		z[i] = (digit)(acc >> d);
+	}
+	return carry;
+}
+
+/* z[0:m] = two's complement of a[0:m] */
+static void v_complement(digit *z, const digit *a, Vi_size_t m)
+{
+	digit carry = 1;
+	for (Vi_size_t i = 0; i < m; ++i)
+	{
+		carry += a[i] ^ MASK;
+		z[i] = carry & MASK;
+		carry >>= SHIFT;
+	}
+}
+
+static int bit_length_digit(digit x)
+{
+	int n = 0;
+	while (x != 0)
+	{
+		n++;
+		x >>= 1;
+	}
+	return n;
+}
+
+static Vi_size_t int_bit_length(const ViIntObject *a)
+{
+	Vi_size_t n = ABS_SIZE(a);
+	if (n == 0)
+		return 0;
+	return (n - 1) * SHIFT + bit_length_digit(a->ob_digit[n - 1]);
+}
+
+/* Returns -1, 0 or 1 as a is less than, equal to or greater than b */
+static int long_compare(const ViIntObject *a, const ViIntObject *b)
+{
+	Vi_size_t i;
+
+	if (Vi_SIZE(a) != Vi_SIZE(b))
+		return Vi_SIZE(a) < Vi_SIZE(b) ? -1 : 1;
+	i = ABS_SIZE(a);
+	while (--i >= 0 && a->ob_digit[i] == b->ob_digit[i])
+		;
+	if (i < 0)
+		return 0;
+	int cmp = a->ob_digit[i] < b->ob_digit[i] ? -1 : 1;
+	return Vi_SIZE(a) < 0 ? -cmp : cmp;
+}
+
+//
+//
+//		Addition and subtraction
+//
+//
+
+/* |a| + |b| */
+static ViIntObject *x_add(const ViIntObject *a, const ViIntObject *b)
+{
+	Vi_size_t size_a = ABS_SIZE(a), size_b = ABS_SIZE(b);
+	ViIntObject *z;
+	Vi_size_t i;
+	digit carry = 0;
+
+	if (size_a < size_b)
+	{
+		const ViIntObject *t = a; a = b; b = t;
+		Vi_size_t s = size_a; size_a = size_b; size_b = s;
+	}
+	z = int_new(size_a + 1);
+	if (z == NULL)
+		return NULL;
+	for (i = 0; i < size_b; ++i)
+	{
+		carry += a->ob_digit[i] + b->ob_digit[i];
+		z->ob_digit[i] = carry & MASK;
+		carry >>= SHIFT;
+	}
+	for (; i < size_a; ++i)
+	{
+		carry += a->ob_digit[i];
+		z->ob_digit[i] = carry & MASK;
+		carry >>= SHIFT;
+	}
+	z->ob_digit[i] = carry;
+	return int_normalize(z);
+}
+
+/* |a| - |b| */
+static ViIntObject *x_sub(const ViIntObject *a, const ViIntObject *b)
+{
+	Vi_size_t size_a = ABS_SIZE(a), size_b = ABS_SIZE(b);
+	ViIntObject *z;
+	Vi_size_t i;
+	int sign = 1;
+	digit borrow = 0;
+
+	if (size_a < size_b)
+	{
+		sign = -1;
+		const ViIntObject *t = a; a = b; b = t;
+		Vi_size_t s = size_a; size_a = size_b; size_b = s;
+	}
+	else if (size_a == size_b)
+	{
+		/* Find the highest digit where a and b differ */
+		i = size_a;
+		while (--i >= 0 && a->ob_digit[i] == b->ob_digit[i])
+			;
+		if (i < 0)
+			return int_new(0);
+		if (a->ob_digit[i] < b->ob_digit[i])
+		{
+			sign = -1;
+			const ViIntObject *t = a; a = b; b = t;
+		}
+		size_a = size_b = i + 1;
+	}
+	z = int_new(size_a);
+	if (z == NULL)
+		return NULL;
+	for (i = 0; i < size_b; ++i)
+	{
+		borrow = a->ob_digit[i] - b->ob_digit[i] - borrow;
+		z->ob_digit[i] = borrow & MASK;
+		borrow >>= SHIFT;
+		borrow &= 1;
+	}
+	for (; i < size_a; ++i)
+	{
+		borrow = a->ob_digit[i] - borrow;
+		z->ob_digit[i] = borrow & MASK;
+		borrow >>= SHIFT;
+		borrow &= 1;
+	}
+	if (sign < 0)
+		NEGATE(z);
+	return int_normalize(z);
+}
+
+static ViIntObject *long_add(ViIntObject *a, ViIntObject *b)
+{
+	ViIntObject *z;
+
+	if (Vi_SIZE(a) < 0)
+	{
+		if (Vi_SIZE(b) < 0)
+		{
+			z = x_add(a, b);
+			if (z != NULL)
+				NEGATE(z);
+		}
+		else
+			z = x_sub(b, a);
+	}
+	else
+	{
+		if (Vi_SIZE(b) < 0)
+			z = x_sub(a, b);
+		else
+			z = x_add(a, b);
+	}
+	return z;
+}
+
+static ViIntObject *long_sub(ViIntObject *a, ViIntObject *b)
+{
+	ViIntObject *z;
+
+	if (Vi_SIZE(a) < 0)
+	{
+		if (Vi_SIZE(b) < 0)
+			z = x_sub(b, a);
+		else
+		{
+			z = x_add(a, b);
+			if (z != NULL)
+				NEGATE(z);
+		}
+	}
+	else
+	{
+		if (Vi_SIZE(b) < 0)
+			z = x_add(a, b);
+		else
+			z = x_sub(a, b);
+	}
+	return z;
+}
+
+//
+//
+//		Multiplication
+//
+//
+
+/* Schoolbook multiplication of |a| and |b| */
+static ViIntObject *x_mul(const ViIntObject *a, const ViIntObject *b)
+{
+	Vi_size_t size_a = ABS_SIZE(a), size_b = ABS_SIZE(b);
+	ViIntObject *z = int_new(size_a + size_b);
+	if (z == NULL)
+		return NULL;
+
+	memset(z->ob_digit, 0, (size_a + size_b) * sizeof(digit));
+	for (Vi_size_t i = 0; i < size_a; ++i)
+	{
+		twodigits carry = 0;
+		twodigits f = a->ob_digit[i];
+		digit *pz = z->ob_digit + i;
+		const digit *pb = b->ob_digit;
+		const digit *pbend = b->ob_digit + size_b;
+
+		while (pb < pbend)
+		{
+			carry += *pz + *pb++ * f;
+			*pz++ = (digit)(carry & MASK);
+			carry >>= SHIFT;
+		}
+		if (carry)
+			*pz += (digit)(carry & MASK);
+	}
+	return int_normalize(z);
+}
+
+/* Split |n| into high and low parts at digit size */
+static int kmul_split(const ViIntObject *n, Vi_size_t size, ViIntObject **high, ViIntObject **low)
+{
+	Vi_size_t size_n = ABS_SIZE(n);
+	Vi_size_t size_lo = size_n < size ? size_n : size;
+	Vi_size_t size_hi = size_n - size_lo;
+	ViIntObject *hi, *lo;
+
+	hi = int_new(size_hi);
+	if (hi == NULL)
+		return -1;
+	lo = int_new(size_lo);
+	if (lo == NULL)
+	{
+		ViObject_DECREF(hi);
+		return -1;
+	}
+	memcpy(lo->ob_digit, n->ob_digit, size_lo * sizeof(digit));
+	memcpy(hi->ob_digit, n->ob_digit + size_lo, size_hi * sizeof(digit));
+	*high = int_normalize(hi);
+	*low = int_normalize(lo);
+	return 0;
+}
+
+static ViIntObject *k_lopsided_mul(const ViIntObject *a, const ViIntObject *b);
+
+/* Karatsuba multiplication of |a| and |b|: with a = ah*X + al and
+   b = bh*X + bl, a*b = ah*bh*X^2 + ((ah+al)*(bh+bl) - ah*bh - al*bl)*X + al*bl
+   takes three half size products instead of four */
+static ViIntObject *k_mul(const ViIntObject *a, const ViIntObject *b)
+{
+	Vi_size_t asize = ABS_SIZE(a), bsize = ABS_SIZE(b);
+	ViIntObject *ah = NULL, *al = NULL, *bh = NULL, *bl = NULL;
+	ViIntObject *ret = NULL, *t1 = NULL, *t2 = NULL, *t3 = NULL;
+	Vi_size_t shift, i;
+
+	/* Make a the smaller one */
+	if (asize > bsize)
+	{
+		const ViIntObject *t = a; a = b; b = t;
+		Vi_size_t s = asize; asize = bsize; bsize = s;
+	}
+	if (asize <= KARATSUBA_CUTOFF)
+		return x_mul(a, b);
+
+	/* Splitting b in halves would leave nothing of a in the high part */
+	if (2 * asize <= bsize)
+		return k_lopsided_mul(a, b);
+
+	shift = bsize >> 1;
+	if (kmul_split(a, shift, &ah, &al) < 0)
+		goto fail;
+	if (kmul_split(b, shift, &bh, &bl) < 0)
+		goto fail;
+
+	ret = int_new(asize + bsize);
+	if (ret == NULL)
+		goto fail;
+
+	/* ret = ah*bh << 2*shift | al*bl */
+	t1 = k_mul(ah, bh);
+	if (t1 == NULL)
+		goto fail;
+	memcpy(ret->ob_digit + 2 * shift, t1->ob_digit, ABS_SIZE(t1) * sizeof(digit));
+	i = asize + bsize - 2 * shift - ABS_SIZE(t1);
+	if (i)
+		memset(ret->ob_digit + 2 * shift + ABS_SIZE(t1), 0, i * sizeof(digit));
+
+	t2 = k_mul(al, bl);
+	if (t2 == NULL)
+		goto fail;
+	memcpy(ret->ob_digit, t2->ob_digit, ABS_SIZE(t2) * sizeof(digit));
+	i = 2 * shift - ABS_SIZE(t2);
+	if (i)
+		memset(ret->ob_digit + ABS_SIZE(t2), 0, i * sizeof(digit));
+
+	/* Subtract both products from the middle, the borrows are undone by
+	   the addition of the cross product */
+	i = asize + bsize - shift;
+	(void)v_isub(ret->ob_digit + shift, i, t2->ob_digit, ABS_SIZE(t2));
+	(void)v_isub(ret->ob_digit + shift, i, t1->ob_digit, ABS_SIZE(t1));
+	ViObject_CLEAR(t1);
+	ViObject_CLEAR(t2);
+
+	t1 = x_add(ah, al);
+	if (t1 == NULL)
+		goto fail;
+	t2 = x_add(bh, bl);
+	if (t2 == NULL)
+		goto fail;
+	t3 = k_mul(t1, t2);
+	if (t3 == NULL)
+		goto fail;
+	(void)v_iadd(ret->ob_digit + shift, i, t3->ob_digit, ABS_SIZE(t3));
+
+	ViObject_DECREF(ah);
+	ViObject_DECREF(al);
+	ViObject_DECREF(bh);
+	ViObject_DECREF(bl);
+	ViObject_DECREF(t1);
+	ViObject_DECREF(t2);
+	ViObject_DECREF(t3);
+	return int_normalize(ret);
+
+fail:
+	ViObject_XDECREF(ret);
+	ViObject_XDECREF(ah);
+	ViObject_XDECREF(al);
+	ViObject_XDECREF(bh);
+	ViObject_XDECREF(bl);
+	ViObject_XDECREF(t1);
+	ViObject_XDECREF(t2);
+	ViObject_XDECREF(t3);
+	return NULL;
+}
+
+/* Multiply a small a by a much bigger b as a sequence of balanced
+   products of a and slices of b */
+static ViIntObject *k_lopsided_mul(const ViIntObject *a, const ViIntObject *b)
+{
+	Vi_size_t asize = ABS_SIZE(a), bsize = ABS_SIZE(b);
+	Vi_size_t nbdone = 0;
+	Vi_size_t size_ret = asize + bsize;
+	ViIntObject *ret, *bslice;
+
+	ret = int_new(size_ret);
+	if (ret == NULL)
+		return NULL;
+	memset(ret->ob_digit, 0, size_ret * sizeof(digit));
+
+	bslice = int_new(asize);
+	if (bslice == NULL)
+	{
+		ViObject_DECREF(ret);
+		return NULL;
+	}
+
+	while (bsize > 0)
+	{
+		Vi_size_t nbtouse = bsize < asize ? bsize : asize;
+		ViIntObject *product;
+
+		memcpy(bslice->ob_digit, b->ob_digit + nbdone, nbtouse * sizeof(digit));
+		VAROBJECT_SET_SIZE(bslice, nbtouse);
+		product = k_mul(a, bslice);
+		if (product == NULL)
+		{
+			ViObject_DECREF(ret);
+			ViObject_DECREF(bslice);
+			return NULL;
+		}
+		(void)v_iadd(ret->ob_digit + nbdone, size_ret - nbdone, product->ob_digit, ABS_SIZE(product));
+		ViObject_DECREF(product);
+
+		bsize -= nbtouse;
+		nbdone += nbtouse;
+	}
+
+	ViObject_DECREF(bslice);
+	return int_normalize(ret);
+}
+
+static ViIntObject *long_mul(ViIntObject *a, ViIntObject *b)
+{
+	ViIntObject *z = k_mul(a, b);
+	if (z != NULL && ((Vi_SIZE(a) < 0) != (Vi_SIZE(b) < 0)))
+		NEGATE(z);
+	return z;
+}
+
+//
+//
+//		Shifts
+//
+//
+
+/* a << bits, keeping the sign */
+static ViIntObject *long_lshift(const ViIntObject *a, Vi_size_t bits)
+{
+	Vi_size_t wordshift = bits / SHIFT;
+	int remshift = (int)(bits % SHIFT);
+	Vi_size_t oldsize = ABS_SIZE(a);
+	Vi_size_t newsize, i, j;
+	twodigits accum = 0;
+	ViIntObject *z;
+
+	if (oldsize == 0)
+		return int_new(0);
+	if (wordshift > MAX_INT_DIGITS - oldsize - 1)
+	{
+		ViError_SetString(ViExc_OverflowError, "too many digits in integer");
+		return NULL;
+	}
+	newsize = oldsize + wordshift + (remshift ? 1 : 0);
+	z = int_new(newsize);
+	if (z == NULL)
+		return NULL;
+	if (Vi_SIZE(a) < 0)
+		NEGATE(z);
+
+	for (i = 0; i < wordshift; i++)
+		z->ob_digit[i] = 0;
+	for (j = 0; j < oldsize; i++, j++)
+	{
+		accum |= (twodigits)a->ob_digit[j] << remshift;
+		z->ob_digit[i] = (digit)(accum & MASK);
+		accum >>= SHIFT;
+	}
+	if (remshift)
+		z->ob_digit[newsize - 1] = (digit)accum;
+	return int_normalize(z);
+}
+
+/* |a| >> bits */
+static ViIntObject *rshift_mag(const ViIntObject *a, Vi_size_t bits)
+{
+	Vi_size_t wordshift = bits / SHIFT;
+	Vi_size_t newsize = ABS_SIZE(a) - wordshift;
+	int loshift = (int)(bits % SHIFT);
+	int hishift = SHIFT - loshift;
+	digit lomask = ((digit)1 << hishift) - 1;
+	digit himask = MASK ^ lomask;
+	ViIntObject *z;
+
+	if (newsize <= 0)
+		return int_new(0);
+	z = int_new(newsize);
+	if (z == NULL)
+		return NULL;
+	for (Vi_size_t i = 0, j = wordshift; i < newsize; i++, j++)
+	{
+		z->ob_digit[i] = (a->ob_digit[j] >> loshift) & lomask;
+		if (i + 1 < newsize)
+			z->ob_digit[i] |= (a->ob_digit[j + 1] << hishift) & himask;
+	}
+	return int_normalize(z);
+}
+
+/* a >> bits, rounding towards minus infinity */
+static ViIntObject *long_rshift(const ViIntObject *a, Vi_size_t bits)
+{
+	wide_int tmp;
+	ViIntObject *one, *t, *z;
+
+	if (Vi_SIZE(a) >= 0)
+		return rshift_mag(a, bits);
+
+	/* For negative values a >> n == -((|a| - 1) >> n) - 1 */
+	one = wide_int_init(&tmp, 1);
+	t = x_sub(a, one);
+	if (t == NULL)
+		return NULL;
+	z = rshift_mag(t, bits);
+	ViObject_DECREF(t);
+	if (z == NULL)
+		return NULL;
+	t = x_add(z, one);
+	ViObject_DECREF(z);
+	if (t != NULL)
+		NEGATE(t);
+	return t;
+}
+
+/* The low bits of |a| */
+static ViIntObject *low_bits(const ViIntObject *a, Vi_size_t bits)
+{
+	Vi_size_t full = bits / SHIFT;
+	Vi_size_t n = full + (bits % SHIFT ? 1 : 0);
+	ViIntObject *z;
+
+	if (n > ABS_SIZE(a))
+		n = ABS_SIZE(a);
+	z = int_new(n);
+	if (z == NULL)
+		return NULL;
+	memcpy(z->ob_digit, a->ob_digit, n * sizeof(digit));
+	if (full < n)
+		z->ob_digit[full] &= ((digit)1 << (bits % SHIFT)) - 1;
+	return int_normalize(z);
+}
+
+//
+//
+//		Division
+//
+//
+
+/* pout[0:size] = pin[0:size] / n, returns the remainder */
+static digit inplace_divrem1(digit *pout, const digit *pin, Vi_size_t size, digit n)
+{
+	twodigits rem = 0;
+
+	pin += size;
+	pout += size;
+	while (--size >= 0)
+	{
+		digit hi;
+		rem = (rem << SHIFT) | *--pin;
+		*--pout = hi = (digit)(rem / n);
+		rem -= (twodigits)hi * n;
+	}
+	return (digit)rem;
+}
+
+/* |a| / n for a single digit n */
+static ViIntObject *divrem1(const ViIntObject *a, digit n, digit *prem)
+{
+	Vi_size_t size = ABS_SIZE(a);
+	ViIntObject *z = int_new(size);
+	if (z == NULL)
+		return NULL;
+	*prem = inplace_divrem1(z->ob_digit, a->ob_digit, size, n);
+	return int_normalize(z);
+}
+
+/* Knuth's algorithm D for |v1| / |w1|, w1 has at least two digits and
+   v1 at least as many.  Relies on >> of negative values being an
+   arithmetic shift, as on every supported compiler. */
+static ViIntObject *x_divrem(const ViIntObject *v1, const ViIntObject *w1, ViIntObject **prem)
+{
+	ViIntObject *v, *w, *a;
+	Vi_size_t i, k, size_v, size_w;
+	int d;
+	digit wm1, wm2, carry, q, r, vtop, *v0, *vk, *w0, *ak;
+	twodigits vv;
+	sdigit zhi;
+	stwodigits z;
+
+	size_v = ABS_SIZE(v1);
+	size_w = ABS_SIZE(w1);
+	assert(size_v >= size_w && size_w >= 2);
+	v = int_new(size_v + 1);
+	if (v == NULL)
+		return NULL;
+	w = int_new(size_w);
+	if (w == NULL)
+	{
+		ViObject_DECREF(v);
+		return NULL;
+	}
+
+	/* Normalize: shift w1 left so its top digit has its top bit set,
+	   and v1 by the same amount */
+	d = SHIFT - bit_length_digit(w1->ob_digit[size_w - 1]);
+	carry = v_lshift(w->ob_digit, w1->ob_digit, size_w, d);
+	assert(carry == 0);
+	carry = v_lshift(v->ob_digit, v1->ob_digit, size_v, d);
+	if (carry != 0 || v->ob_digit[size_v - 1] >= w->ob_digit[size_w - 1])
+	{
+		v->ob_digit[size_v] = carry;
+		size_v++;
+	}
+
+	/* The quotient has at most k = size_v - size_w digits */
+	k = size_v - size_w;
+	assert(k >= 0);
+	a = int_new(k);
+	if (a == NULL)
+	{
+		ViObject_DECREF(w);
+		ViObject_DECREF(v);
+		return NULL;
+	}
+	v0 = v->ob_digit;
+	w0 = w->ob_digit;
+	wm1 = w0[size_w - 1];
+	wm2 = w0[size_w - 2];
+	for (vk = v0 + k, ak = a->ob_digit + k; vk-- > v0;)
+	{
+		/* Estimate the quotient digit q, it may be one too large */
+		vtop = vk[size_w];
+		assert(vtop <= wm1);
+		vv = ((twodigits)vtop << SHIFT) | vk[size_w - 1];
+		q = (digit)(vv / wm1);
+		r = (digit)(vv - (twodigits)wm1 * q);
+		while ((twodigits)wm2 * q > (((twodigits)r << SHIFT) | vk[size_w - 2]))
+		{
+			--q;
+			r += wm1;
+			if (r >= BASE)
+				break;
+		}
+		assert(q <= BASE);
+
+		/* Subtract q * w0[0:size_w] from vk[0:size_w + 1] */
+		zhi = 0;
+		for (i = 0; i < size_w; ++i)
+		{
+			z = (sdigit)vk[i] + zhi - (stwodigits)q * (stwodigits)w0[i];
+			vk[i] = (digit)z & MASK;
+			zhi = (sdigit)(z >> SHIFT);
+		}
+
+		/* Add w back if q was too large */
+		assert((sdigit)vtop + zhi == -1 || (sdigit)vtop + zhi == 0);
+		if ((sdigit)vtop + zhi < 0)
+		{
+			carry = 0;
+			for (i = 0; i < size_w; ++i)
+			{
+				carry += vk[i] + w0[i];
+				vk[i] = carry & MASK;
+				carry >>= SHIFT;
+			}
+			--q;
+		}
+
+		*--ak = q;
+	}
+
+	/* Unshift the remainder */
+	carry = v_rshift(w0, v0, size_w, d);
+	assert(carry == 0);
+	ViObject_DECREF(v);
+
+	*prem = int_normalize(w);
+	return int_normalize(a);
+}
+
+static int bz_divmod_pos(ViIntObject *a, ViIntObject *b, ViIntObject **pq, ViIntObject **pr);
+
+/* Divide |a| by |b|, the quotient and remainder are non-negative.  Big
+   divisors use the recursive division when allowed. */
+static int divrem_mag(ViIntObject *a, ViIntObject *b, ViIntObject **pq, ViIntObject **pr, int allow_bz)
+{
+	Vi_size_t size_a = ABS_SIZE(a), size_b = ABS_SIZE(b);
+	ViIntObject *q, *r;
+
+	if (size_b == 0)
+	{
+		ViError_SetString(ViExc_ZeroDivisionError, "integer division or modulo by zero");
+		return -1;
+	}
+
+	if (size_a < size_b ||
+		(size_a == size_b && a->ob_digit[size_a - 1] < b->ob_digit[size_b - 1]))
+	{
+		/* |a| < |b| */
+		r = long_copy(a);
+		if (r == NULL)
+			return -1;
+		VAROBJECT_SET_SIZE(r, size_a);
+		q = int_new(0);
+		if (q == NULL)
+		{
+			ViObject_DECREF(r);
+			return -1;
+		}
+	}
+	else if (size_b == 1)
+	{
+		digit rem = 0;
+		q = divrem1(a, b->ob_digit[0], &rem);
+		if (q == NULL)
+			return -1;
+		r = long_from_wide(rem);
+		if (r == NULL)
+		{
+			ViObject_DECREF(q);
+			return -1;
+		}
+	}
+	else if (allow_bz && size_b >= BZ_CUTOFF)
+	{
+		ViIntObject *abs_a = long_copy(a), *abs_b = long_copy(b);
+		int err = -1;
+
+		if (abs_a != NULL && abs_b != NULL)
+		{
+			VAROBJECT_SET_SIZE(abs_a, size_a);
+			VAROBJECT_SET_SIZE(abs_b, size_b);
+			err = bz_divmod_pos(abs_a, abs_b, &q, &r);
+		}
+		ViObject_XDECREF(abs_a);
+		ViObject_XDECREF(abs_b);
+		if (err < 0)
+			return -1;
+	}
+	else
+	{
+		q = x_divrem(a, b, &r);
+		if (q == NULL)
+			return -1;
+	}
+
+	*pq = q;
+	*pr = r;
+	return 0;
+}
+
+/* Division rounding towards zero, the remainder has the sign of a */
+static int long_divrem(ViIntObject *a, ViIntObject *b, ViIntObject **pdiv, ViIntObject **prem)
+{
+	if (divrem_mag(a, b, pdiv, prem, 1) < 0)
+		return -1;
+	if ((Vi_SIZE(a) < 0) != (Vi_SIZE(b) < 0))
+		NEGATE(*pdiv);
+	if (Vi_SIZE(a) < 0)
+		NEGATE(*prem);
+	return 0;
+}
+
+/* Division rounding towards minus infinity, the remainder has the sign
+   of b */
+static int long_divmod(ViIntObject *a, ViIntObject *b, ViIntObject **pdiv, ViIntObject **pmod)
+{
+	ViIntObject *div, *mod, *t;
+
+	if (long_divrem(a, b, &div, &mod) < 0)
+		return -1;
+	if ((Vi_SIZE(mod) < 0 && Vi_SIZE(b) > 0) || (Vi_SIZE(mod) > 0 && Vi_SIZE(b) < 0))
+	{
+		wide_int tmp;
+
+		t = long_add(mod, b);
+		ViObject_DECREF(mod);
+		mod = t;
+		t = long_sub(div, wide_int_init(&tmp, 1));
+		ViObject_DECREF(div);
+		div = t;
+		if (mod == NULL || div == NULL)
+		{
+			ViObject_XDECREF(mod);
+			ViObject_XDECREF(div);
+			return -1;
+		}
+	}
+	*pdiv = div;
+	*pmod = mod;
+	return 0;
+}
+
+/*
+ * Burnikel-Ziegler division
+ *
+ * Divides a 2n bit number by an n bit one with two recursive 3n/2n bit
+ * divisions, each of which is a half size division and a multiplication.
+ * With Karatsuba multiplication this is O(n^1.58 log n) instead of the
+ * O(n^2) of algorithm D.  All values are non-negative.
+*/
+
+/* Consume a and return a op b, NULL in gives NULL out so a chain of
+   operations needs a single error check */
+static ViIntObject *add_steal(ViIntObject *a, ViIntObject *b)
+{
+	ViIntObject *z;
+	if (a == NULL)
+		return NULL;
+	z = long_add(a, b);
+	ViObject_DECREF(a);
+	return z;
+}
+
+static ViIntObject *sub_steal(ViIntObject *a, ViIntObject *b)
+{
+	ViIntObject *z;
+	if (a == NULL)
+		return NULL;
+	z = long_sub(a, b);
+	ViObject_DECREF(a);
+	return z;
+}
+
+static ViIntObject *lshift_steal(ViIntObject *a, Vi_size_t bits)
+{
+	ViIntObject *z;
+	if (a == NULL)
+		return NULL;
+	z = long_lshift(a, bits);
+	ViObject_DECREF(a);
+	return z;
+}
+
+static ViIntObject *rshift_steal(ViIntObject *a, Vi_size_t bits)
+{
+	ViIntObject *z;
+	if (a == NULL)
+		return NULL;
+	z = rshift_mag(a, bits);
+	ViObject_DECREF(a);
+	return z;
+}
+
+static ViIntObject *low_bits_steal(ViIntObject *a, Vi_size_t bits)
+{
+	ViIntObject *z;
+	if (a == NULL)
+		return NULL;
+	z = low_bits(a, bits);
+	ViObject_DECREF(a);
+	return z;
+}
+
+static int bz_div2n1n(ViIntObject *a, ViIntObject *b, Vi_size_t n, ViIntObject **pq, ViIntObject **pr);
+
+/* Divide a12 * 2^n + a3 by b = b1 * 2^n + b2, where a12 < b * 2^n */
+static int bz_div3n2n(ViIntObject *a12, ViIntObject *a3, ViIntObject *b, ViIntObject *b1, ViIntObject *b2,
+	Vi_size_t n, ViIntObject **pq, ViIntObject **pr)
+{
+	wide_int tmp;
+	ViIntObject *one = wide_int_init(&tmp, 1);
+	ViIntObject *q = NULL, *r = NULL, *t;
+	int top_equal;
+
+	t = rshift_mag(a12, n);
+	if (t == NULL)
+		return -1;
+	top_equal = long_compare(t, b1) == 0;
+	ViObject_DECREF(t);
+
+	if (top_equal)
+	{
+		/* The quotient would not fit in n bits, the estimate is 2^n - 1 */
+		q = sub_steal(long_lshift(one, n), one);
+		t = long_lshift(b1, n);
+		if (t != NULL)
+		{
+			r = add_steal(long_sub(a12, t), b1);
+			ViObject_DECREF(t);
+		}
+	}
+	else if (bz_div2n1n(a12, b1, n, &q, &r) < 0)
+		return -1;
+	if (q == NULL || r == NULL)
+		goto fail;
+
+	/* r = (r << n | a3) - q * b2 */
+	r = add_steal(lshift_steal(r, n), a3);
+	t = long_mul(q, b2);
+	if (r == NULL || t == NULL)
+	{
+		ViObject_XDECREF(t);
+		goto fail;
+	}
+	r = sub_steal(r, t);
+	ViObject_DECREF(t);
+
+	/* The estimate is at most two too large */
+	while (r != NULL && Vi_SIZE(r) < 0)
+	{
+		q = sub_steal(q, one);
+		r = add_steal(r, b);
+		if (q == NULL)
+			goto fail;
+	}
+	if (r == NULL)
+		goto fail;
+
+	*pq = q;
+	*pr = r;
+	return 0;
+
+fail:
+	ViObject_XDECREF(q);
+	ViObject_XDECREF(r);
+	return -1;
+}
+
+/* Divide a < b * 2^n by b of n bits */
+static int bz_div2n1n(ViIntObject *a, ViIntObject *b, Vi_size_t n, ViIntObject **pq, ViIntObject **pr)
+{
+	ViIntObject *b1 = NULL, *b2 = NULL, *a1 = NULL, *a2 = NULL, *a3 = NULL;
+	ViIntObject *q1 = NULL, *q2 = NULL, *r1 = NULL, *r2 = NULL;
+	Vi_size_t half;
+	int pad = n & 1;
+	int result = -1;
+
+	if (n <= BZ_CUTOFF * SHIFT)
+		return divrem_mag(a, b, pq, pr, 0);
+
+	/* Work on an even number of bits */
+	if (pad)
+	{
+		a = long_lshift(a, 1);
+		b = long_lshift(b, 1);
+		n++;
+		if (a == NULL || b == NULL)
+			goto done;
+	}
+	else
+	{
+		ViObject_INCREF(a);
+		ViObject_INCREF(b);
+	}
+	half = n >> 1;
+
+	b1 = rshift_mag(b, half);
+	b2 = low_bits(b, half);
+	a1 = rshift_mag(a, n);
+	a2 = low_bits_steal(rshift_mag(a, half), half);
+	a3 = low_bits(a, half);
+	if (b1 == NULL || b2 == NULL || a1 == NULL || a2 == NULL || a3 == NULL)
+		goto done;
+
+	if (bz_div3n2n(a1, a2, b, b1, b2, half, &q1, &r1) < 0)
+		goto done;
+	if (bz_div3n2n(r1, a3, b, b1, b2, half, &q2, &r2) < 0)
+		goto done;
+	if (pad)
+	{
+		r2 = rshift_steal(r2, 1);
+		if (r2 == NULL)
+			goto done;
+	}
+
+	*pq = add_steal(lshift_steal(q1, half), q2);
+	q1 = NULL;
+	if (*pq == NULL)
+		goto done;
+	*pr = r2;
+	r2 = NULL;
+	result = 0;
+
+done:
+	ViObject_XDECREF(a);
+	ViObject_XDECREF(b);
+	ViObject_XDECREF(b1);
+	ViObject_XDECREF(b2);
+	ViObject_XDECREF(a1);
+	ViObject_XDECREF(a2);
+	ViObject_XDECREF(a3);
+	ViObject_XDECREF(q1);
+	ViObject_XDECREF(q2);
+	ViObject_XDECREF(r1);
+	ViObject_XDECREF(r2);
+	return result;
+}
+
+/* Long division of a by b in base 2^n, where n is the size of b in
+   bits, with every step done by bz_div2n1n() */
+static int bz_divmod_pos(ViIntObject *a, ViIntObject *b, ViIntObject **pq, ViIntObject **pr)
+{
+	Vi_size_t n = int_bit_length(b);
+	Vi_size_t chunks = (int_bit_length(a) + n - 1) / n;
+	ViIntObject *q, *r, *chunk, *t, *qd;
+
+	q = int_new(0);
+	r = int_new(0);
+	if (q == NULL || r == NULL)
+		goto fail;
+
+	for (Vi_size_t i = chunks; i-- > 0;)
+	{
+		chunk = low_bits_steal(rshift_mag(a, i * n), n);
+		if (chunk == NULL)
+			goto fail;
+		t = add_steal(lshift_steal(r, n), chunk);
+		r = NULL;
+		ViObject_DECREF(chunk);
+		if (t == NULL)
+			goto fail;
+		if (bz_div2n1n(t, b, n, &qd, &r) < 0)
+		{
+			ViObject_DECREF(t);
+			goto fail;
+		}
+		ViObject_DECREF(t);
+		q = add_steal(lshift_steal(q, n), qd);
+		ViObject_DECREF(qd);
+		if (q == NULL)
+			goto fail;
+	}
+
+	*pq = q;
+	*pr = r;
+	return 0;
+
+fail:
+	ViObject_XDECREF(q);
+	ViObject_XDECREF(r);
+	return -1;
+}
+
+//
+//
+//		Other operations
+//
+//
+
+/* a ** b for b >= 0, left to right binary exponentiation */
+static ViIntObject *long_pow(ViIntObject *a, ViIntObject *b)
+{
+	ViIntObject *z = long_from_wide(1);
+
+	for (Vi_size_t i = ABS_SIZE(b); --i >= 0 && z != NULL;)
+	{
+		digit bi = b->ob_digit[i];
+		for (digit j = (digit)1 << (SHIFT - 1); j != 0 && z != NULL; j >>= 1)
+		{
+			ViIntObject *t = long_mul(z, z);
+			ViObject_DECREF(z);
+			z = t;
+			if (z != NULL && (bi & j))
+			{
+				t = long_mul(z, a);
+				ViObject_DECREF(z);
+				z = t;
+			}
+		}
+	}
+	return z;
+}
+
+/* v mod c with the sign of c like %, v is released.  NULL is passed
+   through. */
+static ViIntObject *long_mod_release(ViIntObject *v, ViIntObject *c)
+{
+	ViIntObject *q, *r;
+
+	if (v == NULL)
+		return NULL;
+	int status = long_divmod(v, c, &q, &r);
+	ViObject_DECREF(v);
+	if (status < 0)
+		return NULL;
+	ViObject_DECREF(q);
+	return r;
+}
+
+/* a ** b mod c for b >= 0 and c != 0, long_pow() with every product
+   reduced modulo c */
+static ViIntObject *long_pow_mod(ViIntObject *a, ViIntObject *b, ViIntObject *c)
+{
+	ViIntObject *q, *base;
+
+	if (long_divmod(a, c, &q, &base) < 0)
+		return NULL;
+	ViObject_DECREF(q);
+
+	ViIntObject *z = long_mod_release(long_from_wide(1), c);
+	for (Vi_size_t i = ABS_SIZE(b); --i >= 0 && z != NULL;)
+	{
+		digit bi = b->ob_digit[i];
+		for (digit j = (digit)1 << (SHIFT - 1); j != 0 && z != NULL; j >>= 1)
+		{
+			ViIntObject *t = long_mul(z, z);
+			ViObject_DECREF(z);
+			z = long_mod_release(t, c);
+			if (z != NULL && (bi & j))
+			{
+				t = long_mul(z, base);
+				ViObject_DECREF(z);
+				z = long_mod_release(t, c);
+			}
+		}
+	}
+	ViObject_DECREF(base);
+	return z;
+}
+
+/* Bitwise operations on the infinite two's complement representation */
+static ViIntObject *long_bitwise(ViIntObject *a, char op, ViIntObject *b)
+{
+	int nega = Vi_SIZE(a) < 0, negb = Vi_SIZE(b) < 0;
+	int negz;
+	Vi_size_t size_a, size_b, size_z, i;
+	ViIntObject *z, *ca = NULL, *cb = NULL;
+
+	/* Negative operands are replaced by their complement */
+	if (nega)
+	{
+		ca = int_new(ABS_SIZE(a));
+		if (ca == NULL)
+			return NULL;
+		v_complement(ca->ob_digit, a->ob_digit, ABS_SIZE(a));
+		a = ca;
+	}
+	if (negb)
+	{
+		cb = int_new(ABS_SIZE(b));
+		if (cb == NULL)
+		{
+			ViObject_XDECREF(ca);
+			return NULL;
+		}
+		v_complement(cb->ob_digit, b->ob_digit, ABS_SIZE(b));
+		b = cb;
+	}
+
+	/* Make a the longer one */
+	size_a = ABS_SIZE(a);
+	size_b = ABS_SIZE(b);
+	if (size_a < size_b)
+	{
+		ViIntObject *t = a; a = b; b = t;
+		Vi_size_t s = size_a; size_a = size_b; size_b = s;
+		int n = nega; nega = negb; negb = n;
+	}
+
+	/* The digits of b past size_b are all 0 or all 1 */
+	switch (op)
+	{
+	case '^':
+		negz = nega ^ negb;
+		size_z = size_a;
+		break;
+	case '&':
+		negz = nega & negb;
+		size_z = negb ? size_a : size_b;
+		break;
+	default: // '|'
+		negz = nega | negb;
+		size_z = negb ? size_b : size_a;
+		break;
+	}
+
+	z = int_new(size_z + negz);
+	if (z == NULL)
+		goto done;
+
+	switch (op)
+	{
+	case '&':
+		for (i = 0; i < size_b; ++i)
+			z->ob_digit[i] = a->ob_digit[i] & b->ob_digit[i];
+		break;
+	case '|':
+		for (i = 0; i < size_b; ++i)
+			z->ob_digit[i] = a->ob_digit[i] | b->ob_digit[i];
+		break;
+	default:
+		for (i = 0; i < size_b; ++i)
+			z->ob_digit[i] = a->ob_digit[i] ^ b->ob_digit[i];
+		break;
+	}
+
+	/* Copy the rest of a, inverted if b is negative for xor */
+	if (op == '^' && negb)
+		for (; i < size_z; ++i)
+			z->ob_digit[i] = a->ob_digit[i] ^ MASK;
+	else if (i < size_z)
+		memcpy(&z->ob_digit[i], &a->ob_digit[i], (size_z - i) * sizeof(digit));
+
+	/* A negative result is complemented back */
+	if (negz)
+	{
+		NEGATE(z);
+		z->ob_digit[size_z] = MASK;
+		v_complement(z->ob_digit, z->ob_digit, size_z + 1);
+	}
+	z = int_normalize(z);
+
+done:
+	ViObject_XDECREF(ca);
+	ViObject_XDECREF(cb);
+	return z;
+}
+
+/* Nearest double to a.  The top 62 bits are collected in a word with a
+   sticky bit for the ones below, so the value is rounded only once. */
+static int long_to_double(const ViIntObject *a, double *result)
+{
+	Vi_size_t size = ABS_SIZE(a);
+	Vi_size_t nbits = int_bit_length(a);
+	Vi_size_t shift, wi;
+	Vi_uint64_t m = 0;
+	int bi, sticky = 0;
+	double x;
+
+	if (nbits <= 62)
+	{
+		for (Vi_size_t i = size; --i >= 0;)
+			m = (m << SHIFT) | a->ob_digit[i];
+		x = (double)m;
+	}
+	else
+	{
+		shift = nbits - 62;
+		if (shift > 1100)
+			goto overflow;
+		wi = shift / SHIFT;
+		bi = (int)(shift % SHIFT);
+		for (Vi_size_t i = wi; i < size; i++)
+		{
+			Vi_size_t s = (i - wi) * SHIFT - bi;
+			m |= s < 0 ? (Vi_uint64_t)a->ob_digit[i] >> -s : (Vi_uint64_t)a->ob_digit[i] << s;
+		}
+		sticky = (a->ob_digit[wi] & (((digit)1 << bi) - 1)) != 0;
+		for (Vi_size_t i = 0; i < wi && !sticky; i++)
+			sticky = a->ob_digit[i] != 0;
+		x = std::ldexp((double)(m | sticky), (int)shift);
+		if (std::isinf(x))
+			goto overflow;
+	}
+	*result = Vi_SIZE(a) < 0 ? -x : x;
+	return 0;
+
+overflow:
+	ViError_SetString(ViExc_OverflowError, "int too large to convert to float");
+	return -1;
+}
+
+/* a / b as a double, correctly rounded.  The magnitudes are scaled so
+   the quotient has 55 or 56 bits, with a sticky bit for a non-zero
+   remainder, so the one rounding to 53 bits happens in the conversion. */
+static ViObject *long_true_divide(ViIntObject *a, ViIntObject *b)
+{
+	Vi_size_t na = int_bit_length(a), nb = int_bit_length(b);
+	int negative = (Vi_SIZE(a) < 0) != (Vi_SIZE(b) < 0);
+	Vi_size_t shift;
+	Vi_int64_t ival;
+	ViIntObject *num, *den, *q, *r;
+	double x;
+
+	if (nb == 0)
+	{
+		ViError_SetString(ViExc_ZeroDivisionError, "division by zero");
+		return NULL;
+	}
+	if (na == 0)
+		return ViFloatObject_FromDouble(negative ? -0.0 : 0.0);
+
+	shift = na - nb - 55;
+	if (shift > 1100)
+	{
+		ViError_SetString(ViExc_OverflowError, "integer division result too large for a float");
+		return NULL;
+	}
+	if (shift < 0)
+	{
+		num = long_lshift(a, -shift);
+		den = long_copy(b);
+	}
+	else
+	{
+		num = long_copy(a);
+		den = long_lshift(b, shift);
+	}
+	if (num == NULL || den == NULL)
+	{
+		ViObject_XDECREF(num);
+		ViObject_XDECREF(den);
+		return NULL;
+	}
+	VAROBJECT_SET_SIZE(num, ABS_SIZE(num));
+	VAROBJECT_SET_SIZE(den, ABS_SIZE(den));
+	if (divrem_mag(num, den, &q, &r, 1) < 0)
+	{
+		ViObject_DECREF(num);
+		ViObject_DECREF(den);
+		return NULL;
+	}
+	ViObject_DECREF(num);
+	ViObject_DECREF(den);
+
+	(void)int_to_wide(q, &ival);
+	if (Vi_SIZE(r) != 0)
+		ival |= 1;
+	ViObject_DECREF(q);
+	ViObject_DECREF(r);
+
+	x = std::ldexp((double)ival, shift < -1200 ? -1200 : (int)shift);
+	if (std::isinf(x))
+	{
+		ViError_SetString(ViExc_OverflowError, "integer division result too large for a float");
+		return NULL;
+	}
+	return ViFloatObject_FromDouble(negative ? -x : x);
+}
+
+//
+//
+//		String conversion
+//
+//
+
+/* Powers 10^(DEC_CHUNK * 2^j), built by squaring as they are needed */
+typedef struct _pow10table
+{
+	ViIntObject *pows[DEC_MAX_POWERS];
+	int count;
+} pow10_table;
+
+static ViIntObject *pow10_get(pow10_table *table, int j)
+{
+	if (j >= DEC_MAX_POWERS)
+	{
+		ViError_SetString(ViExc_OverflowError, "too many digits in integer");
+		return NULL;
+	}
+	while (table->count <= j)
+	{
+		ViIntObject *p;
+		if (table->count == 0)
+		{
+			wide_int ten, exponent;
+			p = long_pow(wide_int_init(&ten, 10), wide_int_init(&exponent, DEC_CHUNK));
+		}
+		else
+			p = long_mul(table->pows[table->count - 1], table->pows[table->count - 1]);
+		if (p == NULL)
+			return NULL;
+		table->pows[table->count++] = p;
+	}
+	return table->pows[j];
+}
+
+static void pow10_clear(pow10_table *table)
+{
+	for (int i = 0; i < table->count; i++)
+		ViObject_DECREF(table->pows[i]);
+	table->count = 0;
+}
+
+static int digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'z')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'Z')
+		return c - 'A' + 10;
+	return 37;
+}
+
+/* Parse digits in a power of two base, linear time */
+static ViIntObject *from_binary_base(const char *digits, Vi_size_t len, int bits_per_char)
+{
+	Vi_size_t n, pdigit = 0;
+	twodigits accum = 0;
+	int bits_in_accum = 0;
+	ViIntObject *z;
+
+	if (len > MAX_INT_DIGITS)
+	{
+		ViError_SetString(ViExc_OverflowError, "too many digits in integer");
+		return NULL;
+	}
+	n = (len * bits_per_char + SHIFT - 1) / SHIFT;
+	z = int_new(n);
+	if (z == NULL)
+		return NULL;
+
+	for (const char *p = digits + len; p-- > digits;)
+	{
+		accum |= (twodigits)digit_value(*p) << bits_in_accum;
+		bits_in_accum += bits_per_char;
+		if (bits_in_accum >= SHIFT)
+		{
+			z->ob_digit[pdigit++] = (digit)(accum & MASK);
+			accum >>= SHIFT;
+			bits_in_accum -= SHIFT;
+		}
+	}
+	if (bits_in_accum)
+		z->ob_digit[pdigit++] = (digit)accum;
+	while (pdigit < n)
+		z->ob_digit[pdigit++] = 0;
+	return int_normalize(z);
+}
+
+/* Parse digits in any base, multiplying in as many digits at a time as
+   fit in a digit.  Quadratic time. */
+static ViIntObject *from_base_classic(const char *digits, Vi_size_t len, int base)
+{
+	const char *p = digits, *end = digits + len;
+	twodigits convmultmax = base;
+	int convwidth = 1;
+	Vi_size_t size = 0, size_z;
+	double size_estimate;
+	ViIntObject *z;
+
+	while (convmultmax * base <= BASE)
+	{
+		convmultmax *= base;
+		convwidth++;
+	}
+
+	size_estimate = (double)len * std::log2((double)base) / SHIFT + 2;
+	if (size_estimate > (double)MAX_INT_DIGITS)
+	{
+		ViError_SetString(ViExc_OverflowError, "too many digits in integer");
+		return NULL;
+	}
+	size_z = (Vi_size_t)size_estimate;
+	z = int_new(size_z);
+	if (z == NULL)
+		return NULL;
+
+	while (p < end)
+	{
+		twodigits c = digit_value(*p++);
+		twodigits convmult = base;
+		for (int i = 1; i < convwidth && p < end; ++i, ++p)
+		{
+			c = c * base + digit_value(*p);
+			convmult *= base;
+		}
+
+		/* z = z * convmult + c */
+		for (Vi_size_t i = 0; i < size; ++i)
+		{
+			c += (twodigits)z->ob_digit[i] * convmult;
+			z->ob_digit[i] = (digit)(c & MASK);
+			c >>= SHIFT;
+		}
+		if (c)
+		{
+			assert(size < size_z);
+			z->ob_digit[size++] = (digit)c;
+		}
+	}
+	VAROBJECT_SET_SIZE(z, size);
+	return int_normalize(z);
+}
+
+/* Parse decimal digits, splitting off the low DEC_CHUNK * 2^j digits
+   so the halves are combined with one big multiplication */
+static ViIntObject *from_decimal(const char *digits, Vi_size_t len, pow10_table *table)
+{
+	ViIntObject *hi, *lo, *p, *z;
+	Vi_size_t k;
+	int j = 0;
+
+	if (len <= 2 * DEC_CHUNK)
+		return from_base_classic(digits, len, 10);
+
+	while (((Vi_size_t)DEC_CHUNK << (j + 1)) < len)
+		j++;
+	k = (Vi_size_t)DEC_CHUNK << j;
+
+	p = pow10_get(table, j);
+	if (p == NULL)
+		return NULL;
+	hi = from_decimal(digits, len - k, table);
+	if (hi == NULL)
+		return NULL;
+	lo = from_decimal(digits + len - k, k, table);
+	if (lo == NULL)
+	{
+		ViObject_DECREF(hi);
+		return NULL;
+	}
+	z = long_mul(hi, p);
+	ViObject_DECREF(hi);
+	z = add_steal(z, lo);
+	ViObject_DECREF(lo);
+	return z;
+}
+
+/* Append the decimal digits of |a| to out, zero padded to pad digits.
+   Converts to base 10^9 first.  Quadratic time. */
+static int to_decimal_classic(const ViIntObject *a, Vi_size_t pad, Vi_string_t &out)
+{
+	Vi_size_t size_a = ABS_SIZE(a);
+	Vi_size_t d = (33 * DECIMAL_SHIFT) / (10 * SHIFT - 33 * DECIMAL_SHIFT);
+	Vi_size_t size = 1 + size_a + size_a / d;
+	Vi_size_t ndigits;
+	digit *pout, top;
+	char buf[16];
+
+	pout = (digit *)Mem_Alloc(size * sizeof(digit));
+	if (pout == NULL)
+	{
+		ViError_NoMemory();
+		return -1;
+	}
+
+	size = 0;
+	for (Vi_size_t i = size_a; --i >= 0;)
+	{
+		digit hi = a->ob_digit[i];
+		for (Vi_size_t j = 0; j < size; j++)
+		{
+			twodigits z = (twodigits)pout[j] << SHIFT | hi;
+			hi = (digit)(z / DECIMAL_BASE);
+			pout[j] = (digit)(z - (twodigits)hi * DECIMAL_BASE);
+		}
+		while (hi)
+		{
+			pout[size++] = hi % DECIMAL_BASE;
+			hi /= DECIMAL_BASE;
+		}
+	}
+	if (size == 0)
+		pout[size++] = 0;
+
+	ndigits = (size - 1) * DECIMAL_SHIFT;
+	for (top = pout[size - 1]; top >= 10; top /= 10)
+		ndigits++;
+	ndigits++;
+	if (pad > ndigits)
+		out.append(pad - ndigits, '0');
+
+	snprintf(buf, sizeof(buf), "%u", (unsigned int)pout[size - 1]);
+	out += buf;
+	for (Vi_size_t i = size - 1; i-- > 0;)
+	{
+		snprintf(buf, sizeof(buf), "%09u", (unsigned int)pout[i]);
+		out += buf;
+	}
+
+	Mem_Free(pout);
+	return 0;
+}
+
+/* Append the decimal digits of |a| < 10^(2 * DEC_CHUNK * 2^j) to out,
+   zero padded to pad digits, by splitting around 10^(DEC_CHUNK * 2^j) */
+static int to_decimal(ViIntObject *a, int j, Vi_size_t pad, Vi_string_t &out, pow10_table *table)
+{
+	ViIntObject *p, *q, *r;
+	Vi_size_t k;
+	int err;
+
+	if (j < 0)
+		return to_decimal_classic(a, pad, out);
+
+	p = pow10_get(table, j);
+	if (p == NULL)
+		return -1;
+
+	/* Without padding a number below the power has no high half */
+	if (pad == 0 && long_compare(a, p) < 0)
+		return to_decimal(a, j - 1, 0, out, table);
+
+	if (divrem_mag(a, p, &q, &r, 1) < 0)
+		return -1;
+	k = (Vi_size_t)DEC_CHUNK << j;
+	err = to_decimal(q, j - 1, pad > k ? pad - k : 0, out, table);
+	if (err == 0)
+		err = to_decimal(r, j - 1, k, out, table);
+	ViObject_DECREF(q);
+	ViObject_DECREF(r);
+	return err;
+}
+
+/* Append the digits of |a| in a power of two base to out */
+static void to_binary_base(const ViIntObject *a, int bits_per_char, Vi_string_t &out)
+{
+	Vi_size_t size = ABS_SIZE(a);
+	size_t start = out.size();
+	twodigits accum = 0;
+	int bits_in_accum = 0;
+	digit mask = ((digit)1 << bits_per_char) - 1;
+
+	for (Vi_size_t i = 0; i < size; i++)
+	{
+		accum |= (twodigits)a->ob_digit[i] << bits_in_accum;
+		bits_in_accum += SHIFT;
+		/* Stop at the last digit when only leading zeros are left */
+		while (bits_in_accum >= bits_per_char || (i == size - 1 && accum != 0))
+		{
+			out += "0123456789abcdef"[accum & mask];
+			accum >>= bits_per_char;
+			bits_in_accum -= bits_per_char;
+			if (bits_in_accum < 0)
+				break;
+		}
+	}
+	/* Leading zeros of the top digit were written too */
+	while (out.size() > start + 1 && out.back() == '0')
+		out.pop_back();
+	if (out.size() == start)
+		out += '0';
+	std::reverse(out.begin() + start, out.end());
+}
+
 //
 //
 //		Methods
@@ -8,36 +1892,889 @@
 
 static void int_dealloc(ViIntObject *self)
 {
+	if (ViInt_CheckExact(self) && ABS_SIZE(self) <= WIDE_DIGITS && numfree < ViInt_MAXFREELIST)
+	{
+		numfree++;
+		ViObject_SET_TYPE(self, (ViTypeObject *)free_list);
+		free_list = self;
+		return;
+	}
 	Vi_TYPE(self)->tp_free((ViObject *)self);
 }
 
+/* Value of an operand if it fits in 64 bits */
+static int wide_value(ViObject *obj, Vi_int64_t *ival)
+{
+	if (ViTaggedInt_Check(obj))
+	{
+		*ival = ViTaggedInt_VALUE(obj);
+		return 1;
+	}
+	if (ViInt_Check(obj) || ViBool_Check(obj))
+		return int_to_wide((ViIntObject *)obj, ival);
+	return 0;
+}
+
+/* Values of both operands if they fit in 64 bits.  Two tagged ints, the
+   common case, are decoded inline. */
+static inline int wide_operands(ViObject *v, ViObject *w, Vi_int64_t *a, Vi_int64_t *b)
+{
+	if (ViTaggedInt_Check(v) && ViTaggedInt_Check(w))
+	{
+		*a = ViTaggedInt_VALUE(v);
+		*b = ViTaggedInt_VALUE(w);
+		return 1;
+	}
+	return wide_value(v, a) && wide_value(w, b);
+}
+
+/* 64 bit arithmetic, returns 0 if the result does not fit */
+static inline int wide_add(Vi_int64_t a, Vi_int64_t b, Vi_int64_t *r)
+{
+	if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+		return 0;
+	*r = a + b;
+	return 1;
+}
+
+static inline int wide_sub(Vi_int64_t a, Vi_int64_t b, Vi_int64_t *r)
+{
+	if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b))
+		return 0;
+	*r = a - b;
+	return 1;
+}
+
+static inline int wide_mul(Vi_int64_t a, Vi_int64_t b, Vi_int64_t *r)
+{
+	Vi_uint64_t ua, ub;
+
+	if (a >= INT32_MIN && a <= INT32_MAX && b >= INT32_MIN && b <= INT32_MAX)
+	{
+		*r = a * b;
+		return 1;
+	}
+	ua = a < 0 ? 0 - (Vi_uint64_t)a : (Vi_uint64_t)a;
+	ub = b < 0 ? 0 - (Vi_uint64_t)b : (Vi_uint64_t)b;
+	if (ua != 0 && ub > (Vi_uint64_t)INT64_MAX / ua)
+		return 0;
+	*r = a * b;
+	return 1;
+}
+
+static int wide_pow(Vi_int64_t a, Vi_int64_t b, Vi_int64_t *r)
+{
+	Vi_int64_t result = 1;
+
+	while (b > 0)
+	{
+		if ((b & 1) && !wide_mul(result, a, &result))
+			return 0;
+		b >>= 1;
+		if (b > 0 && !wide_mul(a, a, &a))
+			return 0;
+	}
+	*r = result;
+	return 1;
+}
+
+/* Floor division and modulo with the sign rules of Python, b != 0 and
+   not a == INT64_MIN with b == -1 */
+static inline void wide_divmod(Vi_int64_t a, Vi_int64_t b, Vi_int64_t *div, Vi_int64_t *mod)
+{
+	Vi_int64_t q = a / b;
+	Vi_int64_t r = a % b;
+	if (r != 0 && ((r < 0) != (b < 0)))
+	{
+		r += b;
+		q--;
+	}
+	*div = q;
+	*mod = r;
+}
+
+/* Run a digit algorithm on two int operands */
+static ViObject *digit_binop(ViObject *v, ViObject *w, ViIntObject *(*op)(ViIntObject *, ViIntObject *))
+{
+	wide_int tv, tw;
+	ViIntObject *a = int_digits(v, &tv);
+	if (a == NULL)
+		return NULL;
+	ViIntObject *b = int_digits(w, &tw);
+	if (b == NULL)
+		return NULL;
+	return int_result(op(a, b));
+}
+
+static ViObject *int_add(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b, r;
+	if (wide_operands(v, w, &a, &b) && wide_add(a, b, &r))
+		return ViIntObject_FromInt64(r);
+	return digit_binop(v, w, long_add);
+}
+
+static ViObject *int_sub(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b, r;
+	if (wide_operands(v, w, &a, &b) && wide_sub(a, b, &r))
+		return ViIntObject_FromInt64(r);
+	return digit_binop(v, w, long_sub);
+}
+
+static ViObject *int_mul(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b, r;
+	if (wide_operands(v, w, &a, &b) && wide_mul(a, b, &r))
+		return ViIntObject_FromInt64(r);
+	return digit_binop(v, w, long_mul);
+}
+
+#define WANT_DIV 1
+#define WANT_MOD 2
+
+static ViObject *make_pair(ViObject *a, ViObject *b)
+{
+	ViObject *result;
+
+	if (a == NULL || b == NULL)
+		goto fail;
+	result = ViTupleObject_New(2);
+	if (result == NULL)
+		goto fail;
+	ViTuple_SET_ITEM(result, 0, a);
+	ViTuple_SET_ITEM(result, 1, b);
+	return result;
+
+fail:
+	ViObject_XDECREF(a);
+	ViObject_XDECREF(b);
+	return NULL;
+}
+
+/* Floor division, modulo or both as a tuple */
+static ViObject *int_divmod_common(ViObject *v, ViObject *w, int want)
+{
+	Vi_int64_t a, b, div, mod;
+	wide_int tv, tw;
+	ViIntObject *x, *y, *q, *r;
+
+	if (wide_operands(v, w, &a, &b) && !(a == INT64_MIN && b == -1))
+	{
+		if (b == 0)
+		{
+			ViError_SetString(ViExc_ZeroDivisionError, "integer division or modulo by zero");
+			return NULL;
+		}
+		wide_divmod(a, b, &div, &mod);
+		if (want == WANT_DIV)
+			return ViIntObject_FromInt64(div);
+		if (want == WANT_MOD)
+			return ViIntObject_FromInt64(mod);
+		return make_pair(ViIntObject_FromInt64(div), ViIntObject_FromInt64(mod));
+	}
+
+	x = int_digits(v, &tv);
+	if (x == NULL)
+		return NULL;
+	y = int_digits(w, &tw);
+	if (y == NULL)
+		return NULL;
+	if (long_divmod(x, y, &q, &r) < 0)
+		return NULL;
+	if (want == WANT_DIV)
+	{
+		ViObject_DECREF(r);
+		return int_result(q);
+	}
+	if (want == WANT_MOD)
+	{
+		ViObject_DECREF(q);
+		return int_result(r);
+	}
+	return make_pair(int_result(q), int_result(r));
+}
+
+static ViObject *int_floor_div(ViObject *v, ViObject *w)
+{
+	return int_divmod_common(v, w, WANT_DIV);
+}
+
+static ViObject *int_mod(ViObject *v, ViObject *w)
+{
+	return int_divmod_common(v, w, WANT_MOD);
+}
+
+static ViObject *int_divmod(ViObject *v, ViObject *w)
+{
+	return int_divmod_common(v, w, WANT_DIV | WANT_MOD);
+}
+
+static ViObject *int_true_div(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b;
+	wide_int tv, tw;
+	ViIntObject *x, *y;
+
+	/* Values of at most 53 bits are exact as doubles */
+	if (wide_operands(v, w, &a, &b) &&
+		a >= -((Vi_int64_t)1 << 53) && a <= ((Vi_int64_t)1 << 53) &&
+		b >= -((Vi_int64_t)1 << 53) && b <= ((Vi_int64_t)1 << 53))
+	{
+		if (b == 0)
+		{
+			ViError_SetString(ViExc_ZeroDivisionError, "division by zero");
+			return NULL;
+		}
+		return ViFloatObject_FromDouble((double)a / (double)b);
+	}
+
+	x = int_digits(v, &tv);
+	if (x == NULL)
+		return NULL;
+	y = int_digits(w, &tw);
+	if (y == NULL)
+		return NULL;
+	return long_true_divide(x, y);
+}
+
+/* pow(v, w, z), the result has the sign of z like v ** w % z */
+static ViObject *int_pow_mod(ViObject *v, ViObject *w, ViObject *z)
+{
+	Vi_int64_t a, b, c, q, r;
+	wide_int tv, tw, tz;
+	ViIntObject *x, *y, *m;
+
+	x = int_digits(v, &tv);
+	if (x == NULL)
+		return NULL;
+	y = int_digits(w, &tw);
+	if (y == NULL)
+		return NULL;
+	m = int_digits(z, &tz);
+	if (m == NULL)
+		return NULL;
+	if (Vi_SIZE(y) < 0)
+	{
+		ViError_SetString(ViExc_ValueError, "pow() 2nd argument cannot be negative when 3rd argument specified");
+		return NULL;
+	}
+	if (Vi_SIZE(m) == 0)
+	{
+		ViError_SetString(ViExc_ValueError, "pow() 3rd argument cannot be 0");
+		return NULL;
+	}
+
+	/* Residues of a modulus below 2**31 multiply without overflow */
+	if (int_to_wide(x, &a) && int_to_wide(y, &b) && int_to_wide(m, &c) &&
+		c > -((Vi_int64_t)1 << 31) && c < ((Vi_int64_t)1 << 31))
+	{
+		if (c == 1 || c == -1)
+			return ViIntObject_FromInt64(0);
+		wide_divmod(a, c, &q, &a);
+		wide_divmod(1, c, &q, &r);
+		while (b > 0)
+		{
+			if (b & 1)
+				wide_divmod(r * a, c, &q, &r);
+			b >>= 1;
+			if (b > 0)
+				wide_divmod(a * a, c, &q, &a);
+		}
+		return ViIntObject_FromInt64(r);
+	}
+	return int_result(long_pow_mod(x, y, m));
+}
+
+static ViObject *int_pow(ViObject *v, ViObject *w, ViObject *z)
+{
+	Vi_int64_t a, b, r;
+	wide_int tv, tw;
+	ViIntObject *x, *y;
+	double dx, dy;
+
+	if (z != NULL)
+		return int_pow_mod(v, w, z);
+
+	if (wide_operands(v, w, &a, &b) && b >= 0 && wide_pow(a, b, &r))
+		return ViIntObject_FromInt64(r);
+
+	x = int_digits(v, &tv);
+	if (x == NULL)
+		return NULL;
+	y = int_digits(w, &tw);
+	if (y == NULL)
+		return NULL;
+
+	/* A negative exponent gives a float */
+	if (Vi_SIZE(y) < 0)
+	{
+		if (Vi_SIZE(x) == 0)
+		{
+			ViError_SetString(ViExc_ZeroDivisionError, "0 cannot be raised to a negative power");
+			return NULL;
+		}
+		if (long_to_double(x, &dx) < 0 || long_to_double(y, &dy) < 0)
+			return NULL;
+		return ViFloatObject_FromDouble(std::pow(dx, dy));
+	}
+	return int_result(long_pow(x, y));
+}
+
+/* Get a shift count, counts too big for 64 bits are clamped */
+static int shift_count(ViObject *w, Vi_int64_t *count)
+{
+	wide_int tmp;
+	ViIntObject *b = int_digits(w, &tmp);
+	if (b == NULL)
+		return -1;
+	if (Vi_SIZE(b) < 0)
+	{
+		ViError_SetString(ViExc_ValueError, "negative shift count");
+		return -1;
+	}
+	if (!int_to_wide(b, count))
+		*count = INT64_MAX;
+	return 0;
+}
+
+static ViObject *int_lshift(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, n;
+	wide_int tmp;
+	ViIntObject *x;
+
+	if (ViTaggedInt_Check(v) && ViTaggedInt_Check(w))
+	{
+		a = ViTaggedInt_VALUE(v);
+		n = ViTaggedInt_VALUE(w);
+		if (n >= 0 && n < 62 &&
+			a >= -((Vi_int64_t)1 << (62 - n)) && a < ((Vi_int64_t)1 << (62 - n)))
+			return ViIntObject_FromInt64(a * ((Vi_int64_t)1 << n));
+	}
+
+	if (shift_count(w, &n) < 0)
+		return NULL;
+	x = int_digits(v, &tmp);
+	if (x == NULL)
+		return NULL;
+	if (Vi_SIZE(x) == 0)
+		return ViIntObject_FromInt(0);
+	if (n > (Vi_int64_t)VI_SIZE_T_MAX)
+	{
+		ViError_SetString(ViExc_OverflowError, "too many digits in integer");
+		return NULL;
+	}
+	return int_result(long_lshift(x, (Vi_size_t)n));
+}
+
+static ViObject *int_rshift(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, n;
+	wide_int tmp;
+	ViIntObject *x;
+
+	if (ViTaggedInt_Check(v) && ViTaggedInt_Check(w))
+	{
+		a = ViTaggedInt_VALUE(v);
+		n = ViTaggedInt_VALUE(w);
+		if (n >= 0)
+		{
+			if (n >= 63)
+				return ViIntObject_FromInt(a < 0 ? -1 : 0);
+			/* Rounds towards minus infinity without shifting a negative */
+			return ViIntObject_FromInt64(a >= 0 ? a >> n : ~(~a >> n));
+		}
+	}
+
+	if (shift_count(w, &n) < 0)
+		return NULL;
+	x = int_digits(v, &tmp);
+	if (x == NULL)
+		return NULL;
+	if (n > (Vi_int64_t)VI_SIZE_T_MAX)
+		n = VI_SIZE_T_MAX;
+	return int_result(long_rshift(x, (Vi_size_t)n));
+}
+
+static ViIntObject *long_and(ViIntObject *a, ViIntObject *b)
+{
+	return long_bitwise(a, '&', b);
+}
+
+static ViIntObject *long_xor(ViIntObject *a, ViIntObject *b)
+{
+	return long_bitwise(a, '^', b);
+}
+
+static ViIntObject *long_or(ViIntObject *a, ViIntObject *b)
+{
+	return long_bitwise(a, '|', b);
+}
+
+static ViObject *int_and(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b;
+	if (wide_operands(v, w, &a, &b))
+		return ViIntObject_FromInt64(a & b);
+	return digit_binop(v, w, long_and);
+}
+
+static ViObject *int_xor(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b;
+	if (wide_operands(v, w, &a, &b))
+		return ViIntObject_FromInt64(a ^ b);
+	return digit_binop(v, w, long_xor);
+}
+
+static ViObject *int_or(ViObject *v, ViObject *w)
+{
+	Vi_int64_t a, b;
+	if (wide_operands(v, w, &a, &b))
+		return ViIntObject_FromInt64(a | b);
+	return digit_binop(v, w, long_or);
+}
+
+static ViObject *int_neg(ViObject *v)
+{
+	Vi_int64_t a;
+	wide_int tmp;
+	ViIntObject *x, *z;
+
+	if (wide_value(v, &a) && a != INT64_MIN)
+		return ViIntObject_FromInt64(-a);
+	x = int_digits(v, &tmp);
+	if (x == NULL)
+		return NULL;
+	z = long_copy(x);
+	if (z != NULL)
+		NEGATE(z);
+	return int_result(z);
+}
+
+static ViObject *int_abs(ViObject *v)
+{
+	Vi_int64_t a;
+	wide_int tmp;
+	ViIntObject *x, *z;
+
+	if (wide_value(v, &a) && a != INT64_MIN)
+		return ViIntObject_FromInt64(a < 0 ? -a : a);
+	x = int_digits(v, &tmp);
+	if (x == NULL)
+		return NULL;
+	z = long_copy(x);
+	if (z != NULL)
+		VAROBJECT_SET_SIZE(z, ABS_SIZE(z));
+	return int_result(z);
+}
+
+static ViObject *int_invert(ViObject *v)
+{
+	Vi_int64_t a;
+	wide_int tmp, one;
+	ViIntObject *x, *z;
+
+	if (wide_value(v, &a))
+		return ViIntObject_FromInt64(~a);
+
+	/* ~x == -(x + 1) */
+	x = int_digits(v, &tmp);
+	if (x == NULL)
+		return NULL;
+	z = long_add(x, wide_int_init(&one, 1));
+	if (z != NULL)
+		NEGATE(z);
+	return int_result(z);
+}
+
+/* Exact ints are returned as they are, bools and subclasses become a
+   plain int */
+static ViObject *int_int(ViObject *v)
+{
+	wide_int tmp;
+	ViIntObject *x;
+
+	if (ViInt_CheckExact(v))
+	{
+		ViObject_INCREF(v);
+		return v;
+	}
+	x = int_digits(v, &tmp);
+	if (x == NULL)
+		return NULL;
+	return int_result(long_copy(x));
+}
+
+static int int_bool(ViObject *v)
+{
+	if (ViTaggedInt_Check(v))
+		return ViTaggedInt_VALUE(v) != 0;
+	return Vi_SIZE(v) != 0;
+}
+
+static ViObject *int_float(ViObject *v)
+{
+	double x = ViInt_AsDouble(v);
+	if (x == -1.0 && ViError_Occurred())
+		return NULL;
+	return ViFloatObject_FromDouble(x);
+}
+
+static ViObject *int_richcompare(ViObject *a, ViObject *b, int op)
+{
+	if (!(ViInt_Check(a) || ViBool_Check(a)) || !(ViInt_Check(b) || ViBool_Check(b)))
+		Vi_RETURN_NOTIMPLEMENTED;
+	Vi_RETURN_RICHCOMPARE(ViInt_Compare(a, b), 0, op);
+}
+
+static ViNumberMethods int_as_number = {
+	int_add,				// nb_add
+	int_sub,				// nb_subtract
+	int_mul,				// nb_multiply
+	int_mod,				// nb_remainder
+	int_divmod,				// nb_divmod
+	int_pow,				// nb_power
+	int_neg,				// nb_negative
+	int_int,				// nb_positive
+	int_abs,				// nb_absolute
+	int_bool,				// nb_bool
+	int_invert,				// nb_invert
+	int_lshift,				// nb_lshift
+	int_rshift,				// nb_rshift
+	int_and,				// nb_and
+	int_xor,				// nb_xor
+	int_or,					// nb_or
+	int_int,				// nb_int
+	int_float,				// nb_float
+	0,						// nb_inplace_add
+	0,						// nb_inplace_subtract
+	0,						// nb_inplace_multiply
+	0,						// nb_inplace_remainder
+	0,						// nb_inplace_power
+	0,						// nb_inplace_lshift
+	0,						// nb_inplace_rshift
+	0,						// nb_inplace_and
+	0,						// nb_inplace_xor
+	0,						// nb_inplace_or
+	int_floor_div,			// nb_floor_divide
+	int_true_div,			// nb_true_divide
+	0,						// nb_inplace_floor_divide
+	0,						// nb_inplace_true_divide
+	int_int,				// nb_index
+	0,						// nb_matrix_multiply
+	0,						// nb_inplace_matrix_multiply
+};
+
 ViTypeObject ViIntType = {
 	VAROBJECT_HEAD_INIT(&ViIntType, 0)	// base
 	"int",								// tp_name
 	"Interger object type",				// tp_doc
-	sizeof(ViIntObject),				// tp_size
-	0,									// tp_itemsize
+	offsetof(ViIntObject, ob_digit),	// tp_size
+	sizeof(digit),						// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE, // tp_flags
 	(destructor)int_dealloc,			// tp_dealloc
-	0,									// tp_number_methods
+	&int_as_number,						// tp_number_methods
 	0,									// tp_sequence_methods
+	(hashfunc)ViInt_Hash,				// tp_hash
+	0,									// tp_traverse
 	0,									// tp_clear
+	int_richcompare,					// tp_richcompare
 	0,									// tp_base
 	0,									// tp_dict
 	0,									// tp_new
-	Mem_Free							// tp_free
+	ViObject_Free,						// tp_free
+	0,									// tp_cached_keys
 };
 
+//
+//
+//		API Functions
+//
+//
+
 ViObject* ViIntObject_FromInt(Vi_int32_t ival)
 {
-	ViIntObject* obj = ViObject_NEW(ViIntObject, &ViIntType);
-	obj->ob_ival = ival;
-	return (ViObject*)obj;
+	return ViIntObject_FromInt64(ival);
+}
+
+/* Values that fit are returned tagged and need no memory at all */
+ViObject *ViIntObject_FromInt64(Vi_int64_t ival)
+{
+	if (ViTaggedInt_FITS(ival))
+		return ViTaggedInt_FROM(ival);
+	return (ViObject *)long_from_wide(ival);
+}
+
+ViObject *ViIntObject_FromUInt64(Vi_uint64_t ival)
+{
+	ViIntObject *z;
+	Vi_size_t ndigits = 0;
+
+	if (ival <= (Vi_uint64_t)INT64_MAX)
+		return ViIntObject_FromInt64((Vi_int64_t)ival);
+	z = int_new(WIDE_DIGITS);
+	if (z == NULL)
+		return NULL;
+	while (ival != 0)
+	{
+		z->ob_digit[ndigits++] = (digit)(ival & MASK);
+		ival >>= SHIFT;
+	}
+	VAROBJECT_SET_SIZE(z, ndigits);
+	return (ViObject *)z;
 }
 
 ViObject *ViIntObject_FromString(const char *str, int base)
 {
-	ViIntObject *obj = ViObject_NEW(ViIntObject, &ViIntType);
-	obj->ob_ival = std::stoi(str, nullptr, base);
-	return (ViObject *)obj;
+	const char *p = str;
+	char *digits, *q;
+	int negative = 0;
+	int bits_per_char = 0;
+	int prefixed;
+	ViIntObject *z;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p == '+' || *p == '-')
+		negative = *p++ == '-';
+
+	if (base == 0)
+	{
+		base = 10;
+		if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+			base = 16;
+		else if (p[0] == '0' && (p[1] == 'o' || p[1] == 'O'))
+			base = 8;
+		else if (p[0] == '0' && (p[1] == 'b' || p[1] == 'B'))
+			base = 2;
+		if (base != 10)
+			p += 2;
+		prefixed = base != 10;
+	}
+	else
+	{
+		prefixed = (base == 16 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) ||
+			(base == 8 && p[0] == '0' && (p[1] == 'o' || p[1] == 'O')) ||
+			(base == 2 && p[0] == '0' && (p[1] == 'b' || p[1] == 'B'));
+		if (prefixed)
+			p += 2;
+	}
+
+	if (base < 2 || base > 36)
+	{
+		ViError_SetString(ViExc_ValueError, "int() base must be >= 2 and <= 36, or 0");
+		return NULL;
+	}
+
+	/* Copy the digits without the underscores, which may only separate
+	   digits or follow a prefix */
+	digits = (char *)Mem_Alloc(strlen(p) + 1);
+	if (digits == NULL)
+	{
+		ViError_NoMemory();
+		return NULL;
+	}
+	q = digits;
+	for (; *p != '\0' && *p != ' ' && *p != '\t' && *p != '\n'; p++)
+	{
+		if (*p == '_' && (q > digits || prefixed) && p[1] != '_' && p[1] != '\0' && digit_value(p[1]) < base)
+			continue;
+		if (digit_value(*p) >= base)
+			goto invalid;
+		*q++ = *p;
+	}
+	while (*p == ' ' || *p == '\t' || *p == '\n')
+		p++;
+	if (*p != '\0' || q == digits)
+		goto invalid;
+
+	for (int b = base; (b & 1) == 0; b >>= 1)
+		bits_per_char++;
+	if (base == 1 << bits_per_char)
+		z = from_binary_base(digits, q - digits, bits_per_char);
+	else if (base == 10)
+	{
+		pow10_table table;
+		table.count = 0;
+		z = from_decimal(digits, q - digits, &table);
+		pow10_clear(&table);
+	}
+	else
+		z = from_base_classic(digits, q - digits, base);
+	Mem_Free(digits);
+
+	if (z != NULL && negative)
+		NEGATE(z);
+	return int_result(z);
+
+invalid:
+	Mem_Free(digits);
+	ViError_SetString(ViExc_ValueError, "invalid literal for int()");
+	return NULL;
+}
+
+Vi_int64_t ViInt_AsInt64(ViObject *obj)
+{
+	Vi_int64_t ival;
+
+	if (ViTaggedInt_Check(obj))
+		return ViTaggedInt_VALUE(obj);
+	if (!ViInt_Check(obj) && !ViBool_Check(obj))
+	{
+		ViError_SetString(ViExc_TypeError, "an integer is required");
+		return -1;
+	}
+	if (!int_to_wide((ViIntObject *)obj, &ival))
+	{
+		ViError_SetString(ViExc_OverflowError, "int too large to convert to a 64 bit integer");
+		return -1;
+	}
+	return ival;
+}
+
+double ViInt_AsDouble(ViObject *obj)
+{
+	wide_int tmp;
+	ViIntObject *x;
+	double result;
+
+	if (ViTaggedInt_Check(obj))
+		return (double)ViTaggedInt_VALUE(obj);
+	x = int_digits(obj, &tmp);
+	if (x == NULL || long_to_double(x, &result) < 0)
+		return -1.0;
+	return result;
+}
+
+Vi_hash_t ViInt_Hash(ViObject *obj)
+{
+	Vi_uint64_t x = 0;
+	Vi_hash_t h;
+	int negative;
+
+	if (ViTaggedInt_Check(obj))
+	{
+		Vi_int64_t v = ViTaggedInt_VALUE(obj);
+		negative = v < 0;
+		x = (negative ? 0 - (Vi_uint64_t)v : (Vi_uint64_t)v) % ViHASH_MODULUS;
+	}
+	else
+	{
+		ViIntObject *v = (ViIntObject *)obj;
+		negative = Vi_SIZE(v) < 0;
+		/* Multiplying by 2^SHIFT modulo 2^61 - 1 is a rotation of the
+		   61 bit value */
+		for (Vi_size_t i = ABS_SIZE(v); --i >= 0;)
+		{
+			x = ((x << SHIFT) & ViHASH_MODULUS) | (x >> (ViHASH_BITS - SHIFT));
+			x += v->ob_digit[i];
+			if (x >= ViHASH_MODULUS)
+				x -= ViHASH_MODULUS;
+		}
+	}
+	h = negative ? -(Vi_hash_t)x : (Vi_hash_t)x;
+	return h == -1 ? -2 : h;
+}
+
+int ViInt_Compare(ViObject *a, ViObject *b)
+{
+	wide_int ta, tb;
+
+	if (ViTaggedInt_Check(a) && ViTaggedInt_Check(b))
+	{
+		Vi_intptr_t x = ViTaggedInt_VALUE(a), y = ViTaggedInt_VALUE(b);
+		return x < y ? -1 : x > y;
+	}
+	return long_compare(int_digits(a, &ta), int_digits(b, &tb));
+}
+
+ViObject *ViInt_Format(ViObject *obj, int base)
+{
+	wide_int tmp;
+	ViIntObject *x;
+	Vi_string_t out;
+
+	x = int_digits(obj, &tmp);
+	if (x == NULL)
+		return NULL;
+
+	if (Vi_SIZE(x) < 0)
+		out += '-';
+	switch (base)
+	{
+	case 2:
+		out += "0b";
+		to_binary_base(x, 1, out);
+		break;
+	case 8:
+		out += "0o";
+		to_binary_base(x, 3, out);
+		break;
+	case 16:
+		out += "0x";
+		to_binary_base(x, 4, out);
+		break;
+	case 10:
+	{
+		pow10_table table;
+		int j = -1, err;
+
+		table.count = 0;
+		if (ABS_SIZE(x) > DEC_CLASSIC_DIGITS)
+		{
+			/* Split around the largest power not above |x| */
+			ViIntObject *abs_x = long_copy(x);
+			if (abs_x == NULL)
+				return NULL;
+			VAROBJECT_SET_SIZE(abs_x, ABS_SIZE(x));
+			for (;;)
+			{
+				ViIntObject *p = pow10_get(&table, j + 1);
+				if (p == NULL)
+				{
+					ViObject_DECREF(abs_x);
+					pow10_clear(&table);
+					return NULL;
+				}
+				if (long_compare(p, abs_x) > 0)
+					break;
+				j++;
+			}
+			err = to_decimal(abs_x, j, 0, out, &table);
+			ViObject_DECREF(abs_x);
+		}
+		else
+			err = to_decimal_classic(x, 0, out);
+		pow10_clear(&table);
+		if (err < 0)
+			return NULL;
+		break;
+	}
+	default:
+		ViError_SetString(ViExc_ValueError, "int can only be formatted in base 2, 8, 10 or 16");
+		return NULL;
+	}
+	return ViStringObject_FromStringAndSize(out.data(), (Vi_size_t)out.size());
+}
+
+int ViInt_ClearFreeList()
+{
+	int freed = numfree;
+	while (free_list != NULL)
+	{
+		ViIntObject *next = (ViIntObject *)Vi_TYPE(free_list);
+		ViObject_Free(free_list);
+		free_list = next;
+	}
+	numfree = 0;
+	return freed;
 }
+
+void ViInt_GetFreeListStats(ViFreeListStats *stats)
+{
+	stats->hits = free_list_hits;
+	stats->misses = free_list_misses;
+	stats->size = numfree;
+}
\ No newline at end of file
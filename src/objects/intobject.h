@@ -3,10 +3,20 @@
 
 #include "object.h"
 
+/* Ints that do not fit in a tagged pointer (see object.h) are stored as
+   an array of ViInt_SHIFT bit digits, least significant first.  The
+   absolute value of ob_size is the number of digits and its sign is the
+   sign of the int, zero has an ob_size of 0.  The top digit is never 0. */
+typedef Vi_uint32_t ViInt_digit;
+
+#define ViInt_SHIFT 30
+#define ViInt_BASE ((ViInt_digit)1 << ViInt_SHIFT)
+#define ViInt_MASK ((ViInt_digit)(ViInt_BASE - 1))
+
 typedef struct _intobject
 {
 	ViObject_VAR_HEAD
-	Vi_int32_t ob_ival;
+	ViInt_digit ob_digit[1];
 } ViIntObject;
 
 /* Type object */
@@ -17,10 +27,39 @@ extern ViTypeObject ViIntType;
 #define ViInt_CheckExact(self) Vi_IS_TYPE(self, &ViIntType)
 
 /* Cast argument to ViIntObject* type. */
-#define ViInt_CAST(obj) (assert(ViInt_Check(obj)), ((ViTupleObject*)obj))
+#define ViInt_CAST(obj) (assert(ViInt_Check(obj)), ((ViIntObject*)obj))
 
-/* Convert a C++ int to a ViIntObject */
+/* Convert a C++ integer to an int */
 ViObject* ViIntObject_FromInt(Vi_int32_t ival);
+ViObject *ViIntObject_FromInt64(Vi_int64_t ival);
+ViObject *ViIntObject_FromUInt64(Vi_uint64_t ival);
+
+/* Parse an int in the given base, 2 to 36, or 0 to take the base from a
+   0x / 0o / 0b prefix.  Underscores may separate digits.  Returns NULL
+   with a ValueError set if the string is not a valid int. */
 ViObject *ViIntObject_FromString(const char *str, int base);
 
+/* Value of an int, -1 with an OverflowError set if it does not fit in 64
+   bits.  Bools are laid out as ints and can be read the same way. */
+Vi_int64_t ViInt_AsInt64(ViObject *obj);
+
+/* Nearest double, -1.0 with an OverflowError set if out of range */
+double ViInt_AsDouble(ViObject *obj);
+
+/* Hash of an int, the value modulo 2^61 - 1 with the sign kept so equal
+   values hash equal whether they are tagged or not */
+Vi_hash_t ViInt_Hash(ViObject *obj);
+
+/* Returns -1, 0 or 1 as a is less than, equal to or greater than b,
+   both must be ints or bools */
+int ViInt_Compare(ViObject *a, ViObject *b);
+
+/* Digits of an int as a string in base 2, 8, 10 or 16, the bases other
+   than 10 get their 0b / 0o / 0x prefix */
+ViObject *ViInt_Format(ViObject *obj, int base);
+
+/* Free list functions */
+int ViInt_ClearFreeList();
+void ViInt_GetFreeListStats(ViFreeListStats *stats);
+
 #endif // __INTOBJECT_H__
\ No newline at end of file
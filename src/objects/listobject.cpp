@@ -1,8 +1,25 @@
 #include "listobject.h"
 
 #include "../core/error.h"
+#include "../core/vigc.h"
 #include "../core/vimem.h"
 
+#include "boolobject.h"
+#include "floatobject.h"
+#include "intobject.h"
+#include "stringobject.h"
+
+/* Empty list objects are kept around for reuse, their item vectors
+   are released on deallocation. */
+#ifndef ViList_MAXFREELIST
+#	define ViList_MAXFREELIST 80
+#endif
+
+static ViListObject *free_list[ViList_MAXFREELIST];
+static int numfree = 0;
+static size_t free_list_hits = 0;
+static size_t free_list_misses = 0;
+
 static int list_resize(ViListObject* self, Vi_size_t new_size)
 {
 	ViObject** items;
@@ -35,10 +52,10 @@ static int list_resize(ViListObject* self, Vi_size_t new_size)
 	if (new_size == 0)
 		new_allocated = 0;
 	num_allocated_bytes = new_allocated * sizeof(ViObject*);
-	items = (ViObject**)Mem_Realloc(self->ob_items, num_allocated_bytes);
+	items = (ViObject**)ViObject_Realloc(self->ob_items, num_allocated_bytes);
 	if (items == NULL)
 	{
-		ViError_SetString(ViExc_MemoryError, "out of memory");
+		ViError_NoMemory();
 		return -1;
 	}
 	self->ob_items = items;
@@ -75,8 +92,8 @@ static inline int valid_index(Vi_size_t i, Vi_size_t limit)
 static void list_dealloc(ViListObject *self)
 {
 	Vi_size_t i;
-	// Untrack list for GC
-	// begin trashcan
+	ViObject_GC_UnTrack(self);
+	ViTrash_BEGIN(self)
 	if (self->ob_items != NULL)
 	{
 		i = Vi_SIZE(self);
@@ -84,11 +101,43 @@ static void list_dealloc(ViListObject *self)
 		{
 			ViObject_DECREF(self->ob_items[i]);
 		}
-		Mem_Free(self->ob_items);
+		ViObject_Free(self->ob_items);
 	}
-	Vi_TYPE(self)->tp_free((ViObject *)self);
+	if (numfree < ViList_MAXFREELIST && ViList_CheckExact(self))
+		free_list[numfree++] = self;
+	else
+		Vi_TYPE(self)->tp_free((ViObject *)self);
+	ViTrash_END
+}
+
+static int list_traverse(ViListObject *self, visitproc visit, void *arg)
+{
+	Vi_size_t i;
 
-	// end trashcan
+	for (i = Vi_SIZE(self); --i >= 0; )
+		Vi_VISIT(self->ob_items[i]);
+	return 0;
+}
+
+static int list_clear(ViListObject *self)
+{
+	Vi_size_t i;
+	ViObject **items = self->ob_items;
+	if (items != NULL)
+	{
+		/* Detach the items first, DECREF may run arbitrary code
+		   that looks at the list again */
+		i = Vi_SIZE(self);
+		VAROBJECT_SET_SIZE(self, 0);
+		self->ob_items = NULL;
+		self->allocated = 0;
+		while (--i >= 0)
+		{
+			ViObject_XDECREF(items[i]);
+		}
+		ViObject_Free(items);
+	}
+	return 0;
 }
 
 /* Sequence methods */
@@ -169,38 +218,57 @@ ViTypeObject ViListType = {
 	"List object type",						// tp_doc
 	sizeof(ViListObject),					// tp_size
 	0,										// tp_itemsize
-	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
-		TPFLAGS_LIST_SUBCLASS,
+	TPFLAGS_DEFAULT | TPFLAGS_HAVE_GC |		// tp_flags
+		TPFLAGS_BASETYPE | TPFLAGS_LIST_SUBCLASS,
 	(destructor)list_dealloc,				// tp_dealloc
 	0,										// tp_number_methods
 	&list_sequence_methods,					// tp_sequence_methods
-	0,										// tp_clear
+	ViObject_HashNotImplemented,			// tp_hash
+	(traverseproc)list_traverse,			// tp_traverse
+	(inquiry)list_clear,					// tp_clear
+	0,										// tp_richcompare
 	&ViBaseObjectType,						// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_GC_Del,							// tp_free
+	0,										// tp_cached_keys
 };
 
 ViObject* ViListObject_New(Vi_size_t size)
 {
 	ViListObject* obj;
-	size_t alloc;
 
-	obj = ViObject_NEW(ViListObject, &ViListType);
-	if (obj == NULL)
-		return NULL;
-	if (size == 0)
+	if (numfree)
 	{
-		obj->ob_items = NULL;
-		alloc = 0;
+		numfree--;
+		obj = free_list[numfree];
+		free_list_hits++;
+		ObjectInit((ViObject *)obj, &ViListType);
 	}
 	else
 	{
-		alloc = size * sizeof(ViObject*);
-		obj->ob_items = (ViObject**)Mem_Alloc(alloc);
+		free_list_misses++;
+		obj = ViObject_NEW(ViListObject, &ViListType);
+		if (obj == NULL)
+			return NULL;
+	}
+	if (size == 0)
+		obj->ob_items = NULL;
+	else
+	{
+		/* Zeroed, the collector may look at the list before it is filled */
+		obj->ob_items = (ViObject**)ViObject_Calloc(size, sizeof(ViObject*));
+		if (obj->ob_items == NULL)
+		{
+			/* Not tracked yet, the collector never saw it */
+			ViObject_GC_Del(obj);
+			ViError_NoMemory();
+			return NULL;
+		}
 	}
 	VAROBJECT_SET_SIZE(obj, size);
 	obj->allocated = size;
+	ViObject_GC_Track(obj);
 	return (ViObject*)obj;
 }
 
@@ -231,3 +299,1130 @@ int ViList_SetItem(ViObject *list, Vi_size_t i, ViObject *newitem)
 	ViObject_XSETREF(*p, newitem);
 	return 0;
 }
+
+//
+//
+//		Sorting
+//
+//
+
+/*
+ * A stable, adaptive merge sort after Tim Peters' listsort.  The list is
+ * split into runs that are already ascending or strictly descending, the
+ * descending ones are reversed in place and short runs are extended to
+ * minrun items with a binary insertion sort.  The runs are merged as they
+ * are found, keeping the pending run lengths decreasing faster than the
+ * Fibonacci numbers so merges stay balanced.  Merging gallops, when one
+ * run keeps winning its items are found with an exponential search and
+ * copied as a block.  Sorted, reversed and partly sorted data take close
+ * to n comparisons.
+ *
+ * Before sorting the keys are scanned once.  When they are all ints, all
+ * floats or all strings the comparisons are done in C, otherwise they go
+ * to the tp_richcompare of the keys' type when they share one, and through
+ * ViObject_RichCompareBool only for keys of mixed types.
+*/
+
+/* Enough for 2**64 items, the pending run lengths grow at least as fast
+   as the Fibonacci numbers */
+#define MAX_MERGE_PENDING 85
+
+/* Wins in a row after which a merge starts galloping */
+#define MIN_GALLOP 7
+
+/* Temporary storage that does not need an allocation */
+#define MERGESTATE_TEMP_SIZE 256
+
+/* The keys being sorted and the items they belong to, values is NULL
+   when the items are their own keys */
+typedef struct _sortslice
+{
+	ViObject **keys;
+	ViObject **values;
+} sortslice;
+
+/* A run waiting to be merged */
+typedef struct _sortrun
+{
+	sortslice base;
+	Vi_size_t len;
+} sortrun;
+
+typedef struct _mergestate MergeState;
+
+struct _mergestate
+{
+	/* Wins in a row before galloping, adapts to the data */
+	Vi_size_t min_gallop;
+
+	/* Room for merging, a.keys points to temparray while that is enough */
+	sortslice a;
+	Vi_size_t alloced;
+
+	/* Runs not merged yet, run i starts at pending[i].base */
+	int n;
+	sortrun pending[MAX_MERGE_PENDING];
+
+	ViObject *temparray[MERGESTATE_TEMP_SIZE];
+
+	/* 1 if v < w, 0 if not, -1 on error */
+	int (*key_compare)(ViObject *v, ViObject *w, MergeState *ms);
+
+	/* tp_richcompare of the keys when they all have the same type */
+	richcmpfunc key_richcompare;
+};
+
+#define ISLT(X, Y) (*(ms->key_compare))(X, Y, ms)
+
+/* Run the statement after it if X < Y, jumps to fail on error.  Needs an
+   int k. */
+#define IFLT(X, Y) if ((k = ISLT(X, Y)) < 0) goto fail;	\
+				   if (k)
+
+static inline void sortslice_copy(sortslice *s1, Vi_size_t i, sortslice *s2, Vi_size_t j)
+{
+	s1->keys[i] = s2->keys[j];
+	if (s1->values != NULL)
+		s1->values[i] = s2->values[j];
+}
+
+static inline void sortslice_copy_incr(sortslice *dst, sortslice *src)
+{
+	*dst->keys++ = *src->keys++;
+	if (dst->values != NULL)
+		*dst->values++ = *src->values++;
+}
+
+static inline void sortslice_copy_decr(sortslice *dst, sortslice *src)
+{
+	*dst->keys-- = *src->keys--;
+	if (dst->values != NULL)
+		*dst->values-- = *src->values--;
+}
+
+static inline void sortslice_memcpy(sortslice *s1, Vi_size_t i, sortslice *s2, Vi_size_t j, Vi_size_t n)
+{
+	memcpy(&s1->keys[i], &s2->keys[j], sizeof(ViObject *) * n);
+	if (s1->values != NULL)
+		memcpy(&s1->values[i], &s2->values[j], sizeof(ViObject *) * n);
+}
+
+static inline void sortslice_memmove(sortslice *s1, Vi_size_t i, sortslice *s2, Vi_size_t j, Vi_size_t n)
+{
+	memmove(&s1->keys[i], &s2->keys[j], sizeof(ViObject *) * n);
+	if (s1->values != NULL)
+		memmove(&s1->values[i], &s2->values[j], sizeof(ViObject *) * n);
+}
+
+static inline void sortslice_advance(sortslice *slice, Vi_size_t n)
+{
+	slice->keys += n;
+	if (slice->values != NULL)
+		slice->values += n;
+}
+
+static void reverse_slice(ViObject **lo, ViObject **hi)
+{
+	assert(lo != NULL && hi != NULL);
+
+	--hi;
+	while (lo < hi)
+	{
+		ViObject *t = *lo;
+		*lo = *hi;
+		*hi = t;
+		++lo;
+		--hi;
+	}
+}
+
+static void reverse_sortslice(sortslice *s, Vi_size_t n)
+{
+	reverse_slice(s->keys, &s->keys[n]);
+	if (s->values != NULL)
+		reverse_slice(s->values, &s->values[n]);
+}
+
+/* Sort [lo, hi) with a binary insertion sort, [lo, start) is already
+   sorted.  Stable, an item goes after the items equal to it. */
+static int binarysort(MergeState *ms, sortslice lo, ViObject **hi, ViObject **start)
+{
+	Vi_size_t k;
+	ViObject **l, **p, **r;
+	ViObject *pivot;
+
+	assert(lo.keys <= start && start <= hi);
+	if (lo.keys == start)
+		++start;
+	for (; start < hi; ++start)
+	{
+		l = lo.keys;
+		r = start;
+		pivot = *r;
+		do
+		{
+			p = l + ((r - l) >> 1);
+			IFLT(pivot, *p)
+				r = p;
+			else
+				l = p + 1;
+		} while (l < r);
+		assert(l == r);
+		for (p = start; p > l; --p)
+			*p = *(p - 1);
+		*l = pivot;
+		if (lo.values != NULL)
+		{
+			Vi_size_t offset = lo.values - lo.keys;
+			p = start + offset;
+			pivot = *p;
+			l += offset;
+			for (; p > l; --p)
+				*p = *(p - 1);
+			*l = pivot;
+		}
+	}
+	return 0;
+
+fail:
+	return -1;
+}
+
+/* Length of the run starting at lo, ascending (lo[0] <= lo[1] <= ...) or
+   strictly descending (lo[0] > lo[1] > ...) so reversing it keeps the sort
+   stable.  -1 on error. */
+static Vi_size_t count_run(MergeState *ms, ViObject **lo, ViObject **hi, int *descending)
+{
+	Vi_size_t k;
+	Vi_size_t n;
+
+	assert(lo < hi);
+	*descending = 0;
+	++lo;
+	if (lo == hi)
+		return 1;
+
+	n = 2;
+	IFLT(*lo, *(lo - 1))
+	{
+		*descending = 1;
+		for (lo = lo + 1; lo < hi; ++lo, ++n)
+		{
+			IFLT(*lo, *(lo - 1))
+				;
+			else
+				break;
+		}
+	}
+	else
+	{
+		for (lo = lo + 1; lo < hi; ++lo, ++n)
+		{
+			IFLT(*lo, *(lo - 1))
+				break;
+		}
+	}
+	return n;
+
+fail:
+	return -1;
+}
+
+/* Where key belongs in the sorted a[0:n], before the items equal to it.
+   The search starts at a[hint], 0 <= hint < n, and probes 1, 3, 7, ...
+   items away before a binary search, so it is fast when key is close to
+   the hint.  -1 on error. */
+static Vi_size_t gallop_left(MergeState *ms, ViObject *key, ViObject **a, Vi_size_t n, Vi_size_t hint)
+{
+	Vi_size_t ofs;
+	Vi_size_t lastofs;
+	Vi_size_t k;
+
+	assert(key && a && n > 0 && hint >= 0 && hint < n);
+
+	a += hint;
+	lastofs = 0;
+	ofs = 1;
+	IFLT(*a, key)
+	{
+		/* a[hint] < key, gallop right until a[hint + lastofs] < key <= a[hint + ofs] */
+		const Vi_size_t maxofs = n - hint;
+		while (ofs < maxofs)
+		{
+			IFLT(a[ofs], key)
+			{
+				lastofs = ofs;
+				assert(ofs <= (VI_SIZE_T_MAX - 1) / 2);
+				ofs = (ofs << 1) + 1;
+			}
+			else
+				break;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		lastofs += hint;
+		ofs += hint;
+	}
+	else
+	{
+		/* key <= a[hint], gallop left until a[hint - ofs] < key <= a[hint - lastofs] */
+		const Vi_size_t maxofs = hint + 1;
+		while (ofs < maxofs)
+		{
+			IFLT(*(a - ofs), key)
+				break;
+			lastofs = ofs;
+			assert(ofs <= (VI_SIZE_T_MAX - 1) / 2);
+			ofs = (ofs << 1) + 1;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		k = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - k;
+	}
+	a -= hint;
+
+	/* a[lastofs] < key <= a[ofs], binary search the range between */
+	assert(-1 <= lastofs && lastofs < ofs && ofs <= n);
+	++lastofs;
+	while (lastofs < ofs)
+	{
+		Vi_size_t m = lastofs + ((ofs - lastofs) >> 1);
+
+		IFLT(a[m], key)
+			lastofs = m + 1;
+		else
+			ofs = m;
+	}
+	assert(lastofs == ofs);
+	return ofs;
+
+fail:
+	return -1;
+}
+
+/* Same as gallop_left but key goes after the items equal to it */
+static Vi_size_t gallop_right(MergeState *ms, ViObject *key, ViObject **a, Vi_size_t n, Vi_size_t hint)
+{
+	Vi_size_t ofs;
+	Vi_size_t lastofs;
+	Vi_size_t k;
+
+	assert(key && a && n > 0 && hint >= 0 && hint < n);
+
+	a += hint;
+	lastofs = 0;
+	ofs = 1;
+	IFLT(key, *a)
+	{
+		/* key < a[hint], gallop left until a[hint - ofs] <= key < a[hint - lastofs] */
+		const Vi_size_t maxofs = hint + 1;
+		while (ofs < maxofs)
+		{
+			IFLT(key, *(a - ofs))
+			{
+				lastofs = ofs;
+				assert(ofs <= (VI_SIZE_T_MAX - 1) / 2);
+				ofs = (ofs << 1) + 1;
+			}
+			else
+				break;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		k = lastofs;
+		lastofs = hint - ofs;
+		ofs = hint - k;
+	}
+	else
+	{
+		/* a[hint] <= key, gallop right until a[hint + lastofs] <= key < a[hint + ofs] */
+		const Vi_size_t maxofs = n - hint;
+		while (ofs < maxofs)
+		{
+			IFLT(key, a[ofs])
+				break;
+			lastofs = ofs;
+			assert(ofs <= (VI_SIZE_T_MAX - 1) / 2);
+			ofs = (ofs << 1) + 1;
+		}
+		if (ofs > maxofs)
+			ofs = maxofs;
+		lastofs += hint;
+		ofs += hint;
+	}
+	a -= hint;
+
+	/* a[lastofs] <= key < a[ofs], binary search the range between */
+	assert(-1 <= lastofs && lastofs < ofs && ofs <= n);
+	++lastofs;
+	while (lastofs < ofs)
+	{
+		Vi_size_t m = lastofs + ((ofs - lastofs) >> 1);
+
+		IFLT(key, a[m])
+			ofs = m;
+		else
+			lastofs = m + 1;
+	}
+	assert(lastofs == ofs);
+	return ofs;
+
+fail:
+	return -1;
+}
+
+static void merge_init(MergeState *ms, Vi_size_t list_size, int has_keyfunc)
+{
+	assert(ms != NULL);
+	if (has_keyfunc)
+	{
+		/* A merge needs room for half the list at most, keys and values.
+		   The rest of temparray holds the keys of a short list. */
+		ms->alloced = (list_size + 1) / 2;
+		if (MERGESTATE_TEMP_SIZE / 2 < ms->alloced)
+			ms->alloced = MERGESTATE_TEMP_SIZE / 2;
+		ms->a.values = &ms->temparray[ms->alloced];
+	}
+	else
+	{
+		ms->alloced = MERGESTATE_TEMP_SIZE;
+		ms->a.values = NULL;
+	}
+	ms->a.keys = ms->temparray;
+	ms->n = 0;
+	ms->min_gallop = MIN_GALLOP;
+}
+
+static void merge_freemem(MergeState *ms)
+{
+	assert(ms != NULL);
+	if (ms->a.keys != ms->temparray)
+	{
+		Mem_Free(ms->a.keys);
+		ms->a.keys = NULL;
+	}
+}
+
+/* Make room for need keys, and as many values if the sort has a key
+   function.  0 on success, -1 with an error set. */
+static int merge_getmem(MergeState *ms, Vi_size_t need)
+{
+	int multiplier;
+
+	assert(ms != NULL);
+	if (need <= ms->alloced)
+		return 0;
+
+	multiplier = ms->a.values != NULL ? 2 : 1;
+
+	/* The old contents are not needed, free them first so there is no
+	   realloc copy */
+	merge_freemem(ms);
+	if ((size_t)need > VI_SIZE_T_MAX / sizeof(ViObject *) / multiplier)
+	{
+		ViError_NoMemory();
+		return -1;
+	}
+	ms->a.keys = (ViObject **)Mem_Alloc(multiplier * need * sizeof(ViObject *));
+	if (ms->a.keys != NULL)
+	{
+		ms->alloced = need;
+		if (ms->a.values != NULL)
+			ms->a.values = &ms->a.keys[need];
+		return 0;
+	}
+	ViError_NoMemory();
+	return -1;
+}
+#define MERGE_GETMEM(MS, NEED) ((NEED) <= (MS)->alloced ? 0 : merge_getmem(MS, NEED))
+
+/* Merge the na items at ssa with the nb items following them, na <= nb.
+   ssa.keys[0] belongs at the end of the merge and ssb.keys[nb - 1] is the
+   last item.  0 on success, -1 on error. */
+static Vi_size_t merge_lo(MergeState *ms, sortslice ssa, Vi_size_t na, sortslice ssb, Vi_size_t nb)
+{
+	Vi_size_t k;
+	sortslice dest;
+	int result = -1;
+	Vi_size_t min_gallop;
+
+	assert(ms && ssa.keys && ssb.keys && na > 0 && nb > 0);
+	assert(ssa.keys + na == ssb.keys);
+	if (MERGE_GETMEM(ms, na) < 0)
+		return -1;
+	sortslice_memcpy(&ms->a, 0, &ssa, 0, na);
+	dest = ssa;
+	ssa = ms->a;
+
+	sortslice_copy_incr(&dest, &ssb);
+	--nb;
+	if (nb == 0)
+		goto succeed;
+	if (na == 1)
+		goto copyb;
+
+	min_gallop = ms->min_gallop;
+	for (;;)
+	{
+		Vi_size_t acount = 0; // Number of times A won in a row
+		Vi_size_t bcount = 0; // Number of times B won in a row
+
+		/* Do the straightforward thing until one run appears to win
+		   consistently */
+		for (;;)
+		{
+			assert(na > 1 && nb > 0);
+			k = ISLT(ssb.keys[0], ssa.keys[0]);
+			if (k)
+			{
+				if (k < 0)
+					goto fail;
+				sortslice_copy_incr(&dest, &ssb);
+				++bcount;
+				acount = 0;
+				--nb;
+				if (nb == 0)
+					goto succeed;
+				if (bcount >= min_gallop)
+					break;
+			}
+			else
+			{
+				sortslice_copy_incr(&dest, &ssa);
+				++acount;
+				bcount = 0;
+				--na;
+				if (na == 1)
+					goto copyb;
+				if (acount >= min_gallop)
+					break;
+			}
+		}
+
+		/* One run is winning so consistently that galloping may be a
+		   huge win.  Keep at it until neither run wins MIN_GALLOP times
+		   in a row. */
+		++min_gallop;
+		do
+		{
+			assert(na > 1 && nb > 0);
+			min_gallop -= min_gallop > 1;
+			ms->min_gallop = min_gallop;
+			k = gallop_right(ms, ssb.keys[0], ssa.keys, na, 0);
+			acount = k;
+			if (k)
+			{
+				if (k < 0)
+					goto fail;
+				sortslice_memcpy(&dest, 0, &ssa, 0, k);
+				sortslice_advance(&dest, k);
+				sortslice_advance(&ssa, k);
+				na -= k;
+				if (na == 1)
+					goto copyb;
+				/* na == 0 is impossible now if the comparison function is
+				   consistent, but we can't assume that it is */
+				if (na == 0)
+					goto succeed;
+			}
+			sortslice_copy_incr(&dest, &ssb);
+			--nb;
+			if (nb == 0)
+				goto succeed;
+
+			k = gallop_left(ms, ssa.keys[0], ssb.keys, nb, 0);
+			bcount = k;
+			if (k)
+			{
+				if (k < 0)
+					goto fail;
+				sortslice_memmove(&dest, 0, &ssb, 0, k);
+				sortslice_advance(&dest, k);
+				sortslice_advance(&ssb, k);
+				nb -= k;
+				if (nb == 0)
+					goto succeed;
+			}
+			sortslice_copy_incr(&dest, &ssa);
+			--na;
+			if (na == 1)
+				goto copyb;
+		} while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+		++min_gallop; // Penalize leaving galloping mode
+		ms->min_gallop = min_gallop;
+	}
+
+succeed:
+	result = 0;
+
+fail:
+	if (na)
+		sortslice_memcpy(&dest, 0, &ssa, 0, na);
+	return result;
+
+copyb:
+	assert(na == 1 && nb > 0);
+	/* The last item of A belongs at the end of the merge */
+	sortslice_memmove(&dest, 0, &ssb, 0, nb);
+	sortslice_copy(&dest, nb, &ssa, 0);
+	return 0;
+}
+
+/* Same as merge_lo for na >= nb, merges from the end.  ssa.keys[na - 1]
+   belongs at the end of the merge and ssb.keys[0] is the first item. */
+static Vi_size_t merge_hi(MergeState *ms, sortslice ssa, Vi_size_t na, sortslice ssb, Vi_size_t nb)
+{
+	Vi_size_t k;
+	sortslice dest, basea, baseb;
+	int result = -1;
+	Vi_size_t min_gallop;
+
+	assert(ms && ssa.keys && ssb.keys && na > 0 && nb > 0);
+	assert(ssa.keys + na == ssb.keys);
+	if (MERGE_GETMEM(ms, nb) < 0)
+		return -1;
+	dest = ssb;
+	sortslice_advance(&dest, nb - 1);
+	sortslice_memcpy(&ms->a, 0, &ssb, 0, nb);
+	basea = ssa;
+	baseb = ms->a;
+	ssb.keys = ms->a.keys + nb - 1;
+	if (ssb.values != NULL)
+		ssb.values = ms->a.values + nb - 1;
+	sortslice_advance(&ssa, na - 1);
+
+	sortslice_copy_decr(&dest, &ssa);
+	--na;
+	if (na == 0)
+		goto succeed;
+	if (nb == 1)
+		goto copya;
+
+	min_gallop = ms->min_gallop;
+	for (;;)
+	{
+		Vi_size_t acount = 0; // Number of times A won in a row
+		Vi_size_t bcount = 0; // Number of times B won in a row
+
+		for (;;)
+		{
+			assert(na > 0 && nb > 1);
+			k = ISLT(ssb.keys[0], ssa.keys[0]);
+			if (k)
+			{
+				if (k < 0)
+					goto fail;
+				sortslice_copy_decr(&dest, &ssa);
+				++acount;
+				bcount = 0;
+				--na;
+				if (na == 0)
+					goto succeed;
+				if (acount >= min_gallop)
+					break;
+			}
+			else
+			{
+				sortslice_copy_decr(&dest, &ssb);
+				++bcount;
+				acount = 0;
+				--nb;
+				if (nb == 1)
+					goto copya;
+				if (bcount >= min_gallop)
+					break;
+			}
+		}
+
+		++min_gallop;
+		do
+		{
+			assert(na > 0 && nb > 1);
+			min_gallop -= min_gallop > 1;
+			ms->min_gallop = min_gallop;
+			k = gallop_right(ms, ssb.keys[0], basea.keys, na, na - 1);
+			if (k < 0)
+				goto fail;
+			k = na - k;
+			acount = k;
+			if (k)
+			{
+				sortslice_advance(&dest, -k);
+				sortslice_advance(&ssa, -k);
+				sortslice_memmove(&dest, 1, &ssa, 1, k);
+				na -= k;
+				if (na == 0)
+					goto succeed;
+			}
+			sortslice_copy_decr(&dest, &ssb);
+			--nb;
+			if (nb == 1)
+				goto copya;
+
+			k = gallop_left(ms, ssa.keys[0], baseb.keys, nb, nb - 1);
+			if (k < 0)
+				goto fail;
+			k = nb - k;
+			bcount = k;
+			if (k)
+			{
+				sortslice_advance(&dest, -k);
+				sortslice_advance(&ssb, -k);
+				sortslice_memcpy(&dest, 1, &ssb, 1, k);
+				nb -= k;
+				if (nb == 1)
+					goto copya;
+				/* nb == 0 is impossible now if the comparison function is
+				   consistent, but we can't assume that it is */
+				if (nb == 0)
+					goto succeed;
+			}
+			sortslice_copy_decr(&dest, &ssa);
+			--na;
+			if (na == 0)
+				goto succeed;
+		} while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+		++min_gallop; // Penalize leaving galloping mode
+		ms->min_gallop = min_gallop;
+	}
+
+succeed:
+	result = 0;
+
+fail:
+	if (nb)
+		sortslice_memcpy(&dest, -(nb - 1), &baseb, 0, nb);
+	return result;
+
+copya:
+	assert(nb == 1 && na > 0);
+	/* The first item of B belongs at the front of the merge */
+	sortslice_memmove(&dest, 1 - na, &ssa, 1 - na, na);
+	sortslice_advance(&dest, -na);
+	sortslice_advance(&ssa, -na);
+	sortslice_copy(&dest, 0, &ssb, 0);
+	return 0;
+}
+
+/* Merge the pending runs i and i + 1, i must be the second or third last */
+static Vi_size_t merge_at(MergeState *ms, Vi_size_t i)
+{
+	sortslice ssa, ssb;
+	Vi_size_t na, nb;
+	Vi_size_t k;
+
+	assert(ms != NULL);
+	assert(ms->n >= 2);
+	assert(i >= 0);
+	assert(i == ms->n - 2 || i == ms->n - 3);
+
+	ssa = ms->pending[i].base;
+	na = ms->pending[i].len;
+	ssb = ms->pending[i + 1].base;
+	nb = ms->pending[i + 1].len;
+	assert(na > 0 && nb > 0);
+	assert(ssa.keys + na == ssb.keys);
+
+	/* Record the length of the combined runs, if i is the third last
+	   run slide over the last run */
+	ms->pending[i].len = na + nb;
+	if (i == ms->n - 3)
+		ms->pending[i + 1] = ms->pending[i + 2];
+	--ms->n;
+
+	/* The items of A before where B starts are already in place */
+	k = gallop_right(ms, *ssb.keys, ssa.keys, na, 0);
+	if (k < 0)
+		return -1;
+	sortslice_advance(&ssa, k);
+	na -= k;
+	if (na == 0)
+		return 0;
+
+	/* The items of B after where A ends are already in place */
+	nb = gallop_left(ms, ssa.keys[na - 1], ssb.keys, nb, nb - 1);
+	if (nb <= 0)
+		return nb;
+
+	/* Merge what remains, with min(na, nb) items of temporary storage */
+	if (na <= nb)
+		return merge_lo(ms, ssa, na, ssb, nb);
+	else
+		return merge_hi(ms, ssa, na, ssb, nb);
+}
+
+/* Merge runs until the pending lengths satisfy, for the last four runs W,
+   X, Y and Z:
+
+	1. len(X) > len(Y) + len(Z)
+	2. len(Y) > len(Z)
+	3. len(W) > len(X) + len(Y)
+
+   The third condition is checked as well as the first two, without it
+   the first can break further down the stack and the stack can overflow.
+   0 on success, -1 on error. */
+static int merge_collapse(MergeState *ms)
+{
+	sortrun *p = ms->pending;
+
+	assert(ms);
+	while (ms->n > 1)
+	{
+		Vi_size_t n = ms->n - 2;
+		if ((n > 0 && p[n - 1].len <= p[n].len + p[n + 1].len) ||
+			(n > 1 && p[n - 2].len <= p[n - 1].len + p[n].len))
+		{
+			if (p[n - 1].len < p[n + 1].len)
+				--n;
+			if (merge_at(ms, n) < 0)
+				return -1;
+		}
+		else if (p[n].len <= p[n + 1].len)
+		{
+			if (merge_at(ms, n) < 0)
+				return -1;
+		}
+		else
+			break;
+	}
+	return 0;
+}
+
+/* Merge all the pending runs into one, at the end of the sort */
+static int merge_force_collapse(MergeState *ms)
+{
+	sortrun *p = ms->pending;
+
+	assert(ms);
+	while (ms->n > 1)
+	{
+		Vi_size_t n = ms->n - 2;
+		if (n > 0 && p[n - 1].len < p[n + 1].len)
+			--n;
+		if (merge_at(ms, n) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/* A good minimum run length for n items, n / minrun is a power of 2 or a
+   little less.  Runs shorter than this are extended with binarysort. */
+static Vi_size_t merge_compute_minrun(Vi_size_t n)
+{
+	Vi_size_t r = 0; // Becomes 1 if any 1 bits are shifted off
+
+	assert(n >= 0);
+	while (n >= 64)
+	{
+		r |= n & 1;
+		n >>= 1;
+	}
+	return n + r;
+}
+
+//
+//
+//		Sort key comparisons
+//
+//
+
+/* Keys of mixed types */
+static int safe_object_compare(ViObject *v, ViObject *w, MergeState *)
+{
+	return ViObject_RichCompareBool(v, w, Vi_LT);
+}
+
+/* Keys of one type, call its tp_richcompare without the reflected
+   operator lookup */
+static int unsafe_object_compare(ViObject *v, ViObject *w, MergeState *ms)
+{
+	ViObject *res;
+	int ok;
+
+	assert(Vi_TYPE(v) == Vi_TYPE(w));
+	assert(Vi_TYPE(v)->tp_richcompare == ms->key_richcompare);
+
+	res = (*(ms->key_richcompare))(v, w, Vi_LT);
+	if (res == NULL)
+		return -1;
+	if (res == Vi_True || res == Vi_False)
+	{
+		ok = res == Vi_True;
+		ViObject_DECREF(res);
+		return ok;
+	}
+	/* Vi_NotImplemented or a result that is not a bool */
+	ViObject_DECREF(res);
+	return ViObject_RichCompareBool(v, w, Vi_LT);
+}
+
+/* Ints that all fit in a tagged pointer */
+static int unsafe_tagged_int_compare(ViObject *v, ViObject *w, MergeState *)
+{
+	assert(ViTaggedInt_Check(v) && ViTaggedInt_Check(w));
+	return ViTaggedInt_VALUE(v) < ViTaggedInt_VALUE(w);
+}
+
+static int unsafe_int_compare(ViObject *v, ViObject *w, MergeState *)
+{
+	assert(ViInt_CheckExact(v) && ViInt_CheckExact(w));
+	return ViInt_Compare(v, w) < 0;
+}
+
+static int unsafe_float_compare(ViObject *v, ViObject *w, MergeState *)
+{
+	assert(ViFloat_CheckExact(v) && ViFloat_CheckExact(w));
+	return ((ViFloatObject *)v)->ob_fval < ((ViFloatObject *)w)->ob_fval;
+}
+
+/* UTF-8 bytes sort in code point order, comparing the bytes is enough.
+   Ropes were flattened by the scan of the keys. */
+static int unsafe_string_compare(ViObject *v, ViObject *w, MergeState *)
+{
+	Vi_size_t len_v = Vi_SIZE(v), len_w = Vi_SIZE(w);
+	int c;
+
+	c = memcmp(ViString_AS_STRING(v), ViString_AS_STRING(w), len_v < len_w ? len_v : len_w);
+	if (c == 0)
+		return len_v < len_w;
+	return c < 0;
+}
+
+/* Pick the cheapest comparison that orders the keys the same as
+   ViObject_RichCompareBool.  Flattens ropes, -1 on error. */
+static int merge_pick_compare(MergeState *ms, ViObject **keys, Vi_size_t n)
+{
+	ViTypeObject *key_type;
+	int same_type = 1;
+	int all_tagged = 1;
+
+	ms->key_compare = safe_object_compare;
+	ms->key_richcompare = NULL;
+	if (n < 2)
+		return 0;
+
+	key_type = Vi_TYPE(keys[0]);
+	if (key_type == &ViRopeType)
+		key_type = &ViStringType;
+	for (Vi_size_t i = 0; i < n; i++)
+	{
+		ViObject *key = keys[i];
+		ViTypeObject *type = Vi_TYPE(key);
+
+		if (type == &ViRopeType)
+		{
+			if (ViString_AS_STRING(key) == NULL)
+				return -1;
+			type = &ViStringType;
+		}
+		if (type != key_type)
+		{
+			same_type = 0;
+			break;
+		}
+		all_tagged &= ViTaggedInt_Check(key);
+	}
+	if (!same_type)
+		return 0;
+
+	if (key_type == &ViIntType)
+		ms->key_compare = all_tagged ? unsafe_tagged_int_compare : unsafe_int_compare;
+	else if (key_type == &ViFloatType)
+		ms->key_compare = unsafe_float_compare;
+	else if (key_type == &ViStringType)
+		ms->key_compare = unsafe_string_compare;
+	else if (key_type->tp_richcompare != NULL)
+	{
+		ms->key_compare = unsafe_object_compare;
+		ms->key_richcompare = key_type->tp_richcompare;
+	}
+	return 0;
+}
+
+int ViList_Sort(ViObject *list, unaryfunc keyfunc, int reverse)
+{
+	ViListObject *self = (ViListObject *)list;
+	MergeState ms;
+	Vi_size_t nremaining;
+	Vi_size_t minrun;
+	sortslice lo;
+	Vi_size_t saved_ob_size, saved_allocated;
+	ViObject **saved_ob_items;
+	ViObject **final_ob_items;
+	int result = -1;
+	Vi_size_t i;
+	ViObject **keys;
+
+	if (list == NULL || !ViList_Check(list))
+	{
+		ViError_BadInternalCall();
+		return -1;
+	}
+
+	/* Take the items out of the list while sorting, the key function
+	   and the comparisons see an empty list and any change to it is
+	   noticed at the end */
+	saved_ob_size = Vi_SIZE(self);
+	saved_ob_items = self->ob_items;
+	saved_allocated = self->allocated;
+	VAROBJECT_SET_SIZE(self, 0);
+	self->ob_items = NULL;
+	self->allocated = -1;
+
+	if (keyfunc == NULL)
+	{
+		keys = NULL;
+		lo.keys = saved_ob_items;
+		lo.values = NULL;
+	}
+	else
+	{
+		/* Short lists keep their keys after the merge room in temparray */
+		if (saved_ob_size < MERGESTATE_TEMP_SIZE / 2)
+			keys = &ms.temparray[saved_ob_size + 1];
+		else
+		{
+			keys = (ViObject **)Mem_Alloc(sizeof(ViObject *) * saved_ob_size);
+			if (keys == NULL)
+			{
+				ViError_NoMemory();
+				goto keyfunc_fail;
+			}
+		}
+
+		for (i = 0; i < saved_ob_size; i++)
+		{
+			keys[i] = keyfunc(saved_ob_items[i]);
+			if (keys[i] == NULL)
+			{
+				for (i = i - 1; i >= 0; i--)
+					ViObject_DECREF(keys[i]);
+				if (saved_ob_size >= MERGESTATE_TEMP_SIZE / 2)
+					Mem_Free(keys);
+				goto keyfunc_fail;
+			}
+		}
+
+		lo.keys = keys;
+		lo.values = saved_ob_items;
+	}
+
+	merge_init(&ms, saved_ob_size, keys != NULL);
+	if (merge_pick_compare(&ms, lo.keys, saved_ob_size) < 0)
+		goto fail;
+
+	nremaining = saved_ob_size;
+	if (nremaining < 2)
+		goto succeed;
+
+	/* Reverse the items so sorting them and reversing them again keeps
+	   equal items in their order */
+	if (reverse)
+	{
+		if (keys != NULL)
+			reverse_slice(&keys[0], &keys[saved_ob_size]);
+		reverse_slice(&saved_ob_items[0], &saved_ob_items[saved_ob_size]);
+	}
+
+	/* March over the items once, left to right, finding natural runs and
+	   extending short ones to minrun items */
+	minrun = merge_compute_minrun(nremaining);
+	do
+	{
+		int descending;
+		Vi_size_t n;
+
+		/* Identify the next run */
+		n = count_run(&ms, lo.keys, lo.keys + nremaining, &descending);
+		if (n < 0)
+			goto fail;
+		if (descending)
+			reverse_sortslice(&lo, n);
+		/* If it is short, extend it to min(minrun, nremaining) */
+		if (n < minrun)
+		{
+			const Vi_size_t force = nremaining <= minrun ? nremaining : minrun;
+			if (binarysort(&ms, lo, lo.keys + force, lo.keys + n) < 0)
+				goto fail;
+			n = force;
+		}
+		/* Push the run onto the pending stack and maybe merge */
+		assert(ms.n < MAX_MERGE_PENDING);
+		ms.pending[ms.n].base = lo;
+		ms.pending[ms.n].len = n;
+		++ms.n;
+		if (merge_collapse(&ms) < 0)
+			goto fail;
+		/* Advance to find the next run */
+		sortslice_advance(&lo, n);
+		nremaining -= n;
+	} while (nremaining);
+
+	if (merge_force_collapse(&ms) < 0)
+		goto fail;
+	assert(ms.n == 1);
+	assert(keys == NULL ? ms.pending[0].base.keys == saved_ob_items : ms.pending[0].base.keys == &keys[0]);
+	assert(ms.pending[0].len == saved_ob_size);
+
+succeed:
+	result = 0;
+
+fail:
+	if (keys != NULL)
+	{
+		for (i = 0; i < saved_ob_size; i++)
+			ViObject_DECREF(keys[i]);
+		if (saved_ob_size >= MERGESTATE_TEMP_SIZE / 2)
+			Mem_Free(keys);
+	}
+
+	if (self->allocated != -1 && result >= 0)
+	{
+		/* The list was modified while it was sorted */
+		ViError_SetString(ViExc_ValueError, "list modified during sort");
+		result = -1;
+	}
+
+	if (reverse && saved_ob_size > 1)
+		reverse_slice(saved_ob_items, saved_ob_items + saved_ob_size);
+
+	merge_freemem(&ms);
+
+keyfunc_fail:
+	/* Put the sorted items back and drop whatever was added meanwhile */
+	final_ob_items = self->ob_items;
+	i = Vi_SIZE(self);
+	VAROBJECT_SET_SIZE(self, saved_ob_size);
+	self->ob_items = saved_ob_items;
+	self->allocated = saved_allocated;
+	if (final_ob_items != NULL)
+	{
+		while (--i >= 0)
+			ViObject_XDECREF(final_ob_items[i]);
+		ViObject_Free(final_ob_items);
+	}
+	return result;
+}
+#undef IFLT
+#undef ISLT
+
+int ViList_ClearFreeList()
+{
+	int freed = numfree;
+	while (numfree)
+	{
+		ViListObject *obj = free_list[--numfree];
+		assert(ViList_CheckExact(obj));
+		ViObject_GC_Del(obj);
+	}
+	return freed;
+}
+
+void ViList_GetFreeListStats(ViFreeListStats *stats)
+{
+	stats->hits = free_list_hits;
+	stats->misses = free_list_misses;
+	stats->size = numfree;
+}
@@ -35,6 +35,17 @@ ViObject* ViListObject_New(Vi_size_t size);
 int ViList_Append(ViObject* list, ViObject* new_item);
 int ViList_SetItem(ViObject *list, Vi_size_t i, ViObject *newitem);
 
+/* Sort the list in place, stable, equal items keep their order even when
+   reverse sorts it in descending order.  With keyfunc the items are
+   ordered by keyfunc(item), called once per item, which returns a new
+   reference or NULL on error.  Returns 0 on success, -1 with an error set.
+   Changing the list while it is sorted is a ValueError. */
+int ViList_Sort(ViObject *list, unaryfunc keyfunc, int reverse);
+
+/* Free list functions */
+int ViList_ClearFreeList();
+void ViList_GetFreeListStats(ViFreeListStats *stats);
+
 #define ViList_CAST(obj) (assert(ViList_Check(obj)), ((ViListObject*)obj))
 
 #define ViList_GET_ITEM(obj, i)     (ViList_CAST(obj)->ob_items[i])
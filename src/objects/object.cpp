@@ -1,6 +1,18 @@
 #include "object.h"
 
+#include <cstdio>
+
 #include "../core/error.h"
+#include "../core/vigc.h"
+#include "../core/vihash.h"
+
+#include "boolobject.h"
+#include "complexobject.h"
+#include "dictobject.h"
+#include "floatobject.h"
+#include "intobject.h"
+#include "listobject.h"
+#include "tupleobject.h"
 
 static int type_is_subtype_chain(ViTypeObject* a, ViTypeObject* b)
 {
@@ -27,11 +39,15 @@ ViTypeObject ViBaseType = {
 	0,										// tp_dealloc
 	0,										// tp_number_methods
 	0,										// tp_sequence_methods
+	0,										// tp_hash
+	0,										// tp_traverse
 	0,										// tp_clear
+	0,										// tp_richcompare
 	0,										// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
 };
 
 ViTypeObject ViBaseObjectType = {
@@ -44,11 +60,15 @@ ViTypeObject ViBaseObjectType = {
 	(destructor)object_dealloc,				// tp_dealloc
 	0,										// tp_number_methods
 	0,										// tp_sequence_methods
+	0,										// tp_hash
+	0,										// tp_traverse
 	0,										// tp_clear
+	0,										// tp_richcompare
 	0,										// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
 };
 
 ViTypeObject ViNullType = {
@@ -61,15 +81,44 @@ ViTypeObject ViNullType = {
 	0,										// tp_dealloc
 	0,										// tp_number_methods
 	0,										// tp_sequence_methods
+	0,										// tp_hash
+	0,										// tp_traverse
 	0,										// tp_clear
+	0,										// tp_richcompare
 	0,										// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
 };
 
 ViObject ViNullStruct = {
-	1, &ViNullType
+	Vi_IMMORTAL_REFCNT, &ViNullType
+};
+
+ViTypeObject ViNotImplementedType = {
+	VAROBJECT_HEAD_INIT(&ViBaseType, 0)		// base
+	"NotImplementedType",					// tp_name
+	0,										// tp_doc
+	0,										// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT,						// tp_flags
+	0,										// tp_dealloc
+	0,										// tp_number_methods
+	0,										// tp_sequence_methods
+	0,										// tp_hash
+	0,										// tp_traverse
+	0,										// tp_clear
+	0,										// tp_richcompare
+	0,										// tp_base
+	0,										// tp_dict
+	0,										// tp_new
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
+};
+
+ViObject ViNotImplementedStruct = {
+	Vi_IMMORTAL_REFCNT, &ViNotImplementedType
 };
 
 int ViType_IsSubtype(ViTypeObject* a, ViTypeObject* b)
@@ -119,9 +168,28 @@ int ViType_Ready(ViTypeObject *type)
 	// Initialize ob_type if NULL
 	if (Vi_IS_TYPE(type, NULL) && base != NULL)
 		ViObject_SET_TYPE(type, Vi_TYPE(base));
+
+	// Inherit hashing and comparison together, they must agree
+	if (base != NULL && type->tp_hash == NULL && type->tp_richcompare == NULL)
+	{
+		type->tp_hash = base->tp_hash;
+		type->tp_richcompare = base->tp_richcompare;
+	}
+
+	// Initialize tp_dict
+	if (type->tp_dict == NULL)
+	{
+		type->tp_dict = ViDictObject_New();
+		if (type->tp_dict == NULL)
+			goto error;
+	}
+
+	type->tp_flags = (type->tp_flags & ~TPFLAGS_READYING) | TPFLAGS_READY;
+	return 0;
+
 error:
 	type->tp_flags &= ~TPFLAGS_READYING;
-	return 0;
+	return -1;
 }
 
 void ObjectNewRef(ViObject* obj)
@@ -135,21 +203,258 @@ void ObjectDealloc(ViObject *obj)
 	(*dealloc)(obj);
 }
 
-ViObject *Object_NewRef(ViObject *obj)
+Vi_hash_t ViObject_Hash(ViObject *obj)
 {
-	ViObject_INCREF(obj);
-	return obj;
+	ViTypeObject *type = Vi_TYPE(obj);
+
+	if (type->tp_hash != NULL)
+		return type->tp_hash(obj);
+	if (type->tp_richcompare == NULL)
+		return ViHash_Pointer(obj);
+	return ViObject_HashNotImplemented(obj);
 }
 
-ViObject *Object_XNewRef(ViObject *obj)
+Vi_hash_t ViObject_HashNotImplemented(ViObject *obj)
 {
-	ViObject_XINCREF(obj);
-	return obj;
+	char msg[128];
+	snprintf(msg, sizeof(msg), "unhashable type: '%.80s'", Vi_TYPE(obj)->tp_name);
+	ViError_SetString(ViExc_TypeError, msg);
+	return -1;
+}
+
+/* Operator with the operands swapped, a < b is b > a */
+static const int swapped_op[] = { Vi_GT, Vi_GE, Vi_EQ, Vi_NE, Vi_LT, Vi_LE };
+static const char *const opstrings[] = { "<", "<=", "==", "!=", ">", ">=" };
+
+ViObject *ViObject_RichCompare(ViObject *a, ViObject *b, int op)
+{
+	ViTypeObject *ta = Vi_TYPE(a), *tb = Vi_TYPE(b);
+	ViObject *res;
+	int checked_reverse = 0;
+
+	assert(Vi_LT <= op && op <= Vi_GE);
+
+	/* A subtype of the left operand gets the first go */
+	if (ta != tb && ViType_IsSubtype(tb, ta) && tb->tp_richcompare != NULL)
+	{
+		checked_reverse = 1;
+		res = tb->tp_richcompare(b, a, swapped_op[op]);
+		if (res != Vi_NotImplemented)
+			return res;
+		ViObject_DECREF(res);
+	}
+	if (ta->tp_richcompare != NULL)
+	{
+		res = ta->tp_richcompare(a, b, op);
+		if (res != Vi_NotImplemented)
+			return res;
+		ViObject_DECREF(res);
+	}
+	if (!checked_reverse && tb->tp_richcompare != NULL)
+	{
+		res = tb->tp_richcompare(b, a, swapped_op[op]);
+		if (res != Vi_NotImplemented)
+			return res;
+		ViObject_DECREF(res);
+	}
+
+	/* Neither operand knows the other, fall back to identity */
+	switch (op)
+	{
+	case Vi_EQ:
+		return ViBool_FromLong(a == b);
+	case Vi_NE:
+		return ViBool_FromLong(a != b);
+	default:
+	{
+		char msg[256];
+		snprintf(msg, sizeof(msg), "'%s' not supported between instances of '%.80s' and '%.80s'",
+			opstrings[op], ta->tp_name, tb->tp_name);
+		ViError_SetString(ViExc_TypeError, msg);
+		return NULL;
+	}
+	}
+}
+
+int ViObject_RichCompareBool(ViObject *a, ViObject *b, int op)
+{
+	ViObject *res;
+	int ok;
+
+	/* Identity implies equality, even for NaN */
+	if (a == b)
+	{
+		if (op == Vi_EQ)
+			return 1;
+		if (op == Vi_NE)
+			return 0;
+	}
+
+	res = ViObject_RichCompare(a, b, op);
+	if (res == NULL)
+		return -1;
+	if (res == Vi_True)
+		ok = 1;
+	else if (res == Vi_False)
+		ok = 0;
+	else
+	{
+		/* Truth value of another result, objects are true by default */
+		ViNumberMethods *nb = Vi_TYPE(res)->tp_number_methods;
+		ok = nb != NULL && nb->nb_bool != NULL ? nb->nb_bool(res) : 1;
+	}
+	ViObject_DECREF(res);
+	return ok;
+}
+
+/* GC types get their memory with a GC head in front */
+static inline void* object_alloc(ViTypeObject* type, size_t size)
+{
+	if (ViType_IS_GC(type))
+		return ViObject_GC_Malloc(size);
+	return ViObject_Malloc(size);
+}
+
+static void* object_malloc(ViTypeObject* type, size_t size)
+{
+	void* mem = object_alloc(type, size);
+	if (mem == NULL)
+	{
+		/* Give the memory parked on the free lists back and retry */
+		if (ViObject_ClearFreeLists() > 0)
+			mem = object_alloc(type, size);
+		if (mem == NULL)
+			ViError_NoMemory();
+	}
+	return mem;
 }
 
 ViObject* Object_New(ViTypeObject* type)
 {
-	ViObject* obj = (ViObject*)Mem_Alloc(type->tp_size);
+	ViTraceMalloc_SET_SITE(type->tp_name, 0);
+	ViObject* obj = (ViObject*)object_malloc(type, type->tp_size);
+	if (obj == NULL)
+		return NULL;
 	ObjectInit(obj, type);
 	return obj;
 }
+
+ViVarObject* Object_NewVar(ViTypeObject* type, Vi_size_t nitems)
+{
+	if (nitems < 0 ||
+		(type->tp_itemsize != 0 &&
+		 (size_t)nitems > ((size_t)VI_SIZE_T_MAX - type->tp_size) / type->tp_itemsize))
+	{
+		ViError_NoMemory();
+		return NULL;
+	}
+
+	ViTraceMalloc_SET_SITE(type->tp_name, 0);
+	ViVarObject* obj = (ViVarObject*)object_malloc(type, ViObject_VAR_SIZE(type, nitems));
+	if (obj == NULL)
+		return NULL;
+	ObjectInit((ViObject*)obj, type);
+	VAROBJECT_SET_SIZE(obj, nitems);
+	return obj;
+}
+
+/* Trashcan state, not thread safe like the rest of the object layer */
+static int trash_delete_nesting = 0;
+static ViObject *trash_delete_later = NULL;
+static Vi_size_t trash_pending = 0;
+static Vi_size_t trash_budget = 0;
+
+/* The queue is linked through gc_prev of the (untracked) GC head */
+#define TRASH_NEXT(obj) (ViGC_AS_GC(obj)->gc.gc_prev)
+
+static void trash_deposit(ViObject *obj)
+{
+	assert(ViObject_IS_GC(obj));
+	assert(!ViObject_GC_IS_TRACKED(obj));
+	assert(obj->ob_refcount == 0);
+	TRASH_NEXT(obj) = (ViGC_Head *)trash_delete_later;
+	trash_delete_later = obj;
+	trash_pending++;
+}
+
+/* Destroy up to limit queued objects (all of them if limit is 0),
+   including what they queue themselves while being destroyed */
+static void trash_destroy_chain(Vi_size_t limit)
+{
+	Vi_size_t destroyed = 0;
+
+	while (trash_delete_later != NULL && (limit == 0 || destroyed < limit))
+	{
+		ViObject *obj = trash_delete_later;
+		destructor dealloc = Vi_TYPE(obj)->tp_dealloc;
+
+		trash_delete_later = (ViObject *)TRASH_NEXT(obj);
+		trash_pending--;
+
+		/* The nesting level is raised so the objects freed by this
+		   deallocation can queue themselves again instead of recursing */
+		assert(obj->ob_refcount == 0);
+		++trash_delete_nesting;
+		(*dealloc)(obj);
+		--trash_delete_nesting;
+		destroyed++;
+	}
+}
+
+int ViTrash_Begin(ViObject *obj)
+{
+	if (trash_delete_nesting >= ViTrash_UNWIND_LEVEL)
+	{
+		/* Too deep, destroy the object later */
+		trash_deposit(obj);
+		return 1;
+	}
+	++trash_delete_nesting;
+	return 0;
+}
+
+void ViTrash_End()
+{
+	--trash_delete_nesting;
+	if (trash_delete_later != NULL && trash_delete_nesting <= 0)
+		trash_destroy_chain(trash_budget);
+}
+
+void ViTrash_SetBudget(Vi_size_t budget)
+{
+	trash_budget = budget < 0 ? 0 : budget;
+}
+
+Vi_size_t ViTrash_GetBudget()
+{
+	return trash_budget;
+}
+
+Vi_size_t ViTrash_Pending()
+{
+	return trash_pending;
+}
+
+void ViTrash_Checkpoint()
+{
+	if (trash_delete_nesting == 0)
+		trash_destroy_chain(trash_budget);
+}
+
+void ViTrash_Flush()
+{
+	if (trash_delete_nesting == 0)
+		trash_destroy_chain(0);
+}
+
+int ViObject_ClearFreeLists()
+{
+	int freed = 0;
+	freed += ViInt_ClearFreeList();
+	freed += ViFloat_ClearFreeList();
+	freed += ViComplex_ClearFreeList();
+	freed += ViTuple_ClearFreeList();
+	freed += ViList_ClearFreeList();
+	freed += ViDict_ClearFreeList();
+	return freed;
+}
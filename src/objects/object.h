@@ -15,12 +15,27 @@ typedef struct _viidentifier
 #define Vi_IDENTIFIER(varname) Vi_STATIC_STRING(ViId_##varname, #varname)
 
 struct _typeobject;
+struct _dictkeysobject;
 
 /* ViObject_HEAD defines the initial segment of every ViObject. */
 #define ViObject_HEAD ViObject ob_base;
 
+/*
+ * Immortal objects
+ *
+ * Objects that live for the whole process (static types, singletons,
+ * interned strings, cached small ints) carry a reference count with
+ * Vi_IMMORTAL_BIT set.  INCREF and DECREF leave such objects untouched,
+ * so they are never written to, never deallocated, and their cache
+ * lines can be shared between threads.  The bit sits below the sign bit
+ * so that an immortal count stays positive and far away from zero.
+*/
+#define Vi_IMMORTAL_BIT ((intptr_t)1 << (8 * sizeof(intptr_t) - 2))
+#define Vi_IMMORTAL_REFCNT Vi_IMMORTAL_BIT
+
+/* Statically allocated objects are immortal */
 #define ViObject_HEAD_INIT(type) \
-	{1, type},
+	{Vi_IMMORTAL_REFCNT, type},
 
 #define VAROBJECT_HEAD_INIT(type, size) \
 	{ViObject_HEAD_INIT(type) size},
@@ -178,16 +193,62 @@ typedef struct _typeobject
     ViNumberMethods* tp_number_methods;
     ViSequenceMethods* tp_sequence_methods;
 
+    hashfunc tp_hash; // NULL for types that compare by identity
+
+    traverseproc tp_traverse; // Call a function on every contained object (GC)
     inquiry tp_clear; // Delete references to contained objects
 
+    richcmpfunc tp_richcompare; // Comparison operators, see Vi_LT etc.
+
     // Strong reference on a heap type, borrowed reference on a static type
     struct _typeobject *tp_base;
     ViObject *tp_dict;
     newfunc tp_new;
 	freefunc tp_free; // Low-level free memory routine
+
+    // Keys shared by the attribute dicts of the instances, see dictobject.h
+    struct _dictkeysobject *tp_cached_keys;
 } ViTypeObject;
 
-#define Vi_TYPE(ob)             (ViObject_CAST(ob)->ob_type)
+/*
+ * Tagged integers
+ *
+ * A ViObject* with the low bit set does not point to an object, it holds
+ * a small int directly in its upper bits.  Real objects are at least
+ * pointer aligned so their low bit is always clear.  Tagged ints are of
+ * type int, they have no memory and are never deallocated: Vi_TYPE()
+ * answers ViIntType for them and INCREF / DECREF treat them as immortal.
+ * Code that dereferences an object must make sure it is not tagged.
+*/
+#define Vi_TAGGED_INT_BIT ((uintptr_t)1)
+
+#define ViTaggedInt_MIN (INTPTR_MIN >> 1)
+#define ViTaggedInt_MAX (INTPTR_MAX >> 1)
+
+extern ViTypeObject ViIntType; // Type of the tagged ints, see intobject.h
+
+static inline int ObjectIsTaggedInt(const ViObject* obj)
+{
+	return ((uintptr_t)obj & Vi_TAGGED_INT_BIT) != 0;
+}
+#define ViTaggedInt_Check(obj) ObjectIsTaggedInt(ViObject_CAST_CONST(obj))
+
+/* Test if a value fits in a tagged int */
+#define ViTaggedInt_FITS(ival) \
+	((ival) >= ViTaggedInt_MIN && (ival) <= ViTaggedInt_MAX)
+
+/* Make a tagged int from a value that fits, and get the value back */
+#define ViTaggedInt_FROM(ival) \
+	((ViObject*)(((uintptr_t)(Vi_intptr_t)(ival) << 1) | Vi_TAGGED_INT_BIT))
+#define ViTaggedInt_VALUE(obj) ((Vi_intptr_t)(obj) >> 1)
+
+static inline ViTypeObject* ObjectType(const ViObject* obj)
+{
+	if (ObjectIsTaggedInt(obj))
+		return &ViIntType;
+	return obj->ob_type;
+}
+#define Vi_TYPE(ob)             ObjectType(ViObject_CAST_CONST(ob))
 
 #define Vi_SIZE(ob)             (ViVarObject_CAST(ob)->ob_size)
 
@@ -232,14 +293,33 @@ static inline void ObjectInit(ViObject* obj, ViTypeObject* type)
  *
  * Objects keep track of the amount of references to them they have.
  * If an objects reference count reaches 0, it is free'd from memory.
+ * Immortal objects are skipped.
 */
 
 void ObjectDealloc(ViObject *obj);
 #define ViObject_DEALLOC(obj) ObjectDealloc(obj)
 
+/* Check if an object is immortal, tagged ints count as immortal */
+static inline int ObjectIsImmortal(const ViObject* obj)
+{
+	if (ObjectIsTaggedInt(obj))
+		return 1;
+	return (obj->ob_refcount & Vi_IMMORTAL_BIT) != 0;
+}
+#define ViObject_IS_IMMORTAL(obj) ObjectIsImmortal(ViObject_CAST_CONST(obj))
+
+/* Make an object immortal, it will never be deallocated */
+static inline void ObjectSetImmortal(ViObject* obj)
+{
+	obj->ob_refcount = Vi_IMMORTAL_REFCNT;
+}
+#define ViObject_SET_IMMORTAL(obj) ObjectSetImmortal(ViObject_CAST(obj))
+
 /* Increase object reference count */
 static inline void ObjectIncRef(ViObject* obj)
 {
+	if (ObjectIsImmortal(obj))
+		return;
 	obj->ob_refcount++;
 }
 #define ViObject_INCREF(obj) ObjectIncRef(ViObject_CAST(obj))
@@ -247,10 +327,10 @@ static inline void ObjectIncRef(ViObject* obj)
 /* Decrease object reference count */
 static inline void ObjectDecRef(ViObject* obj)
 {
-	obj->ob_refcount--;
-	if (obj->ob_refcount == 0)
-		// TODO: Change to dealloc
-		obj->ob_type->tp_free(obj);
+	if (ObjectIsImmortal(obj))
+		return;
+	if (--obj->ob_refcount == 0)
+		ObjectDealloc(obj);
 }
 #define ViObject_DECREF(obj) ObjectDecRef(ViObject_CAST(obj))
 
@@ -272,17 +352,148 @@ static inline void ObjectXDecRef(ViObject* obj)
 
 // Create a new strong reference to an object:
 // increment the reference count of the object and return the object.
-static ViObject *Object_NewRef(ViObject *obj);
+static inline ViObject *Object_NewRef(ViObject *obj)
+{
+	ObjectIncRef(obj);
+	return obj;
+}
 #define ViObject_NEWREF(obj) Object_NewRef(ViObject_CAST(obj));
 
 // Similar to Py_NewRef(), but the object can be NULL.
-static ViObject *Object_XNewRef(ViObject *obj);
+static inline ViObject *Object_XNewRef(ViObject *obj)
+{
+	ObjectXIncRef(obj);
+	return obj;
+}
 #define ViObject_XNEWREF(obj) Object_XNewRef(ViObject_CAST(obj));
 
 /* Create a new object */
 ViObject* Object_New(ViTypeObject* type);
 #define ViObject_NEW(type, typedef) (type *)Object_New(typedef)
 
+/* Bytes needed for a variable-size object of the type holding nitems
+   items, rounded up to pointer alignment */
+#define ViObject_VAR_SIZE(typeobj, nitems) \
+    Vi_SIZE_ROUND_UP((typeobj)->tp_size + (size_t)(nitems) * (typeobj)->tp_itemsize, sizeof(void*))
+
+/* Create a new variable-size object, its items are stored inline after
+   the header and ob_size is set to nitems */
+ViVarObject* Object_NewVar(ViTypeObject* type, Vi_size_t nitems);
+#define ViObject_NEWVAR(type, typedef, nitems) (type *)Object_NewVar(typedef, nitems)
+
+/*
+ * Hashing and comparison
+ *
+ * Objects that compare equal must hash equal.  A type without tp_hash
+ * and tp_richcompare hashes and compares by identity, mutable types
+ * that compare by value use ViObject_HashNotImplemented as tp_hash.
+ *
+ * tp_richcompare returns a new reference to the result of the operator,
+ * Vi_NotImplemented if it does not know the other operand or NULL on
+ * error.  ViObject_RichCompare then tries the reflected operator of the
+ * other operand and compares by identity for == and != as a last resort.
+*/
+
+/* Rich comparison opcodes */
+#define Vi_LT 0
+#define Vi_LE 1
+#define Vi_EQ 2
+#define Vi_NE 3
+#define Vi_GT 4
+#define Vi_GE 5
+
+/* Hash of an object, -1 with a TypeError set if it is unhashable */
+Vi_hash_t ViObject_Hash(ViObject *obj);
+
+/* tp_hash of unhashable types, always fails */
+Vi_hash_t ViObject_HashNotImplemented(ViObject *obj);
+
+/* Apply a comparison operator, returns a new reference or NULL on error */
+ViObject *ViObject_RichCompare(ViObject *a, ViObject *b, int op);
+
+/* Same as ViObject_RichCompare but returns 1 for a true result, 0 for a
+   false one and -1 on error.  Identical objects are equal. */
+int ViObject_RichCompareBool(ViObject *a, ViObject *b, int op);
+
+/* Return the result of comparing two C values in a tp_richcompare,
+   needs boolobject.h */
+#define Vi_RETURN_RICHCOMPARE(val1, val2, op)							\
+	do {																\
+		switch (op)														\
+		{																\
+		case Vi_EQ: if ((val1) == (val2)) Vi_RETURN_TRUE; Vi_RETURN_FALSE;	\
+		case Vi_NE: if ((val1) != (val2)) Vi_RETURN_TRUE; Vi_RETURN_FALSE;	\
+		case Vi_LT: if ((val1) < (val2)) Vi_RETURN_TRUE; Vi_RETURN_FALSE;	\
+		case Vi_GT: if ((val1) > (val2)) Vi_RETURN_TRUE; Vi_RETURN_FALSE;	\
+		case Vi_LE: if ((val1) <= (val2)) Vi_RETURN_TRUE; Vi_RETURN_FALSE;	\
+		case Vi_GE: if ((val1) >= (val2)) Vi_RETURN_TRUE; Vi_RETURN_FALSE;	\
+		default: return NULL;											\
+		}																\
+	} while (0)
+
+/*
+ * Free lists
+ *
+ * Frequently created types keep a bounded number of dead instances
+ * around and hand them out again instead of going back to the allocator.
+*/
+
+typedef struct _freeliststats
+{
+	size_t hits;	// Allocations served from the free list
+	size_t misses;	// Allocations that had to go to the allocator
+	size_t size;	// Objects currently kept on the free list
+} ViFreeListStats;
+
+/* Release the memory held by all free lists (e.g. on memory pressure),
+   returns the number of objects freed */
+int ViObject_ClearFreeLists();
+
+/*
+ * Trashcan mechanism
+ *
+ * Deallocating a deeply nested container recurses through tp_dealloc
+ * once per level and can overflow the C stack.  Container deallocators
+ * wrap their body in ViTrash_BEGIN / ViTrash_END.  Past
+ * ViTrash_UNWIND_LEVEL nested deallocations the object is queued instead
+ * and destroyed iteratively once the outermost deallocation is done.
+ *
+ * With a budget set, at most that many queued objects are destroyed in
+ * one go, the rest waits for the next ViTrash_Checkpoint() so freeing a
+ * huge structure is spread over several check points.
+ *
+ * Only GC objects can be queued, the queue is linked through their GC
+ * head, so they must be untracked before ViTrash_BEGIN.  Code between
+ * the two macros must not return, jump to a label before ViTrash_END.
+*/
+
+#define ViTrash_UNWIND_LEVEL 50
+
+int ViTrash_Begin(ViObject *obj);
+void ViTrash_End();
+
+#define ViTrash_BEGIN(obj)							\
+	do {											\
+		if (ViTrash_Begin(ViObject_CAST(obj)))		\
+			break;
+
+#define ViTrash_END									\
+		ViTrash_End();								\
+	} while (0);
+
+/* Objects destroyed per flush of the queue, 0 means no limit */
+void ViTrash_SetBudget(Vi_size_t budget);
+Vi_size_t ViTrash_GetBudget();
+
+/* Number of objects waiting to be destroyed */
+Vi_size_t ViTrash_Pending();
+
+/* Destroy queued objects within the budget, call between units of work */
+void ViTrash_Checkpoint();
+
+/* Destroy all queued objects regardless of the budget */
+void ViTrash_Flush();
+
 #define ViObject_CLEAR(obj)                     \
     do {                                        \
         ViObject *vi_tmp = ViObject_CAST(obj);  \
@@ -336,6 +547,17 @@ extern ViObject ViNullStruct; // Do not use directly
 /* Macro for returning Vi_Null from a function */
 #define Vi_RETURN_NULL return ViObject_NEWREF(VI_Null)
 
+/*
+ Vi_NotImplemented is returned by binary operations and comparisons that
+ do not support the type of the other operand, so the other operand can
+ have a go.
+ */
+extern ViObject ViNotImplementedStruct; // Do not use directly
+#define Vi_NotImplemented (&ViNotImplementedStruct)
+
+/* Macro for returning Vi_NotImplemented from a function */
+#define Vi_RETURN_NOTIMPLEMENTED return ViObject_NEWREF(Vi_NotImplemented)
+
 /*
  *	Type object flags
 */
@@ -1,32 +1,176 @@
 #include "stringobject.h"
 
+#include <climits>
+
 #include "../core/error.h"
+#include "../core/vifastsearch.h"
+#include "../core/vihash.h"
+#include "../core/viutf8.h"
 
+#include "boolobject.h"
 #include "intobject.h"
+#include "listobject.h"
+
+/* The empty string and the one-byte ASCII strings are shared, immortal
+   singletons created on first use. */
+static ViStringObject *empty_string = NULL;
+static ViStringObject *characters[0x80];
+
+/* The intern table is an open addressing hash set of strings, looked up
+   by contents so a string is only created for contents not interned yet.
+   It is never shrunk, interned strings are immortal. */
+#define INTERNED_MINSIZE 256
+
+static ViStringObject **interned = NULL;
+static Vi_size_t interned_size = 0;		// Number of slots, a power of 2
+static Vi_size_t interned_used = 0;
+
+/* Strings of the Vi_IDENTIFIER statics, by the index of the identifier */
+static ViObject **identifiers = NULL;
+static Vi_size_t identifiers_used = 0;
+static Vi_size_t identifiers_allocated = 0;
 
 static inline int valid_index(Vi_size_t i, Vi_size_t limit)
 {
 	return (size_t)i < (size_t)limit;
 }
 
-static int get_char_value(ViObject* obj, int* value)
+static ViStringObject *string_alloc(const char *bytes, Vi_size_t size)
 {
+	ViStringObject *obj = ViObject_NEWVAR(ViStringObject, &ViStringType, size);
+	if (obj == NULL)
+		return NULL;
+	obj->ob_shash = -1;
+	obj->ob_slength = -1;
+	obj->ob_sstate = SSTATE_NOT_INTERNED;
+	obj->ob_sropes = 0;
+	obj->ob_sindex = NULL;
+	if (bytes != NULL && size > 0)
+		memcpy(obj->ob_svar, bytes, size);
+	obj->ob_svar[size] = '\0'; // Trailing NULL byte (end of string)
+	return obj;
+}
+
+/* Record the number of code points, strings and ropes share the fields */
+static inline void string_set_info(ViStringObject *s, Vi_size_t length, int is_ascii)
+{
+	s->ob_slength = length;
+	if (is_ascii)
+		s->ob_sstate |= SSTATE_ASCII;
+	else
+		s->ob_sstate &= ~SSTATE_ASCII;
+}
+
+/* Info of the string made of a followed by b, if both are known */
+static inline void string_join_info(ViStringObject *result, ViStringObject *a, ViStringObject *b)
+{
+	if (a->ob_slength >= 0 && b->ob_slength >= 0)
+		string_set_info(result, a->ob_slength + b->ob_slength, a->ob_sstate & b->ob_sstate & SSTATE_ASCII);
+}
+
+static ViObject *get_empty_string()
+{
+	if (empty_string == NULL)
+	{
+		empty_string = string_alloc(NULL, 0);
+		if (empty_string == NULL)
+			return NULL;
+		string_set_info(empty_string, 0, 1);
+		ViObject_SET_IMMORTAL(empty_string);
+	}
+	return (ViObject *)empty_string;
+}
+
+static ViObject *get_character(unsigned char c)
+{
+	ViStringObject *obj = characters[c];
+	assert(c < 0x80);
+	if (obj == NULL)
+	{
+		obj = string_alloc((const char *)&c, 1);
+		if (obj == NULL)
+			return NULL;
+		string_set_info(obj, 1, 1);
+		ViObject_SET_IMMORTAL(obj);
+		characters[c] = obj;
+	}
+	return (ViObject *)obj;
+}
+
+/* Encode the code point obj to encoded, which has room for 4 bytes.
+   Returns the number of bytes, 0 with an error set. */
+static int get_char_value(ViObject* obj, char* encoded)
+{
+	int size;
+
 	if (!ViInt_Check(obj))
 	{
 		ViError_SetString(ViExc_TypeError, "object must be an integer type");
-		*value = -1;
 		return 0;
 	}
 
-	int v = ((ViIntObject*)obj)->ob_ival;
-	if (v < 0 || v >= 256)
+	Vi_int64_t v = ViInt_AsInt64(obj);
+	if (v == -1 && ViError_Occurred())
+		return 0;
+	size = v < 0 || v > ViUtf8_MAX_CODE_POINT ? 0 : ViUtf8_Encode((Vi_uint32_t)v, encoded);
+	if (size == 0)
+		ViError_SetString(ViExc_ValueError, "char must be a unicode code point");
+	return size;
+}
+
+//
+//
+//		Interning
+//
+//
+
+/* Slot of the interned string with the contents, or of the empty slot
+   where it belongs */
+static Vi_size_t interned_find(const char *bytes, Vi_size_t size, Vi_hash_t hash)
+{
+	size_t mask = (size_t)interned_size - 1;
+	size_t perturb = (size_t)hash;
+	size_t i = (size_t)hash & mask;
+
+	for (;;)
 	{
-		ViError_SetString(ViExc_ValueError, "char must be in range (0, 256)");
-		*value = -1;
+		ViStringObject *s = interned[i];
+		if (s == NULL)
+			return i;
+		if (s->ob_shash == hash && Vi_SIZE(s) == size && memcmp(s->ob_svar, bytes, size) == 0)
+			return i;
+		perturb >>= 5;
+		i = (i * 5 + perturb + 1) & mask;
+	}
+}
+
+/* Make room for one more string, keeping the table at most 2/3 full */
+static int interned_reserve()
+{
+	ViStringObject **oldtable = interned;
+	Vi_size_t oldsize = interned_size;
+	Vi_size_t newsize;
+
+	if ((interned_used + 1) * 3 <= interned_size * 2)
 		return 0;
+
+	newsize = oldsize ? oldsize * 2 : INTERNED_MINSIZE;
+	interned = (ViStringObject **)Mem_Calloc(newsize, sizeof(ViStringObject *));
+	if (interned == NULL)
+	{
+		interned = oldtable;
+		ViError_NoMemory();
+		return -1;
 	}
-	*value = v;
-	return 1;
+	interned_size = newsize;
+	for (Vi_size_t i = 0; i < oldsize; i++)
+	{
+		ViStringObject *s = oldtable[i];
+		if (s != NULL)
+			interned[interned_find(s->ob_svar, Vi_SIZE(s), s->ob_shash)] = s;
+	}
+	Mem_Free(oldtable);
+	return 0;
 }
 
 //
@@ -37,20 +181,84 @@ static int get_char_value(ViObject* obj, int* value)
 
 static void string_dealloc(ViStringObject *self)
 {
-	if (self->ob_svar != 0)
-		Mem_Free(self->ob_svar);
+	Mem_Free(self->ob_sindex);
 	Vi_TYPE(self)->tp_free((ViObject *)self);
 }
 
-static Vi_size_t string_length(ViStringObject* string)
+/* The flat string holding the bytes of op, with its length computed.
+   NULL on error. */
+static ViStringObject *string_flat(ViObject *op)
+{
+	ViStringObject *s = (ViStringObject *)op;
+	Vi_size_t length;
+	int is_ascii;
+
+	if (ViRope_CheckExact(op))
+	{
+		if (ViRope_AsString(op) == NULL)
+			return NULL;
+		s = ((ViRopeObject *)op)->flat;
+	}
+	if (s->ob_slength < 0)
+	{
+		length = ViUtf8_Check(s->ob_svar, Vi_SIZE(s), &is_ascii);
+		if (length < 0)
+		{
+			ViError_SetString(ViExc_UnicodeError, "string is not valid utf-8");
+			return NULL;
+		}
+		string_set_info(s, length, is_ascii);
+	}
+	return s;
+}
+
+/* Offsets of every ViString_INDEX_STEP-th code point, in one pass */
+static int string_build_index(ViStringObject *s)
+{
+	Vi_size_t n = (s->ob_slength + ViString_INDEX_STEP - 1) / ViString_INDEX_STEP;
+	Vi_size_t offset = 0;
+	Vi_size_t *index;
+
+	index = (Vi_size_t *)Mem_Alloc(n * sizeof(Vi_size_t));
+	if (index == NULL)
+	{
+		ViError_NoMemory();
+		return -1;
+	}
+	for (Vi_size_t k = 0; k < n; k++)
+	{
+		index[k] = offset;
+		if (k + 1 == n)
+			break;
+		for (int j = 0; j < ViString_INDEX_STEP; j++)
+			offset += ViUtf8_SequenceLength((unsigned char)s->ob_svar[offset]);
+	}
+	s->ob_sindex = index;
+	return 0;
+}
+
+/* Start of code point i of a flat string, which must be in range.  NULL
+   on error. */
+static char *string_char_at(ViStringObject *s, Vi_size_t i)
 {
-	return Vi_SIZE(string);
+	char *p;
+
+	if (s->ob_sstate & SSTATE_ASCII)
+		return s->ob_svar + i;
+	if (s->ob_sindex == NULL && string_build_index(s) < 0)
+		return NULL;
+	p = s->ob_svar + s->ob_sindex[i / ViString_INDEX_STEP];
+	for (i %= ViString_INDEX_STEP; i > 0; i--)
+		p += ViUtf8_SequenceLength((unsigned char)*p);
+	return p;
 }
 
+static ViObject *rope_new(ViObject *a, ViObject *b);
+
 static ViObject* string_concat(ViStringObject* a, ViObject* b)
 {
 	ViStringObject* result = NULL;
-	if (!ViString_CheckExact(b))
+	if (!ViString_Check(b))
 	{
 		ViError_SetString(ViExc_TypeError, "can only concat strings");
 		return NULL;
@@ -68,30 +276,56 @@ static ViObject* string_concat(ViStringObject* a, ViObject* b)
 		ViObject_INCREF(result);
 		return (ViObject*)result;
 	}
+	if (Vi_SIZE(a) > VI_SIZE_T_MAX - Vi_SIZE(b))
+	{
+		ViError_NoMemory();
+		return NULL;
+	}
+	if (Vi_SIZE(a) + Vi_SIZE(b) >= ViRope_MIN_SIZE)
+		return rope_new((ViObject *)a, b);
 
+	/* Too short to be ropes */
+	assert(!ViRope_CheckExact(a) && !ViRope_CheckExact(b));
 	result = (ViStringObject*)ViStringObject_FromStringAndSize(NULL, Vi_SIZE(a) + Vi_SIZE(b));
 	if (result != NULL)
 	{
 		memcpy(result->ob_svar, a->ob_svar, Vi_SIZE(a));
 		memcpy(result->ob_svar + Vi_SIZE(a), ((ViStringObject*)b)->ob_svar, Vi_SIZE(b));
+		string_join_info(result, a, (ViStringObject*)b);
 	}
 	return (ViObject*)result;
 }
 
 static ViObject* string_item(ViStringObject* string, Vi_size_t i)
 {
-	if (valid_index(i, Vi_SIZE(string)))
+	ViStringObject *flat;
+	char *p;
+
+	flat = string_flat((ViObject *)string);
+	if (flat == NULL)
+		return NULL;
+	if (!valid_index(i, flat->ob_slength))
 	{
 		ViError_SetString(ViExc_IndexError, "string index out of range");
 		return NULL;
 	}
-	return ViIntObject_FromInt(string->ob_svar[i]);
+	p = string_char_at(flat, i);
+	if (p == NULL)
+		return NULL;
+	return ViIntObject_FromInt(ViUtf8_Decode(p));
 }
 
 static int string_assign_item(ViStringObject* string, Vi_size_t i, ViObject* value)
 {
-	int ival;
-	if (valid_index(i, Vi_SIZE(string)))
+	ViStringObject *flat;
+	char encoded[4];
+	char *p;
+	int size;
+
+	flat = string_flat((ViObject *)string);
+	if (flat == NULL)
+		return -1;
+	if (!valid_index(i, flat->ob_slength))
 	{
 		ViError_SetString(ViExc_IndexError, "string index out of range");
 		return -1;
@@ -103,22 +337,67 @@ static int string_assign_item(ViStringObject* string, Vi_size_t i, ViObject* val
 		return -1;
 	}
 
-	if (!get_char_value(value, &ival))
+	size = get_char_value(value, encoded);
+	if (size == 0)
+		return -1;
+
+	if (ViObject_IS_IMMORTAL(string) || (string->ob_sstate & SSTATE_IN_ROPE))
+	{
+		ViError_SetString(ViExc_TypeError, "shared string cannot be modified");
 		return -1;
+	}
 
-	string->ob_svar[i] = ival;
+	/* Code points after i keep their offsets, so the index stays valid */
+	p = string_char_at(flat, i);
+	if (p == NULL)
+		return -1;
+	if (size != ViUtf8_SequenceLength((unsigned char)*p))
+	{
+		ViError_SetString(ViExc_ValueError, "char must encode to as many bytes as the one it replaces");
+		return -1;
+	}
+	memcpy(p, encoded, size);
+	string->ob_shash = -1;
+	flat->ob_shash = -1;
 	return 0;
 }
 
+static ViObject *string_richcompare(ViObject *a, ViObject *b, int op)
+{
+	Vi_size_t len_a, len_b;
+	char *bytes_a, *bytes_b;
+	int c;
+
+	if (!ViString_Check(a) || !ViString_Check(b))
+		Vi_RETURN_NOTIMPLEMENTED;
+
+	/* Strings of different sizes are never equal, skip the bytes */
+	len_a = Vi_SIZE(a);
+	len_b = Vi_SIZE(b);
+	if ((op == Vi_EQ || op == Vi_NE) && len_a != len_b)
+		return ViBool_FromLong(op == Vi_NE);
+
+	bytes_a = ViString_AS_STRING(a);
+	if (bytes_a == NULL)
+		return NULL;
+	bytes_b = ViString_AS_STRING(b);
+	if (bytes_b == NULL)
+		return NULL;
+	c = memcmp(bytes_a, bytes_b, len_a < len_b ? len_a : len_b);
+	if (c == 0)
+		c = len_a < len_b ? -1 : len_a > len_b;
+	Vi_RETURN_RICHCOMPARE(c, 0, op);
+}
+
 static ViSequenceMethods string_sequence_methods = {
-	(lenfunc)string_length,				// sq_length
+	(lenfunc)ViString_Length,			// sq_length
 	(binaryfunc)string_concat,			// sq_concat
 	0,	// sq_repeat
 	(sizeargfunc)string_item,			// sq_item
 	0,	// sq_slice
 	(sizeobjargproc)string_assign_item,	// sq_assign_item
 	0,	// sq_assign_slice
-	0,	// sq_contains
+	(objobjproc)ViString_Contains,		// sq_contains
 	0,	// sq_inplace_concat
 	0,	// sq_inplace_repeat
 };
@@ -127,19 +406,227 @@ ViTypeObject ViStringType = {
 	VAROBJECT_HEAD_INIT(&ViStringType, 0)	// base
 	"string",								// tp_name
 	"String object type",					// tp_doc
-	sizeof(ViStringObject),					// tp_size
-	0,										// tp_itemsize
+	offsetof(ViStringObject, ob_svar) + 1,	// tp_size
+	sizeof(char),							// tp_itemsize
 	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE,		// tp_flags
 	(destructor)string_dealloc,				// tp_dealloc
 	0,										// tp_number_methods
 	&string_sequence_methods,				// tp_sequence_methods
+	(hashfunc)ViString_Hash,				// tp_hash
+	0,										// tp_traverse
 	0,										// tp_clear
+	string_richcompare,						// tp_richcompare
 	&ViBaseObjectType,						// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
 };
 
+//
+//
+//		Ropes
+//
+//
+
+/* Ropes up to this deep are flattened without allocating a stack */
+#define ROPE_SMALL_STACK 64
+
+/* Depth a new rope over half adds to */
+static inline int rope_depth(ViObject *half)
+{
+	if (ViRope_CheckExact(half) && ((ViRopeObject *)half)->flat == NULL)
+		return ((ViRopeObject *)half)->depth;
+	return 0;
+}
+
+/* A half can not change while a rope that has not copied it yet holds it.
+   The count saturates, a string held by that many ropes stays frozen. */
+static inline void rope_hold(ViObject *half)
+{
+	ViStringObject *s = (ViStringObject *)half;
+	if (s->ob_sropes < USHRT_MAX)
+		s->ob_sropes++;
+	s->ob_sstate |= SSTATE_IN_ROPE;
+}
+
+static inline void rope_unhold(ViObject *half)
+{
+	ViStringObject *s = (ViStringObject *)half;
+	if (s->ob_sropes < USHRT_MAX && --s->ob_sropes == 0)
+		s->ob_sstate &= ~SSTATE_IN_ROPE;
+}
+
+static ViObject *rope_make(ViObject *left, ViObject *right)
+{
+	ViRopeObject *rope;
+	int depth_left = rope_depth(left);
+	int depth_right = rope_depth(right);
+
+	rope = ViObject_NEW(ViRopeObject, &ViRopeType);
+	if (rope == NULL)
+		return NULL;
+	VAROBJECT_SET_SIZE(rope, Vi_SIZE(left) + Vi_SIZE(right));
+	rope->ob_shash = -1;
+	rope->ob_slength = -1;
+	rope->ob_sstate = SSTATE_NOT_INTERNED;
+	rope->ob_sropes = 0;
+	string_join_info((ViStringObject *)rope, (ViStringObject *)left, (ViStringObject *)right);
+	rope->depth = (depth_left > depth_right ? depth_left : depth_right) + 1;
+	/* The rope copies the halves later, they must not change until then */
+	rope_hold(left);
+	rope_hold(right);
+	rope->left = ViObject_NEWREF(left);
+	rope->right = ViObject_NEWREF(right);
+	rope->flat = NULL;
+	return (ViObject *)rope;
+}
+
+static ViObject *rope_new(ViObject *a, ViObject *b)
+{
+	ViRopeObject *ra = (ViRopeObject *)a;
+	ViObject *last, *result;
+
+	/* Copy a short piece into the last half of the rope while that stays
+	   short, instead of adding a level for it */
+	if (ViRope_CheckExact(a) && ra->flat == NULL && !ViRope_CheckExact(b) &&
+		!ViRope_CheckExact(ra->right) && Vi_SIZE(ra->right) + Vi_SIZE(b) < ViRope_MIN_SIZE)
+	{
+		last = string_concat((ViStringObject *)ra->right, b);
+		if (last == NULL)
+			return NULL;
+		result = rope_make(ra->left, last);
+		ViObject_DECREF(last);
+		return result;
+	}
+	return rope_make(a, b);
+}
+
+/* Release the halves of a rope.  Ropes can be very deep, releasing them
+   recursively could run out of stack, so ropes freed here are queued
+   through their flat field and freed by this loop instead. */
+static void rope_release_halves(ViRopeObject *rope)
+{
+	ViRopeObject *pending = NULL;
+	ViRopeObject *current = rope;
+
+	for (;;)
+	{
+		ViObject *halves[2] = { current->left, current->right };
+		current->left = NULL;
+		current->right = NULL;
+		for (int i = 0; i < 2; i++)
+		{
+			ViRopeObject *half = (ViRopeObject *)halves[i];
+			if (halves[i] == NULL)
+				continue;
+			rope_unhold(halves[i]);
+			if (ViRope_CheckExact(half) && half->ob_base.ob_base.ob_refcount == 1 && half->flat == NULL)
+			{
+				half->ob_base.ob_base.ob_refcount = 0;
+				half->flat = (ViStringObject *)pending;
+				pending = half;
+			}
+			else
+				ViObject_DECREF(halves[i]);
+		}
+		if (current != rope)
+			Vi_TYPE(current)->tp_free((ViObject *)current);
+		if (pending == NULL)
+			break;
+		current = pending;
+		pending = (ViRopeObject *)current->flat;
+		current->flat = NULL;
+	}
+}
+
+static void rope_dealloc(ViRopeObject *self)
+{
+	rope_release_halves(self);
+	ViObject_XDECREF(self->flat);
+	Vi_TYPE(self)->tp_free((ViObject *)self);
+}
+
+ViTypeObject ViRopeType = {
+	VAROBJECT_HEAD_INIT(&ViRopeType, 0)	// base
+	"string",								// tp_name
+	"String made of two strings, flattened on first access",	// tp_doc
+	sizeof(ViRopeObject),					// tp_size
+	0,										// tp_itemsize
+	TPFLAGS_DEFAULT,						// tp_flags
+	(destructor)rope_dealloc,				// tp_dealloc
+	0,										// tp_number_methods
+	&string_sequence_methods,				// tp_sequence_methods
+	(hashfunc)ViString_Hash,				// tp_hash
+	0,										// tp_traverse
+	0,										// tp_clear
+	string_richcompare,						// tp_richcompare
+	&ViStringType,							// tp_base
+	0,										// tp_dict
+	0,										// tp_new
+	ViObject_Free,							// tp_free
+	0,										// tp_cached_keys
+};
+
+char *ViRope_AsString(ViObject *op)
+{
+	ViRopeObject *rope = (ViRopeObject *)op;
+	ViObject *small_stack[ROPE_SMALL_STACK];
+	ViObject **stack = small_stack;
+	ViObject *node;
+	ViStringObject *flat;
+	char *end;
+	int n = 0;
+
+	if (rope->flat != NULL)
+		return rope->flat->ob_svar;
+
+	flat = (ViStringObject *)ViStringObject_FromStringAndSize(NULL, Vi_SIZE(rope));
+	if (flat == NULL)
+		return NULL;
+	if (rope->depth > ROPE_SMALL_STACK)
+	{
+		stack = (ViObject **)Mem_Alloc(rope->depth * sizeof(ViObject *));
+		if (stack == NULL)
+		{
+			ViObject_DECREF(flat);
+			ViError_NoMemory();
+			return NULL;
+		}
+	}
+
+	/* Fill the buffer from the end, going right first, so the left
+	   leaning ropes made by appending only ever stack one left half */
+	end = flat->ob_svar + Vi_SIZE(rope);
+	node = op;
+	for (;;)
+	{
+		while (ViRope_CheckExact(node) && ((ViRopeObject *)node)->flat == NULL)
+		{
+			assert(n < rope->depth);
+			stack[n++] = ((ViRopeObject *)node)->left;
+			node = ((ViRopeObject *)node)->right;
+		}
+		end -= Vi_SIZE(node);
+		if (ViRope_CheckExact(node))
+			memcpy(end, ((ViRopeObject *)node)->flat->ob_svar, Vi_SIZE(node));
+		else
+			memcpy(end, ((ViStringObject *)node)->ob_svar, Vi_SIZE(node));
+		if (n == 0)
+			break;
+		node = stack[--n];
+	}
+	assert(end == flat->ob_svar);
+
+	if (stack != small_stack)
+		Mem_Free(stack);
+	if (rope->ob_slength >= 0)
+		string_set_info(flat, rope->ob_slength, rope->ob_sstate & SSTATE_ASCII);
+	rope->flat = flat;
+	rope_release_halves(rope);
+	return flat->ob_svar;
+}
+
 ViObject* ViStringObject_FromString(const char* bytes)
 {
 	return ViStringObject_FromStringAndSize(bytes, strlen(bytes));
@@ -147,8 +634,9 @@ ViObject* ViStringObject_FromString(const char* bytes)
 
 ViObject* ViStringObject_FromStringAndSize(const char* bytes, Vi_size_t size)
 {
-	ViStringObject* obj;
-	size_t alloc;
+	ViStringObject *obj;
+	Vi_size_t length = -1;
+	int is_ascii = 0;
 
 	if (size < 0)
 	{
@@ -156,30 +644,31 @@ ViObject* ViStringObject_FromStringAndSize(const char* bytes, Vi_size_t size)
 		return NULL;
 	}
 
-	obj = ViObject_NEW(ViStringObject, &ViStringType);
-	if (obj == NULL)
-		return NULL;
 	if (size == 0)
+		return get_empty_string();
+	/* Only when the contents are known, a NULL bytes pointer means
+	   the caller fills in the string */
+	if (bytes != NULL)
 	{
-		obj->ob_svar = NULL;
-		alloc = 0;
+		length = ViUtf8_Check(bytes, size, &is_ascii);
+		if (length < 0)
+		{
+			ViError_SetString(ViExc_UnicodeError, "invalid utf-8 string");
+			return NULL;
+		}
+		if (size == 1)
+			return get_character((unsigned char)*bytes);
 	}
-	else
-	{
-		alloc = size + 1;
-		obj->ob_svar = (char*)Mem_Alloc(alloc);
-		if (bytes != NULL && size > 0)
-			memcpy(obj->ob_svar, bytes, size);
-		obj->ob_svar[size] = '\0'; // Trailing NULL byte (end of string)
-	}
-	VAROBJECT_SET_SIZE(obj, size);
-	obj->ob_alloc = alloc;
+
+	obj = string_alloc(bytes, size);
+	if (obj != NULL && length >= 0)
+		string_set_info(obj, length, is_ascii);
 	return (ViObject*)obj;
 }
 
 ViObject* ViString_Concat(ViObject* a, ViObject* b)
 {
-	if (!ViString_CheckExact(a))
+	if (!ViString_Check(a))
 	{
 		ViError_SetString(ViExc_SystemError, "Tried to pass non-ViStringObject in ViString_Concat");
 		return NULL;
@@ -188,6 +677,394 @@ ViObject* ViString_Concat(ViObject* a, ViObject* b)
 	return a->ob_type->tp_sequence_methods->sq_concat(a, b);
 }
 
+Vi_size_t ViString_Length(ViObject *str)
+{
+	ViStringObject *s = (ViStringObject *)str;
+	ViStringObject *flat;
+
+	if (s->ob_slength >= 0)
+		return s->ob_slength;
+	flat = string_flat(str);
+	if (flat == NULL)
+		return -1;
+	if (flat != s)
+		string_set_info(s, flat->ob_slength, flat->ob_sstate & SSTATE_ASCII);
+	return s->ob_slength;
+}
+
+void ViString_Append(ViObject **pleft, ViObject *right)
+{
+	ViObject *left = *pleft;
+	ViObject *result;
+	Vi_size_t left_len, left_length;
+	int left_ascii;
+
+	if (left == NULL)
+		return;
+	if (!ViString_Check(right))
+	{
+		ViError_SetString(ViExc_TypeError, "can only concat strings");
+		ViObject_CLEAR(*pleft);
+		return;
+	}
+
+	/* Nobody else can see left, grow it instead of copying it.  A rope on
+	   the right is cheaper to refer to than to flatten. */
+	left_len = Vi_SIZE(left);
+	if (left->ob_refcount == 1 && ViString_CheckExact(left) && left != right &&
+		ViString_CheckExact(right) && Vi_SIZE(right) > 0)
+	{
+		if (left_len > VI_SIZE_T_MAX - Vi_SIZE(right))
+		{
+			ViError_NoMemory();
+			ViObject_CLEAR(*pleft);
+			return;
+		}
+		/* Resizing forgets the length, it is the sum of the two */
+		left_length = ((ViStringObject *)left)->ob_slength;
+		left_ascii = ((ViStringObject *)left)->ob_sstate & ((ViStringObject *)right)->ob_sstate & SSTATE_ASCII;
+		if (ViString_Resize(pleft, left_len + Vi_SIZE(right)) < 0)
+			return;
+		memcpy(((ViStringObject *)*pleft)->ob_svar + left_len, ((ViStringObject *)right)->ob_svar, Vi_SIZE(right));
+		if (left_length >= 0 && ((ViStringObject *)right)->ob_slength >= 0)
+			string_set_info((ViStringObject *)*pleft, left_length + ((ViStringObject *)right)->ob_slength, left_ascii);
+		return;
+	}
+
+	result = ViString_Concat(left, right);
+	ViObject_DECREF(left);
+	*pleft = result;
+}
+
+int ViString_Resize(ViObject **pv, Vi_size_t newsize)
+{
+	ViObject *v = *pv;
+	ViStringObject *sv;
+
+	if (newsize < 0 || !ViString_CheckExact(v) || v->ob_refcount != 1)
+	{
+		*pv = NULL;
+		ViObject_DECREF(v);
+		ViError_BadInternalCall();
+		return -1;
+	}
+	if (Vi_SIZE(v) == newsize)
+		return 0;
+	if (newsize == 0)
+	{
+		*pv = get_empty_string();
+		ViObject_DECREF(v);
+		return *pv == NULL ? -1 : 0;
+	}
+
+	sv = (ViStringObject *)ViObject_Realloc(v, ViObject_VAR_SIZE(&ViStringType, newsize));
+	if (sv == NULL)
+	{
+		*pv = NULL;
+		ViObject_DECREF(v);
+		ViError_NoMemory();
+		return -1;
+	}
+	VAROBJECT_SET_SIZE(sv, newsize);
+	sv->ob_svar[newsize] = '\0';
+	sv->ob_shash = -1;
+	sv->ob_slength = -1;
+	sv->ob_sstate &= ~SSTATE_ASCII;
+	Mem_Free(sv->ob_sindex);
+	sv->ob_sindex = NULL;
+	*pv = (ViObject *)sv;
+	return 0;
+}
+
+Vi_hash_t ViString_Hash(ViObject *str)
+{
+	ViStringObject *s = (ViStringObject *)str;
+	Vi_hash_t h = s->ob_shash;
+
+	if (h == -1)
+	{
+		char *bytes = ViString_AS_STRING(s);
+		if (bytes == NULL)
+			return -1;
+		h = ViHash_Bytes(bytes, Vi_SIZE(s));
+		s->ob_shash = h;
+	}
+	return h;
+}
+
+int ViString_Equal(ViObject *a, ViObject *b)
+{
+	if (a == b)
+		return 1;
+	/* There is only one interned string per contents */
+	if (ViString_CHECK_INTERNED(a) && ViString_CHECK_INTERNED(b))
+		return 0;
+	if (Vi_SIZE(a) != Vi_SIZE(b))
+		return 0;
+	return memcmp(((ViStringObject *)a)->ob_svar, ((ViStringObject *)b)->ob_svar, Vi_SIZE(a)) == 0;
+}
+
+/* Bytes of a string argument, NULL with an error set if it is not a
+   string */
+static char *string_arg_bytes(ViObject *arg)
+{
+	if (!ViString_Check(arg))
+	{
+		ViError_SetString(ViExc_TypeError, "argument must be a string");
+		return NULL;
+	}
+	return ViString_AS_STRING(arg);
+}
+
+/* ASCII whitespace */
+static inline int is_space(unsigned char c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static int split_add(ViObject *list, const char *bytes, Vi_size_t size)
+{
+	ViObject *piece = ViStringObject_FromStringAndSize(bytes, size);
+	int err;
+
+	if (piece == NULL)
+		return -1;
+	err = ViList_Append(list, piece);
+	ViObject_DECREF(piece);
+	return err;
+}
+
+static int split_whitespace(ViObject *list, const char *s, Vi_size_t n, Vi_size_t maxsplit)
+{
+	Vi_size_t i = 0, j;
+
+	while (maxsplit-- > 0)
+	{
+		while (i < n && is_space(s[i]))
+			i++;
+		if (i == n)
+			break;
+		j = i;
+		while (i < n && !is_space(s[i]))
+			i++;
+		if (split_add(list, s + j, i - j) < 0)
+			return -1;
+	}
+
+	/* Out of splits, the rest is one piece without the leading space */
+	while (i < n && is_space(s[i]))
+		i++;
+	if (i < n && split_add(list, s + i, n - i) < 0)
+		return -1;
+	return 0;
+}
+
+Vi_size_t ViString_Find(ViObject *str, ViObject *sub)
+{
+	ViStringObject *info = (ViStringObject *)str;
+	char *s, *p;
+	Vi_size_t pos;
+
+	s = ViString_AS_STRING(str);
+	if (s == NULL)
+		return -2;
+	p = string_arg_bytes(sub);
+	if (p == NULL)
+		return -2;
+	pos = ViFastSearch_Find(s, Vi_SIZE(str), p, Vi_SIZE(sub));
+	/* A match of valid UTF-8 starts on a code point, count the ones
+	   before it unless they are all bytes */
+	if (pos <= 0 || (info->ob_slength >= 0 && (info->ob_sstate & SSTATE_ASCII)))
+		return pos;
+	return ViUtf8_Count(s, pos);
+}
+
+Vi_size_t ViString_Count(ViObject *str, ViObject *sub)
+{
+	char *s, *p;
+
+	s = ViString_AS_STRING(str);
+	if (s == NULL)
+		return -1;
+	p = string_arg_bytes(sub);
+	if (p == NULL)
+		return -1;
+	/* The empty string occurs before every code point and at the end */
+	if (Vi_SIZE(sub) == 0)
+	{
+		Vi_size_t length = ViString_Length(str);
+		return length < 0 ? -1 : length + 1;
+	}
+	return ViFastSearch_Count(s, Vi_SIZE(str), p, Vi_SIZE(sub), VI_SIZE_T_MAX);
+}
+
+int ViString_Contains(ViObject *str, ViObject *sub)
+{
+	char *s, *p;
+	char encoded[4];
+	int size;
+
+	s = ViString_AS_STRING(str);
+	if (s == NULL)
+		return -1;
+	if (ViInt_Check(sub))
+	{
+		size = get_char_value(sub, encoded);
+		if (size == 0)
+			return -1;
+		if (size == 1)
+			return ViFastSearch_FindChar(s, Vi_SIZE(str), encoded[0]) >= 0;
+		return ViFastSearch_Find(s, Vi_SIZE(str), encoded, size) >= 0;
+	}
+	p = string_arg_bytes(sub);
+	if (p == NULL)
+		return -1;
+	return ViFastSearch_Find(s, Vi_SIZE(str), p, Vi_SIZE(sub)) >= 0;
+}
+
+ViObject *ViString_Split(ViObject *str, ViObject *sep, Vi_size_t maxsplit)
+{
+	ViObject *list;
+	char *s, *p = NULL;
+	Vi_size_t n = Vi_SIZE(str), m = 0, i = 0, pos;
+
+	s = ViString_AS_STRING(str);
+	if (s == NULL)
+		return NULL;
+	if (sep != NULL)
+	{
+		p = string_arg_bytes(sep);
+		if (p == NULL)
+			return NULL;
+		m = Vi_SIZE(sep);
+		if (m == 0)
+		{
+			ViError_SetString(ViExc_ValueError, "empty separator");
+			return NULL;
+		}
+	}
+	if (maxsplit < 0)
+		maxsplit = VI_SIZE_T_MAX;
+
+	list = ViListObject_New(0);
+	if (list == NULL)
+		return NULL;
+
+	if (sep == NULL)
+	{
+		if (split_whitespace(list, s, n, maxsplit) < 0)
+			goto error;
+		return list;
+	}
+
+	while (maxsplit-- > 0)
+	{
+		pos = ViFastSearch_Find(s + i, n - i, p, m);
+		if (pos < 0)
+			break;
+		if (split_add(list, s + i, pos) < 0)
+			goto error;
+		i += pos + m;
+	}
+
+	/* Nothing to split, the string is its only piece */
+	if (i == 0 && ViString_CheckExact(str))
+	{
+		if (ViList_Append(list, str) < 0)
+			goto error;
+	}
+	else if (split_add(list, s + i, n - i) < 0)
+		goto error;
+	return list;
+
+error:
+	ViObject_DECREF(list);
+	return NULL;
+}
+
+ViObject *ViString_Replace(ViObject *str, ViObject *old, ViObject *replacement, Vi_size_t maxcount)
+{
+	ViObject *result;
+	char *s, *o, *r, *out;
+	Vi_size_t n = Vi_SIZE(str), m, r_len, count, size, i, pos;
+
+	s = ViString_AS_STRING(str);
+	if (s == NULL)
+		return NULL;
+	o = string_arg_bytes(old);
+	if (o == NULL)
+		return NULL;
+	r = string_arg_bytes(replacement);
+	if (r == NULL)
+		return NULL;
+	m = Vi_SIZE(old);
+	r_len = Vi_SIZE(replacement);
+
+	if (maxcount < 0)
+		maxcount = VI_SIZE_T_MAX;
+	if (m == 0)
+	{
+		count = ViString_Length(str);
+		if (count < 0)
+			return NULL;
+		count = count + 1 < maxcount ? count + 1 : maxcount;
+	}
+	else
+		count = ViFastSearch_Count(s, n, o, m, maxcount);
+	if (count == 0)
+	{
+		if (ViString_CheckExact(str))
+			return ViObject_NEWREF(str);
+		return ViStringObject_FromStringAndSize(s, n);
+	}
+
+	/* One pass to size the result, one to fill it */
+	if (r_len > m && r_len - m > (VI_SIZE_T_MAX - n) / count)
+	{
+		ViError_NoMemory();
+		return NULL;
+	}
+	size = n + count * (r_len - m);
+	result = ViStringObject_FromStringAndSize(NULL, size);
+	if (result == NULL)
+		return NULL;
+	out = ((ViStringObject *)result)->ob_svar;
+
+	i = 0;
+	if (m == 0)
+	{
+		/* The empty string occurs before every code point and at the
+		   end */
+		for (Vi_size_t k = 0; k < count; k++)
+		{
+			memcpy(out, r, r_len);
+			out += r_len;
+			if (i < n)
+			{
+				int len = ViUtf8_SequenceLength((unsigned char)s[i]);
+				memcpy(out, s + i, len);
+				out += len;
+				i += len;
+			}
+		}
+	}
+	else
+	{
+		for (Vi_size_t k = 0; k < count; k++)
+		{
+			pos = ViFastSearch_Find(s + i, n - i, o, m);
+			assert(pos >= 0);
+			memcpy(out, s + i, pos);
+			out += pos;
+			memcpy(out, r, r_len);
+			out += r_len;
+			i += pos + m;
+		}
+	}
+	memcpy(out, s + i, n - i);
+	return result;
+}
+
 char *ViString_ToString(ViObject *str)
 {
 	if (!ViString_Check(str))
@@ -195,5 +1072,220 @@ char *ViString_ToString(ViObject *str)
 		ViError_SetString(ViExc_TypeError, "type is not a string");
 		return NULL;
 	}
-	return ((ViStringObject*)str)->ob_svar;
+	return ViString_AS_STRING(str);
 }
+
+void ViString_InternInPlace(ViObject **p)
+{
+	ViStringObject *s = (ViStringObject *)*p;
+	Vi_size_t i;
+
+	if (!ViString_CheckExact(s) || ViString_CHECK_INTERNED(s))
+		return;
+	if (interned_reserve() < 0)
+	{
+		ViError_Clear(); // Not interning is not an error
+		return;
+	}
+
+	i = interned_find(s->ob_svar, Vi_SIZE(s), ViString_Hash((ViObject *)s));
+	if (interned[i] != NULL)
+	{
+		*p = (ViObject *)interned[i];
+		ViObject_DECREF(s);
+		return;
+	}
+	ViObject_SET_IMMORTAL(s);
+	s->ob_sstate |= SSTATE_INTERNED;
+	interned[i] = s;
+	interned_used++;
+}
+
+ViObject *ViString_InternFromString(const char *bytes)
+{
+	return ViString_InternFromStringAndSize(bytes, strlen(bytes));
+}
+
+ViObject *ViString_InternFromStringAndSize(const char *bytes, Vi_size_t size)
+{
+	ViStringObject *s;
+	Vi_hash_t hash;
+	Vi_size_t i;
+
+	if (size < 0 || (bytes == NULL && size > 0))
+	{
+		ViError_BadInternalCall();
+		return NULL;
+	}
+	if (size == 0)
+		bytes = "";
+	if (interned_reserve() < 0)
+		return NULL;
+
+	hash = ViHash_Bytes(bytes, size);
+	i = interned_find(bytes, size, hash);
+	if (interned[i] != NULL)
+		return (ViObject *)interned[i];
+
+	s = (ViStringObject *)ViStringObject_FromStringAndSize(bytes, size);
+	if (s == NULL)
+		return NULL;
+	s->ob_shash = hash;
+	ViObject_SET_IMMORTAL(s);
+	s->ob_sstate |= SSTATE_INTERNED;
+	interned[i] = s;
+	interned_used++;
+	return (ViObject *)s;
+}
+
+ViObject *ViString_FromId(ViIdentifier *id)
+{
+	ViObject *s;
+
+	if (id->index >= 0)
+		return identifiers[id->index];
+
+	if (identifiers_used == identifiers_allocated)
+	{
+		Vi_size_t newsize = identifiers_allocated ? identifiers_allocated * 2 : 64;
+		ViObject **newids = (ViObject **)Mem_Realloc(identifiers, newsize * sizeof(ViObject *));
+		if (newids == NULL)
+		{
+			ViError_NoMemory();
+			return NULL;
+		}
+		identifiers = newids;
+		identifiers_allocated = newsize;
+	}
+
+	s = ViString_InternFromString(id->string);
+	if (s == NULL)
+		return NULL;
+	identifiers[identifiers_used] = s;
+	id->index = identifiers_used++;
+	return s;
+}
+
+Vi_size_t ViString_InternedSize()
+{
+	return interned_used;
+}
+
+//
+//
+//		String writer
+//
+//
+
+void ViStringWriter_Init(ViStringWriter *writer)
+{
+	writer->buffer = NULL;
+	writer->str = writer->small_buffer;
+	writer->size = 0;
+	writer->allocated = ViStringWriter_SMALL_SIZE;
+}
+
+int ViStringWriter_Reserve(ViStringWriter *writer, Vi_size_t size)
+{
+	Vi_size_t needed, newsize;
+
+	if (size < 0)
+	{
+		ViError_BadInternalCall();
+		return -1;
+	}
+	if (size <= writer->allocated - writer->size)
+		return 0;
+	if (writer->size > VI_SIZE_T_MAX - size)
+	{
+		ViError_NoMemory();
+		return -1;
+	}
+
+	/* Overallocate by half, n appends copy O(n) bytes in total */
+	needed = writer->size + size;
+	newsize = needed <= VI_SIZE_T_MAX - needed / 2 ? needed + needed / 2 : needed;
+
+	if (writer->buffer == NULL)
+	{
+		/* Move out of the small buffer */
+		writer->buffer = ViStringObject_FromStringAndSize(NULL, newsize);
+		if (writer->buffer == NULL)
+			return -1;
+		memcpy(((ViStringObject *)writer->buffer)->ob_svar, writer->small_buffer, writer->size);
+	}
+	else if (ViString_Resize(&writer->buffer, newsize) < 0)
+	{
+		ViStringWriter_Init(writer);
+		return -1;
+	}
+	writer->str = ((ViStringObject *)writer->buffer)->ob_svar;
+	writer->allocated = newsize;
+	return 0;
+}
+
+int ViStringWriter_WriteBytes(ViStringWriter *writer, const char *bytes, Vi_size_t size)
+{
+	if (ViStringWriter_Reserve(writer, size) < 0)
+		return -1;
+	memcpy(writer->str + writer->size, bytes, size);
+	writer->size += size;
+	return 0;
+}
+
+int ViStringWriter_WriteString(ViStringWriter *writer, const char *str)
+{
+	return ViStringWriter_WriteBytes(writer, str, strlen(str));
+}
+
+int ViStringWriter_WriteChar(ViStringWriter *writer, char c)
+{
+	if (writer->size == writer->allocated && ViStringWriter_Reserve(writer, 1) < 0)
+		return -1;
+	writer->str[writer->size++] = c;
+	return 0;
+}
+
+int ViStringWriter_WriteObject(ViStringWriter *writer, ViObject *str)
+{
+	char *bytes;
+
+	if (!ViString_Check(str))
+	{
+		ViError_SetString(ViExc_TypeError, "can only write strings");
+		return -1;
+	}
+	bytes = ViString_AS_STRING(str);
+	if (bytes == NULL)
+		return -1;
+	return ViStringWriter_WriteBytes(writer, bytes, Vi_SIZE(str));
+}
+
+ViObject *ViStringWriter_Finish(ViStringWriter *writer)
+{
+	ViObject *result;
+
+	if (writer->buffer == NULL)
+		result = ViStringObject_FromStringAndSize(writer->small_buffer, writer->size);
+	else if (writer->size <= ViStringWriter_SMALL_SIZE)
+	{
+		/* A reservation moved a short string out of the small buffer,
+		   copy it rather than resize the buffer to a shareable size */
+		result = ViStringObject_FromStringAndSize(writer->str, writer->size);
+		ViObject_DECREF(writer->buffer);
+	}
+	else
+	{
+		result = writer->buffer;
+		if (ViString_Resize(&result, writer->size) == 0 && string_flat(result) == NULL)
+			ViObject_CLEAR(result);
+	}
+	ViStringWriter_Init(writer);
+	return result;
+}
+
+void ViStringWriter_Dealloc(ViStringWriter *writer)
+{
+	ViObject_XDECREF(writer->buffer);
+	ViStringWriter_Init(writer);
+}
\ No newline at end of file
@@ -3,26 +3,228 @@
 
 #include "object.h"
 
+/*
+ * Strings hold UTF-8 text, ob_size is its size in bytes.  Strings made
+ * from bytes are validated when they are created, which also counts the
+ * code points and notes whether they are all ASCII.  Strings filled in by
+ * their creator are counted the first time the length is needed.
+ *
+ * Indexing counts code points.  In an ASCII string a code point is a
+ * byte, other strings build an index holding the byte offset of every
+ * ViString_INDEX_STEP-th code point on first access, so finding a code
+ * point decodes at most ViString_INDEX_STEP - 1 others.
+*/
+
+#define ViString_INDEX_STEP 64
+
 typedef struct _stringobject
 {
 	ViObject_VAR_HEAD;
-	size_t ob_alloc;
-	char *ob_svar;
+	Vi_hash_t ob_shash; // Hash of the contents, -1 until computed
+	Vi_size_t ob_slength; // Number of code points, -1 until computed
+	unsigned char ob_sstate; // SSTATE_* bits
+	unsigned short ob_sropes; // Unflattened ropes holding this string as a half
+	Vi_size_t *ob_sindex; // Code point index, NULL until needed
+	/* ob_svar contains space for 'ob_size+1' elements.
+	   ob_svar[ob_size] == 0. */
+	char ob_svar[1];
 } ViStringObject;
 
-/* Type object */
+/* Bits of ob_sstate */
+#define SSTATE_NOT_INTERNED 0
+#define SSTATE_INTERNED 1
+#define SSTATE_IN_ROPE 2 // Held by ob_sropes ropes, the bytes can not change
+#define SSTATE_ASCII 4 // Every byte is ASCII, set along with ob_slength
+
+#define ViString_CHECK_INTERNED(op) (((ViStringObject *)(op))->ob_sstate & SSTATE_INTERNED)
+
+/*
+ * Ropes
+ *
+ * Concatenating strings into a string of at least ViRope_MIN_SIZE bytes
+ * makes a rope, which only refers to the two halves.  The bytes are copied
+ * into one buffer the first time they are needed, so building a long
+ * string from many pieces copies each byte once instead of once per
+ * concatenation.  Shorter results are copied right away, and a short
+ * piece appended to a rope is copied into the last half while that stays
+ * short, so appending many small pieces does not make a tree of tiny
+ * leaves.
+ *
+ * A rope is a ViRopeObject, its type is a subtype of ViStringType and it
+ * starts like a ViStringObject without ob_svar.  Use ViString_AS_STRING()
+ * to get at the bytes of a string that may be a rope.
+*/
+
+#define ViRope_MIN_SIZE 512
+
+typedef struct _ropeobject
+{
+	ViObject_VAR_HEAD; // ob_size is the length of the whole string
+	Vi_hash_t ob_shash;
+	Vi_size_t ob_slength;
+	unsigned char ob_sstate;
+	unsigned short ob_sropes;
+	int depth; // Longest chain of unflattened ropes from here, this one included
+	ViObject *left; // The halves, NULL once flattened
+	ViObject *right;
+	ViStringObject *flat; // The bytes, NULL until first needed
+} ViRopeObject;
+
+/* Type objects */
 extern ViTypeObject ViStringType;
+extern ViTypeObject ViRopeType;
 
 /* Type check macros */
 #define ViString_Check(self) ViObject_TypeCheck(self, &ViStringType)
 #define ViString_CheckExact(self) Vi_IS_TYPE(self, &ViStringType)
+#define ViRope_CheckExact(self) Vi_IS_TYPE(self, &ViRopeType)
 
-/* Convert an array of bytes to a ViStringObject */
+/* Bytes of a rope, flattening it on first use.  NULL on error. */
+char *ViRope_AsString(ViObject *rope);
+
+static inline char *StringAsString(ViObject *str)
+{
+	if (ViRope_CheckExact(str))
+		return ViRope_AsString(str);
+	return ((ViStringObject *)str)->ob_svar;
+}
+/* Bytes of any string, NULL with an error set if a rope can not be
+   flattened */
+#define ViString_AS_STRING(str) StringAsString(ViObject_CAST(str))
+
+/* Convert an array of bytes to a ViStringObject, NULL with a
+   UnicodeError set if they are not valid UTF-8.  With bytes NULL the
+   caller fills in the string. */
 ViObject *ViStringObject_FromString(const char *bytes);
 ViObject *ViStringObject_FromStringAndSize(const char *bytes, Vi_size_t size);
 
 /* API Functions */
 ViObject *ViString_Concat(ViObject *a, ViObject *b);
+
+/* Number of code points, -1 on error */
+Vi_size_t ViString_Length(ViObject *str);
+
+/* Append right to *pleft, consuming the reference in *pleft.  A string
+   nobody else references is grown in place instead of copied.  On error
+   *pleft is set to NULL. */
+void ViString_Append(ViObject **pleft, ViObject *right);
+
+/* Change the size of a string nobody else references, the object may
+   move.  Only for strings that are still being filled in.  On error *pv
+   is released and set to NULL. */
+int ViString_Resize(ViObject **pv, Vi_size_t newsize);
+
+/* Hash of the contents, computed on first use and cached in the string.
+   -1 on error if a rope can not be flattened. */
+Vi_hash_t ViString_Hash(ViObject *str);
+
+/* Test if two flat strings hold the same bytes */
+int ViString_Equal(ViObject *a, ViObject *b);
+
+/*
+ * Searching
+ *
+ * Needles and separators must be strings.  The searches run on the
+ * vectorised kernels of core/vifastsearch.h.
+*/
+
+/* Code point index of the first occurrence of sub in str, -1 if there is
+   none and -2 on error */
+Vi_size_t ViString_Find(ViObject *str, ViObject *sub);
+
+/* Number of non-overlapping occurrences of sub in str, -1 on error */
+Vi_size_t ViString_Count(ViObject *str, ViObject *sub);
+
+/* 1 if sub occurs in str, 0 if not, -1 on error.  sub may also be an int,
+   a code point as returned by indexing. */
+int ViString_Contains(ViObject *str, ViObject *sub);
+
+/* List of the pieces of str between occurrences of sep, splitting at most
+   maxsplit times, maxsplit < 0 splits everywhere.  With sep NULL the
+   pieces are separated by runs of whitespace and no piece is empty. */
+ViObject *ViString_Split(ViObject *str, ViObject *sep, Vi_size_t maxsplit);
+
+/* Copy of str with the first maxcount occurrences of old replaced by
+   replacement, maxcount < 0 replaces all */
+ViObject *ViString_Replace(ViObject *str, ViObject *old, ViObject *replacement, Vi_size_t maxcount);
+
+/*
+ * Interning
+ *
+ * Interned strings are kept in a global table which holds exactly one
+ * string per contents, so two interned strings are equal only if they are
+ * the same object.  Interned strings are immortal and can not be modified.
+ * Names in the source code, identifiers and the keys of attribute dicts
+ * are interned, comparing them is a pointer compare.
+*/
+
+/* Replace *p by the interned string with the same contents, interning *p
+   itself if there is none yet.  Consumes the reference in *p.  On error
+   *p is left as it is. */
+void ViString_InternInPlace(ViObject **p);
+
+/* Return the interned string with the given contents, NULL on error.
+   The table is searched before a string is created. */
+ViObject *ViString_InternFromString(const char *bytes);
+ViObject *ViString_InternFromStringAndSize(const char *bytes, Vi_size_t size);
+
+/* Return the interned string of a Vi_IDENTIFIER, a borrowed reference.
+   The string is created on first use and cached by the index of the
+   identifier. */
+ViObject *ViString_FromId(ViIdentifier *id);
+
+/* Number of interned strings */
+Vi_size_t ViString_InternedSize();
+
+/*
+ * String writer
+ *
+ * Builds a string from pieces without creating a string per piece.  The
+ * first bytes go to a buffer inside the writer, when that is full they
+ * move to a string object which grows by half its size each time.  Finish
+ * shrinks that object to the written size and returns it as the result,
+ * so a long string is not copied once more at the end.
+ *
+ *	ViStringWriter writer;
+ *	ViStringWriter_Init(&writer);
+ *	if (ViStringWriter_WriteString(&writer, "name: ") < 0 ||
+ *		ViStringWriter_WriteObject(&writer, name) < 0)
+ *	{
+ *		ViStringWriter_Dealloc(&writer);
+ *		return NULL;
+ *	}
+ *	return ViStringWriter_Finish(&writer);
+*/
+
+#define ViStringWriter_SMALL_SIZE 256
+
+typedef struct _stringwriter
+{
+	ViObject *buffer; // String written to, NULL while small_buffer is used
+	char *str; // Start of the data, in buffer or small_buffer
+	Vi_size_t size; // Number of bytes written
+	Vi_size_t allocated; // Number of bytes str has room for
+	char small_buffer[ViStringWriter_SMALL_SIZE];
+} ViStringWriter;
+
+void ViStringWriter_Init(ViStringWriter *writer);
+
+/* Make room for size more bytes, 0 on success, -1 with an error set */
+int ViStringWriter_Reserve(ViStringWriter *writer, Vi_size_t size);
+
+/* Append to the string, 0 on success, -1 with an error set */
+int ViStringWriter_WriteBytes(ViStringWriter *writer, const char *bytes, Vi_size_t size);
+int ViStringWriter_WriteString(ViStringWriter *writer, const char *str);
+int ViStringWriter_WriteChar(ViStringWriter *writer, char c);
+int ViStringWriter_WriteObject(ViStringWriter *writer, ViObject *str);
+
+/* Return the written string and reset the writer, NULL on error or if
+   the bytes written are not valid UTF-8 */
+ViObject *ViStringWriter_Finish(ViStringWriter *writer);
+
+/* Release the writer without creating a string */
+void ViStringWriter_Dealloc(ViStringWriter *writer);
+
 char *ViString_ToString(ViObject *str);
 
 #endif // __STRINGOBJECT_H__
\ No newline at end of file
@@ -1,6 +1,28 @@
 #include "tupleobject.h"
 
 #include "../core/error.h"
+#include "../core/vigc.h"
+#include "../core/vihash.h"
+
+#include "boolobject.h"
+
+/* Speed optimization to avoid frequent malloc/free of small tuples.
+   Dead tuples of each size are linked through ob_items[0];
+   free_list[0] is unused. */
+#ifndef ViTuple_MAXSAVESIZE
+#	define ViTuple_MAXSAVESIZE 20		// Largest tuple to save on free list
+#endif
+#ifndef ViTuple_MAXFREELIST
+#	define ViTuple_MAXFREELIST 2000	// Maximum number of tuples of each size to save
+#endif
+
+/* The empty tuple is a shared, immortal singleton */
+static ViTupleObject *empty_tuple = NULL;
+
+static ViTupleObject *free_list[ViTuple_MAXSAVESIZE];
+static int numfree[ViTuple_MAXSAVESIZE];
+static size_t free_list_hits = 0;
+static size_t free_list_misses = 0;
 
 //
 //
@@ -11,20 +33,38 @@
 static void tuple_dealloc(ViTupleObject *self)
 {
 	Vi_size_t i;
-	// Untrack list for GC
-	// begin trashcan
-	if (self->ob_items != NULL)
+	Vi_size_t len = Vi_SIZE(self);
+	ViObject_GC_UnTrack(self);
+	ViTrash_BEGIN(self)
+	if (len > 0)
 	{
-		i = Vi_SIZE(self);
+		i = len;
 		while (--i >= 0)
 		{
-			ViObject_DECREF(self->ob_items[i]);
+			ViObject_XDECREF(self->ob_items[i]);
+		}
+		if (len < ViTuple_MAXSAVESIZE &&
+			numfree[len] < ViTuple_MAXFREELIST &&
+			ViTuple_CheckExact(self))
+		{
+			self->ob_items[0] = (ViObject *)free_list[len];
+			numfree[len]++;
+			free_list[len] = self;
+			goto done;
 		}
-		Mem_Free(self->ob_items);
 	}
 	Vi_TYPE(self)->tp_free((ViObject *)self);
+done:
+	ViTrash_END
+}
 
-	// end trashcan
+static int tuple_traverse(ViTupleObject *self, visitproc visit, void *arg)
+{
+	Vi_size_t i;
+
+	for (i = Vi_SIZE(self); --i >= 0; )
+		Vi_VISIT(self->ob_items[i]);
+	return 0;
 }
 
 static Vi_size_t tuple_length(ViTupleObject* tuple)
@@ -44,6 +84,72 @@ static ViObject* tuple_item(ViTupleObject* tuple, Vi_size_t i)
 	return tuple->ob_items[i];
 }
 
+/* xxHash style mixing of the item hashes, the result is cached as the
+   items can not change */
+#define XXPRIME_1 ((Vi_uint64_t)11400714785074694791ULL)
+#define XXPRIME_2 ((Vi_uint64_t)14029467366897019727ULL)
+#define XXPRIME_5 ((Vi_uint64_t)2870177450012600261ULL)
+#define XXROTATE(x) ((x << 31) | (x >> 33))
+
+static Vi_hash_t tuple_hash(ViTupleObject *self)
+{
+	Vi_size_t len = Vi_SIZE(self);
+	Vi_uint64_t acc = XXPRIME_5;
+
+	if (self->ob_hash != -1)
+		return self->ob_hash;
+
+	for (Vi_size_t i = 0; i < len; i++)
+	{
+		Vi_uint64_t lane = (Vi_uint64_t)ViObject_Hash(self->ob_items[i]);
+		if (lane == (Vi_uint64_t)-1)
+			return -1;
+		acc += lane * XXPRIME_2;
+		acc = XXROTATE(acc);
+		acc *= XXPRIME_1;
+	}
+	acc += (Vi_uint64_t)len ^ (XXPRIME_5 ^ 3527539UL);
+	if (acc == (Vi_uint64_t)-1)
+		acc = 1546275796;
+
+	self->ob_hash = (Vi_hash_t)acc;
+	return self->ob_hash;
+}
+
+static ViObject *tuple_richcompare(ViObject *a, ViObject *b, int op)
+{
+	ViTupleObject *v, *w;
+	Vi_size_t i, vlen, wlen;
+
+	if (!ViTuple_Check(a) || !ViTuple_Check(b))
+		Vi_RETURN_NOTIMPLEMENTED;
+	v = (ViTupleObject *)a;
+	w = (ViTupleObject *)b;
+	vlen = Vi_SIZE(v);
+	wlen = Vi_SIZE(w);
+
+	/* Search for the first index where the items differ */
+	for (i = 0; i < vlen && i < wlen; i++)
+	{
+		int k = ViObject_RichCompareBool(v->ob_items[i], w->ob_items[i], Vi_EQ);
+		if (k < 0)
+			return NULL;
+		if (!k)
+			break;
+	}
+
+	/* No more items to compare, compare the sizes */
+	if (i >= vlen || i >= wlen)
+		Vi_RETURN_RICHCOMPARE(vlen, wlen, op);
+
+	/* The first differing items decide */
+	if (op == Vi_EQ)
+		Vi_RETURN_FALSE;
+	if (op == Vi_NE)
+		Vi_RETURN_TRUE;
+	return ViObject_RichCompare(v->ob_items[i], w->ob_items[i], op);
+}
+
 static ViSequenceMethods tuple_sequence_methods = {
 	(lenfunc)tuple_length,		// sq_length
 	0,	// sq_concat
@@ -61,40 +167,62 @@ ViTypeObject ViTupleType = {
 	VAROBJECT_HEAD_INIT(&ViTupleType, 0)	// base
 	"tuple",								// tp_name
 	"Tuple object type",					// tp_doc
-	sizeof(ViTupleObject),					// tp_size
-	0,										// tp_itemsize
-	TPFLAGS_DEFAULT | TPFLAGS_BASETYPE |	// tp_flags
-		TPFLAGS_TUPLE_SUBCLASS,
+	sizeof(ViTupleObject) - sizeof(ViObject*),	// tp_size
+	sizeof(ViObject*),						// tp_itemsize
+	TPFLAGS_DEFAULT | TPFLAGS_HAVE_GC |		// tp_flags
+		TPFLAGS_BASETYPE | TPFLAGS_TUPLE_SUBCLASS,
 	(destructor)tuple_dealloc,				// tp_dealloc
 	0,										// tp_number_methods
 	&tuple_sequence_methods,				// tp_sequence_methods
+	(hashfunc)tuple_hash,					// tp_hash
+	(traverseproc)tuple_traverse,			// tp_traverse
 	0,										// tp_clear
+	tuple_richcompare,						// tp_richcompare
 	&ViBaseObjectType,						// tp_base
 	0,										// tp_dict
 	0,										// tp_new
-	Mem_Free								// tp_free
+	ViObject_GC_Del,							// tp_free
+	0,										// tp_cached_keys
 };
 
 ViObject* ViTupleObject_New(Vi_size_t size)
 {
 	ViTupleObject* obj;
-	size_t alloc;
 
-	obj = ViObject_NEW(ViTupleObject, &ViTupleType);
-	if (obj == NULL)
+	if (size < 0)
+	{
+		ViError_BadInternalCall();
 		return NULL;
+	}
 	if (size == 0)
 	{
-		obj->ob_items = NULL;
-		alloc = 0;
+		if (empty_tuple == NULL)
+		{
+			empty_tuple = ViObject_NEWVAR(ViTupleObject, &ViTupleType, 0);
+			if (empty_tuple == NULL)
+				return NULL;
+			empty_tuple->ob_hash = -1;
+			ViObject_SET_IMMORTAL(empty_tuple);
+		}
+		return (ViObject*)empty_tuple;
+	}
+	if (size < ViTuple_MAXSAVESIZE && (obj = free_list[size]) != NULL)
+	{
+		free_list[size] = (ViTupleObject*)obj->ob_items[0];
+		numfree[size]--;
+		free_list_hits++;
+		ObjectInit((ViObject*)obj, &ViTupleType);
 	}
 	else
 	{
-		alloc = size * sizeof(ViObject*);
-		obj->ob_items = (ViObject**)Mem_Alloc(alloc);
+		free_list_misses++;
+		obj = ViObject_NEWVAR(ViTupleObject, &ViTupleType, size);
+		if (obj == NULL)
+			return NULL;
 	}
-	VAROBJECT_SET_SIZE(obj, size);
-
+	obj->ob_hash = -1;
+	memset(obj->ob_items, 0, size * sizeof(ViObject*));
+	ViObject_GC_Track(obj);
 	return (ViObject*)obj;
 }
 
@@ -116,3 +244,32 @@ ViObject* ViTupleObject_FromArray(ViObject* const* src, Vi_size_t size)
 	}
 	return (ViObject*)tuple;
 }
+
+int ViTuple_ClearFreeList()
+{
+	int freed = 0;
+	for (Vi_size_t i = 1; i < ViTuple_MAXSAVESIZE; i++)
+	{
+		ViTupleObject *obj = free_list[i];
+		freed += numfree[i];
+		free_list[i] = NULL;
+		numfree[i] = 0;
+		while (obj != NULL)
+		{
+			ViTupleObject *next = (ViTupleObject*)obj->ob_items[0];
+			ViObject_GC_Del(obj);
+			obj = next;
+		}
+	}
+	return freed;
+}
+
+void ViTuple_GetFreeListStats(ViFreeListStats *stats)
+{
+	size_t size = 0;
+	for (Vi_size_t i = 1; i < ViTuple_MAXSAVESIZE; i++)
+		size += numfree[i];
+	stats->hits = free_list_hits;
+	stats->misses = free_list_misses;
+	stats->size = size;
+}
\ No newline at end of file
@@ -6,10 +6,12 @@
 typedef struct _tupleobject
 {
     ViObject_VAR_HEAD
-    /* ob_item contains space for 'ob_size' elements.
+    Vi_hash_t ob_hash; // Hash of the items, -1 until computed
+    /* ob_items contains space for 'ob_size' elements, allocated inline
+        after the header.
         Items must normally not be NULL, except during construction when
         the tuple is not yet visible outside the function that builds it. */
-    ViObject** ob_items;
+    ViObject* ob_items[1];
 } ViTupleObject;
 
 /* Type object */
@@ -20,6 +22,10 @@ ViObject* ViTupleObject_New(Vi_size_t size);
 
 ViObject* ViTupleObject_FromArray(ViObject* const* src, Vi_size_t size);
 
+/* Free list functions */
+int ViTuple_ClearFreeList();
+void ViTuple_GetFreeListStats(ViFreeListStats *stats);
+
 /* Type check macros */
 #define ViTuple_Check(self) ViObject_TypeCheck(self, &ViTupleType)
 #define ViTuple_CheckExact(self) Vi_IS_TYPE(self, &ViTupleType)
@@ -2408,10 +2408,22 @@ static int bad_single_statement(Parser *p)
 	}
 }
 
+static void memo_clear(Token *t)
+{
+	Memo *m = t->memo;
+	while (m != NULL)
+	{
+		Memo *next = m->next;
+		ViObject_Free(m);
+		m = next;
+	}
+	t->memo = NULL;
+}
+
 static void parser_reset_state(Parser *p)
 {
 	for (int i = 0; i < p->fill; i++)
-		p->tokens[i]->memo = NULL;
+		memo_clear(p->tokens[i]);
 	p->mark = 0;
 }
 
@@ -2463,15 +2475,15 @@ Parser *ViParser_New(TokState *tok, int mode, int *error_code, ViArena *arena)
 	if (!p->tokens)
 	{
 		Mem_Free(p->tokens);
-		ViError_SetString(ViExc_MemoryError, "out of memory");
+		ViError_NoMemory();
 		return NULL;
 	}
-	p->tokens[0] = (Token *)Mem_Calloc(1, sizeof(Token));
+	p->tokens[0] = (Token *)ViObject_Calloc(1, sizeof(Token));
 	if (!p->tokens)
 	{
-		Mem_Free(p->tokens[0]);
+		ViObject_Free(p->tokens[0]);
 		Mem_Free(p->tokens);
-		ViError_SetString(ViExc_MemoryError, "out of memory");
+		ViError_NoMemory();
 		return NULL;
 	}
 	p->size = 1;
@@ -2524,7 +2536,8 @@ void ViParser_Free(Parser *p)
 {
 	for (int i = 0; i < p->size; i++)
 	{
-		Mem_Free(p->tokens[i]);
+		memo_clear(p->tokens[i]);
+		ViObject_Free(p->tokens[i]);
 	}
 	Mem_Free(p->tokens);
 	Mem_Free(p);
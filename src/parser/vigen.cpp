@@ -193,7 +193,7 @@ int ViGen_IsMemoized(Parser *p, int type, void *pres)
 int ViGen_Memo_Insert(Parser *p, int mark, int type, void *node)
 {
 	// Insert in front
-	Memo *m = (Memo *)Mem_Alloc(sizeof(Memo));
+	Memo *m = (Memo *)ViObject_Malloc(sizeof(Memo));
 	if (m == NULL)
 		return -1;
 	m->type = type;
@@ -264,7 +264,7 @@ int ViGen_FillToken(Parser *p)
 
 		for (int i = p->size; i < newsize; i++)
 		{
-			p->tokens[i] = (Token *)Mem_Alloc(sizeof(Token));
+			p->tokens[i] = (Token *)ViObject_Malloc(sizeof(Token));
 			if (p->tokens[i] == NULL)
 			{
 				p->size = i; // Needed, in order to cleanup correctly after parser fails
@@ -278,7 +278,11 @@ int ViGen_FillToken(Parser *p)
 
 	Token *t = p->tokens[p->fill];
 	t->type = static_cast<token_type>((type == TOK_NAME) ? get_keyword_or_name_type(p, start, (int)(end - start)) : type);
-	t->value = ViStringObject_FromStringAndSize(start, end - start);
+	/* Names repeat a lot, they share one interned string per name */
+	if (type == TOK_NAME)
+		t->value = ViString_InternFromStringAndSize(start, end - start);
+	else
+		t->value = ViStringObject_FromStringAndSize(start, end - start);
 	if (t->value == NULL)
 		return TOK_UNKNOWN;
 
@@ -378,7 +382,7 @@ ast_stmt_seq *ViGen_InteractiveExit(Parser *p)
 static ViObject *parse_number_raw(const char *s)
 {
 	const char *end;
-	long x;
+	Vi_int64_t x;
 	double dx;
 	ViComplex compl;
 	int imflag;
@@ -387,26 +391,32 @@ static ViObject *parse_number_raw(const char *s)
 	errno = 0;
 	end = s + strlen(s) - 1;
 	imflag = *end == 'j' || *end == 'J';
+	/* strtoll() does not know the 0o and 0b prefixes */
+	if (s[0] == '0' && (s[1] == 'o' || s[1] == 'O' || s[1] == 'b' || s[1] == 'B'))
+	{
+		return ViIntObject_FromString(s, 0);
+	}
 	if (s[0] == '0')
 	{
-		
-		x = (long)strtoul(s, (char **)&end, 0);
-		if (x < 0 && errno == 0)
+		Vi_uint64_t ux = strtoull(s, (char **)&end, 0);
+		if (ux > (Vi_uint64_t)INT64_MAX && errno == 0)
 		{
 			return ViIntObject_FromString(s, 0);
 		}
+		x = (Vi_int64_t)ux;
 	}
 	else
 	{
-		x = strtol(s, (char **)&end, 0);
+		x = strtoll(s, (char **)&end, 0);
 	}
 	if (*end == '\0')
 	{
+		/* Literals too big for 64 bits become arbitrary precision ints */
 		if (errno != 0)
 		{
-			return ViIntObject_FromString(s,  0);
+			return ViIntObject_FromString(s, 0);
 		}
-		return ViIntObject_FromInt(x);
+		return ViIntObject_FromInt64(x);
 	}
 	// XXX Huge floats may silently fail
 	if (imflag)
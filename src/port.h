@@ -79,6 +79,21 @@ bool ValueIsIn(First&& first, T && ... t)
 /* Check if pointer "p" is aligned to "a"-bytes boundary. */
 #define Vi_IS_ALIGNED(p, a) (!((uintptr_t)(p) & (uintptr_t)((a) - 1)))
 
+/* For functions that read memory they may not own on purpose, which the
+   sanitizers would report.  Such a function must not be inlined into an
+   instrumented caller, so the macro also keeps it out of line. */
+#if defined(__clang__)
+#	define Vi_NO_SANITIZE __attribute__((noinline, no_sanitize("address", "thread", "memory")))
+#elif defined(__GNUC__)
+#	define Vi_NO_SANITIZE __attribute__((noinline, no_sanitize_address, no_sanitize_thread))
+#elif defined(_MSC_VER) && _MSC_VER >= 1928
+#	define Vi_NO_SANITIZE __declspec(noinline) __declspec(no_sanitize_address)
+#elif defined(_MSC_VER)
+#	define Vi_NO_SANITIZE __declspec(noinline)
+#else
+#	define Vi_NO_SANITIZE
+#endif
+
 #ifndef ViAPI_FUNC
 #   define ViAPI_FUNC(RTYPE) RTYPE
 #endif
@@ -0,0 +1,33 @@
+#include "vitest.h"
+
+#include "../core/viarena.h"
+
+/* The last allocation grows and shrinks in place, anything else moves */
+int test_arena()
+{
+	ViArena *arena = ViArena_New();
+	VI_CHECK(arena != NULL);
+
+	char *p = (char *)ViArena_Alloc(arena, 10);
+	VI_CHECK(p != NULL);
+	memset(p, 'x', 10);
+	VI_CHECK(ViArena_Realloc(arena, p, 10, 100) == p);
+	VI_CHECK(ViArena_Realloc(arena, p, 100, 20) == p);
+
+	/* No longer the last one, the bytes are copied */
+	char *other = (char *)ViArena_Alloc(arena, 16);
+	VI_CHECK(other != NULL);
+	char *moved = (char *)ViArena_Realloc(arena, p, 20, 40);
+	VI_CHECK(moved != NULL && moved != p);
+	VI_CHECK(memcmp(moved, "xxxxxxxxxx", 10) == 0);
+
+	/* Past the end of its block it moves too */
+	char *big = (char *)ViArena_Realloc(arena, moved, 40, 1 << 20);
+	VI_CHECK(big != NULL && big != moved);
+	VI_CHECK(memcmp(big, "xxxxxxxxxx", 10) == 0);
+	big[(1 << 20) - 1] = 'y';
+
+	VI_CHECK(ViArena_Realloc(arena, NULL, 0, 8) != NULL);
+	ViArena_Free(arena);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "vitest.h"
+
+#include "../core/runtime.h"
+#include "../core/viarena.h"
+
+/* A released arena comes back from the next acquire with its blocks */
+int test_arenacache()
+{
+	ViThreadState *tstate = ViThreadState_GET();
+	ViArena_ClearCache(tstate);
+
+	ViArena *arena = ViArena_Acquire();
+	VI_CHECK(arena != NULL);
+	ViObject *list = ViListObject_New(0);
+	VI_CHECK(list != NULL);
+	VI_CHECK(ViArena_AddViObject(arena, list) == 0);
+	void *first = ViArena_Alloc(arena, 16);
+	VI_CHECK(first != NULL);
+	for (int i = 0; i < 100; i++)
+		VI_CHECK(ViArena_Alloc(arena, 4000) != NULL);
+	ViArena_Release(arena);
+
+	ViArena *again = ViArena_Acquire();
+	VI_CHECK(again == arena);
+	VI_CHECK(ViArena_Alloc(again, 16) == first);
+	ViArenaStats stats;
+	ViArena_GetStats(again, &stats);
+	VI_CHECK(stats.objects == 0);
+
+	/* Reset keeps the first blocks */
+	for (int i = 0; i < 100; i++)
+		VI_CHECK(ViArena_Alloc(again, 4000) != NULL);
+	ViArena_Reset(again, 3);
+	ViArena_GetStats(again, &stats);
+	VI_CHECK(stats.blocks <= 3);
+	VI_CHECK(ViArena_Alloc(again, 16) == first);
+
+	ViArena_Release(again);
+	ViArena_ClearCache(tstate);
+	ViArena *fresh = ViArena_Acquire();
+	VI_CHECK(fresh != NULL);
+	ViArena_Free(fresh);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "vitest.h"
+
+typedef struct _bigcase
+{
+	const char *op;
+	const char *a;
+	const char *b;
+	const char *expected;
+} BigCase;
+
+/* Results worked out by Python */
+static BigCase cases[] = {
+	{ "+", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "123456788913580246791358024679135802468" },
+	{ "-", "-98765432109876543210987654321", "123456789012345678901234567890123456789", "-123456789111111111011111111101111111110" },
+	{ "*", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "-12193263113702179522618503273374485596336229233322374638011112635269" },
+	{ "//", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "-1249999989" },
+	{ "%", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "-38580246903858024690262345680" },
+	{ "//", "-98765432109876543210987654321", "97", "-1018200331029655084649357262" },
+	{ "%", "-98765432109876543210987654321", "97", "93" },
+	{ "**", "3", "200", "265613988875874769338781322035779626829233452653394495974574961739092490901302182994384699044001" },
+	{ "**", "-18446744073709551629", "5", "-2135987035920910089921507506595104827743120480724857278768078337562830676482991624403573964909149" },
+	{ "<<", "123456789012345678901234567890123456789", "100", "156500072693749876333549759455083473609492697353681459748461728497664" },
+	{ ">>", "-98765432109876543210987654321", "40", "-89826637222246558" },
+	{ "&", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "123456788923212972487441294508886098181" },
+	{ "|", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "-9632725696083269829750295713" },
+	{ "^", "123456789012345678901234567890123456789", "-98765432109876543210987654321", "-123456788932845698183524564338636393894" },
+	{ "*", "4611686018427387904", "4611686018427387904", "21267647932558653966460912964485513216" },
+	{ "-", "-9223372036854775808", "1", "-9223372036854775809" },
+	{ NULL, NULL, NULL, NULL }
+};
+
+typedef struct _powmodcase
+{
+	const char *base;
+	const char *exponent;
+	const char *modulus;
+	const char *expected;
+} PowModCase;
+
+static PowModCase powmod_cases[] = {
+	{ "123456789012345678901234567890123456789", "98765432109876543210987654321", "18446744073709551629", "7013479645069394603" },
+	{ "2", "1000000000000000000000000000000", "1000000007", "312267046" },
+	{ "-123456789012345678901234567890123456789", "65537", "98765432109876543210987654321", "45446047882739600167056058254" },
+	{ "7", "0", "13", "1" },
+	{ "5", "3", "-13", "-5" },
+	{ "12345678901234567890", "98765", "1", "0" },
+	{ NULL, NULL, NULL, NULL }
+};
+
+static ViObject *apply(const char *op, ViObject *a, ViObject *b)
+{
+	ViNumberMethods *nb = ViIntType.tp_number_methods;
+
+	if (strcmp(op, "+") == 0)
+		return nb->nb_add(a, b);
+	if (strcmp(op, "-") == 0)
+		return nb->nb_subtract(a, b);
+	if (strcmp(op, "*") == 0)
+		return nb->nb_multiply(a, b);
+	if (strcmp(op, "//") == 0)
+		return nb->nb_floor_divide(a, b);
+	if (strcmp(op, "%") == 0)
+		return nb->nb_remainder(a, b);
+	if (strcmp(op, "**") == 0)
+		return nb->nb_power(a, b, NULL);
+	if (strcmp(op, "<<") == 0)
+		return nb->nb_lshift(a, b);
+	if (strcmp(op, ">>") == 0)
+		return nb->nb_rshift(a, b);
+	if (strcmp(op, "&") == 0)
+		return nb->nb_and(a, b);
+	if (strcmp(op, "|") == 0)
+		return nb->nb_or(a, b);
+	return nb->nb_xor(a, b);
+}
+
+static int check_text(ViObject *text, const char *expected)
+{
+	VI_CHECK(text != NULL);
+	VI_CHECK(strcmp(ViString_AS_STRING(text), expected) == 0);
+	ViObject_DECREF(text);
+	return 0;
+}
+
+/* The decimal text of result is expected */
+static int check_result(ViObject *result, const char *expected)
+{
+	VI_CHECK(result != NULL);
+	VI_CHECK(check_text(ViInt_Format(result, 10), expected) == 0);
+	ViObject_DECREF(result);
+	return 0;
+}
+
+int test_bigint()
+{
+	ViNumberMethods *nb = ViIntType.tp_number_methods;
+
+	for (BigCase *c = cases; c->op != NULL; c++)
+	{
+		ViObject *a = ViIntObject_FromString(c->a, 10);
+		ViObject *b = ViIntObject_FromString(c->b, 10);
+		VI_CHECK(a != NULL && b != NULL);
+		VI_CHECK(check_result(apply(c->op, a, b), c->expected) == 0);
+		ViObject_DECREF(a);
+		ViObject_DECREF(b);
+	}
+
+	for (PowModCase *c = powmod_cases; c->base != NULL; c++)
+	{
+		ViObject *base = ViIntObject_FromString(c->base, 10);
+		ViObject *exponent = ViIntObject_FromString(c->exponent, 10);
+		ViObject *modulus = ViIntObject_FromString(c->modulus, 10);
+		VI_CHECK(base != NULL && exponent != NULL && modulus != NULL);
+		VI_CHECK(check_result(nb->nb_power(base, exponent, modulus), c->expected) == 0);
+		ViObject_DECREF(base);
+		ViObject_DECREF(exponent);
+		ViObject_DECREF(modulus);
+	}
+
+	/* No modular inverse, and no modulus of 0 */
+	ViObject *two = ViIntObject_FromInt(2);
+	VI_CHECK(nb->nb_power(two, ViIntObject_FromInt(-1), ViIntObject_FromInt(7)) == NULL);
+	VI_CHECK(ViThreadState_GET()->curr_exc_type == ViExc_ValueError);
+	ViError_Clear();
+	VI_CHECK(nb->nb_power(two, two, ViIntObject_FromInt(0)) == NULL);
+	VI_CHECK(ViThreadState_GET()->curr_exc_type == ViExc_ValueError);
+	ViError_Clear();
+
+	ViObject *big = ViIntObject_FromString("-98765432109876543210987654321", 10);
+	VI_CHECK(nb->nb_floor_divide(big, ViIntObject_FromInt(0)) == NULL);
+	VI_CHECK(ViThreadState_GET()->curr_exc_type == ViExc_ZeroDivisionError);
+	ViError_Clear();
+
+	/* Power of two bases */
+	VI_CHECK(check_text(ViInt_Format(big, 16), "-0x13f20d9c2fff89d38e1c70cb1") == 0);
+	VI_CHECK(check_text(ViInt_Format(big, 8), "-0o117620331605777704723434161606261") == 0);
+	VI_CHECK(check_text(ViInt_Format(big, 2), "-0b1001111110010000011011001110000101111111111111000100111010011100011100001110001110000110010110001") == 0);
+	ViObject_DECREF(big);
+	big = ViIntObject_FromString("0x5ce0e9a56015fec5aadfa328ae398115", 0);
+	VI_CHECK(check_result(big, "123456789012345678901234567890123456789") == 0);
+	return 0;
+}
\ No newline at end of file
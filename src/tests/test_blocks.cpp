@@ -0,0 +1,61 @@
+#include "vitest.h"
+
+#define HUGE_PAGE_SIZE (2 << 20)
+
+int test_blocks()
+{
+	ViMemBlockConfig saved, config;
+	ViMemBlockStats stats;
+
+	ViMem_GetBlockConfig(&saved);
+	config = saved;
+	config.cache_blocks = 4;
+	config.huge_pages = 0;
+	VI_CHECK(ViMem_SetBlockConfig(&config) == 0);
+
+	/* Sizes are rounded up to whole pages */
+	VI_CHECK(ViMem_BlockSize(1) >= 1);
+	VI_CHECK(ViMem_BlockSize(ViMem_BlockSize(1) + 1) == 2 * ViMem_BlockSize(1));
+
+	/* Small blocks come from the raw allocator and are not cached */
+	void *small = ViMem_BlockAlloc(8192);
+	VI_CHECK(small != NULL);
+	ViMem_BlockFree(small, 8192);
+	ViMem_GetBlockStats(&stats);
+	VI_CHECK(stats.cached_blocks == 0);
+
+	/* Mapped blocks are page aligned and a freed one is reused */
+	void *block = ViMem_BlockAlloc(1 << 20);
+	VI_CHECK(block != NULL);
+	VI_CHECK(((uintptr_t)block & (ViMem_BlockSize(1) - 1)) == 0);
+	memset(block, 1, 1 << 20);
+	ViMem_BlockFree(block, 1 << 20);
+	ViMem_GetBlockStats(&stats);
+	VI_CHECK(stats.cached_blocks == 1);
+	size_t hits = stats.cache_hits;
+	block = ViMem_BlockAlloc(1 << 20);
+	VI_CHECK(block != NULL);
+	ViMem_GetBlockStats(&stats);
+	VI_CHECK(stats.cache_hits == hits + 1);
+	VI_CHECK(stats.cached_blocks == 0);
+	memset(block, 2, 1 << 20);
+	ViMem_BlockFree(block, 1 << 20);
+
+	/* Huge page blocks are aligned to the huge page size */
+	config.huge_pages = 1;
+	VI_CHECK(ViMem_SetBlockConfig(&config) == 0);
+	block = ViMem_BlockAlloc(2 * HUGE_PAGE_SIZE);
+	VI_CHECK(block != NULL);
+	VI_CHECK(((uintptr_t)block & (HUGE_PAGE_SIZE - 1)) == 0);
+	memset(block, 3, 2 * HUGE_PAGE_SIZE);
+	ViMem_BlockFree(block, 2 * HUGE_PAGE_SIZE);
+
+	/* Turning the cache off empties it */
+	config.cache_blocks = 0;
+	VI_CHECK(ViMem_SetBlockConfig(&config) == 0);
+	ViMem_GetBlockStats(&stats);
+	VI_CHECK(stats.cached_blocks == 0);
+
+	VI_CHECK(ViMem_SetBlockConfig(&saved) == 0);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "vitest.h"
+
+#include "../objects/boolobject.h"
+
+#define NKEYS 10000
+
+static ViObject *key_for(int i)
+{
+	/* Odd keys are ints, even ones strings */
+	if (i & 1)
+		return ViIntObject_FromInt(i);
+	char text[16];
+	snprintf(text, sizeof(text), "key%d", i);
+	return ViStringObject_FromString(text);
+}
+
+/* Lookups, deletion and iteration in insertion order */
+static int check_combined()
+{
+	ViObject *dict = ViDictObject_New();
+	VI_CHECK(dict != NULL);
+	VI_CHECK(((ViDictObject *)dict)->ma_values == NULL);
+
+	for (int i = 0; i < NKEYS; i++)
+	{
+		ViObject *key = key_for(i);
+		VI_CHECK(ViDict_SetItem(dict, key, key) == 0);
+		ViObject_DECREF(key);
+	}
+	for (int i = 0; i < NKEYS; i += 3)
+	{
+		ViObject *key = key_for(i);
+		VI_CHECK(ViDict_DelItem(dict, key) == 0);
+		VI_CHECK(ViDict_DelItem(dict, key) == -1);
+		ViError_Clear();
+		ViObject_DECREF(key);
+	}
+	VI_CHECK(ViDict_Size(dict) == NKEYS - (NKEYS + 2) / 3);
+	for (int i = 0; i < NKEYS; i++)
+	{
+		ViObject *key = key_for(i);
+		ViObject *value = ViDict_GetItemWithError(dict, key);
+		VI_CHECK(!ViError_Occurred());
+		if (i % 3 == 0)
+			VI_CHECK(value == NULL);
+		else
+			VI_CHECK(value != NULL && ViObject_RichCompareBool(value, key, Vi_EQ) == 1);
+		ViObject_DECREF(key);
+	}
+
+	Vi_size_t pos = 0;
+	ViObject *key, *value;
+	int expected = 1;
+	while (ViDict_Next(dict, &pos, &key, &value))
+	{
+		ViObject *want = key_for(expected);
+		VI_CHECK(ViObject_RichCompareBool(key, want, Vi_EQ) == 1);
+		ViObject_DECREF(want);
+		expected += expected % 3 == 1 ? 1 : 2;
+	}
+	VI_CHECK(expected >= NKEYS);
+
+	/* True and 1 are the same key */
+	ViObject *one = ViIntObject_FromInt(1);
+	VI_CHECK(ViDict_GetItemWithError(dict, Vi_True) == one);
+
+	ViObject *copy = ViDict_Copy(dict);
+	VI_CHECK(copy != NULL && ViDict_Size(copy) == ViDict_Size(dict));
+	ViObject_DECREF(copy);
+	ViDict_Clear(dict);
+	VI_CHECK(ViDict_Size(dict) == 0);
+	ViObject_DECREF(dict);
+	return 0;
+}
+
+/* Instance dicts of one type share their keys until one of them adds keys
+   in another order, deletes one or uses a key that is not a string */
+static int check_split()
+{
+	static ViTypeObject type = {};
+	type.tp_name = "split";
+	ViObject *one = ViIntObject_FromInt(1);
+	ViObject *two = ViIntObject_FromInt(2);
+
+	ViObject *a = ViDictObject_NewForInstance(&type);
+	ViObject *b = ViDictObject_NewForInstance(&type);
+	VI_CHECK(a != NULL && b != NULL);
+	VI_CHECK(ViDict_SetItemString(a, "x", one) == 0);
+	VI_CHECK(ViDict_SetItemString(a, "y", one) == 0);
+	VI_CHECK(ViDict_SetItemString(b, "x", two) == 0);
+	VI_CHECK(ViDict_SetItemString(b, "y", two) == 0);
+	VI_CHECK(((ViDictObject *)a)->ma_values != NULL);
+	VI_CHECK(((ViDictObject *)b)->ma_values != NULL);
+	VI_CHECK(((ViDictObject *)a)->ma_keys == ((ViDictObject *)b)->ma_keys);
+	VI_CHECK(ViDict_GetItemString(a, "y") == one);
+	VI_CHECK(ViDict_GetItemString(b, "y") == two);
+
+	/* A key added after the shared ones is shared too, the other dicts
+	   just have no value for it */
+	VI_CHECK(ViDict_SetItemString(a, "z", one) == 0);
+	VI_CHECK(((ViDictObject *)a)->ma_values != NULL);
+	VI_CHECK(ViDict_GetItemString(b, "z") == NULL);
+	VI_CHECK(ViDict_Size(a) == 3 && ViDict_Size(b) == 2);
+
+	ViObject *copy = ViDict_Copy(a);
+	VI_CHECK(copy != NULL && ViDict_Size(copy) == 3);
+	VI_CHECK(ViDict_GetItemString(copy, "z") == one);
+	ViObject_DECREF(copy);
+
+	/* Out of order */
+	ViObject *c = ViDictObject_NewForInstance(&type);
+	VI_CHECK(ViDict_SetItemString(c, "y", one) == 0);
+	VI_CHECK(((ViDictObject *)c)->ma_values == NULL);
+	VI_CHECK(ViDict_GetItemString(c, "y") == one);
+
+	/* Deleted */
+	ViObject *key = ViStringObject_FromString("x");
+	VI_CHECK(ViDict_DelItem(b, key) == 0);
+	ViObject_DECREF(key);
+	VI_CHECK(((ViDictObject *)b)->ma_values == NULL);
+	VI_CHECK(ViDict_GetItemString(b, "x") == NULL && ViDict_GetItemString(b, "y") == two);
+
+	/* Not a string */
+	ViObject *d = ViDictObject_NewForInstance(&type);
+	VI_CHECK(ViDict_SetItem(d, one, one) == 0);
+	VI_CHECK(((ViDictObject *)d)->ma_values == NULL);
+
+	/* Past the size of the shared keys */
+	ViObject *e = ViDictObject_NewForInstance(&type);
+	for (int i = 0; i < 40; i++)
+	{
+		char text[16];
+		snprintf(text, sizeof(text), "k%d", i);
+		VI_CHECK(ViDict_SetItemString(e, text, one) == 0);
+	}
+	VI_CHECK(ViDict_Size(e) == 40);
+	VI_CHECK(ViDict_GetItemString(e, "k39") == one);
+
+	ViObject_DECREF(a);
+	ViObject_DECREF(b);
+	ViObject_DECREF(c);
+	ViObject_DECREF(d);
+	ViObject_DECREF(e);
+	ViDict_ClearCachedKeys(&type);
+	return 0;
+}
+
+int test_dict()
+{
+	if (check_combined() != 0)
+		return 1;
+	return check_split();
+}
\ No newline at end of file
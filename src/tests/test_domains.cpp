@@ -0,0 +1,69 @@
+#include "vitest.h"
+
+/* A hook counting the calls of a domain and forwarding them to the
+   allocator it replaced, which it gets as its context */
+typedef struct _counthook
+{
+	ViMemAllocator next;
+	int allocs;
+	int frees;
+} CountHook;
+
+static void *hook_malloc(void *ctx, size_t size)
+{
+	CountHook *hook = (CountHook *)ctx;
+	hook->allocs++;
+	return hook->next.malloc(hook->next.ctx, size);
+}
+
+static void *hook_calloc(void *ctx, size_t elemCount, size_t elemSize)
+{
+	CountHook *hook = (CountHook *)ctx;
+	hook->allocs++;
+	return hook->next.calloc(hook->next.ctx, elemCount, elemSize);
+}
+
+static void *hook_realloc(void *ctx, void *ptr, size_t new_size)
+{
+	CountHook *hook = (CountHook *)ctx;
+	return hook->next.realloc(hook->next.ctx, ptr, new_size);
+}
+
+static void hook_free(void *ctx, void *ptr)
+{
+	CountHook *hook = (CountHook *)ctx;
+	hook->frees++;
+	hook->next.free(hook->next.ctx, ptr);
+}
+
+static int check_domain(ViMemAllocatorDomain domain, void *(*alloc)(size_t), void (*release)(void *))
+{
+	CountHook hook = { {}, 0, 0 };
+	ViMemAllocator allocator = { &hook, hook_malloc, hook_calloc, hook_realloc, hook_free };
+	ViMemAllocator current;
+
+	ViMem_GetAllocator(domain, &hook.next);
+	ViMem_SetAllocator(domain, &allocator);
+	ViMem_GetAllocator(domain, &current);
+	VI_CHECK(current.ctx == &hook && current.malloc == hook_malloc);
+
+	void *p = alloc(100);
+	VI_CHECK(p != NULL);
+	release(p);
+	VI_CHECK(hook.allocs == 1);
+	VI_CHECK(hook.frees == 1);
+
+	ViMem_SetAllocator(domain, &hook.next);
+	p = alloc(100);
+	release(p);
+	VI_CHECK(hook.allocs == 1);
+	return 0;
+}
+
+int test_domains()
+{
+	VI_CHECK(check_domain(ViMem_DOMAIN_RAW, ViMem_RawMalloc, ViMem_RawFree) == 0);
+	VI_CHECK(check_domain(ViMem_DOMAIN_MEM, Mem_Alloc, Mem_Free) == 0);
+	VI_CHECK(check_domain(ViMem_DOMAIN_OBJ, ViObject_Malloc, ViObject_Free) == 0);
+	return 0;
+}
\ No newline at end of file
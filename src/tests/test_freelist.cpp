@@ -0,0 +1,65 @@
+#include "vitest.h"
+
+#include "../objects/complexobject.h"
+
+static ViObject *new_int()
+{
+	/* Too big to be tagged */
+	return ViIntObject_FromInt64(INT64_MAX);
+}
+
+static ViObject *new_float()
+{
+	return ViFloatObject_FromDouble(1.5);
+}
+
+static ViObject *new_complex()
+{
+	return ViComplexObject_FromDoubles(1.0, 2.0);
+}
+
+static ViObject *new_tuple()
+{
+	return ViTupleObject_New(3);
+}
+
+static ViObject *new_list()
+{
+	return ViListObject_New(0);
+}
+
+/* A released object is kept on the free list of its type and handed out
+   again by the next allocation */
+static int check_reuse(ViObject *(*make)(), int (*clear)(), void (*get_stats)(ViFreeListStats *))
+{
+	ViFreeListStats before, after;
+
+	clear();
+	ViObject *first = make();
+	VI_CHECK(first != NULL);
+	ViObject_DECREF(first);
+	get_stats(&before);
+	VI_CHECK(before.size == 1);
+
+	ViObject *second = make();
+	get_stats(&after);
+	VI_CHECK(second == first);
+	VI_CHECK(after.hits == before.hits + 1);
+	VI_CHECK(after.size == 0);
+
+	ViObject_DECREF(second);
+	VI_CHECK(clear() == 1);
+	get_stats(&after);
+	VI_CHECK(after.size == 0);
+	return 0;
+}
+
+int test_freelist()
+{
+	VI_CHECK(check_reuse(new_int, ViInt_ClearFreeList, ViInt_GetFreeListStats) == 0);
+	VI_CHECK(check_reuse(new_float, ViFloat_ClearFreeList, ViFloat_GetFreeListStats) == 0);
+	VI_CHECK(check_reuse(new_complex, ViComplex_ClearFreeList, ViComplex_GetFreeListStats) == 0);
+	VI_CHECK(check_reuse(new_tuple, ViTuple_ClearFreeList, ViTuple_GetFreeListStats) == 0);
+	VI_CHECK(check_reuse(new_list, ViList_ClearFreeList, ViList_GetFreeListStats) == 0);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "vitest.h"
+
+/* Unreachable reference cycles are found and freed, reachable ones are
+   left alone */
+int test_gc()
+{
+	ViMemAccount *saved = ViMem_GetAccount();
+	ViMemAccount account;
+	int enabled = ViGC_Disable();
+
+	ViGC_Collect();
+	VI_CHECK(ViMem_InitAccount(&account) == 0);
+	ViMem_SetAccount(&account);
+
+	/* A list holding itself, and a list and a tuple holding each other */
+	ViObject *self = ViListObject_New(0);
+	VI_CHECK(self != NULL);
+	VI_CHECK(ViList_Append(self, self) == 0);
+	ViObject *list = ViListObject_New(0);
+	ViObject *tuple = ViTupleObject_New(1);
+	VI_CHECK(list != NULL && tuple != NULL);
+	ViObject_INCREF(list);
+	((ViTupleObject *)tuple)->ob_items[0] = list;
+	VI_CHECK(ViList_Append(list, tuple) == 0);
+	ViObject_DECREF(tuple);
+	ViObject_DECREF(list);
+	ViObject_DECREF(self);
+
+	ViObject *keep = ViListObject_New(0);
+	VI_CHECK(keep != NULL);
+	VI_CHECK(ViList_Append(keep, keep) == 0);
+
+	ViGCStats before, after;
+	VI_CHECK(ViGC_GetStats(2, &before) == 0);
+	VI_CHECK(ViGC_Collect() == 3);
+	VI_CHECK(ViGC_GetStats(2, &after) == 0);
+	VI_CHECK(after.collections == before.collections + 1);
+	VI_CHECK(ViObject_GC_IS_TRACKED(keep));
+	VI_CHECK(ViList_GET_ITEM(keep, 0) == keep);
+
+	ViObject_DECREF(keep);
+	VI_CHECK(ViGC_Collect() == 1);
+	VI_CHECK(ViGC_Collect() == 0);
+
+	/* Everything went back, once the free lists let go of it too */
+	ViObject_ClearFreeLists();
+	VI_CHECK(account.used == 0);
+
+	ViMem_ReleaseAccount(&account);
+	ViMem_SetAccount(saved);
+	if (enabled)
+		ViGC_Enable();
+	return 0;
+}
\ No newline at end of file
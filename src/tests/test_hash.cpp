@@ -0,0 +1,62 @@
+#include "vitest.h"
+
+#include "../core/vihash.h"
+#include "../objects/boolobject.h"
+
+static Vi_hash_t hash_of(ViObject *obj)
+{
+	Vi_hash_t hash = ViObject_Hash(obj);
+	ViObject_DECREF(obj);
+	return hash;
+}
+
+int test_hash()
+{
+	/* Strings hash their bytes once and keep the result */
+	ViObject *str = ViStringObject_FromString("hash me once");
+	VI_CHECK(str != NULL);
+	VI_CHECK(((ViStringObject *)str)->ob_shash == -1);
+	Vi_hash_t hash = ViString_Hash(str);
+	VI_CHECK(hash != -1);
+	VI_CHECK(((ViStringObject *)str)->ob_shash == hash);
+	VI_CHECK(ViObject_Hash(str) == hash);
+	VI_CHECK(ViHash_Bytes("hash me once", 12) == hash);
+	VI_CHECK(hash_of(ViStringObject_FromString("hash me once")) == hash);
+	VI_CHECK(hash_of(ViStringObject_FromString("hash me twice")) != hash);
+	VI_CHECK(ViHash_Bytes("", 0) == 0);
+	ViObject_DECREF(str);
+
+	/* Numbers that compare equal hash equal, modulo 2^61 - 1 */
+	VI_CHECK(hash_of(ViIntObject_FromInt(2)) == 2);
+	VI_CHECK(hash_of(ViFloatObject_FromDouble(2.0)) == 2);
+	VI_CHECK(ViObject_Hash(Vi_True) == 1);
+	VI_CHECK(hash_of(ViIntObject_FromInt(-1)) == -2);
+	VI_CHECK(hash_of(ViIntObject_FromString("2305843009213693951", 10)) == 0);
+	VI_CHECK(hash_of(ViIntObject_FromString("2305843009213693952", 10)) == 1);
+	VI_CHECK(hash_of(ViIntObject_FromString("-2305843009213693952", 10)) == -2);
+	VI_CHECK(hash_of(ViFloatObject_FromDouble(1e20)) == hash_of(ViIntObject_FromString("100000000000000000000", 10)));
+	VI_CHECK(hash_of(ViFloatObject_FromDouble(1.5)) == hash_of(ViFloatObject_FromDouble(1.5)));
+
+	/* Tuples combine the hashes of their items and keep the result */
+	ViObject *tuple = ViTupleObject_New(2);
+	ViObject *other = ViTupleObject_New(2);
+	VI_CHECK(tuple != NULL && other != NULL);
+	ViTuple_SET_ITEM(tuple, 0, ViIntObject_FromInt(1));
+	ViTuple_SET_ITEM(tuple, 1, ViStringObject_FromString("two"));
+	ViTuple_SET_ITEM(other, 0, ViFloatObject_FromDouble(1.0));
+	ViTuple_SET_ITEM(other, 1, ViStringObject_FromString("two"));
+	hash = ViObject_Hash(tuple);
+	VI_CHECK(hash != -1);
+	VI_CHECK(((ViTupleObject *)tuple)->ob_hash == hash);
+	VI_CHECK(ViObject_Hash(other) == hash);
+	ViObject_DECREF(tuple);
+	ViObject_DECREF(other);
+
+	/* Mutable containers are not hashable */
+	ViObject *list = ViListObject_New(0);
+	VI_CHECK(ViObject_Hash(list) == -1);
+	VI_CHECK(ViError_Occurred());
+	ViError_Clear();
+	ViObject_DECREF(list);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "vitest.h"
+
+#include "../objects/boolobject.h"
+
+/* Reference counting leaves an immortal object's count alone */
+static int check_untouched(ViObject *obj)
+{
+	intptr_t refcount = obj->ob_refcount;
+
+	VI_CHECK(ViObject_IS_IMMORTAL(obj));
+	for (int i = 0; i < 1000; i++)
+		ViObject_INCREF(obj);
+	VI_CHECK(obj->ob_refcount == refcount);
+	for (int i = 0; i < 2000; i++)
+		ViObject_DECREF(obj);
+	VI_CHECK(obj->ob_refcount == refcount);
+	return 0;
+}
+
+int test_immortal()
+{
+	VI_CHECK(check_untouched(Vi_Null) == 0);
+	VI_CHECK(check_untouched(Vi_True) == 0);
+	VI_CHECK(check_untouched(Vi_False) == 0);
+	VI_CHECK(check_untouched((ViObject *)&ViIntType) == 0);
+	VI_CHECK(check_untouched((ViObject *)&ViListType) == 0);
+	VI_CHECK(check_untouched(ViString_InternFromString("immortal")) == 0);
+
+	ViObject *value = ViFloatObject_FromDouble(2.5);
+	VI_CHECK(value != NULL);
+	VI_CHECK(!ViObject_IS_IMMORTAL(value));
+	ViObject_SET_IMMORTAL(value);
+	VI_CHECK(check_untouched(value) == 0);
+	VI_CHECK(((ViFloatObject *)value)->ob_fval == 2.5);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "vitest.h"
+
+Vi_IDENTIFIER(interned_identifier);
+
+/* One interned string per contents */
+int test_intern()
+{
+	Vi_size_t size = ViString_InternedSize();
+
+	ViObject *name = ViString_InternFromString("interned_name");
+	VI_CHECK(name != NULL);
+	VI_CHECK(ViString_CHECK_INTERNED(name));
+	VI_CHECK(ViObject_IS_IMMORTAL(name));
+	VI_CHECK(ViString_InternFromString("interned_name") == name);
+	VI_CHECK(ViString_InternFromStringAndSize("interned_name_too", 13) == name);
+	VI_CHECK(ViString_InternedSize() == size + 1);
+
+	/* A string with the same contents is replaced by the interned one */
+	ViObject *str = ViStringObject_FromString("interned_name");
+	VI_CHECK(str != NULL && str != name);
+	ViString_InternInPlace(&str);
+	VI_CHECK(str == name);
+
+	/* A string with new contents is interned itself */
+	ViObject *fresh = ViStringObject_FromString("interned_fresh");
+	ViObject *original = fresh;
+	ViString_InternInPlace(&fresh);
+	VI_CHECK(fresh == original);
+	VI_CHECK(ViString_CHECK_INTERNED(fresh));
+	VI_CHECK(ViString_InternFromString("interned_fresh") == fresh);
+
+	/* Identifiers are interned and cached */
+	ViObject *id = ViString_FromId(&ViId_interned_identifier);
+	VI_CHECK(id != NULL);
+	VI_CHECK(ViString_FromId(&ViId_interned_identifier) == id);
+	VI_CHECK(ViString_InternFromString("interned_identifier") == id);
+
+	/* The table grows */
+	size = ViString_InternedSize();
+	for (int i = 0; i < 5000; i++)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "interned_%d", i);
+		VI_CHECK(ViString_InternFromString(text) != NULL);
+	}
+	VI_CHECK(ViString_InternedSize() == size + 5000);
+	for (int i = 0; i < 5000; i += 499)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "interned_%d", i);
+		ViObject *again = ViStringObject_FromString(text);
+		ViString_InternInPlace(&again);
+		VI_CHECK(ViString_CHECK_INTERNED(again));
+		VI_CHECK(ViString_InternFromString(text) == again);
+	}
+	VI_CHECK(ViString_InternedSize() == size + 5000);
+	return 0;
+}
\ No newline at end of file
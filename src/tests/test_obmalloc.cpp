@@ -0,0 +1,92 @@
+#include "vitest.h"
+
+#define NBLOCKS 10000
+
+/* Blocks are aligned, keep their contents and a freed block is the
+   next one handed out for its size class */
+static int check_pools()
+{
+	static void *blocks[NBLOCKS];
+
+	for (int i = 0; i < NBLOCKS; i++)
+	{
+		size_t size = (size_t)i % 512 + 1;
+		blocks[i] = ViObject_Malloc(size);
+		VI_CHECK(blocks[i] != NULL);
+		VI_CHECK(((uintptr_t)blocks[i] & (sizeof(void *) - 1)) == 0);
+		memset(blocks[i], i & 0xFF, size);
+	}
+	for (int i = 0; i < NBLOCKS; i++)
+	{
+		size_t size = (size_t)i % 512 + 1;
+		unsigned char *bytes = (unsigned char *)blocks[i];
+		VI_CHECK(bytes[0] == (i & 0xFF) && bytes[size - 1] == (i & 0xFF));
+	}
+	for (int i = 0; i < NBLOCKS; i += 2)
+		ViObject_Free(blocks[i]);
+	for (int i = 1; i < NBLOCKS; i += 2)
+		ViObject_Free(blocks[i]);
+
+	void *p = ViObject_Malloc(40);
+	ViObject_Free(p);
+	VI_CHECK(ViObject_Malloc(40) == p);
+
+	/* Same size class, the block stays where it is */
+	VI_CHECK(ViObject_Realloc(p, 44) == p);
+
+	/* Bigger than any size class, the contents move along */
+	memset(p, 'x', 44);
+	unsigned char *big = (unsigned char *)ViObject_Realloc(p, 4000);
+	VI_CHECK(big != NULL);
+	VI_CHECK(big[0] == 'x' && big[43] == 'x');
+	ViObject_Free(big);
+
+	p = ViObject_Malloc(0);
+	VI_CHECK(p != NULL);
+	ViObject_Free(p);
+	return 0;
+}
+
+/* Blocks are charged to the current account and credited to it when
+   freed, whichever account is current then */
+static int check_accounts()
+{
+	ViMemAccount *saved = ViMem_GetAccount();
+	ViMemAccount a, b;
+
+	VI_CHECK(ViMem_InitAccount(&a) == 0);
+	VI_CHECK(ViMem_InitAccount(&b) == 0);
+
+	ViMem_SetAccount(&a);
+	void *p = ViObject_Malloc(40);
+	void *q = ViObject_Malloc(100);
+	VI_CHECK(p != NULL && q != NULL);
+	VI_CHECK(a.used == 48 + 112);
+
+	ViMem_SetAccount(&b);
+	ViObject_Free(p);
+	VI_CHECK(a.used == 112);
+	VI_CHECK(b.used == 0);
+
+	/* The pool of a stays with a, b gets its own */
+	void *r = ViObject_Malloc(40);
+	VI_CHECK(b.used == 48);
+	ViObject_Free(r);
+	VI_CHECK(b.used == 0);
+
+	ViMem_SetAccount(saved);
+	ViObject_Free(q);
+	VI_CHECK(a.used == 0);
+
+	ViMem_ReleaseAccount(&a);
+	ViMem_ReleaseAccount(&b);
+	ViMem_SetAccount(saved);
+	return 0;
+}
+
+int test_obmalloc()
+{
+	if (check_pools() != 0)
+		return 1;
+	return check_accounts();
+}
\ No newline at end of file
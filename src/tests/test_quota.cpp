@@ -0,0 +1,94 @@
+#include "vitest.h"
+
+#include "../core/runtime.h"
+
+/* Allocations past the interpreter's limit fail with a MemoryError that
+   says so, and the memory is given back as it is freed */
+static int check_limit()
+{
+	ViInterpreterState *interp = ViInterpreterState_GET();
+	ViThreadState *tstate = ViThreadState_GET();
+
+	ViObject *list = ViListObject_New(0);
+	VI_CHECK(list != NULL);
+	size_t base = ViInterpreterState_GetMemoryUsage(interp);
+	size_t refused = interp->mem_account.refused;
+	ViInterpreterState_SetMemoryLimit(interp, base + 100000);
+
+	int appended = 0;
+	for (;;)
+	{
+		ViObject *str = ViStringObject_FromString("a string that is charged to the interpreter");
+		if (str == NULL)
+			break;
+		int status = ViList_Append(list, str);
+		ViObject_DECREF(str);
+		if (status < 0)
+			break;
+		appended++;
+	}
+	VI_CHECK(appended > 100);
+	VI_CHECK(ViInterpreterState_GetMemoryUsage(interp) <= base + 100000);
+	VI_CHECK(interp->mem_account.refused > refused);
+	VI_CHECK(tstate->curr_exc_type == ViExc_MemoryError);
+	VI_CHECK(strstr(ViString_AS_STRING(tstate->curr_exc_value), "limit") != NULL);
+	ViError_Clear();
+
+	ViObject_DECREF(list);
+	ViObject_ClearFreeLists();
+	VI_CHECK(ViInterpreterState_GetMemoryUsage(interp) < base);
+
+	ViInterpreterState_SetMemoryLimit(interp, 0);
+	void *p = Mem_Alloc(200000);
+	VI_CHECK(p != NULL);
+	Mem_Free(p);
+	return 0;
+}
+
+/* Blocks are credited to the account they were charged to */
+static int check_owners()
+{
+	ViMemAccount *saved = ViMem_GetAccount();
+	ViMemAccount a, b;
+
+	VI_CHECK(ViMem_InitAccount(&a) == 0);
+	VI_CHECK(ViMem_InitAccount(&b) == 0);
+	ViMem_SetAccount(&a);
+	void *p = Mem_Alloc(1000);
+	VI_CHECK(p != NULL);
+	VI_CHECK(a.used >= 1000);
+
+	ViMem_SetAccount(&b);
+	Mem_Free(p);
+	VI_CHECK(a.used == 0 && b.used == 0);
+
+	/* Growing charges the owner of the block, not the current account */
+	ViMem_SetAccount(&a);
+	p = Mem_Alloc(10);
+	ViMem_SetAccount(&b);
+	p = Mem_Realloc(p, 5000);
+	VI_CHECK(p != NULL);
+	VI_CHECK(a.used >= 5000 && b.used == 0);
+
+	/* Over the limit the account refuses and remembers why */
+	ViMem_SetAccountLimit(&b, 4096);
+	VI_CHECK(Mem_Alloc(8192) == NULL);
+	VI_CHECK(b.refused == 1 && b.exceeded);
+	ViError_NoMemory();
+	VI_CHECK(!b.exceeded);
+	ViError_Clear();
+
+	Mem_Free(p);
+	VI_CHECK(a.used == 0);
+	ViMem_ReleaseAccount(&a);
+	ViMem_ReleaseAccount(&b);
+	ViMem_SetAccount(saved);
+	return 0;
+}
+
+int test_quota()
+{
+	if (check_limit() != 0)
+		return 1;
+	return check_owners();
+}
\ No newline at end of file
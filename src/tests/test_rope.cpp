@@ -0,0 +1,100 @@
+#include "vitest.h"
+
+/* Replacing the first character succeeds only on a string nobody
+   else depends on */
+static int assign_first(ViObject *str)
+{
+	ViString_Length(str);
+	int result = Vi_TYPE(str)->tp_sequence_methods->sq_assign_item(str, 0, ViIntObject_FromInt('z'));
+	if (result < 0)
+		ViError_Clear();
+	return result;
+}
+
+int test_rope()
+{
+	std::string left(600, 'a'), right(700, 'b');
+	std::string both = left + right;
+
+	/* Short results stay flat */
+	ViObject *ab = ViStringObject_FromString("ab");
+	ViObject *cd = ViStringObject_FromString("cd");
+	ViObject *small = ViString_Concat(ab, cd);
+	VI_CHECK(small != NULL && ViString_CheckExact(small));
+	VI_CHECK(strcmp(ViString_AS_STRING(small), "abcd") == 0);
+	ViObject_DECREF(small);
+	ViObject_DECREF(ab);
+	ViObject_DECREF(cd);
+
+	/* Long ones are ropes, which read like the flat string */
+	ViObject *a = ViStringObject_FromStringAndSize(left.data(), (Vi_size_t)left.size());
+	ViObject *b = ViStringObject_FromStringAndSize(right.data(), (Vi_size_t)right.size());
+	ViObject *rope = ViString_Concat(a, b);
+	VI_CHECK(rope != NULL && ViRope_CheckExact(rope) && ViString_Check(rope));
+	VI_CHECK(Vi_SIZE(rope) == (Vi_size_t)both.size());
+
+	ViObject *flat = ViStringObject_FromStringAndSize(both.data(), (Vi_size_t)both.size());
+	VI_CHECK(ViObject_Hash(rope) == ViObject_Hash(flat));
+	VI_CHECK(ViObject_RichCompareBool(rope, flat, Vi_EQ) == 1);
+	VI_CHECK(ViObject_RichCompareBool(flat, rope, Vi_EQ) == 1);
+	ViObject *item = Vi_TYPE(rope)->tp_sequence_methods->sq_item(rope, 650);
+	VI_CHECK(item != NULL && ViInt_AsInt64(item) == 'b');
+	VI_CHECK(Vi_TYPE(rope)->tp_sequence_methods->sq_item(rope, 1300) == NULL);
+	ViError_Clear();
+
+	/* The halves cannot change while a rope holds them, and can again
+	   once every rope holding them is flattened */
+	ViObject *other = ViString_Concat(a, b);
+	VI_CHECK(assign_first(a) == -1);
+	VI_CHECK(memcmp(ViString_AS_STRING(rope), both.data(), both.size()) == 0);
+	VI_CHECK(ViString_AS_STRING(rope)[both.size()] == '\0');
+	VI_CHECK(assign_first(a) == -1);
+	ViString_AS_STRING(other);
+	VI_CHECK(assign_first(a) == 0);
+	VI_CHECK(ViString_AS_STRING(a)[0] == 'z');
+	VI_CHECK(ViString_AS_STRING(rope)[0] == 'a');
+	ViObject_DECREF(other);
+
+	/* Appending to a rope */
+	ViObject *grown = ViStringObject_FromStringAndSize(left.data(), (Vi_size_t)left.size());
+	ViString_Append(&grown, rope);
+	VI_CHECK(grown != NULL && Vi_SIZE(grown) == (Vi_size_t)(left.size() + both.size()));
+	ViObject_DECREF(grown);
+	ViObject_DECREF(flat);
+	ViObject_DECREF(rope);
+
+	/* A long chain of short appends, flattened once */
+	std::string expected;
+	ViObject *text = ViStringObject_FromString("");
+	for (int i = 0; i < 20000; i++)
+	{
+		char line[32];
+		int n = snprintf(line, sizeof(line), "line %d\n", i);
+		expected.append(line, n);
+		ViObject *piece = ViStringObject_FromStringAndSize(line, n);
+		ViObject *next = ViString_Concat(text, piece);
+		VI_CHECK(next != NULL);
+		ViObject_DECREF(piece);
+		ViObject_DECREF(text);
+		text = next;
+	}
+	VI_CHECK(Vi_SIZE(text) == (Vi_size_t)expected.size());
+	VI_CHECK(memcmp(ViString_AS_STRING(text), expected.data(), expected.size()) == 0);
+	ViObject_DECREF(text);
+
+	/* A deep rope released without being flattened */
+	text = ViStringObject_FromString("");
+	for (int i = 0; i < 100000; i++)
+	{
+		ViObject *next = ViString_Concat(b, text);
+		VI_CHECK(next != NULL);
+		ViObject_DECREF(text);
+		text = next;
+	}
+	VI_CHECK(Vi_SIZE(text) == (Vi_size_t)right.size() * 100000);
+	ViObject_DECREF(text);
+
+	ViObject_DECREF(a);
+	ViObject_DECREF(b);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "vitest.h"
+
+#include "../core/vifastsearch.h"
+
+static Vi_size_t naive_find(const std::string &s, const std::string &p)
+{
+	size_t at = s.find(p);
+	return at == std::string::npos ? -1 : (Vi_size_t)at;
+}
+
+static Vi_size_t naive_count(const std::string &s, const std::string &p)
+{
+	if (p.empty())
+		return (Vi_size_t)s.size() + 1;
+	Vi_size_t count = 0;
+	for (size_t at = s.find(p); at != std::string::npos; at = s.find(p, at + p.size()))
+		count++;
+	return count;
+}
+
+static unsigned int next_random(unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+/* Every kernel agrees with std::string on haystacks over a small
+   alphabet, which makes for plenty of partial matches */
+static int check_kernels()
+{
+	unsigned int seed = 12345;
+	for (int round = 0; round < 2000; round++)
+	{
+		std::string s, p;
+		size_t n = (size_t)(next_random(&seed) % 300);
+		size_t m = (size_t)(next_random(&seed) % (round % 5 == 0 ? 60 : 6));
+		for (size_t i = 0; i < n; i++)
+			s += (char)('a' + next_random(&seed) % 3);
+		for (size_t i = 0; i < m; i++)
+			p += (char)('a' + next_random(&seed) % 3);
+
+		Vi_size_t sn = (Vi_size_t)s.size(), pm = (Vi_size_t)p.size();
+		VI_CHECK(ViFastSearch_Find(s.data(), sn, p.data(), pm) == naive_find(s, p));
+		VI_CHECK(ViFastSearch_Count(s.data(), sn, p.data(), pm, sn + 1) == naive_count(s, p));
+		VI_CHECK(ViFastSearch_FindChar(s.data(), sn, 'c') == naive_find(s, "c"));
+	}
+
+	/* Matches at the very end, past the last full block */
+	std::string s(1000, 'x');
+	s += "needle";
+	VI_CHECK(ViFastSearch_Find(s.data(), (Vi_size_t)s.size(), "needle", 6) == 1000);
+	VI_CHECK(ViFastSearch_Find(s.data(), (Vi_size_t)s.size() - 1, "needle", 6) == -1);
+	VI_CHECK(ViFastSearch_FindChar(s.data(), (Vi_size_t)s.size(), 'e') == 1001);
+	VI_CHECK(ViFastSearch_FindNonAscii(s.data(), (Vi_size_t)s.size()) == -1);
+	s[777] = (char)0xC3;
+	VI_CHECK(ViFastSearch_FindNonAscii(s.data(), (Vi_size_t)s.size()) == 777);
+	VI_CHECK(ViFastSearch_Count(s.data(), (Vi_size_t)s.size(), "xx", 2, 100) == 100);
+
+	/* A long needle that almost matches everywhere goes to two-way */
+	std::string hay(5000, 'a'), needle(40, 'a');
+	needle += 'b';
+	VI_CHECK(ViFastSearch_Find(hay.data(), (Vi_size_t)hay.size(), needle.data(), (Vi_size_t)needle.size()) == -1);
+	hay += needle;
+	VI_CHECK(ViFastSearch_Find(hay.data(), (Vi_size_t)hay.size(), needle.data(), (Vi_size_t)needle.size()) == 5000);
+	return 0;
+}
+
+static int check_strings()
+{
+	ViObject *str = ViStringObject_FromString("a,b,,c");
+	ViObject *comma = ViStringObject_FromString(",");
+	ViObject *dash = ViStringObject_FromString("--");
+	ViObject *missing = ViStringObject_FromString("z");
+
+	VI_CHECK(ViString_Find(str, comma) == 1);
+	VI_CHECK(ViString_Find(str, missing) == -1);
+	VI_CHECK(ViString_Count(str, comma) == 3);
+	VI_CHECK(ViString_Contains(str, comma) == 1);
+	VI_CHECK(ViString_Contains(str, missing) == 0);
+	VI_CHECK(ViString_Contains(str, ViIntObject_FromInt('c')) == 1);
+	VI_CHECK(ViString_Find(str, ViIntObject_FromInt(1)) == -2);
+	ViError_Clear();
+
+	ViObject *pieces = ViString_Split(str, comma, -1);
+	VI_CHECK(pieces != NULL && Vi_SIZE(pieces) == 4);
+	VI_CHECK(Vi_SIZE(ViList_GET_ITEM(pieces, 2)) == 0);
+	VI_CHECK(strcmp(ViString_AS_STRING(ViList_GET_ITEM(pieces, 3)), "c") == 0);
+	ViObject_DECREF(pieces);
+	pieces = ViString_Split(str, comma, 1);
+	VI_CHECK(pieces != NULL && Vi_SIZE(pieces) == 2);
+	VI_CHECK(strcmp(ViString_AS_STRING(ViList_GET_ITEM(pieces, 1)), "b,,c") == 0);
+	ViObject_DECREF(pieces);
+
+	ViObject *spaced = ViStringObject_FromString("  one \t two\nthree  ");
+	pieces = ViString_Split(spaced, NULL, -1);
+	VI_CHECK(pieces != NULL && Vi_SIZE(pieces) == 3);
+	VI_CHECK(strcmp(ViString_AS_STRING(ViList_GET_ITEM(pieces, 1)), "two") == 0);
+	ViObject_DECREF(pieces);
+	ViObject_DECREF(spaced);
+
+	ViObject *replaced = ViString_Replace(str, comma, dash, -1);
+	VI_CHECK(replaced != NULL && strcmp(ViString_AS_STRING(replaced), "a--b----c") == 0);
+	ViObject_DECREF(replaced);
+	replaced = ViString_Replace(str, comma, dash, 2);
+	VI_CHECK(replaced != NULL && strcmp(ViString_AS_STRING(replaced), "a--b--,c") == 0);
+	ViObject_DECREF(replaced);
+	replaced = ViString_Replace(str, missing, dash, -1);
+	VI_CHECK(replaced != NULL && strcmp(ViString_AS_STRING(replaced), "a,b,,c") == 0);
+	ViObject_DECREF(replaced);
+
+	ViObject_DECREF(str);
+	ViObject_DECREF(comma);
+	ViObject_DECREF(dash);
+	ViObject_DECREF(missing);
+	return 0;
+}
+
+int test_search()
+{
+	int saved = ViFastSearch_SetLevel(ViFastSearch_AVX2);
+
+	for (int level = ViFastSearch_SCALAR; level <= saved; level++)
+	{
+		VI_CHECK(ViFastSearch_SetLevel(level) == level);
+		VI_CHECK(check_kernels() == 0);
+		VI_CHECK(check_strings() == 0);
+	}
+	ViFastSearch_SetLevel(saved);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "vitest.h"
+
+/* Trivial results are shared immortal objects and cost no allocation */
+int test_singletons()
+{
+	ViObject *empty = ViStringObject_FromStringAndSize(NULL, 0);
+	VI_CHECK(empty != NULL);
+	VI_CHECK(ViObject_IS_IMMORTAL(empty));
+	VI_CHECK(ViStringObject_FromString("") == empty);
+
+	ViObject *tuple = ViTupleObject_New(0);
+	VI_CHECK(tuple != NULL);
+	VI_CHECK(ViObject_IS_IMMORTAL(tuple));
+	VI_CHECK(ViTupleObject_New(0) == tuple);
+	VI_CHECK(ViTupleObject_FromArray(NULL, 0) == tuple);
+
+	ViObject *bytes = ViByteArrayObject_FromString("", 0);
+	VI_CHECK(bytes != NULL);
+	VI_CHECK(ViObject_IS_IMMORTAL(bytes));
+	VI_CHECK(ViByteArrayObject_FromString("", 0) == bytes);
+
+	for (int c = 1; c < 0x80; c++)
+	{
+		char ch = (char)c;
+		ViObject *one = ViStringObject_FromStringAndSize(&ch, 1);
+		VI_CHECK(one != NULL);
+		VI_CHECK(ViObject_IS_IMMORTAL(one));
+		VI_CHECK(ViStringObject_FromStringAndSize(&ch, 1) == one);
+		VI_CHECK(ViString_AS_STRING(one)[0] == ch);
+	}
+
+	/* Results of string operations come from the same table */
+	ViObject *str = ViStringObject_FromString("a,b");
+	ViObject *sep = ViStringObject_FromString(",");
+	ViObject *parts = ViString_Split(str, sep, -1);
+	VI_CHECK(parts != NULL);
+	VI_CHECK(ViList_GET_ITEM(parts, 0) == ViStringObject_FromString("a"));
+	ViObject_DECREF(parts);
+	ViObject_DECREF(sep);
+	ViObject_DECREF(str);
+	return 0;
+}
\ No newline at end of file
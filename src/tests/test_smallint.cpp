@@ -0,0 +1,32 @@
+#include "vitest.h"
+
+/* The common small values are shared and cost no memory */
+int test_smallint()
+{
+	ViMemAccount *saved = ViMem_GetAccount();
+	ViMemAccount account;
+
+	VI_CHECK(ViMem_InitAccount(&account) == 0);
+	ViMem_SetAccount(&account);
+
+	for (int i = -5; i <= 1024; i++)
+	{
+		ViObject *value = ViIntObject_FromInt(i);
+		VI_CHECK(value != NULL);
+		VI_CHECK(ViIntObject_FromInt(i) == value);
+		VI_CHECK(ViInt_AsInt64(value) == i);
+		ViObject_DECREF(value);
+		VI_CHECK(ViInt_AsInt64(value) == i);
+	}
+	VI_CHECK(ViIntObject_FromString("1024", 10) == ViIntObject_FromInt(1024));
+	VI_CHECK(ViIntObject_FromString("-5", 10) == ViIntObject_FromInt(-5));
+	VI_CHECK(ViIntObject_FromString("0x10", 0) == ViIntObject_FromInt(16));
+
+	/* Parsing goes through a temporary, which the free list keeps */
+	ViInt_ClearFreeList();
+	VI_CHECK(account.used == 0);
+
+	ViMem_ReleaseAccount(&account);
+	ViMem_SetAccount(saved);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "vitest.h"
+
+#include <algorithm>
+#include <vector>
+
+static unsigned int next_random(unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+static ViObject *first_item(ViObject *pair)
+{
+	ViObject *key = ViTuple_GET_ITEM(pair, 0);
+	ViObject_INCREF(key);
+	return key;
+}
+
+static ViObject *make_pair(Vi_int64_t key, Vi_int64_t position)
+{
+	ViObject *pair = ViTupleObject_New(2);
+	ViTuple_SET_ITEM(pair, 0, ViIntObject_FromInt64(key));
+	ViTuple_SET_ITEM(pair, 1, ViIntObject_FromInt64(position));
+	return pair;
+}
+
+/* Pairs sorted by their first item keep the order of their second for
+   equal keys, in either direction */
+static int check_stability(int reverse)
+{
+	unsigned int seed = 7;
+	std::vector<std::pair<Vi_int64_t, Vi_int64_t> > expected;
+	ViObject *list = ViListObject_New(0);
+
+	for (Vi_int64_t i = 0; i < 5000; i++)
+	{
+		Vi_int64_t key = next_random(&seed) % 20;
+		expected.push_back(std::make_pair(key, i));
+		ViObject *pair = make_pair(key, i);
+		VI_CHECK(ViList_Append(list, pair) == 0);
+		ViObject_DECREF(pair);
+	}
+	std::stable_sort(expected.begin(), expected.end(),
+		[reverse](const std::pair<Vi_int64_t, Vi_int64_t> &a, const std::pair<Vi_int64_t, Vi_int64_t> &b) {
+			return reverse ? a.first > b.first : a.first < b.first;
+		});
+
+	VI_CHECK(ViList_Sort(list, first_item, reverse) == 0);
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		ViObject *pair = ViList_GET_ITEM(list, i);
+		VI_CHECK(ViInt_AsInt64(ViTuple_GET_ITEM(pair, 0)) == expected[i].first);
+		VI_CHECK(ViInt_AsInt64(ViTuple_GET_ITEM(pair, 1)) == expected[i].second);
+	}
+	ViObject_DECREF(list);
+	return 0;
+}
+
+/* Lists of a single type take the fast comparisons, which must agree
+   with std::stable_sort */
+static int check_ints()
+{
+	unsigned int seed = 11;
+	std::vector<Vi_int64_t> expected;
+	ViObject *list = ViListObject_New(0);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		Vi_int64_t value = (Vi_int64_t)next_random(&seed) - 16384;
+		if (i % 7 == 0)
+			value *= (Vi_int64_t)1 << 40;
+		expected.push_back(value);
+		ViObject *item = ViIntObject_FromInt64(value);
+		VI_CHECK(ViList_Append(list, item) == 0);
+		ViObject_DECREF(item);
+	}
+	std::stable_sort(expected.begin(), expected.end());
+	VI_CHECK(ViList_Sort(list, NULL, 0) == 0);
+	for (size_t i = 0; i < expected.size(); i++)
+		VI_CHECK(ViInt_AsInt64(ViList_GET_ITEM(list, i)) == expected[i]);
+	ViObject_DECREF(list);
+	return 0;
+}
+
+static int check_floats()
+{
+	unsigned int seed = 13;
+	std::vector<double> expected;
+	ViObject *list = ViListObject_New(0);
+
+	for (int i = 0; i < 20000; i++)
+	{
+		double value = ((double)next_random(&seed) - 16384.0) / 7.0;
+		expected.push_back(value);
+		ViObject *item = ViFloatObject_FromDouble(value);
+		VI_CHECK(ViList_Append(list, item) == 0);
+		ViObject_DECREF(item);
+	}
+	std::stable_sort(expected.begin(), expected.end(), std::greater<double>());
+	VI_CHECK(ViList_Sort(list, NULL, 1) == 0);
+	for (size_t i = 0; i < expected.size(); i++)
+		VI_CHECK(((ViFloatObject *)ViList_GET_ITEM(list, i))->ob_fval == expected[i]);
+	ViObject_DECREF(list);
+	return 0;
+}
+
+static int check_strings()
+{
+	unsigned int seed = 17;
+	std::vector<std::string> expected;
+	ViObject *list = ViListObject_New(0);
+
+	for (int i = 0; i < 5000; i++)
+	{
+		std::string value;
+		int n = (int)(next_random(&seed) % 8);
+		for (int j = 0; j < n; j++)
+			value += (char)('a' + next_random(&seed) % 4);
+		expected.push_back(value);
+		ViObject *item = ViStringObject_FromStringAndSize(value.data(), (Vi_size_t)value.size());
+		VI_CHECK(ViList_Append(list, item) == 0);
+		ViObject_DECREF(item);
+	}
+	std::stable_sort(expected.begin(), expected.end());
+	VI_CHECK(ViList_Sort(list, NULL, 0) == 0);
+	for (size_t i = 0; i < expected.size(); i++)
+		VI_CHECK(strcmp(ViString_AS_STRING(ViList_GET_ITEM(list, i)), expected[i].c_str()) == 0);
+	ViObject_DECREF(list);
+	return 0;
+}
+
+/* Ints and floats compare with each other, strings do not compare with
+   either */
+static int check_mixed()
+{
+	ViObject *list = ViListObject_New(0);
+	ViObject *items[] = {
+		ViIntObject_FromInt(3), ViFloatObject_FromDouble(1.5), ViIntObject_FromInt(1),
+		ViFloatObject_FromDouble(2.5), ViIntObject_FromInt(2)
+	};
+	for (int i = 0; i < 5; i++)
+	{
+		VI_CHECK(ViList_Append(list, items[i]) == 0);
+		ViObject_DECREF(items[i]);
+	}
+	VI_CHECK(ViList_Sort(list, NULL, 0) == 0);
+	VI_CHECK(ViList_GET_ITEM(list, 0) == items[2]);
+	VI_CHECK(ViList_GET_ITEM(list, 1) == items[1]);
+	VI_CHECK(ViList_GET_ITEM(list, 2) == items[4]);
+	VI_CHECK(ViList_GET_ITEM(list, 3) == items[3]);
+	VI_CHECK(ViList_GET_ITEM(list, 4) == items[0]);
+
+	ViObject *str = ViStringObject_FromString("x");
+	VI_CHECK(ViList_Append(list, str) == 0);
+	ViObject_DECREF(str);
+	VI_CHECK(ViList_Sort(list, NULL, 0) == -1);
+	VI_CHECK(ViThreadState_GET()->curr_exc_type == ViExc_TypeError);
+	ViError_Clear();
+	VI_CHECK(Vi_SIZE(list) == 6);
+	ViObject_DECREF(list);
+	return 0;
+}
+
+int test_sort()
+{
+	VI_CHECK(check_stability(0) == 0);
+	VI_CHECK(check_stability(1) == 0);
+	VI_CHECK(check_ints() == 0);
+	VI_CHECK(check_floats() == 0);
+	VI_CHECK(check_strings() == 0);
+	VI_CHECK(check_mixed() == 0);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "vitest.h"
+
+#include "../core/runtime.h"
+#include "../core/viarena.h"
+
+int test_stats()
+{
+	ViMemStats before, after;
+
+	/* Mem_* calls, current bytes and the high-water mark */
+	ViMem_GetStats(&before);
+	void *p = Mem_Alloc(1000);
+	VI_CHECK(p != NULL);
+	p = Mem_Realloc(p, 5000);
+	VI_CHECK(p != NULL);
+	ViMem_GetStats(&after);
+	VI_CHECK(after.allocs == before.allocs + 1);
+	VI_CHECK(after.reallocs == before.reallocs + 1);
+	VI_CHECK(after.current_bytes == before.current_bytes + 5000);
+	VI_CHECK(after.peak_bytes >= after.current_bytes);
+	VI_CHECK(after.total_bytes >= before.total_bytes + 5000);
+	Mem_Free(p);
+	ViMem_GetStats(&after);
+	VI_CHECK(after.frees == before.frees + 1);
+	VI_CHECK(after.current_bytes == before.current_bytes);
+	ViMem_ResetPeak();
+	ViMem_GetStats(&after);
+	VI_CHECK(after.peak_bytes == after.current_bytes);
+
+	/* Arenas, and their usage once retired */
+	ViArenaUsage usage_before, usage_after;
+	ViArena_GetInterpreterUsage(ViInterpreterState_GET(), &usage_before);
+	ViArena *arena = ViArena_New();
+	VI_CHECK(arena != NULL);
+	for (int i = 0; i < 100; i++)
+		VI_CHECK(ViArena_Alloc(arena, 3000) != NULL);
+	ViArenaStats stats;
+	ViArena_GetStats(arena, &stats);
+	VI_CHECK(stats.allocs == 100);
+	VI_CHECK(stats.alloc_bytes == 300000);
+	VI_CHECK(stats.block_bytes >= stats.alloc_bytes);
+	ViArena_GetInterpreterUsage(ViInterpreterState_GET(), &usage_after);
+	VI_CHECK(usage_after.live_arenas == usage_before.live_arenas + 1);
+	ViArena_Free(arena);
+	ViArena_GetInterpreterUsage(ViInterpreterState_GET(), &usage_after);
+	VI_CHECK(usage_after.live_arenas == usage_before.live_arenas);
+	VI_CHECK(usage_after.arenas == usage_before.arenas + 1);
+	VI_CHECK(usage_after.totals.allocs == usage_before.totals.allocs + 100);
+
+	Vi_string_t json = ViMem_StatsAsJSON();
+	VI_CHECK(json.front() == '{' && json.back() == '}');
+	VI_CHECK(json.find("\"mem\"") != Vi_string_t::npos);
+	VI_CHECK(json.find("\"interpreter\"") != Vi_string_t::npos);
+	return 0;
+}
\ No newline at end of file
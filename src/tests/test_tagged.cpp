@@ -0,0 +1,67 @@
+#include "vitest.h"
+
+#include "../objects/boolobject.h"
+
+static int check_value(ViObject *obj, Vi_int64_t expected)
+{
+	VI_CHECK(obj != NULL);
+	VI_CHECK(ViInt_AsInt64(obj) == expected);
+	return 0;
+}
+
+int test_tagged()
+{
+	ViNumberMethods *nb = ViIntType.tp_number_methods;
+
+	/* Values that fit are held in the pointer and act like any int */
+	ViObject *a = ViIntObject_FromInt(-7);
+	ViObject *b = ViIntObject_FromInt(3);
+	VI_CHECK(ViTaggedInt_Check(a) && ViTaggedInt_Check(b));
+	VI_CHECK(ViInt_Check(a));
+	VI_CHECK(Vi_TYPE(a) == &ViIntType);
+	ViObject_INCREF(a);
+	ViObject_DECREF(a);
+	ViObject_DECREF(a);
+	VI_CHECK(ViInt_AsInt64(a) == -7);
+
+	VI_CHECK(ViTaggedInt_Check(ViIntObject_FromInt64(ViTaggedInt_MAX)));
+	VI_CHECK(ViTaggedInt_Check(ViIntObject_FromInt64(ViTaggedInt_MIN)));
+	VI_CHECK(check_value(ViIntObject_FromInt64(ViTaggedInt_MIN), ViTaggedInt_MIN) == 0);
+	ViObject *boxed = ViIntObject_FromInt64((Vi_int64_t)ViTaggedInt_MAX + 1);
+	VI_CHECK(boxed != NULL && !ViTaggedInt_Check(boxed));
+	VI_CHECK(check_value(boxed, (Vi_int64_t)ViTaggedInt_MAX + 1) == 0);
+	ViObject_DECREF(boxed);
+
+	/* Arithmetic rounds towards negative infinity like Python */
+	VI_CHECK(check_value(nb->nb_add(a, b), -4) == 0);
+	VI_CHECK(check_value(nb->nb_subtract(a, b), -10) == 0);
+	VI_CHECK(check_value(nb->nb_multiply(a, b), -21) == 0);
+	VI_CHECK(check_value(nb->nb_remainder(a, b), 2) == 0);
+	VI_CHECK(check_value(nb->nb_floor_divide(a, b), -3) == 0);
+	VI_CHECK(check_value(nb->nb_power(a, b, NULL), -343) == 0);
+	VI_CHECK(check_value(nb->nb_lshift(a, b), -56) == 0);
+	VI_CHECK(check_value(nb->nb_rshift(a, b), -1) == 0);
+	ViObject *quotient = nb->nb_true_divide(a, b);
+	VI_CHECK(quotient != NULL && ViFloat_CheckExact(quotient));
+	VI_CHECK(((ViFloatObject *)quotient)->ob_fval == -7.0 / 3.0);
+	ViObject_DECREF(quotient);
+
+	ViObject *pair = nb->nb_divmod(a, b);
+	VI_CHECK(pair != NULL);
+	VI_CHECK(check_value(ViTuple_GET_ITEM(pair, 0), -3) == 0);
+	VI_CHECK(check_value(ViTuple_GET_ITEM(pair, 1), 2) == 0);
+	ViObject_DECREF(pair);
+
+	/* Results too big to tag are boxed */
+	ViObject *big = ViIntObject_FromInt(65536);
+	ViObject *product = nb->nb_multiply(big, big);
+	VI_CHECK(check_value(product, (Vi_int64_t)1 << 32) == 0);
+	ViObject_DECREF(product);
+
+	VI_CHECK(nb->nb_remainder(a, ViIntObject_FromInt(0)) == NULL);
+	VI_CHECK(ViThreadState_GET()->curr_exc_type == ViExc_ZeroDivisionError);
+	ViError_Clear();
+
+	VI_CHECK(check_value(ViBoolType.tp_number_methods->nb_and(Vi_True, b), 1) == 0);
+	return 0;
+}
\ No newline at end of file
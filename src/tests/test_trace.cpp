@@ -0,0 +1,64 @@
+#include "vitest.h"
+
+static const ViTraceStatDiff *find_site(const ViTraceDiff *diff, const char *filename, int lineno)
+{
+	for (Vi_size_t i = 0; i < diff->length; i++)
+	{
+		if (diff->diffs[i].lineno == lineno && strstr(diff->diffs[i].filename, filename) != NULL)
+			return &diff->diffs[i];
+	}
+	return NULL;
+}
+
+/* Live blocks are attributed to the line that allocated them, objects
+   to their type */
+int test_trace()
+{
+	ViObject *floats[100];
+	size_t current, peak;
+
+	VI_CHECK(!ViTraceMalloc_IsTracing());
+	VI_CHECK(ViTraceMalloc_Start() == 0);
+	VI_CHECK(ViTraceMalloc_Start() == -1);
+	ViTraceSnapshot *first = ViTraceMalloc_TakeSnapshot();
+	VI_CHECK(first != NULL);
+
+	/* A refused call must not pass its site on to the next one */
+	VI_CHECK(Mem_Alloc((size_t)-1) == NULL);
+	int refused_line = __LINE__ - 1;
+	void *p = Mem_Alloc(5000);
+	int line = __LINE__ - 1;
+	VI_CHECK(p != NULL);
+	for (int i = 0; i < 100; i++)
+		floats[i] = ViFloatObject_FromDouble(i + 0.5);
+
+	ViTraceSnapshot *second = ViTraceMalloc_TakeSnapshot();
+	VI_CHECK(second != NULL);
+	ViTraceDiff *diff = ViTraceMalloc_CompareSnapshots(first, second);
+	VI_CHECK(diff != NULL);
+
+	const ViTraceStatDiff *site = find_site(diff, "test_trace", line);
+	VI_CHECK(site != NULL);
+	VI_CHECK(site->count_diff == 1 && site->size_diff >= 5000);
+	VI_CHECK(find_site(diff, "test_trace", refused_line) == NULL);
+	site = find_site(diff, "float", 0);
+	VI_CHECK(site != NULL);
+	VI_CHECK(site->count_diff == 100);
+
+	ViTraceMalloc_GetTracedMemory(&current, &peak);
+	VI_CHECK(current >= 5000 && peak >= current);
+	Mem_Free(p);
+	for (int i = 0; i < 100; i++)
+		ViObject_DECREF(floats[i]);
+	size_t after;
+	ViTraceMalloc_GetTracedMemory(&after, &peak);
+	VI_CHECK(after < current);
+
+	ViTraceMalloc_FreeDiff(diff);
+	ViTraceMalloc_FreeSnapshot(first);
+	ViTraceMalloc_FreeSnapshot(second);
+	ViTraceMalloc_Stop();
+	VI_CHECK(!ViTraceMalloc_IsTracing());
+	VI_CHECK(ViTraceMalloc_TakeSnapshot() == NULL);
+	return 0;
+}
\ No newline at end of file
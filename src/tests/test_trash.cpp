@@ -0,0 +1,77 @@
+#include "vitest.h"
+
+#define DEPTH 200000
+
+/* Lists and tuples nested DEPTH levels deep, deep enough to overflow the
+   C stack if they were freed recursively */
+static ViObject *nest(int depth)
+{
+	ViObject *inner = ViListObject_New(0);
+
+	for (int i = 0; inner != NULL && i < depth; i++)
+	{
+		ViObject *outer;
+		if (i & 1)
+		{
+			outer = ViTupleObject_New(1);
+			if (outer != NULL)
+				((ViTupleObject *)outer)->ob_items[0] = inner;
+			else
+				ViObject_DECREF(inner);
+		}
+		else
+		{
+			outer = ViListObject_New(0);
+			if (outer != NULL && ViList_Append(outer, inner) < 0)
+				ViObject_CLEAR(outer);
+			ViObject_DECREF(inner);
+		}
+		inner = outer;
+	}
+	return inner;
+}
+
+int test_trash()
+{
+	ViMemAccount *saved = ViMem_GetAccount();
+	ViMemAccount account;
+	Vi_size_t budget = ViTrash_GetBudget();
+	int enabled = ViGC_Disable();
+
+	VI_CHECK(ViMem_InitAccount(&account) == 0);
+	ViMem_SetAccount(&account);
+
+	/* Without a budget everything is gone once the outermost one is */
+	ViTrash_SetBudget(0);
+	ViObject *nested = nest(DEPTH);
+	VI_CHECK(nested != NULL);
+	ViObject_DECREF(nested);
+	VI_CHECK(ViTrash_Pending() == 0);
+
+	/* With one the rest waits for the check points */
+	ViTrash_SetBudget(1000);
+	nested = nest(DEPTH);
+	VI_CHECK(nested != NULL);
+	ViObject_DECREF(nested);
+	VI_CHECK(ViTrash_Pending() > 0);
+	int checkpoints = 0;
+	while (ViTrash_Pending() > 0)
+	{
+		/* Freeing a queued object may queue its items, but every check
+		   point makes progress */
+		VI_CHECK(checkpoints < DEPTH);
+		ViTrash_Checkpoint();
+		checkpoints++;
+	}
+	VI_CHECK(checkpoints > 1);
+
+	ViObject_ClearFreeLists();
+	VI_CHECK(account.used == 0);
+
+	ViTrash_SetBudget(budget);
+	ViMem_ReleaseAccount(&account);
+	ViMem_SetAccount(saved);
+	if (enabled)
+		ViGC_Enable();
+	return 0;
+}
\ No newline at end of file
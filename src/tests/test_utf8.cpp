@@ -0,0 +1,150 @@
+#include "vitest.h"
+
+#include "../core/viutf8.h"
+#include "../core/vifastsearch.h"
+
+typedef struct _utf8case
+{
+	const char *bytes;
+	Vi_size_t length; // Code points, -1 if invalid
+} Utf8Case;
+
+static Utf8Case cases[] = {
+	{ "", 0 },
+	{ "plain", 5 },
+	{ "\xC3\xA9t\xC3\xA9", 3 },
+	{ "\xE2\x82\xAC", 1 },
+	{ "\xF0\x9F\x98\x80", 1 },
+	{ "\xF4\x8F\xBF\xBF", 1 }, // U+10FFFF
+	{ "\xED\x9F\xBF", 1 }, // U+D7FF, just below the surrogates
+	{ "\xEE\x80\x80", 1 }, // U+E000, just above them
+	{ "\xC0\x80", -1 }, // Overlong NUL
+	{ "\xC1\xBF", -1 },
+	{ "\xE0\x9F\xBF", -1 }, // Overlong three byte form
+	{ "\xF0\x8F\xBF\xBF", -1 }, // Overlong four byte form
+	{ "\xED\xA0\x80", -1 }, // U+D800
+	{ "\xED\xBF\xBF", -1 }, // U+DFFF
+	{ "\xF4\x90\x80\x80", -1 }, // U+110000
+	{ "\xF5\x80\x80\x80", -1 },
+	{ "\xFF", -1 },
+	{ "\x80", -1 }, // Lone continuation byte
+	{ "\xC3", -1 }, // Truncated sequences
+	{ "\xE2\x82", -1 },
+	{ "\xF0\x9F\x98", -1 },
+	{ "\xC3(", -1 },
+	{ NULL, 0 }
+};
+
+/* The AVX2 prefix never passes an error and never ends inside a
+   sequence, and its count is that of the bytes it covers */
+static int check_prefix(const std::string &text)
+{
+	Vi_size_t count = -1;
+	Vi_size_t prefix = ViFastSearch_ValidUtf8Prefix(text.data(), (Vi_size_t)text.size(), &count);
+	VI_CHECK(prefix >= 0 && prefix <= (Vi_size_t)text.size());
+	VI_CHECK(ViUtf8_Check(text.data(), prefix, NULL) == count);
+	return 0;
+}
+
+static int check_kernels()
+{
+	for (Utf8Case *c = cases; c->bytes != NULL; c++)
+	{
+		int is_ascii = -1;
+		Vi_size_t n = (Vi_size_t)strlen(c->bytes);
+		VI_CHECK(ViUtf8_Check(c->bytes, n, &is_ascii) == c->length);
+
+		/* Placed at every offset across two 32 byte blocks */
+		for (size_t at = 0; at < 70; at++)
+		{
+			std::string text(at, 'a');
+			text += c->bytes;
+			text += std::string(70 - at, 'b');
+			Vi_size_t expected = c->length < 0 ? -1 : c->length + 70;
+			VI_CHECK(ViUtf8_Check(text.data(), (Vi_size_t)text.size(), NULL) == expected);
+			VI_CHECK(check_prefix(text) == 0);
+		}
+	}
+
+	/* Sequences split by the end of a block */
+	std::string text;
+	for (int i = 0; i < 100; i++)
+		text += "\xE2\x82\xAC\xC3\xA9z";
+	int is_ascii = -1;
+	VI_CHECK(ViUtf8_Check(text.data(), (Vi_size_t)text.size(), &is_ascii) == 300);
+	VI_CHECK(is_ascii == 0);
+	VI_CHECK(check_prefix(text) == 0);
+	text.resize(text.size() - 2);
+	VI_CHECK(ViUtf8_Check(text.data(), (Vi_size_t)text.size(), NULL) == -1);
+	VI_CHECK(check_prefix(text) == 0);
+
+	std::string ascii(1000, 'x');
+	VI_CHECK(ViUtf8_Check(ascii.data(), (Vi_size_t)ascii.size(), &is_ascii) == 1000);
+	VI_CHECK(is_ascii == 1);
+	return 0;
+}
+
+static int check_strings()
+{
+	/* Invalid bytes make no string */
+	VI_CHECK(ViStringObject_FromString("ab\xED\xA0\x80") == NULL);
+	VI_CHECK(ViError_Occurred());
+	ViError_Clear();
+
+	/* Code points are counted and indexed, past the index step too */
+	std::string text;
+	for (int i = 0; i < 200; i++)
+		text += i % 3 == 0 ? "\xE2\x82\xAC" : "a";
+	ViObject *str = ViStringObject_FromStringAndSize(text.data(), (Vi_size_t)text.size());
+	VI_CHECK(str != NULL);
+	VI_CHECK(ViString_Length(str) == 200);
+	VI_CHECK((((ViStringObject *)str)->ob_sstate & SSTATE_ASCII) == 0);
+	for (Vi_size_t i = 0; i < 200; i++)
+	{
+		ViObject *item = Vi_TYPE(str)->tp_sequence_methods->sq_item(str, i);
+		VI_CHECK(item != NULL);
+		VI_CHECK(ViInt_AsInt64(item) == (i % 3 == 0 ? 0x20AC : 'a'));
+	}
+
+	ViObject *euro = ViStringObject_FromString("\xE2\x82\xAC");
+	ViObject *a = ViStringObject_FromString("a");
+	VI_CHECK(ViString_Find(str, a) == 1);
+	VI_CHECK(ViString_Count(str, euro) == 67);
+
+	/* An empty needle is found between every two code points */
+	ViObject *empty = ViStringObject_FromString("");
+	ViObject *short_str = ViStringObject_FromString("\xC3\xA9t\xC3\xA9");
+	VI_CHECK(ViString_Count(short_str, empty) == 4);
+	ViObject *dash = ViStringObject_FromString("-");
+	ViObject *replaced = ViString_Replace(short_str, empty, dash, -1);
+	VI_CHECK(replaced != NULL);
+	VI_CHECK(strcmp(ViString_AS_STRING(replaced), "-\xC3\xA9-t-\xC3\xA9-") == 0);
+	ViObject_DECREF(replaced);
+
+	ViObject *plain = ViStringObject_FromString("plain");
+	VI_CHECK(ViString_Length(plain) == 5);
+	VI_CHECK((((ViStringObject *)plain)->ob_sstate & SSTATE_ASCII) != 0);
+
+	ViObject_DECREF(plain);
+	ViObject_DECREF(dash);
+	ViObject_DECREF(short_str);
+	ViObject_DECREF(empty);
+	ViObject_DECREF(a);
+	ViObject_DECREF(euro);
+	ViObject_DECREF(str);
+	return 0;
+}
+
+int test_utf8()
+{
+	int saved = ViFastSearch_SetLevel(ViFastSearch_AVX2);
+
+	for (int level = ViFastSearch_SCALAR; level <= saved; level++)
+	{
+		VI_CHECK(ViFastSearch_SetLevel(level) == level);
+		VI_CHECK(check_kernels() == 0);
+		VI_CHECK(check_strings() == 0);
+	}
+	ViFastSearch_SetLevel(saved);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "vitest.h"
+
+/* Allocations made through Mem_Alloc(), where blocks too big for the
+   object allocator's pools go */
+static size_t mem_allocs()
+{
+	ViMemStats stats;
+	ViMem_GetStats(&stats);
+	return stats.allocs;
+}
+
+int test_varobject()
+{
+	char bytes[1000];
+	memset(bytes, 'v', sizeof(bytes));
+
+	/* One block holds the header and the bytes */
+	size_t allocs = mem_allocs();
+	ViObject *str = ViStringObject_FromStringAndSize(bytes, sizeof(bytes));
+	VI_CHECK(str != NULL);
+	VI_CHECK(mem_allocs() == allocs + 1);
+	VI_CHECK(Vi_SIZE(str) == sizeof(bytes));
+	VI_CHECK(ViString_AS_STRING(str) == ((ViStringObject *)str)->ob_svar);
+	VI_CHECK(memcmp(ViString_AS_STRING(str), bytes, sizeof(bytes)) == 0);
+	VI_CHECK(ViString_AS_STRING(str)[sizeof(bytes)] == '\0');
+	ViObject_DECREF(str);
+
+	allocs = mem_allocs();
+	ViObject *tuple = ViTupleObject_New(200);
+	VI_CHECK(tuple != NULL);
+	VI_CHECK(mem_allocs() == allocs + 1);
+	VI_CHECK(Vi_SIZE(tuple) == 200);
+	for (Vi_size_t i = 0; i < 200; i++)
+		((ViTupleObject *)tuple)->ob_items[i] = ViIntObject_FromInt((Vi_int32_t)i);
+	VI_CHECK(ViInt_AsInt64(((ViTupleObject *)tuple)->ob_items[199]) == 199);
+	ViObject_DECREF(tuple);
+
+	VI_CHECK(ViObject_VAR_SIZE(&ViStringType, 30) >= ViStringType.tp_size + 30);
+	ViStringObject *raw = ViObject_NEWVAR(ViStringObject, &ViStringType, 30);
+	VI_CHECK(raw != NULL);
+	VI_CHECK(Vi_SIZE(raw) == 30);
+	ViObject_Free(raw);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include "vitest.h"
+
+static int check_string(ViObject *str, const char *expected, Vi_size_t size)
+{
+	VI_CHECK(str != NULL);
+	VI_CHECK(Vi_SIZE(str) == size);
+	VI_CHECK(memcmp(ViString_AS_STRING(str), expected, size) == 0);
+	VI_CHECK(ViString_AS_STRING(str)[size] == '\0');
+	return 0;
+}
+
+int test_writer()
+{
+	ViStringWriter writer;
+	ViObject *result;
+
+	/* Nothing written gives the empty string */
+	ViStringWriter_Init(&writer);
+	result = ViStringWriter_Finish(&writer);
+	VI_CHECK(check_string(result, "", 0) == 0);
+
+	/* Pieces of every kind */
+	ViObject *piece = ViStringObject_FromString("cd");
+	ViStringWriter_Init(&writer);
+	VI_CHECK(ViStringWriter_WriteString(&writer, "ab") == 0);
+	VI_CHECK(ViStringWriter_WriteObject(&writer, piece) == 0);
+	VI_CHECK(ViStringWriter_WriteChar(&writer, 'e') == 0);
+	VI_CHECK(ViStringWriter_WriteBytes(&writer, "fgh", 2) == 0);
+	result = ViStringWriter_Finish(&writer);
+	VI_CHECK(check_string(result, "abcdefg", 7) == 0);
+	VI_CHECK(result->ob_refcount == 1);
+	ViObject_DECREF(result);
+	ViObject_DECREF(piece);
+
+	/* Past the small buffer, many times over */
+	std::string expected;
+	ViStringWriter_Init(&writer);
+	for (int i = 0; i < 100000; i++)
+	{
+		char text[16];
+		int n = snprintf(text, sizeof(text), "%d,", i);
+		expected.append(text, n);
+		VI_CHECK(ViStringWriter_WriteBytes(&writer, text, n) == 0);
+	}
+	result = ViStringWriter_Finish(&writer);
+	VI_CHECK(check_string(result, expected.data(), (Vi_size_t)expected.size()) == 0);
+	ViObject_DECREF(result);
+
+	/* A large reservation, then short strings, which end up in the
+	   shared singletons or a string of their own size */
+	ViStringWriter_Init(&writer);
+	VI_CHECK(ViStringWriter_Reserve(&writer, 1 << 20) == 0);
+	VI_CHECK(writer.allocated >= 1 << 20);
+	result = ViStringWriter_Finish(&writer);
+	VI_CHECK(check_string(result, "", 0) == 0);
+
+	ViStringWriter_Init(&writer);
+	VI_CHECK(ViStringWriter_Reserve(&writer, 1 << 20) == 0);
+	VI_CHECK(ViStringWriter_WriteChar(&writer, 'q') == 0);
+	result = ViStringWriter_Finish(&writer);
+	VI_CHECK(check_string(result, "q", 1) == 0);
+	VI_CHECK(ViObject_IS_IMMORTAL(result));
+
+	ViStringWriter_Init(&writer);
+	VI_CHECK(ViStringWriter_Reserve(&writer, 1 << 20) == 0);
+	VI_CHECK(ViStringWriter_WriteString(&writer, "abcd") == 0);
+	result = ViStringWriter_Finish(&writer);
+	VI_CHECK(check_string(result, "abcd", 4) == 0);
+	ViObject_DECREF(result);
+
+	/* Invalid requests and contents */
+	ViStringWriter_Init(&writer);
+	VI_CHECK(ViStringWriter_Reserve(&writer, -1) == -1);
+	VI_CHECK(ViError_Occurred());
+	ViError_Clear();
+	VI_CHECK(ViStringWriter_WriteObject(&writer, ViIntObject_FromInt(3)) == -1);
+	ViError_Clear();
+	VI_CHECK(ViStringWriter_WriteChar(&writer, (char)0xFF) == 0);
+	VI_CHECK(ViStringWriter_Finish(&writer) == NULL);
+	ViError_Clear();
+
+	ViStringWriter_Init(&writer);
+	for (int i = 0; i < 1000; i++)
+		VI_CHECK(ViStringWriter_WriteChar(&writer, 'z') == 0);
+	ViStringWriter_Dealloc(&writer);
+	return 0;
+}
\ No newline at end of file
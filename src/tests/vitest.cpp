@@ -0,0 +1,69 @@
+#include "vitest.h"
+
+typedef struct _testcase
+{
+	const char *name;
+	int (*func)();
+} TestCase;
+
+static TestCase tests[] = {
+	{ "obmalloc", test_obmalloc },
+	{ "freelist", test_freelist },
+	{ "smallint", test_smallint },
+	{ "immortal", test_immortal },
+	{ "varobject", test_varobject },
+	{ "singletons", test_singletons },
+	{ "gc", test_gc },
+	{ "trash", test_trash },
+	{ "arena", test_arena },
+	{ "arenacache", test_arenacache },
+	{ "stats", test_stats },
+	{ "domains", test_domains },
+	{ "trace", test_trace },
+	{ "blocks", test_blocks },
+	{ "quota", test_quota },
+	{ "tagged", test_tagged },
+	{ "bigint", test_bigint },
+	{ "dict", test_dict },
+	{ "hash", test_hash },
+	{ "intern", test_intern },
+	{ "writer", test_writer },
+	{ "rope", test_rope },
+	{ "search", test_search },
+	{ "utf8", test_utf8 },
+	{ "sort", test_sort },
+	{ NULL, NULL }
+};
+
+int main(int argc, char **argv)
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: ViperTests <test>\n");
+		for (TestCase *test = tests; test->name != NULL; test++)
+			fprintf(stderr, "  %s\n", test->name);
+		return 2;
+	}
+
+	for (TestCase *test = tests; test->name != NULL; test++)
+	{
+		if (strcmp(test->name, argv[1]) != 0)
+			continue;
+
+		ViConfig config;
+		ViConfig_InitViperConfig(&config);
+		ViStatus status = Vi_InitializeFromConfig(&config);
+		if (ViStatus_Exception(status))
+		{
+			fprintf(stderr, "Error: %s\n", status.error_msg);
+			return 1;
+		}
+
+		int result = test->func();
+		ViRuntime_Finalize();
+		return result;
+	}
+
+	fprintf(stderr, "unknown test %s\n", argv[1]);
+	return 2;
+}
\ No newline at end of file
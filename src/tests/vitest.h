@@ -0,0 +1,54 @@
+#ifndef __VITEST_H__
+#define __VITEST_H__
+
+#include <cstdio>
+#include <cstring>
+
+#include "../Viper.h"
+
+/*
+ * Tests
+ *
+ * Each test is a function returning 0 when it passes.  ViperTests runs
+ * the test named by its argument in a fresh runtime, ctest runs every
+ * test in its own process.  A failed check prints where it failed and
+ * returns 1 from the test.
+*/
+
+#define VI_CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+			return 1; \
+		} \
+	} while (0)
+
+int test_obmalloc();
+int test_freelist();
+int test_smallint();
+int test_immortal();
+int test_varobject();
+int test_singletons();
+int test_gc();
+int test_trash();
+int test_arena();
+int test_arenacache();
+int test_stats();
+int test_domains();
+int test_trace();
+int test_blocks();
+int test_quota();
+int test_tagged();
+int test_bigint();
+int test_dict();
+int test_hash();
+int test_intern();
+int test_writer();
+int test_rope();
+int test_search();
+int test_utf8();
+int test_sort();
+
+#endif // __VITEST_H__
\ No newline at end of file